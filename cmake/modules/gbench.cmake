@@ -0,0 +1,35 @@
+option(USE_BUNDLED_GBENCH "Enable building of the bundled Google Benchmark" ${USE_BUNDLED_DEPS})
+
+if(GBENCH_INCLUDE_DIR)
+	# we already have Google Benchmark
+elseif(NOT USE_BUNDLED_GBENCH)
+	find_path(GBENCH_INCLUDE_DIR NAMES benchmark/benchmark.h)
+	find_library(GBENCH_LIB NAMES benchmark)
+	if(GBENCH_INCLUDE_DIR AND GBENCH_LIB)
+		message(STATUS "Found Google Benchmark: include: ${GBENCH_INCLUDE_DIR}, lib: ${GBENCH_LIB}")
+	else()
+		message(FATAL_ERROR "Couldn't find system Google Benchmark")
+	endif()
+else()
+	set(GBENCH_SRC "${PROJECT_BINARY_DIR}/gbench-prefix/src/gbench")
+	set(GBENCH_INSTALL_DIR "${PROJECT_BINARY_DIR}/gbench-prefix/install")
+	set(GBENCH_INCLUDE_DIR "${GBENCH_INSTALL_DIR}/include")
+	set(GBENCH_LIB "${GBENCH_INSTALL_DIR}/lib/libbenchmark.a")
+	message(STATUS "Using bundled Google Benchmark in '${GBENCH_SRC}'")
+
+	if(NOT TARGET gbench)
+		ExternalProject_Add(gbench
+			PREFIX "${PROJECT_BINARY_DIR}/gbench-prefix"
+			GIT_REPOSITORY https://github.com/google/benchmark.git
+			GIT_TAG v1.5.6
+			CMAKE_CACHE_ARGS
+				-DCMAKE_INSTALL_PREFIX:PATH=${GBENCH_INSTALL_DIR}
+				-DCMAKE_INSTALL_LIBDIR:PATH=lib
+				-DCMAKE_BUILD_TYPE:STRING=Release
+				-DBENCHMARK_ENABLE_TESTING:BOOL=OFF
+				-DBENCHMARK_ENABLE_GTEST_TESTS:BOOL=OFF
+			BUILD_BYPRODUCTS ${GBENCH_LIB})
+	endif()
+endif()
+
+include_directories("${GBENCH_INCLUDE_DIR}")
@@ -25,6 +25,7 @@ limitations under the License.
 #include <set>
 #include <thread>
 #include <unordered_map>
+#include <vector>
 #include <stdint.h>
 
 namespace sysdig
@@ -40,6 +41,13 @@ namespace sysdig
  * continue to dequeue and process values while the dequeue_next_key() method
  * returns true.
  *
+ * Lookups are served by a pool of worker threads (one by default, see the
+ * num_workers constructor parameter), each running run_impl().  A key is
+ * never handed to two workers at the same time: while one worker is busy
+ * with it, dequeue_next_key() gives the others the next keys in the queue,
+ * so concrete subclasses only need to make the work on distinct keys
+ * thread-safe.
+ *
  * The constructor for this class accepts a maximum wait time; this specifies
  * how long client code is willing to wait for a synchronous response (i.e.,
  * how long the lookup() method will block waiting for the requested value).
@@ -95,8 +103,10 @@ public:
 	 * @param[in] ttl_ms      The time, in milliseconds, that a cached
 	 *                        value will live before being considered
 	 *                        "too old" and being pruned.
+	 * @param[in] num_workers The number of threads looking up values
+	 *                        concurrently.
 	 */
-	async_key_value_source(uint64_t max_wait_ms, uint64_t ttl_ms) noexcept;
+	async_key_value_source(uint64_t max_wait_ms, uint64_t ttl_ms, uint32_t num_workers = 1) noexcept;
 
 	async_key_value_source(const async_key_value_source&) = delete;
 	async_key_value_source(async_key_value_source&&) = delete;
@@ -116,6 +126,11 @@ public:
 	 */
 	uint64_t get_ttl() const;
 
+	/**
+	 * Returns the number of worker threads.
+	 */
+	uint32_t get_num_workers() const;
+
 	/**
 	 * Lookup value(s) based on the given key.  This method will block
 	 * the caller for up the max_wait_ms time specified at construction
@@ -161,8 +176,8 @@ public:
                     const callback_handler& handler = callback_handler());
 
 	/**
-	 * Determines if the async thread associated with this
-	 * async_key_value_source is running.
+	 * Determines if the async threads associated with this
+	 * async_key_value_source are running.
 	 *
 	 * <b>Note:</b> This API is for information only.  Clients should
 	 * not use this to implement any sort of complex behavior.  Such
@@ -170,7 +185,7 @@ public:
 	 * lookup() could potentially race, causing is_running() to return
 	 * false after lookup() has started the thread.
 	 *
-	 * @returns true if the async thread is running, false otherwise.
+	 * @returns true if an async thread is running, false otherwise.
 	 */
 	bool is_running() const;
 
@@ -200,9 +215,9 @@ public:
 
 protected:
 	/**
-	 * Stops the thread associated with this async_key_value_source, if
-	 * it is running; otherwise, does nothing.  The only use for this is
-	 * in a destructor to ensure that the async thread stops when the
+	 * Stops the threads associated with this async_key_value_source, if
+	 * they are running; otherwise, does nothing.  The only use for this is
+	 * in a destructor to ensure that the async threads stop when the
 	 * object is destroyed.
 	 */
 	void stop();
@@ -212,6 +227,10 @@ protected:
 	 * key.  Concrete subclasses will call this method to get the next key
 	 * for which to collect values.
 	 *
+	 * The key returned by the previous call from the same worker is
+	 * considered done; keys still being processed by other workers are
+	 * skipped and left in the queue.
+	 *
 	 * @returns true if there was a key to dequeue, false otherwise.
 	 */
 	bool dequeue_next_key(key_type& key);
@@ -312,9 +331,22 @@ private:
 	 */
 	void prune_stale_requests();
 
+	/**
+	 * Is another worker processing key? Expects m_mutex to be held.
+	 */
+	bool is_in_flight(const key_type& key) const;
+
+	/**
+	 * Mark the key the calling worker was processing as done. Expects
+	 * m_mutex to be held.
+	 */
+	void finish_key();
+
 	uint64_t m_max_wait_ms;
 	uint64_t m_ttl_ms;
-	std::thread m_thread;
+	uint32_t m_num_workers;
+	std::vector<std::thread> m_threads;
+	uint32_t m_running_workers;
 	bool m_running;
 	bool m_terminate;
 
@@ -335,6 +367,12 @@ private:
 	std::priority_queue<queue_item_t, std::vector<queue_item_t>, std::greater<queue_item_t>> m_request_queue;
 	std::set<key_type> m_request_set;
 	value_map m_value_map;
+
+	/** The key each worker is processing */
+	std::map<std::thread::id, key_type> m_in_flight;
+
+	/** Keys requested again while a worker was processing them */
+	std::set<key_type> m_deferred;
 };
 
 
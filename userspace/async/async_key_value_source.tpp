@@ -31,10 +31,13 @@ namespace sysdig
 template<typename key_type, typename value_type>
 async_key_value_source<key_type, value_type>::async_key_value_source(
 		const uint64_t max_wait_ms,
-		const uint64_t ttl_ms) noexcept:
+		const uint64_t ttl_ms,
+		const uint32_t num_workers) noexcept:
 	m_max_wait_ms(max_wait_ms),
 	m_ttl_ms(ttl_ms),
-	m_thread(),
+	m_num_workers(std::max<uint32_t>(num_workers, 1)),
+	m_threads(),
+	m_running_workers(0),
 	m_running(false),
 	m_terminate(false),
 	m_mutex(),
@@ -69,6 +72,12 @@ uint64_t async_key_value_source<key_type, value_type>::get_ttl() const
 	return m_ttl_ms;
 }
 
+template<typename key_type, typename value_type>
+uint32_t async_key_value_source<key_type, value_type>::get_num_workers() const
+{
+	return m_num_workers;
+}
+
 template<typename key_type, typename value_type>
 void async_key_value_source<key_type, value_type>::stop()
 {
@@ -77,24 +86,27 @@ void async_key_value_source<key_type, value_type>::stop()
 	{
 		std::unique_lock<std::mutex> guard(m_mutex);
 
-		if(m_running)
+		if(!m_threads.empty())
 		{
 			m_terminate = true;
 			join_needed = true;
 
-			// The async thread might be waiting for new events
-			// so wake it up
-			m_queue_not_empty_condition.notify_one();
+			// The async threads might be waiting for new events
+			// so wake them up
+			m_queue_not_empty_condition.notify_all();
 		}
 	} // Drop the mutex before join()
 
 	if (join_needed)
 	{
-		m_thread.join();
+		for(auto& thread : m_threads)
+		{
+			thread.join();
+		}
 
-		// Remove any pointers from the thread to this object
+		// Remove any pointers from the threads to this object
 		// (just to be safe)
-		m_thread = std::thread();
+		m_threads.clear();
 	}
 }
 
@@ -110,7 +122,11 @@ bool async_key_value_source<key_type, value_type>::is_running() const
 template<typename key_type, typename value_type>
 void async_key_value_source<key_type, value_type>::run()
 {
-	m_running = true;
+	{
+		std::lock_guard<std::mutex> guard(m_mutex);
+		m_running_workers++;
+		m_running = true;
+	}
 
 	while(!m_terminate)
 	{
@@ -141,12 +157,17 @@ void async_key_value_source<key_type, value_type>::run()
 
 		if(!m_terminate)
 		{
-
 			run_impl();
+
+			// The last key this worker dequeued is done
+			std::lock_guard<std::mutex> guard(m_mutex);
+			finish_key();
 		}
 	}
 
-	m_running = false;
+	std::lock_guard<std::mutex> guard(m_mutex);
+	m_running_workers--;
+	m_running = (m_running_workers != 0);
 }
 
 template<typename key_type, typename value_type>
@@ -158,9 +179,12 @@ bool async_key_value_source<key_type, value_type>::lookup_delayed(
 {
 	std::unique_lock<std::mutex> guard(m_mutex);
 
-	if(!m_running && !m_thread.joinable())
+	if(!m_running && m_threads.empty())
 	{
-		m_thread = std::thread(&async_key_value_source::run, this);
+		for(uint32_t j = 0; j < m_num_workers; j++)
+		{
+			m_threads.emplace_back(&async_key_value_source::run, this);
+		}
 	}
 
 	typename value_map::iterator itr = m_value_map.find(key);
@@ -186,9 +210,7 @@ bool async_key_value_source<key_type, value_type>::lookup_delayed(
 		itr->second.m_value = value;
 
 		// Make request to API and let the async thread know about it
-		if (std::find(m_request_set.begin(),
-		              m_request_set.end(),
-		              key) == m_request_set.end())
+		if (m_request_set.find(key) == m_request_set.end())
 		{
 			auto start_time = std::chrono::steady_clock::now() + delay;
 			m_request_queue.push(std::make_pair(start_time, key));
@@ -252,21 +274,72 @@ bool async_key_value_source<key_type, value_type>::dequeue_next_key(key_type& ke
 	std::lock_guard<std::mutex> guard(m_mutex);
 	bool key_found = false;
 
-	if(!m_request_queue.empty())
+	finish_key();
+
+	const auto now = std::chrono::steady_clock::now();
+	while(!key_found && !m_request_queue.empty())
 	{
 		auto top_element = m_request_queue.top();
-		if(top_element.first < std::chrono::steady_clock::now())
+		if(!(top_element.first < now))
+		{
+			break;
+		}
+
+		m_request_queue.pop();
+
+		if(is_in_flight(top_element.second))
 		{
-			key_found = true;
-			key = std::move(top_element.second);
-			m_request_queue.pop();
-			m_request_set.erase(key);
+			// Requeued by finish_key() once the other worker
+			// is done with it. The key stays in m_request_set
+			// so lookup() doesn't queue it again meanwhile.
+			m_deferred.insert(top_element.second);
+			continue;
 		}
+
+		key_found = true;
+		key = std::move(top_element.second);
+		m_request_set.erase(key);
+		m_in_flight[std::this_thread::get_id()] = key;
 	}
 
 	return key_found;
 }
 
+template<typename key_type, typename value_type>
+bool async_key_value_source<key_type, value_type>::is_in_flight(const key_type& key) const
+{
+	for(const auto& it : m_in_flight)
+	{
+		if(it.second == key)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// called with m_mutex held
+template<typename key_type, typename value_type>
+void async_key_value_source<key_type, value_type>::finish_key()
+{
+	auto it = m_in_flight.find(std::this_thread::get_id());
+	if(it == m_in_flight.end())
+	{
+		return;
+	}
+
+	auto deferred = m_deferred.find(it->second);
+	if(deferred != m_deferred.end())
+	{
+		m_request_queue.push(std::make_pair(std::chrono::steady_clock::now(), *deferred));
+		m_deferred.erase(deferred);
+		m_queue_not_empty_condition.notify_one();
+	}
+
+	m_in_flight.erase(it);
+}
+
 template<typename key_type, typename value_type>
 value_type async_key_value_source<key_type, value_type>::get_value(
 		const key_type& key)
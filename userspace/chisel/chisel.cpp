@@ -34,6 +34,7 @@ limitations under the License.
 #include "sinsp_int.h"
 #include "chisel.h"
 #include "chisel_api.h"
+#include "chisel_batch.h"
 #include "filter.h"
 #include "filterchecks.h"
 #include "table.h"
@@ -135,6 +136,7 @@ const static struct luaL_Reg ll_sysdig [] =
 const static struct luaL_Reg ll_chisel [] =
 {
 	{"request_field", &lua_cbacks::request_field},
+	{"request_batch", &lua_cbacks::request_batch},
 	{"set_filter", &lua_cbacks::set_filter},
 	{"set_event_formatter", &lua_cbacks::set_event_formatter},
 	{"set_interval_ns", &lua_cbacks::set_interval_ns},
@@ -153,6 +155,38 @@ const static struct luaL_Reg ll_evt [] =
 	{"get_cpuid", &lua_cbacks::get_cpuid},
 	{NULL,NULL}
 };
+
+const static struct luaL_Reg ll_batch [] =
+{
+	{"column", &lua_cbacks::batch_column},
+	{"get", &lua_cbacks::batch_get},
+	{"type", &lua_cbacks::batch_type},
+	{"data", &lua_cbacks::batch_data},
+	{"offsets", &lua_cbacks::batch_offsets},
+	{"valid", &lua_cbacks::batch_valid},
+	{NULL,NULL}
+};
+
+//
+// Metatables of the userdata handed to on_batch()
+//
+static void register_batch_types(lua_State* ls)
+{
+	luaL_newmetatable(ls, "sysdig.batch");
+	lua_newtable(ls);
+	luaL_openlib(ls, NULL, ll_batch, 0);
+	lua_setfield(ls, -2, "__index");
+	lua_pushcfunction(ls, &lua_cbacks::batch_len);
+	lua_setfield(ls, -2, "__len");
+	lua_pop(ls, 1);
+
+	luaL_newmetatable(ls, "sysdig.batch_column");
+	lua_pushcfunction(ls, &lua_cbacks::batch_column_index);
+	lua_setfield(ls, -2, "__index");
+	lua_pushcfunction(ls, &lua_cbacks::batch_column_len);
+	lua_setfield(ls, -2, "__len");
+	lua_pop(ls, 1);
+}
 #endif // HAS_LUA_CHISELS
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -253,6 +287,10 @@ sinsp_chisel::sinsp_chisel(sinsp* inspector, string filename)
 	m_lua_has_handle_evt = false;
 	m_lua_is_first_evt = true;
 	m_lua_cinfo = NULL;
+	m_lua_evt = NULL;
+#ifdef HAS_LUA_CHISELS
+	m_lua_batch_ref = LUA_NOREF;
+#endif
 	m_lua_last_interval_sample_time = 0;
 	m_lua_last_interval_ts = 0;
 	m_udp_socket = 0;
@@ -274,6 +312,13 @@ void sinsp_chisel::free_lua_chisel()
 		m_ls = NULL;
 	}
 
+	//
+	// The batch columns point to the filterchecks
+	//
+	m_lua_batch = chisel_batch();
+	m_lua_batch_ref = LUA_NOREF;
+	m_lua_evt = NULL;
+
 	for(uint32_t j = 0; j < m_allocated_fltchecks.size(); j++)
 	{
 		delete m_allocated_fltchecks[j];
@@ -974,7 +1019,8 @@ bool sinsp_chisel::init_lua_chisel(chisel_desc &cd, string const &fpath)
 	//
 	luaL_openlib(ls, "sysdig", ll_sysdig, 0);
 	luaL_openlib(ls, "chisel", ll_chisel, 0);
-	luaL_openlib(ls, "evt", ll_evt, 0);
+	lua_pushlightuserdata(ls, NULL);
+	luaL_openlib(ls, "evt", ll_evt, 1);
 
 	//
 	// Add our chisel paths to package.path
@@ -1211,7 +1257,9 @@ void sinsp_chisel::load(string cmdstr)
 	//
 	luaL_openlib(m_ls, "sysdig", ll_sysdig, 0);
 	luaL_openlib(m_ls, "chisel", ll_chisel, 0);
-	luaL_openlib(m_ls, "evt", ll_evt, 0);
+	lua_pushlightuserdata(m_ls, this);
+	luaL_openlib(m_ls, "evt", ll_evt, 1);
+	register_batch_types(m_ls);
 
 	//
 	// Add our chisel paths to package.path
@@ -1561,8 +1609,7 @@ bool sinsp_chisel::run(sinsp_evt* evt)
 	//
 	// Make the event available to the API
 	//
-	lua_pushlightuserdata(m_ls, evt);
-	lua_setglobal(m_ls, "sievt");
+	m_lua_evt = evt;
 
 	//
 	// If there is a timeout callback, see if it's time to call it
@@ -1581,9 +1628,17 @@ bool sinsp_chisel::run(sinsp_evt* evt)
 	}
 
 	//
-	// If the script has the on_event callback, call it
+	// In batch mode, the fields are extracted now and the script sees
+	// the events when the batch is full
 	//
-	if(m_lua_has_handle_evt)
+	if(m_lua_batch.enabled())
+	{
+		if(m_lua_batch.append(evt))
+		{
+			flush_batch();
+		}
+	}
+	else if(m_lua_has_handle_evt)
 	{
 		lua_getglobal(m_ls, "on_event");
 
@@ -1655,6 +1710,12 @@ void sinsp_chisel::do_timeout(sinsp_evt* evt)
 				}
 			}
 
+			//
+			// The script sees everything that happened before the
+			// interval ends
+			//
+			flush_batch();
+
 			lua_getglobal(m_ls, "on_interval");
 
 			lua_pushnumber(m_ls, (double)(ts / 1000000000));
@@ -1687,6 +1748,8 @@ void sinsp_chisel::do_timeout(sinsp_evt* evt)
 		{
 			uint64_t t;
 
+			flush_batch();
+
 			for(t = m_lua_last_interval_sample_time; t <= ts - interval; t += interval)
 			{
 				lua_getglobal(m_ls, "on_interval");
@@ -1714,9 +1777,50 @@ void sinsp_chisel::do_timeout(sinsp_evt* evt)
 	}
 }
 
+void sinsp_chisel::flush_batch()
+{
+#ifdef HAS_LUA_CHISELS
+	if(m_lua_batch.size() == 0)
+	{
+		return;
+	}
+
+	//
+	// The batch userdata is created once and kept in the registry
+	//
+	if(m_lua_batch_ref == LUA_NOREF)
+	{
+		chisel_batch** ud = (chisel_batch**)lua_newuserdata(m_ls, sizeof(chisel_batch*));
+		*ud = &m_lua_batch;
+		luaL_getmetatable(m_ls, "sysdig.batch");
+		lua_setmetatable(m_ls, -2);
+		m_lua_batch_ref = luaL_ref(m_ls, LUA_REGISTRYINDEX);
+	}
+
+	lua_getglobal(m_ls, "on_batch");
+	lua_rawgeti(m_ls, LUA_REGISTRYINDEX, m_lua_batch_ref);
+
+	int res = lua_pcall(m_ls, 1, 0, 0);
+
+	m_lua_batch.clear();
+
+	if(res != 0)
+	{
+		throw sinsp_exception(m_filename + " chisel error: calling on_batch() failed:" + lua_tostring(m_ls, -1));
+	}
+
+	if(m_lua_cinfo->m_end_capture == true)
+	{
+		throw sinsp_capture_interrupt_exception();
+	}
+#endif // HAS_LUA_CHISELS
+}
+
 void sinsp_chisel::do_end_of_sample()
 {
 #ifdef HAS_LUA_CHISELS
+	flush_batch();
+
 	lua_getglobal(m_ls, "on_end_of_sample");
 
 	if(lua_pcall(m_ls, 0, 1, 0) != 0)
@@ -1764,6 +1868,8 @@ void sinsp_chisel::on_capture_start()
 void sinsp_chisel::on_capture_end()
 {
 #ifdef HAS_LUA_CHISELS
+	flush_batch();
+
 	lua_getglobal(m_ls, "on_capture_end");
 
 	if(lua_isfunction(m_ls, -1))
@@ -17,6 +17,8 @@ limitations under the License.
 
 #pragma once
 
+#include "chisel_batch.h"
+
 /*!
 	\brief Add a new directory containing chisels.
 
@@ -147,6 +149,7 @@ private:
 	static bool parse_view_info(lua_State *ls, OUT chisel_desc* cd);
 	static bool init_lua_chisel(chisel_desc &cd, string const &path);
 	void first_event_inits(sinsp_evt* evt);
+	void flush_batch();
 
 	sinsp* m_inspector;
 	string m_description;
@@ -161,6 +164,9 @@ private:
 	vector<sinsp_filter_check*> m_allocated_fltchecks;
 	char m_lua_fld_storage[PPM_MAX_ARG_SIZE];
 	chiselinfo* m_lua_cinfo;
+	sinsp_evt* m_lua_evt;
+	chisel_batch m_lua_batch;
+	int m_lua_batch_ref;
 	string m_new_chisel_to_exec;
 	int m_udp_socket;
 	struct sockaddr_in m_serveraddr;
@@ -34,6 +34,7 @@ limitations under the License.
 #include "sinsp_int.h"
 #include "chisel.h"
 #include "chisel_api.h"
+#include "chisel_batch.h"
 #include "filter.h"
 #include "filterchecks.h"
 #ifdef HAS_ANALYZER
@@ -203,11 +204,20 @@ uint32_t lua_cbacks::rawval_to_lua_stack(lua_State *ls, uint8_t* rawval, ppm_par
 	}
 }
 
+//
+// The evt library functions get the chisel as upvalue, which saves a
+// global lookup on every call
+//
+sinsp_evt* lua_cbacks::get_evt(lua_State *ls)
+{
+	sinsp_chisel* ch = (sinsp_chisel*)lua_touserdata(ls, lua_upvalueindex(1));
+
+	return (ch != NULL) ? ch->m_lua_evt : NULL;
+}
+
 int lua_cbacks::get_num(lua_State *ls)
 {
-	lua_getglobal(ls, "sievt");
-	sinsp_evt* evt = (sinsp_evt*)lua_touserdata(ls, -1);
-	lua_pop(ls, 1);
+	sinsp_evt* evt = get_evt(ls);
 
 	if(evt == NULL)
 	{
@@ -222,9 +232,7 @@ int lua_cbacks::get_num(lua_State *ls)
 
 int lua_cbacks::get_ts(lua_State *ls)
 {
-	lua_getglobal(ls, "sievt");
-	sinsp_evt* evt = (sinsp_evt*)lua_touserdata(ls, -1);
-	lua_pop(ls, 1);
+	sinsp_evt* evt = get_evt(ls);
 
 	if(evt == NULL)
 	{
@@ -242,9 +250,7 @@ int lua_cbacks::get_ts(lua_State *ls)
 
 int lua_cbacks::get_type(lua_State *ls)
 {
-	lua_getglobal(ls, "sievt");
-	sinsp_evt* evt = (sinsp_evt*)lua_touserdata(ls, -1);
-	lua_pop(ls, 1);
+	sinsp_evt* evt = get_evt(ls);
 
 	if(evt == NULL)
 	{
@@ -276,9 +282,7 @@ int lua_cbacks::get_type(lua_State *ls)
 
 int lua_cbacks::get_cpuid(lua_State *ls)
 {
-	lua_getglobal(ls, "sievt");
-	sinsp_evt* evt = (sinsp_evt*)lua_touserdata(ls, -1);
-	lua_pop(ls, 1);
+	sinsp_evt* evt = get_evt(ls);
 
 	if(evt == NULL)
 	{
@@ -323,6 +327,7 @@ int lua_cbacks::request_field(lua_State *ls)
 	}
 
 	chk->parse_field_name(fld, true, false);
+	inspector->get_field_cache().attach(chk, fld);
 
 	lua_pushlightuserdata(ls, chk);
 
@@ -333,9 +338,7 @@ int lua_cbacks::request_field(lua_State *ls)
 
 int lua_cbacks::field(lua_State *ls)
 {
-	lua_getglobal(ls, "sievt");
-	sinsp_evt* evt = (sinsp_evt*)lua_touserdata(ls, -1);
-	lua_pop(ls, 1);
+	sinsp_evt* evt = get_evt(ls);
 
 	if(evt == NULL)
 	{
@@ -356,7 +359,7 @@ int lua_cbacks::field(lua_State *ls)
 	}
 
 	uint32_t vlen;
-	uint8_t* rawval = chk->extract(evt, &vlen);
+	uint8_t* rawval = chk->extract_cached(evt, &vlen);
 
 	if(rawval != NULL)
 	{
@@ -369,6 +372,239 @@ int lua_cbacks::field(lua_State *ls)
 	}
 }
 
+int lua_cbacks::request_batch(lua_State *ls)
+{
+	lua_getglobal(ls, "sichisel");
+
+	sinsp_chisel* ch = (sinsp_chisel*)lua_touserdata(ls, -1);
+	lua_pop(ls, 1);
+
+	ASSERT(ch);
+
+	lua_getglobal(ls, "on_batch");
+	bool has_on_batch = lua_isfunction(ls, -1);
+	lua_pop(ls, 1);
+
+	if(!has_on_batch)
+	{
+		string err = "chisel requesting a batch without an on_batch() function";
+		fprintf(stderr, "%s\n", err.c_str());
+		throw sinsp_exception("chisel error");
+	}
+
+	if(ch->m_lua_batch.enabled())
+	{
+		string err = "chisel requesting a batch twice";
+		fprintf(stderr, "%s\n", err.c_str());
+		throw sinsp_exception("chisel error");
+	}
+
+	int64_t size = (int64_t)lua_tonumber(ls, 1);
+
+	if(size <= 0 || !lua_istable(ls, 2))
+	{
+		string err = "wrong arguments for chisel.request_batch(), expected a size and a table of fields";
+		fprintf(stderr, "%s\n", err.c_str());
+		throw sinsp_exception("chisel error");
+	}
+
+	chisel_batch batch;
+
+	try
+	{
+		for(int j = 1; ; j++)
+		{
+			lua_rawgeti(ls, 2, j);
+			if(lua_isnil(ls, -1))
+			{
+				lua_pop(ls, 1);
+				break;
+			}
+
+			sinsp_filter_check* chk = (sinsp_filter_check*)lua_touserdata(ls, -1);
+			lua_pop(ls, 1);
+
+			if(chk == NULL)
+			{
+				throw sinsp_exception("batch fields must come from chisel.request_field()");
+			}
+
+			batch.add_column(chk);
+		}
+
+		if(batch.get_n_columns() == 0)
+		{
+			throw sinsp_exception("no fields");
+		}
+
+		batch.set_capacity((uint32_t)size);
+	}
+	catch(const sinsp_exception& e)
+	{
+		string err = "invalid batch in chisel " + ch->m_filename + ": " + e.what();
+		fprintf(stderr, "%s\n", err.c_str());
+		throw sinsp_exception("chisel error");
+	}
+
+	ch->m_lua_batch = batch;
+
+	return 0;
+}
+
+struct lua_batch_column
+{
+	chisel_batch* m_batch;
+	uint32_t m_col;
+};
+
+chisel_batch* lua_cbacks::check_batch(lua_State *ls)
+{
+	return *(chisel_batch**)luaL_checkudata(ls, 1, "sysdig.batch");
+}
+
+uint32_t lua_cbacks::check_batch_column(lua_State *ls, chisel_batch* batch)
+{
+	int64_t col = (int64_t)lua_tonumber(ls, 2);
+
+	if(col < 1 || col > batch->get_n_columns())
+	{
+		string err = "invalid batch column " + to_string((long long) col);
+		fprintf(stderr, "%s\n", err.c_str());
+		throw sinsp_exception("chisel error");
+	}
+
+	return (uint32_t)(col - 1);
+}
+
+int lua_cbacks::batch_value_to_lua_stack(lua_State *ls, chisel_batch* batch, uint32_t col, int64_t row)
+{
+	if(row < 1 || row > batch->size() || !batch->is_valid(col, (uint32_t)(row - 1)))
+	{
+		lua_pushnil(ls);
+		return 1;
+	}
+
+	uint32_t j = (uint32_t)(row - 1);
+
+	switch(batch->get_type(col))
+	{
+	case chisel_batch::COL_INT64:
+		lua_pushnumber(ls, (double)batch->get_int64(col, j));
+		break;
+	case chisel_batch::COL_UINT64:
+		lua_pushnumber(ls, (double)batch->get_uint64(col, j));
+		break;
+	case chisel_batch::COL_DOUBLE:
+		lua_pushnumber(ls, batch->get_double(col, j));
+		break;
+	case chisel_batch::COL_BOOL:
+		lua_pushboolean(ls, batch->get_uint64(col, j) != 0);
+		break;
+	case chisel_batch::COL_STRING:
+		{
+			uint32_t len;
+			const char* str = batch->get_string(col, j, &len);
+			lua_pushlstring(ls, str, len);
+		}
+		break;
+	default:
+		ASSERT(false);
+		lua_pushnil(ls);
+		break;
+	}
+
+	return 1;
+}
+
+int lua_cbacks::batch_len(lua_State *ls)
+{
+	chisel_batch* batch = check_batch(ls);
+
+	lua_pushnumber(ls, batch->size());
+	return 1;
+}
+
+int lua_cbacks::batch_column(lua_State *ls)
+{
+	chisel_batch* batch = check_batch(ls);
+	uint32_t col = check_batch_column(ls, batch);
+
+	lua_batch_column* view = (lua_batch_column*)lua_newuserdata(ls, sizeof(lua_batch_column));
+	view->m_batch = batch;
+	view->m_col = col;
+	luaL_getmetatable(ls, "sysdig.batch_column");
+	lua_setmetatable(ls, -2);
+	return 1;
+}
+
+int lua_cbacks::batch_get(lua_State *ls)
+{
+	chisel_batch* batch = check_batch(ls);
+	uint32_t col = check_batch_column(ls, batch);
+
+	return batch_value_to_lua_stack(ls, batch, col, (int64_t)lua_tonumber(ls, 3));
+}
+
+int lua_cbacks::batch_type(lua_State *ls)
+{
+	chisel_batch* batch = check_batch(ls);
+	uint32_t col = check_batch_column(ls, batch);
+
+	lua_pushstring(ls, chisel_batch::type_to_string(batch->get_type(col)));
+	return 1;
+}
+
+int lua_cbacks::batch_data(lua_State *ls)
+{
+	chisel_batch* batch = check_batch(ls);
+	uint32_t col = check_batch_column(ls, batch);
+
+	lua_pushlightuserdata(ls, (void*)batch->get_data(col));
+	return 1;
+}
+
+int lua_cbacks::batch_offsets(lua_State *ls)
+{
+	chisel_batch* batch = check_batch(ls);
+	uint32_t col = check_batch_column(ls, batch);
+
+	const uint32_t* offsets = batch->get_offsets(col);
+	if(offsets == NULL)
+	{
+		lua_pushnil(ls);
+	}
+	else
+	{
+		lua_pushlightuserdata(ls, (void*)offsets);
+	}
+
+	return 1;
+}
+
+int lua_cbacks::batch_valid(lua_State *ls)
+{
+	chisel_batch* batch = check_batch(ls);
+	uint32_t col = check_batch_column(ls, batch);
+
+	lua_pushlightuserdata(ls, (void*)batch->get_valid(col));
+	return 1;
+}
+
+int lua_cbacks::batch_column_index(lua_State *ls)
+{
+	lua_batch_column* view = (lua_batch_column*)luaL_checkudata(ls, 1, "sysdig.batch_column");
+
+	return batch_value_to_lua_stack(ls, view->m_batch, view->m_col, (int64_t)lua_tonumber(ls, 2));
+}
+
+int lua_cbacks::batch_column_len(lua_State *ls)
+{
+	lua_batch_column* view = (lua_batch_column*)luaL_checkudata(ls, 1, "sysdig.batch_column");
+
+	lua_pushnumber(ls, view->m_batch->size());
+	return 1;
+}
+
 int lua_cbacks::set_global_filter(lua_State *ls)
 {
 	lua_getglobal(ls, "sichisel");
@@ -17,6 +17,8 @@ limitations under the License.
 
 #pragma once
 
+class chisel_batch;
+
 class lua_cbacks
 {
 public:
@@ -28,6 +30,16 @@ public:
 	static int get_cpuid(lua_State *ls);
 	static int request_field(lua_State *ls);
 	static int field(lua_State *ls);
+	static int request_batch(lua_State *ls);
+	static int batch_len(lua_State *ls);
+	static int batch_column(lua_State *ls);
+	static int batch_get(lua_State *ls);
+	static int batch_type(lua_State *ls);
+	static int batch_data(lua_State *ls);
+	static int batch_offsets(lua_State *ls);
+	static int batch_valid(lua_State *ls);
+	static int batch_column_index(lua_State *ls);
+	static int batch_column_len(lua_State *ls);
 	static int set_global_filter(lua_State *ls);
 	static int set_filter(lua_State *ls);
 	static int set_snaplen(lua_State *ls);
@@ -66,6 +78,10 @@ public:
 	static int push_metric(lua_State *ls);
 #endif
 private:
+	static sinsp_evt* get_evt(lua_State *ls);
+	static chisel_batch* check_batch(lua_State *ls);
+	static uint32_t check_batch_column(lua_State *ls, chisel_batch* batch);
+	static int batch_value_to_lua_stack(lua_State *ls, chisel_batch* batch, uint32_t col, int64_t row);
 	static int get_thread_table_int(lua_State *ls, bool include_fds, bool barebone);
 };
 
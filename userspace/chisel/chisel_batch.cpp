@@ -0,0 +1,328 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#endif
+
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "filterchecks.h"
+#include "chisel_batch.h"
+
+#define CHISEL_BATCH_DEFAULT_CAPACITY 1024
+
+chisel_batch::chisel_batch():
+	m_capacity(CHISEL_BATCH_DEFAULT_CAPACITY),
+	m_size(0)
+{
+}
+
+const char* chisel_batch::type_to_string(column_type type)
+{
+	switch(type)
+	{
+	case COL_INT64:
+		return "int64";
+	case COL_UINT64:
+		return "uint64";
+	case COL_DOUBLE:
+		return "double";
+	case COL_BOOL:
+		return "bool";
+	case COL_STRING:
+		return "string";
+	default:
+		ASSERT(false);
+		return "unknown";
+	}
+}
+
+void chisel_batch::add_column(sinsp_filter_check* chk)
+{
+	column c;
+	c.m_chk = chk;
+	c.m_ptype = chk->get_field_info()->m_type;
+
+	//
+	// Same mapping as lua_cbacks::rawval_to_lua_stack()
+	//
+	switch(c.m_ptype)
+	{
+	case PT_INT8:
+	case PT_INT16:
+	case PT_INT32:
+	case PT_INT64:
+	case PT_ERRNO:
+	case PT_PID:
+	case PT_FD:
+		c.m_type = COL_INT64;
+		break;
+	case PT_L4PROTO:
+	case PT_FLAGS8:
+	case PT_UINT8:
+	case PT_PORT:
+	case PT_FLAGS16:
+	case PT_UINT16:
+	case PT_FLAGS32:
+	case PT_UINT32:
+	case PT_MODE:
+	case PT_UID:
+	case PT_GID:
+	case PT_UINT64:
+	case PT_RELTIME:
+	case PT_ABSTIME:
+		c.m_type = COL_UINT64;
+		break;
+	case PT_DOUBLE:
+		c.m_type = COL_DOUBLE;
+		break;
+	case PT_BOOL:
+		c.m_type = COL_BOOL;
+		break;
+	case PT_CHARBUF:
+	case PT_FSPATH:
+	case PT_FSRELPATH:
+	case PT_BYTEBUF:
+	case PT_IPV4ADDR:
+	case PT_IPV6ADDR:
+	case PT_IPADDR:
+		c.m_type = COL_STRING;
+		break;
+	default:
+		throw sinsp_exception("field " + string(chk->get_field_info()->m_name) +
+			" can't be part of a batch");
+	}
+
+	m_columns.push_back(c);
+	reserve(m_columns.back());
+	clear();
+}
+
+void chisel_batch::set_capacity(uint32_t capacity)
+{
+	if(capacity == 0)
+	{
+		throw sinsp_exception("invalid batch size 0");
+	}
+
+	m_capacity = capacity;
+
+	for(column& c : m_columns)
+	{
+		reserve(c);
+	}
+}
+
+void chisel_batch::reserve(column& c)
+{
+	c.m_valid.reserve(m_capacity);
+
+	switch(c.m_type)
+	{
+	case COL_INT64:
+		c.m_i64.reserve(m_capacity);
+		break;
+	case COL_UINT64:
+	case COL_BOOL:
+		c.m_u64.reserve(m_capacity);
+		break;
+	case COL_DOUBLE:
+		c.m_dbl.reserve(m_capacity);
+		break;
+	case COL_STRING:
+		c.m_offsets.reserve(m_capacity + 1);
+		break;
+	}
+}
+
+void chisel_batch::clear()
+{
+	m_size = 0;
+
+	//
+	// clear() keeps the capacity, after the first batches we don't
+	// allocate anymore
+	//
+	for(column& c : m_columns)
+	{
+		c.m_valid.clear();
+		c.m_i64.clear();
+		c.m_u64.clear();
+		c.m_dbl.clear();
+		c.m_offsets.clear();
+		c.m_chars.clear();
+
+		if(c.m_type == COL_STRING)
+		{
+			c.m_offsets.push_back(0);
+		}
+	}
+}
+
+bool chisel_batch::append(sinsp_evt* evt)
+{
+	for(column& c : m_columns)
+	{
+		uint32_t len;
+		uint8_t* rawval = c.m_chk->extract_cached(evt, &len);
+
+		c.m_valid.push_back(rawval != NULL);
+
+		if(rawval == NULL)
+		{
+			//
+			// Keep the columns aligned
+			//
+			switch(c.m_type)
+			{
+			case COL_INT64:
+				c.m_i64.push_back(0);
+				break;
+			case COL_UINT64:
+			case COL_BOOL:
+				c.m_u64.push_back(0);
+				break;
+			case COL_DOUBLE:
+				c.m_dbl.push_back(0);
+				break;
+			case COL_STRING:
+				append_string(c, "", 0);
+				break;
+			}
+
+			continue;
+		}
+
+		append_value(c, rawval, len);
+	}
+
+	return ++m_size >= m_capacity;
+}
+
+void chisel_batch::append_string(column& c, const char* str, uint32_t len)
+{
+	c.m_chars.insert(c.m_chars.end(), str, str + len);
+	c.m_chars.push_back(0);
+	c.m_offsets.push_back((uint32_t)c.m_chars.size());
+}
+
+void chisel_batch::append_value(column& c, const uint8_t* rawval, uint32_t len)
+{
+	switch(c.m_ptype)
+	{
+	case PT_INT8:
+		c.m_i64.push_back(*(int8_t*)rawval);
+		break;
+	case PT_INT16:
+		c.m_i64.push_back(*(int16_t*)rawval);
+		break;
+	case PT_INT32:
+		c.m_i64.push_back(*(int32_t*)rawval);
+		break;
+	case PT_INT64:
+	case PT_ERRNO:
+	case PT_PID:
+	case PT_FD:
+		c.m_i64.push_back(*(int64_t*)rawval);
+		break;
+	case PT_L4PROTO:
+	case PT_FLAGS8:
+	case PT_UINT8:
+		c.m_u64.push_back(*(uint8_t*)rawval);
+		break;
+	case PT_PORT:
+	case PT_FLAGS16:
+	case PT_UINT16:
+		c.m_u64.push_back(*(uint16_t*)rawval);
+		break;
+	case PT_FLAGS32:
+	case PT_UINT32:
+	case PT_MODE:
+	case PT_UID:
+	case PT_GID:
+		c.m_u64.push_back(*(uint32_t*)rawval);
+		break;
+	case PT_UINT64:
+	case PT_RELTIME:
+	case PT_ABSTIME:
+		c.m_u64.push_back(*(uint64_t*)rawval);
+		break;
+	case PT_DOUBLE:
+		c.m_dbl.push_back(*(double*)rawval);
+		break;
+	case PT_BOOL:
+		c.m_u64.push_back(*(uint32_t*)rawval != 0);
+		break;
+	case PT_CHARBUF:
+	case PT_FSPATH:
+	case PT_FSRELPATH:
+	case PT_BYTEBUF:
+		append_string(c, (const char*)rawval, len);
+		break;
+	case PT_IPV4ADDR:
+	case PT_IPV6ADDR:
+	case PT_IPADDR:
+		{
+			char address[INET6_ADDRSTRLEN];
+			int af = (c.m_ptype == PT_IPV6ADDR || len == sizeof(ipv6addr)) ? AF_INET6 : AF_INET;
+
+			if(inet_ntop(af, rawval, address, sizeof(address)) == NULL)
+			{
+				strcpy(address, "<NA>");
+			}
+
+			append_string(c, address, (uint32_t)strlen(address));
+		}
+		break;
+	default:
+		ASSERT(false);
+		break;
+	}
+}
+
+const void* chisel_batch::get_data(uint32_t col) const
+{
+	const column& c = m_columns[col];
+
+	switch(c.m_type)
+	{
+	case COL_INT64:
+		return c.m_i64.data();
+	case COL_UINT64:
+	case COL_BOOL:
+		return c.m_u64.data();
+	case COL_DOUBLE:
+		return c.m_dbl.data();
+	case COL_STRING:
+		return c.m_chars.data();
+	default:
+		ASSERT(false);
+		return NULL;
+	}
+}
+
+const uint32_t* chisel_batch::get_offsets(uint32_t col) const
+{
+	const column& c = m_columns[col];
+	return (c.m_type == COL_STRING) ? c.m_offsets.data() : NULL;
+}
+
+const uint8_t* chisel_batch::get_valid(uint32_t col) const
+{
+	return m_columns[col].m_valid.data();
+}
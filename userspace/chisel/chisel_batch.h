@@ -0,0 +1,176 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+class sinsp_evt;
+class sinsp_filter_check;
+
+///////////////////////////////////////////////////////////////////////////////
+// A batch of events with the fields requested by a chisel already extracted,
+// one typed column per field.
+//
+// Chisels opt in with chisel.request_batch(size, {fld1, fld2, ...}), passing
+// the handles returned by chisel.request_field(), and get on_batch(batch)
+// called instead of on_event() every size events (and before on_interval(),
+// on_end_of_sample() and on_capture_end(), with whatever is pending).
+//
+// From Lua, a batch is a userdata:
+//
+//   #batch                 number of events
+//   batch:column(c)        a view on the c-th field, indexable with the
+//                          event number and with a length: col[i], #col
+//   batch:get(c, i)        same as batch:column(c)[i]
+//   batch:type(c)          "int64", "uint64", "double", "bool" or "string"
+//
+// Values the field didn't have for an event are nil. Views are only valid
+// until on_batch() returns.
+//
+// With LuaJIT, the columns can be read in place through the FFI:
+//
+//   batch:data(c)          pointer to the values: int64_t*, uint64_t* (also
+//                          for bools, 0 or 1) or double*. For strings, a
+//                          char* to NUL terminated strings, one after the
+//                          other.
+//   batch:offsets(c)       for strings, uint32_t* with the offset of each
+//                          string in data
+//   batch:valid(c)         uint8_t*, 0 where the field had no value
+//
+//   local pids = ffi.cast("int64_t*", batch:data(1))
+//   for i = 0, #batch - 1 do ... pids[i] ... end
+///////////////////////////////////////////////////////////////////////////////
+class chisel_batch
+{
+public:
+	enum column_type
+	{
+		COL_INT64 = 0,
+		COL_UINT64,
+		COL_DOUBLE,
+		COL_BOOL,
+		COL_STRING,
+	};
+
+	chisel_batch();
+
+	//
+	// Throws if the field type can't be stored in a column
+	//
+	void add_column(sinsp_filter_check* chk);
+	void set_capacity(uint32_t capacity);
+
+	//
+	// Extract the fields of evt into a new row. Returns true when the
+	// batch is full.
+	//
+	bool append(sinsp_evt* evt);
+	void clear();
+
+	inline bool enabled() const
+	{
+		return !m_columns.empty();
+	}
+
+	inline uint32_t size() const
+	{
+		return m_size;
+	}
+
+	inline uint32_t get_capacity() const
+	{
+		return m_capacity;
+	}
+
+	inline uint32_t get_n_columns() const
+	{
+		return (uint32_t)m_columns.size();
+	}
+
+	inline column_type get_type(uint32_t col) const
+	{
+		return m_columns[col].m_type;
+	}
+
+	static const char* type_to_string(column_type type);
+
+	//
+	// Raw access, for the FFI
+	//
+	const void* get_data(uint32_t col) const;
+	const uint32_t* get_offsets(uint32_t col) const;
+	const uint8_t* get_valid(uint32_t col) const;
+
+	//
+	// Typed access to row j of col. The caller checks is_valid() and uses
+	// the accessor that matches the column type.
+	//
+	inline bool is_valid(uint32_t col, uint32_t j) const
+	{
+		return m_columns[col].m_valid[j] != 0;
+	}
+
+	inline int64_t get_int64(uint32_t col, uint32_t j) const
+	{
+		return m_columns[col].m_i64[j];
+	}
+
+	inline uint64_t get_uint64(uint32_t col, uint32_t j) const
+	{
+		return m_columns[col].m_u64[j];
+	}
+
+	inline double get_double(uint32_t col, uint32_t j) const
+	{
+		return m_columns[col].m_dbl[j];
+	}
+
+	inline const char* get_string(uint32_t col, uint32_t j, uint32_t* len) const
+	{
+		const column& c = m_columns[col];
+		*len = c.m_offsets[j + 1] - c.m_offsets[j] - 1;
+		return &c.m_chars[c.m_offsets[j]];
+	}
+
+private:
+	struct column
+	{
+		sinsp_filter_check* m_chk;
+		uint32_t m_ptype;
+		column_type m_type;
+		std::vector<uint8_t> m_valid;
+		std::vector<int64_t> m_i64;
+		std::vector<uint64_t> m_u64;
+		std::vector<double> m_dbl;
+		//
+		// Strings are stored back to back, the offsets have one more
+		// entry than the rows so that lengths come for free
+		//
+		std::vector<uint32_t> m_offsets;
+		std::vector<char> m_chars;
+	};
+
+	void append_value(column& c, const uint8_t* rawval, uint32_t len);
+	void append_string(column& c, const char* str, uint32_t len);
+	void reserve(column& c);
+
+	std::vector<column> m_columns;
+	uint32_t m_capacity;
+	uint32_t m_size;
+};
@@ -49,6 +49,7 @@ typedef struct wh_t wh_t;
 #define gztell(F) ftell(F)
 #define gzerror(F, E) ({*E = ferror(F); "error reading file descriptor";})
 #define gzseek fseek
+#define gzdirect(F) 1
 #endif
 
 //
@@ -109,6 +110,18 @@ typedef struct scap_tid
 	UT_hash_handle hh; ///< makes this structure hashable
 } scap_tid;
 
+//
+// The start time of a thread in a warm restart state file, in clock ticks
+// after boot
+//
+typedef struct scap_warm_starttime
+{
+	int64_t tid;
+	uint64_t starttime;
+
+	UT_hash_handle hh; ///< makes this structure hashable
+} scap_warm_starttime;
+
 //
 // The open instance handle
 //
@@ -143,6 +156,10 @@ struct scap
 	bool refresh_proc_table_when_saving;
 	uint32_t m_fd_lookup_limit;
 	uint64_t m_unexpected_block_readsize;
+	bool m_stop_at_checkpoints;
+	// Loaded from a warm restart state file, consumed by the /proc scan
+	scap_threadinfo* m_warm_proclist;
+	scap_warm_starttime* m_warm_starttimes;
 	uint32_t m_ncpus;
 	// Abstraction layer for windows
 #if CYGWING_AGENT || _WIN32
@@ -153,6 +170,13 @@ struct scap
 	bool m_bpf;
 	bool m_udig;
 	bool m_udig_capturing;
+#ifndef _WIN32
+	// The udig producer rings, see udig_rings.h
+	int m_udig_rings_descs_fd;
+	int m_udig_rings_buf_fd;
+	struct udig_rings* m_udig_rings;
+	uint8_t* m_udig_rings_buf;
+#endif
 	// Anonymous struct with bpf stuff
 	struct
 	{
@@ -266,6 +290,14 @@ void scap_fd_remove(scap_t* handle, scap_threadinfo* pi, int64_t fd);
 int32_t scap_next_offline(scap_t* handle, OUT scap_evt** pevent, OUT uint16_t* pcpuid);
 // read the file descriptors for a given process directory
 int32_t scap_fd_scan_fd_dir(scap_t* handle, char * procdir, scap_threadinfo* pi, struct scap_ns_socket_list** sockets_by_ns, uint64_t* num_fds_ret, char *error);
+// the same, taking the fds still open on the same inode from warm_fds instead of reading them
+int32_t scap_fd_scan_fd_dir_warm(scap_t* handle, char * procdir, scap_threadinfo* pi, scap_fdinfo** warm_fds, struct scap_ns_socket_list** sockets_by_ns, uint64_t* num_fds_ret, char *error);
+// Load the thread and fd tables of a warm restart state file for the /proc scan to reconcile
+int32_t scap_load_warm_state(scap_t* handle, const char* fname);
+// Free what the /proc scan didn't take from the warm restart state
+void scap_free_warm_state(scap_t* handle);
+// get the start time of a thread, in clock ticks after boot
+int32_t scap_proc_get_starttime(scap_t* handle, const char* procdirname, int64_t tid, uint64_t* starttime);
 // read tcp or udp sockets from the proc filesystem
 int32_t scap_fd_read_ipv4_sockets_from_proc_fs(scap_t* handle, const char * dir, int l4proto, scap_fdinfo ** sockets);
 // read all sockets and add them to the socket table hashed by their ino
@@ -388,6 +420,9 @@ void udig_end_capture(scap_t* handle);
 uint32_t udig_set_snaplen(scap_t* handle, uint32_t snaplen);
 int32_t udig_stop_dropping_mode(scap_t* handle);
 int32_t udig_start_dropping_mode(scap_t* handle, uint32_t sampling_ratio);
+#ifndef _WIN32
+void udig_update_ndevs(scap_t* handle);
+#endif
 
 #ifdef __cplusplus
 }
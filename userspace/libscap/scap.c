@@ -45,6 +45,7 @@ limitations under the License.
 #include "scap-int.h"
 #if defined(HAS_CAPTURE) && !defined(_WIN32) && !defined(CYGWING_AGENT)
 #include "scap_bpf.h"
+#include "udig_rings.h"
 #endif
 
 #if defined(_WIN32) || defined(CYGWING_AGENT)
@@ -96,7 +97,8 @@ scap_t* scap_open_live_int(char *error, int32_t *rc,
 			   const char **suppressed_comms,
 			   void(*debug_log_fn)(const char* msg),
 			   uint64_t proc_scan_timeout_ms,
-			   uint64_t proc_scan_log_interval_ms)
+			   uint64_t proc_scan_log_interval_ms,
+			   const char *warm_state_file)
 {
 	snprintf(error, SCAP_LASTERR_SIZE, "live capture not supported on %s", PLATFORM_NAME);
 	*rc = SCAP_NOT_SUPPORTED;
@@ -112,7 +114,8 @@ scap_t* scap_open_udig_int(char *error, int32_t *rc,
 			   const char **suppressed_comms,
 			   void(*debug_log_fn)(const char* msg),
 			   uint64_t proc_scan_timeout_ms,
-			   uint64_t proc_scan_log_interval_ms)
+			   uint64_t proc_scan_log_interval_ms,
+			   const char *warm_state_file)
 {
 	snprintf(error, SCAP_LASTERR_SIZE, "udig capture not supported on %s", PLATFORM_NAME);
 	*rc = SCAP_NOT_SUPPORTED;
@@ -150,7 +153,8 @@ scap_t* scap_open_live_int(char *error, int32_t *rc,
 			   const char **suppressed_comms,
 			   void(*debug_log_fn)(const char* msg),
 			   uint64_t proc_scan_timeout_ms,
-			   uint64_t proc_scan_log_interval_ms)
+			   uint64_t proc_scan_log_interval_ms,
+			   const char *warm_state_file)
 {
 	uint32_t j;
 	char filename[SCAP_MAX_PATH_SIZE];
@@ -443,8 +447,14 @@ scap_t* scap_open_live_int(char *error, int32_t *rc,
 	}
 
 	//
-	// Create the process list
+	// Create the process list, starting from the state saved by a previous
+	// run if any
 	//
+	if(warm_state_file != NULL)
+	{
+		scap_load_warm_state(handle, warm_state_file);
+	}
+
 	error[0] = '\0';
 	snprintf(filename, sizeof(filename), "%s/proc", scap_get_host_root());
 	if((*rc = scap_proc_scan_proc_dir(handle, filename, error)) != SCAP_SUCCESS)
@@ -475,10 +485,14 @@ scap_t* scap_open_udig_int(char *error, int32_t *rc,
 			   const char **suppressed_comms,
 			   void(*debug_log_fn)(const char* msg),
 			   uint64_t proc_scan_timeout_ms,
-			   uint64_t proc_scan_log_interval_ms)
+			   uint64_t proc_scan_log_interval_ms,
+			   const char *warm_state_file)
 {
 	char filename[SCAP_MAX_PATH_SIZE];
 	scap_t* handle = NULL;
+#ifndef _WIN32
+	uint32_t j;
+#endif
 
 	//
 	// Allocate the handle
@@ -505,7 +519,18 @@ scap_t* scap_open_udig_int(char *error, int32_t *rc,
 
 	handle->m_ndevs = 1;
 
+	//
+	// Device 0 is the shared ring, the others the producer rings
+	//
+#ifndef _WIN32
+	handle->m_devs = (scap_device*) calloc(sizeof(scap_device), 1 + UDIG_MAX_PRODUCER_RINGS);
+	handle->m_udig_rings_descs_fd = -1;
+	handle->m_udig_rings_buf_fd = -1;
+	handle->m_udig_rings = NULL;
+	handle->m_udig_rings_buf = NULL;
+#else
 	handle->m_devs = (scap_device*) calloc(sizeof(scap_device), handle->m_ndevs);
+#endif
 	if(!handle->m_devs)
 	{
 		scap_close(handle);
@@ -645,6 +670,42 @@ scap_t* scap_open_udig_int(char *error, int32_t *rc,
 		return NULL;
 	}
 
+#ifndef _WIN32
+	//
+	// Map the producer rings
+	//
+	if(udig_alloc_producer_rings(&handle->m_udig_rings_descs_fd,
+		&handle->m_udig_rings_buf_fd,
+		&handle->m_udig_rings,
+		&handle->m_udig_rings_buf,
+		error) != SCAP_SUCCESS)
+	{
+		handle->m_udig_rings = NULL;
+		scap_close(handle);
+		*rc = SCAP_FAILURE;
+		return NULL;
+	}
+
+	for(j = 0; j < handle->m_udig_rings->m_nrings; j++)
+	{
+		scap_device* dev = &handle->m_devs[1 + j];
+
+		dev->m_fd = -1;
+		dev->m_bufinfo_fd = -1;
+		dev->m_buffer = (char*)udig_producer_ring_buffer(handle->m_udig_rings, handle->m_udig_rings_buf, j);
+		dev->m_buffer_size = handle->m_udig_rings->m_ring_size;
+		dev->m_bufinfo = &handle->m_udig_rings->m_rings[j].m_info;
+		dev->m_bufstatus = handle->m_devs[0].m_bufstatus;
+		dev->m_lastreadsize = 0;
+		dev->m_sn_len = 0;
+	}
+
+	//
+	// The producer rings become devices once claimed, see udig_update_ndevs()
+	//
+	handle->m_ndevs = 1;
+#endif
+
 	//
 	// Additional initializations
 	//
@@ -653,8 +714,14 @@ scap_t* scap_open_udig_int(char *error, int32_t *rc,
 	scap_stop_dropping_mode(handle);
 
 	//
-	// Create the process list
+	// Create the process list, starting from the state saved by a previous
+	// run if any
 	//
+	if(warm_state_file != NULL)
+	{
+		scap_load_warm_state(handle, warm_state_file);
+	}
+
 	error[0] = '\0';
 	snprintf(filename, sizeof(filename), "%s/proc", scap_get_host_root());
 	if((*rc = scap_proc_scan_proc_dir(handle, filename, error)) != SCAP_SUCCESS)
@@ -715,6 +782,7 @@ scap_t* scap_open_offline_int(gzFile gzfile,
 	handle->m_userlist = NULL;
 	handle->m_machine_info.num_cpus = (uint32_t)-1;
 	handle->m_last_evt_dump_flags = 0;
+	handle->m_stop_at_checkpoints = false;
 	handle->m_driver_procinfo = NULL;
 	handle->refresh_proc_table_when_saving = true;
 	handle->m_fd_lookup_limit = 0;
@@ -817,7 +885,7 @@ scap_t* scap_open_offline_fd(int fd, char *error, int32_t *rc)
 
 scap_t* scap_open_live(char *error, int32_t *rc)
 {
-	return scap_open_live_int(error, rc, NULL, NULL, true, NULL, NULL, NULL, SCAP_PROC_SCAN_TIMEOUT_NONE, SCAP_PROC_SCAN_LOG_NONE);
+	return scap_open_live_int(error, rc, NULL, NULL, true, NULL, NULL, NULL, SCAP_PROC_SCAN_TIMEOUT_NONE, SCAP_PROC_SCAN_LOG_NONE, NULL);
 }
 
 scap_t* scap_open_nodriver_int(char *error, int32_t *rc,
@@ -826,7 +894,8 @@ scap_t* scap_open_nodriver_int(char *error, int32_t *rc,
 			       bool import_users,
 			       void(*debug_log_fn)(const char* msg),
 			       uint64_t proc_scan_timeout_ms,
-			       uint64_t proc_scan_log_interval_ms)
+			       uint64_t proc_scan_log_interval_ms,
+			       const char *warm_state_file)
 {
 #if !defined(HAS_CAPTURE)
 	snprintf(error, SCAP_LASTERR_SIZE, "live capture not supported on %s", PLATFORM_NAME);
@@ -928,8 +997,14 @@ scap_t* scap_open_nodriver_int(char *error, int32_t *rc,
 	handle->refresh_proc_table_when_saving = true;
 
 	//
-	// Create the process list
+	// Create the process list, starting from the state saved by a previous
+	// run if any
 	//
+	if(warm_state_file != NULL)
+	{
+		scap_load_warm_state(handle, warm_state_file);
+	}
+
 	error[0] = '\0';
 	snprintf(filename, sizeof(filename), "%s/proc", scap_get_host_root());
 	if((*rc = scap_proc_scan_proc_dir(handle, filename, error)) != SCAP_SUCCESS)
@@ -989,7 +1064,8 @@ scap_t* scap_open(scap_open_args args, char *error, int32_t *rc)
 						args.suppressed_comms,
 						args.debug_log_fn,
 						args.proc_scan_timeout_ms,
-						args.proc_scan_log_interval_ms);
+						args.proc_scan_log_interval_ms,
+						args.warm_state_file);
 		}
 		else
 		{
@@ -1000,7 +1076,8 @@ scap_t* scap_open(scap_open_args args, char *error, int32_t *rc)
 						args.suppressed_comms,
 						args.debug_log_fn,
 						args.proc_scan_timeout_ms,
-						args.proc_scan_log_interval_ms);
+						args.proc_scan_log_interval_ms,
+						args.warm_state_file);
 		}
 #else
 		snprintf(error,	SCAP_LASTERR_SIZE, "scap_open: live mode currently not supported on windows. Use nodriver mode instead.");
@@ -1013,7 +1090,8 @@ scap_t* scap_open(scap_open_args args, char *error, int32_t *rc)
 					      args.import_users,
 					      args.debug_log_fn,
 					      args.proc_scan_timeout_ms,
-					      args.proc_scan_log_interval_ms);
+					      args.proc_scan_log_interval_ms,
+					      args.warm_state_file);
 	case SCAP_MODE_NONE:
 		// error
 		break;
@@ -1036,6 +1114,16 @@ void scap_close_udig(scap_t* handle)
 	{
 		udig_free_ring_descriptors((uint8_t*)handle->m_devs[0].m_bufinfo);
 	}
+#ifndef _WIN32
+	if(handle->m_udig_rings != NULL)
+	{
+		udig_free_producer_rings(handle->m_udig_rings_descs_fd,
+			handle->m_udig_rings_buf_fd,
+			handle->m_udig_rings,
+			handle->m_udig_rings_buf);
+		handle->m_udig_rings = NULL;
+	}
+#endif
 #ifdef _WIN32
 	if(handle->m_win_buf_handle != NULL)
 	{
@@ -1132,6 +1220,8 @@ void scap_close(scap_t* handle)
 		scap_proc_free_table(handle);
 	}
 
+	scap_free_warm_state(handle);
+
 	// Free the device table
 	if(handle->m_dev_list != NULL)
 	{
@@ -1214,10 +1304,18 @@ uint32_t scap_get_ndevs(scap_t* handle)
 
 #if defined(HAS_CAPTURE) && !defined(CYGWING_AGENT)
 
+//
+// The udig producer rings are smaller than the kernel ones
+//
+static inline uint32_t scap_get_ring_size(scap_t* handle, uint32_t cpuid)
+{
+	return handle->m_udig ? handle->m_devs[cpuid].m_buffer_size : RING_BUF_SIZE;
+}
+
 #ifndef _WIN32
-static inline void get_buf_pointers(struct ppm_ring_buffer_info* bufinfo, uint32_t* phead, uint32_t* ptail, uint64_t* pread_size)
+static inline void get_buf_pointers(struct ppm_ring_buffer_info* bufinfo, uint32_t ring_size, uint32_t* phead, uint32_t* ptail, uint64_t* pread_size)
 #else
-void get_buf_pointers(struct ppm_ring_buffer_info* bufinfo, uint32_t* phead, uint32_t* ptail, uint64_t* pread_size)
+void get_buf_pointers(struct ppm_ring_buffer_info* bufinfo, uint32_t ring_size, uint32_t* phead, uint32_t* ptail, uint64_t* pread_size)
 #endif
 {
 	*phead = bufinfo->head;
@@ -1225,7 +1323,7 @@ void get_buf_pointers(struct ppm_ring_buffer_info* bufinfo, uint32_t* phead, uin
 
 	if(*ptail > *phead)
 	{
-		*pread_size = RING_BUF_SIZE - *ptail + *phead;
+		*pread_size = ring_size - *ptail + *phead;
 	}
 	else
 	{
@@ -1236,6 +1334,7 @@ void get_buf_pointers(struct ppm_ring_buffer_info* bufinfo, uint32_t* phead, uin
 static void scap_advance_tail(scap_t* handle, uint32_t cpuid)
 {
 	uint32_t ttail;
+	uint32_t ring_size;
 
 #ifndef _WIN32
 	if(handle->m_bpf)
@@ -1263,13 +1362,14 @@ static void scap_advance_tail(scap_t* handle, uint32_t cpuid)
 	__sync_synchronize();
 #endif
 
-	if(ttail < RING_BUF_SIZE)
+	ring_size = scap_get_ring_size(handle, cpuid);
+	if(ttail < ring_size)
 	{
 		handle->m_devs[cpuid].m_bufinfo->tail = ttail;
 	}
 	else
 	{
-		handle->m_devs[cpuid].m_bufinfo->tail = ttail - RING_BUF_SIZE;
+		handle->m_devs[cpuid].m_bufinfo->tail = ttail - ring_size;
 	}
 
 	handle->m_devs[cpuid].m_lastreadsize = 0;
@@ -1292,6 +1392,7 @@ int32_t scap_readbuf(scap_t* handle, uint32_t cpuid, OUT char** buf, OUT uint32_
 	// Read the pointers.
 	//
 	get_buf_pointers(handle->m_devs[cpuid].m_bufinfo,
+	                 scap_get_ring_size(handle, cpuid),
 	                 &thead,
 	                 &ttail,
 	                 &read_size);
@@ -1328,7 +1429,7 @@ static uint64_t buf_size_used(scap_t* handle, uint32_t cpu)
 		uint32_t thead;
 		uint32_t ttail;
 
-		get_buf_pointers(handle->m_devs[cpu].m_bufinfo, &thead, &ttail, &read_size);
+		get_buf_pointers(handle->m_devs[cpu].m_bufinfo, scap_get_ring_size(handle, cpu), &thead, &ttail, &read_size);
 	}
 
 	return read_size;
@@ -1590,6 +1691,9 @@ static int32_t scap_next_udig(scap_t* handle, OUT scap_evt** pevent, OUT uint16_
 		// All the buffers have been consumed. Check if there's enough data to keep going or
 		// if we should wait.
 		//
+#ifndef _WIN32
+		udig_update_ndevs(handle);
+#endif
 		return refill_read_buffers(handle);
 	}
 #endif
@@ -1718,8 +1822,19 @@ int32_t scap_get_stats(scap_t* handle, OUT scap_stats* stats)
 	else
 	{
 		uint32_t j;
+		uint32_t ndevs = handle->m_ndevs;
 
-		for(j = 0; j < handle->m_ndevs; j++)
+#ifndef _WIN32
+		//
+		// Including the udig producer rings not being scanned
+		//
+		if(handle->m_udig_rings != NULL)
+		{
+			ndevs = 1 + handle->m_udig_rings->m_nrings;
+		}
+#endif
+
+		for(j = 0; j < ndevs; j++)
 		{
 			stats->n_evts += handle->m_devs[j].m_bufinfo->n_evts;
 			stats->n_drops_buffer += handle->m_devs[j].m_bufinfo->n_drops_buffer;
@@ -2396,6 +2511,11 @@ uint64_t scap_get_unexpected_block_readsize(scap_t* handle)
 	return handle->m_unexpected_block_readsize;
 }
 
+void scap_set_stop_at_checkpoints(scap_t* handle, bool stop)
+{
+	handle->m_stop_at_checkpoints = stop;
+}
+
 int32_t scap_enable_simpledriver_mode(scap_t* handle)
 {
 	//
@@ -321,6 +321,7 @@ typedef struct scap_open_args
 	void(*debug_log_fn)(const char* msg); // Function which SCAP may use to log a debug message
 	uint64_t proc_scan_timeout_ms; // Timeout in msec, after which so-far-successful scan of /proc should be cut short with success return
 	uint64_t proc_scan_log_interval_ms; // Interval for logging progress messages from /proc scan
+	const char* warm_state_file; ///< A state file saved by a previous run, see \ref scap_write_proc_starttimes. The /proc scan only reads what changed since then. NULL for a cold start.
 }scap_open_args;
 
 
@@ -519,7 +520,9 @@ typedef enum scap_dump_flags
 	SCAP_DF_NONE = 0,
 	SCAP_DF_STATE_ONLY = 1,		///< The event should be used for state update but it should
 								///< not be shown to the user
-	SCAP_DF_TRACER = (1 << 1)	///< This event is a tracer
+	SCAP_DF_TRACER = (1 << 1),	///< This event is a tracer
+	SCAP_DF_CHECKPOINT = (1 << 2)	///< This event belongs to a checkpoint section, readers
+								///< going through the checkpoint skip it
 }scap_dump_flags;
 
 typedef struct scap_dumper scap_dumper_t;
@@ -812,6 +815,66 @@ int32_t scap_number_of_bytes_to_write(scap_evt *e, uint16_t cpuid, int32_t* byte
 */
 int32_t scap_dump(scap_t *handle, scap_dumper_t *d, scap_evt* e, uint16_t cpuid, uint32_t flags);
 
+/*!
+  \brief Start a checkpoint section in a trace file
+
+  \param handle Handle to the capture instance.
+  \param d The dump handle, returned by \ref scap_dump_open
+
+  Writes a section header followed by a checkpoint block, the machine info,
+  the interface list and the user list. The caller must complete the
+  section with the process and fd lists describing the state at this point
+  of the capture (see \ref scap_write_proclist_header), optionally followed
+  by events dumped with SCAP_DF_CHECKPOINT, before dumping the next event.
+
+  A sequential reader skips the checkpoint sections, while a capture opened
+  at the offset of one of them, as returned by \ref scap_find_checkpoints,
+  starts from the state it contains.
+
+  \return SCAP_SUCCESS if the call is successful.
+   On Failure, SCAP_FAILURE is returned and scap_getlasterr() can be used to obtain
+   the cause of the error.
+*/
+int32_t scap_dump_checkpoint(scap_t *handle, scap_dumper_t *d);
+
+/*!
+  \brief List the checkpoint sections of a trace file
+
+  \param fname The name of the trace file.
+  \param error Pointer to a buffer that will contain the error string in case the
+    function fails. The buffer must have size SCAP_LASTERR_SIZE.
+  \param offsets Set to a malloc'ed array with the file offsets of the checkpoint
+    sections, in file order, that the caller must free. NULL when there are none.
+  \param noffsets Set to the number of entries of offsets.
+
+  \note Compressed files are rejected: opening them at an offset means
+   decompressing everything before it.
+
+  \return SCAP_SUCCESS if the call is successful, SCAP_FAILURE otherwise.
+*/
+int32_t scap_find_checkpoints(const char *fname, char *error, uint64_t **offsets, uint32_t *noffsets);
+
+/*!
+  \brief Write the start times of a list of threads in a trace file
+
+  \param handle Handle to the capture instance.
+  \param d The dump handle, returned by \ref scap_dump_open
+  \param tids The threads.
+  \param ntids The number of entries of tids.
+
+  Together with the process and fd lists, the start times turn a trace file
+  into a warm restart state: a live capture opened with it as
+  scap_open_args.warm_state_file takes the threads that are still the same
+  process (same start time and executable) and the fds that are still open
+  on the same inode from the file, and only reads the rest from /proc.
+  Threads that are gone are skipped.
+
+  \return SCAP_SUCCESS if the call is successful.
+   On Failure, SCAP_FAILURE is returned and scap_getlasterr() can be used to obtain
+   the cause of the error.
+*/
+int32_t scap_write_proc_starttimes(scap_t *handle, scap_dumper_t *d, const int64_t *tids, uint32_t ntids);
+
 /*!
   \brief Get the process list for the given capture instance
 
@@ -1063,6 +1126,8 @@ int32_t scap_enable_page_faults(scap_t *handle);
 int32_t scap_enable_skb_capture(scap_t *handle);
 int32_t scap_disable_skb_capture(scap_t *handle);
 uint64_t scap_get_unexpected_block_readsize(scap_t* handle);
+// When true, an offline capture ends at the next checkpoint section instead of skipping it
+void scap_set_stop_at_checkpoints(scap_t* handle, bool stop);
 int32_t scap_proc_add(scap_t* handle, uint64_t tid, scap_threadinfo* tinfo);
 int32_t scap_fd_add(scap_t *handle, scap_threadinfo* tinfo, uint64_t fd, scap_fdinfo* fdinfo);
 scap_dumper_t *scap_memory_dump_open(scap_t *handle, uint8_t* targetbuf, uint64_t targetbufsize);
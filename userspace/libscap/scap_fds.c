@@ -1879,9 +1879,54 @@ char * decode_st_mode(struct stat* sb)
     }
 }
 //
-// Scan the directory containing the fd's of a proc /proc/x/fd
+// Take fd from the fds of a warm restart state if it's still open on the same
+// inode. An inode number doesn't tell the device, so the type must match too.
 //
-int32_t scap_fd_scan_fd_dir(scap_t *handle, char *procdir, scap_threadinfo *tinfo, struct scap_ns_socket_list **sockets_by_ns, uint64_t* num_fds_ret, char *error)
+static scap_fdinfo *scap_fd_take_warm(scap_fdinfo **warm_fds, uint64_t fd, struct stat *sb)
+{
+	scap_fdinfo *fdi;
+	int64_t key = fd;
+	bool same_type;
+
+	HASH_FIND_INT64(*warm_fds, &key, fdi);
+	if(fdi == NULL)
+	{
+		return NULL;
+	}
+
+	HASH_DEL(*warm_fds, fdi);
+
+	switch(sb->st_mode & S_IFMT)
+	{
+	case S_IFSOCK:
+		same_type = fdi->type == SCAP_FD_IPV4_SOCK || fdi->type == SCAP_FD_IPV6_SOCK ||
+			fdi->type == SCAP_FD_IPV4_SERVSOCK || fdi->type == SCAP_FD_IPV6_SERVSOCK ||
+			fdi->type == SCAP_FD_UNIX_SOCK || fdi->type == SCAP_FD_NETLINK;
+		break;
+	case S_IFIFO:
+		same_type = fdi->type == SCAP_FD_FIFO;
+		break;
+	case S_IFDIR:
+		same_type = fdi->type == SCAP_FD_DIRECTORY;
+		break;
+	default:
+		same_type = fdi->type == SCAP_FD_FILE || fdi->type == SCAP_FD_FILE_V2 ||
+			fdi->type == SCAP_FD_EVENT || fdi->type == SCAP_FD_SIGNALFD ||
+			fdi->type == SCAP_FD_EVENTPOLL || fdi->type == SCAP_FD_INOTIFY ||
+			fdi->type == SCAP_FD_TIMERFD || fdi->type == SCAP_FD_UNSUPPORTED;
+		break;
+	}
+
+	if(fdi->ino == 0 || fdi->ino != sb->st_ino || !same_type)
+	{
+		scap_fd_free_fdinfo(&fdi);
+		return NULL;
+	}
+
+	return fdi;
+}
+
+static int32_t scap_fd_scan_fd_dir_impl(scap_t *handle, char *procdir, scap_threadinfo *tinfo, scap_fdinfo **warm_fds, struct scap_ns_socket_list **sockets_by_ns, uint64_t* num_fds_ret, char *error)
 {
 	DIR *dir_p;
 	struct dirent *dir_entry_p;
@@ -1945,6 +1990,26 @@ int32_t scap_fd_scan_fd_dir(scap_t *handle, char *procdir, scap_threadinfo *tinf
 			continue;
 		}
 
+		//
+		// Still open since the state was saved, no need to look it up
+		//
+		if(warm_fds != NULL && (fdi = scap_fd_take_warm(warm_fds, fd, &sb)) != NULL)
+		{
+			res = scap_add_fd_to_proc_table(handle, tinfo, fdi, error);
+			if(handle->m_proc_callback != NULL)
+			{
+				scap_fd_free_fdinfo(&fdi);
+			}
+
+			if(SCAP_SUCCESS != res)
+			{
+				break;
+			}
+
+			++fd_added;
+			continue;
+		}
+
 		switch(sb.st_mode & S_IFMT)
 		{
 		case S_IFIFO:
@@ -2033,6 +2098,18 @@ int32_t scap_fd_scan_fd_dir(scap_t *handle, char *procdir, scap_threadinfo *tinf
 	return res;
 }
 
+//
+// Scan the directory containing the fd's of a proc /proc/x/fd
+//
+int32_t scap_fd_scan_fd_dir(scap_t *handle, char *procdir, scap_threadinfo *tinfo, struct scap_ns_socket_list **sockets_by_ns, uint64_t* num_fds_ret, char *error)
+{
+	return scap_fd_scan_fd_dir_impl(handle, procdir, tinfo, NULL, sockets_by_ns, num_fds_ret, error);
+}
+
+int32_t scap_fd_scan_fd_dir_warm(scap_t *handle, char *procdir, scap_threadinfo *tinfo, scap_fdinfo **warm_fds, struct scap_ns_socket_list **sockets_by_ns, uint64_t* num_fds_ret, char *error)
+{
+	return scap_fd_scan_fd_dir_impl(handle, procdir, tinfo, warm_fds, sockets_by_ns, num_fds_ret, error);
+}
 
 #endif // HAS_CAPTURE
 
@@ -909,6 +909,124 @@ static int32_t scap_proc_add_from_proc(scap_t* handle, uint32_t tid, char* procd
 	return res;
 }
 
+//
+// Take a thread from the warm restart state if /proc shows that it's still
+// the same process: same start time, since pids get reused, and same
+// executable, since execve() keeps both. What can change without the
+// process being replaced, like the credentials, the parent, the cwd or the
+// cgroups, is read again.
+// Returns SCAP_NOTFOUND if the thread must be read from scratch.
+//
+static int32_t scap_proc_add_from_warm_state(scap_t* handle, uint32_t tid, char* procdirname, struct scap_ns_socket_list** sockets_by_ns, uint64_t* num_fds_ret, char *error)
+{
+	char dir_name[256];
+	char filename[SCAP_MAX_PATH_SIZE];
+	char target_name[SCAP_MAX_PATH_SIZE];
+	int target_res;
+	int64_t key = tid;
+	uint64_t starttime;
+	struct scap_threadinfo* tinfo;
+	scap_warm_starttime* st;
+	scap_fdinfo* warm_fds;
+	bool suppressed;
+	bool free_tinfo = false;
+	int32_t uth_status = SCAP_SUCCESS;
+	int32_t res = SCAP_SUCCESS;
+
+	HASH_FIND_INT64(handle->m_warm_proclist, &key, tinfo);
+	if(tinfo == NULL)
+	{
+		return SCAP_NOTFOUND;
+	}
+
+	HASH_DEL(handle->m_warm_proclist, tinfo);
+	warm_fds = tinfo->fdlist;
+	tinfo->fdlist = NULL;
+
+	snprintf(dir_name, sizeof(dir_name), "%s/%u/", procdirname, tid);
+	snprintf(filename, sizeof(filename), "%sexe", dir_name);
+
+	target_res = readlink(filename, target_name, sizeof(target_name) - 1);
+	target_name[target_res > 0 ? target_res : 0] = 0;
+
+	HASH_FIND_INT64(handle->m_warm_starttimes, &key, st);
+	if(st == NULL ||
+	   scap_proc_get_starttime(handle, procdirname, tid, &starttime) != SCAP_SUCCESS ||
+	   starttime != st->starttime ||
+	   strcmp(target_name, tinfo->exepath) != 0)
+	{
+		scap_fd_free_table(handle, &warm_fds);
+		free(tinfo);
+		return SCAP_NOTFOUND;
+	}
+
+	//
+	// The nested errors are cut so that the whole message fits
+	//
+	if((res = scap_update_suppressed(handle, tinfo->comm, tid, 0, &suppressed)) != SCAP_SUCCESS)
+	{
+		snprintf(error, SCAP_LASTERR_SIZE, "can't update set of suppressed tids (%.200s)", handle->m_lasterr);
+		scap_fd_free_table(handle, &warm_fds);
+		free(tinfo);
+		return res;
+	}
+
+	if(suppressed)
+	{
+		scap_fd_free_table(handle, &warm_fds);
+		free(tinfo);
+		return SCAP_SUCCESS;
+	}
+
+	if(SCAP_FAILURE == scap_proc_fill_cwd(handle, dir_name, tinfo) ||
+	   SCAP_FAILURE == scap_proc_fill_info_from_stats(handle, dir_name, tinfo) ||
+	   SCAP_FAILURE == scap_proc_fill_cgroups(handle, tinfo, dir_name))
+	{
+		snprintf(error, SCAP_LASTERR_SIZE, "can't refresh tid %u (%.200s)",
+			 tid, handle->m_lasterr);
+		scap_fd_free_table(handle, &warm_fds);
+		free(tinfo);
+		return SCAP_FAILURE;
+	}
+
+	//
+	// Done. Add the entry to the process table, or fire the notification callback
+	//
+	if(handle->m_proc_callback == NULL)
+	{
+		HASH_ADD_INT64(handle->m_proclist, tid, tinfo);
+		if(uth_status != SCAP_SUCCESS)
+		{
+			snprintf(error, SCAP_LASTERR_SIZE, "process table allocation error (2)");
+			scap_fd_free_table(handle, &warm_fds);
+			free(tinfo);
+			return SCAP_FAILURE;
+		}
+	}
+	else
+	{
+		handle->m_proc_callback(handle->m_proc_callback_context, handle, tinfo->tid, tinfo, NULL);
+		free_tinfo = true;
+	}
+
+	//
+	// Only add fds for processes, not threads
+	//
+	if(tinfo->pid == tinfo->tid)
+	{
+		res = scap_fd_scan_fd_dir_warm(handle, dir_name, tinfo, &warm_fds, sockets_by_ns, num_fds_ret, error);
+	}
+
+	scap_fd_free_table(handle, &warm_fds);
+
+	if(free_tinfo)
+	{
+		free(tinfo);
+	}
+
+	return res;
+}
+
 //
 // Read a single thread info from /proc
 //
@@ -1033,7 +1151,17 @@ static int32_t _scap_proc_scan_proc_dir_impl(scap_t* handle, char* procdirname,
 		// We have a process that needs to be explored
 		//
 		uint64_t num_fds_this_proc;
-		res = scap_proc_add_from_proc(handle, tid, procdirname, &sockets_by_ns, NULL, &num_fds_this_proc, add_error);
+		res = SCAP_NOTFOUND;
+		if(handle->m_warm_proclist != NULL)
+		{
+			res = scap_proc_add_from_warm_state(handle, tid, procdirname, &sockets_by_ns, &num_fds_this_proc, add_error);
+		}
+
+		if(res == SCAP_NOTFOUND)
+		{
+			res = scap_proc_add_from_proc(handle, tid, procdirname, &sockets_by_ns, NULL, &num_fds_this_proc, add_error);
+		}
+
 		if(res != SCAP_SUCCESS)
 		{
 			//
@@ -1163,7 +1291,14 @@ static int32_t _scap_proc_scan_proc_dir_impl(scap_t* handle, char* procdirname,
 
 int32_t scap_proc_scan_proc_dir(scap_t* handle, char* procdirname, char *error)
 {
-	return _scap_proc_scan_proc_dir_impl(handle, procdirname, -1, error);
+	int32_t res = _scap_proc_scan_proc_dir_impl(handle, procdirname, -1, error);
+
+	//
+	// What's left of the warm restart state is gone from /proc
+	//
+	scap_free_warm_state(handle);
+
+	return res;
 }
 
 #endif // CYGWING_AGENT
@@ -1243,6 +1378,50 @@ int32_t scap_proc_scan_proc_dir(scap_t* handle, char* procdirname, char *error)
 }
 #endif
 
+#if !defined(HAS_CAPTURE) || defined(CYGWING_AGENT) || defined(_WIN32)
+int32_t scap_proc_get_starttime(scap_t* handle, const char* procdirname, int64_t tid, uint64_t* starttime)
+{
+	snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "process start times not supported on %s", PLATFORM_NAME);
+	return SCAP_NOT_SUPPORTED;
+}
+#else
+int32_t scap_proc_get_starttime(scap_t* handle, const char* procdirname, int64_t tid, uint64_t* starttime)
+{
+	char filename[SCAP_MAX_PATH_SIZE];
+	char line[512];
+	size_t ssres;
+	char* s;
+	FILE* f;
+
+	snprintf(filename, sizeof(filename), "%s/%" PRId64 "/stat", procdirname, tid);
+
+	f = fopen(filename, "r");
+	if(f == NULL)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "can't open %s/%" PRId64 "/stat (%s)",
+			 procdirname, tid, scap_strerror(handle, errno));
+		return SCAP_NOTFOUND;
+	}
+
+	ssres = fread(line, 1, sizeof(line) - 1, f);
+	fclose(f);
+	line[ssres] = 0;
+
+	//
+	// The start time is the 22nd field, the 20th after the command name
+	//
+	s = strrchr(line, ')');
+	if(s == NULL ||
+	   sscanf(s + 2, "%*c %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %" PRIu64, starttime) != 1)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "can't read the start time from %s/%" PRId64 "/stat", procdirname, tid);
+		return SCAP_FAILURE;
+	}
+
+	return SCAP_SUCCESS;
+}
+#endif // HAS_CAPTURE
+
 //
 // Delete a process entry
 //
@@ -1278,6 +1457,27 @@ void scap_proc_free_table(scap_t* handle)
 	}
 }
 
+void scap_free_warm_state(scap_t* handle)
+{
+	struct scap_threadinfo* tinfo;
+	struct scap_threadinfo* ttinfo;
+	scap_warm_starttime* st;
+	scap_warm_starttime* tst;
+
+	HASH_ITER(hh, handle->m_warm_proclist, tinfo, ttinfo)
+	{
+		HASH_DEL(handle->m_warm_proclist, tinfo);
+		scap_fd_free_proc_fd_table(handle, tinfo);
+		free(tinfo);
+	}
+
+	HASH_ITER(hh, handle->m_warm_starttimes, st, tst)
+	{
+		HASH_DEL(handle->m_warm_starttimes, st);
+		free(st);
+	}
+}
+
 struct scap_threadinfo* scap_proc_get(scap_t* handle, int64_t tid, bool scan_sockets)
 {
 #if !defined(HAS_CAPTURE) || defined(_WIN32)
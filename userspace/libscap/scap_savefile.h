@@ -148,6 +148,24 @@ typedef struct _section_header_block
 
 #define EVF_BLOCK_TYPE_V2	0x217
 
+///////////////////////////////////////////////////////////////////////////////
+// CHECKPOINT BLOCK
+///////////////////////////////////////////////////////////////////////////////
+// Follows the section header block of a section written in the middle of a
+// capture by scap_dump_checkpoint(). The metadata blocks of the section,
+// and the events flagged SCAP_DF_CHECKPOINT that follow them, describe the
+// state at that point, so that reading can start there.
+// The block has no body.
+#define CKP_BLOCK_TYPE		0x221
+
+///////////////////////////////////////////////////////////////////////////////
+// PROCESS START TIMES BLOCK
+///////////////////////////////////////////////////////////////////////////////
+// Written by scap_write_proc_starttimes() in a warm restart state file.
+// The body is a list of (uint64_t tid, uint64_t start time) pairs, the start
+// time in clock ticks after boot as found in /proc/<tid>/stat.
+#define PST_BLOCK_TYPE		0x222
+
 #if defined __sun
 #pragma pack()
 #else
@@ -6,6 +6,7 @@
 #ifndef _WIN32
 #include <unistd.h>
 #include <inttypes.h>
+#include <stddef.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
 #include <sys/ioctl.h>
@@ -29,6 +30,9 @@
 #include "scap.h"
 #include "scap-int.h"
 #include "../../driver/ppm_ringbuffer.h"
+#ifndef _WIN32
+#include "udig_rings.h"
+#endif
 
 #define PPM_PORT_STATSD 8125
 
@@ -39,6 +43,26 @@
 int ud_shm_open(const char *name, int flag, mode_t mode);
 #endif
 
+#ifndef F_OFD_SETLK
+#define F_OFD_SETLK 37
+#endif
+
+//
+// Prepended to the names of all the udig shared memory areas
+//
+static char g_udig_shm_prefix[UDIG_SHM_PREFIX_MAX] = "";
+
+void udig_set_shm_prefix(const char* prefix)
+{
+	snprintf(g_udig_shm_prefix, sizeof(g_udig_shm_prefix), "%s", prefix);
+}
+
+static const char* udig_shm_name(const char* name, char* buf, size_t len)
+{
+	snprintf(buf, len, "%s%s", g_udig_shm_prefix, name);
+	return buf;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // The following 2 function map the ring buffer and the ring buffer 
 // descriptors into the address space of this process.
@@ -50,11 +74,14 @@ int32_t udig_alloc_ring(void* ring_id,
 	char *error)
 {
 	int* ring_fd = (int*)ring_id;
+	char name[UDIG_SHM_NAME_MAX];
+
+	udig_shm_name(UDIG_RING_SM_FNAME, name, sizeof(name));
 
 	//
 	// First, try to open an existing ring
 	//
-	*ring_fd = ud_shm_open(UDIG_RING_SM_FNAME, O_RDWR, 0);
+	*ring_fd = ud_shm_open(name, O_RDWR, 0);
 	if(*ring_fd >= 0)
 	{
 		//
@@ -78,7 +105,7 @@ int32_t udig_alloc_ring(void* ring_id,
 		//
 		*ringsize = UDIG_RING_SIZE;
 
-		*ring_fd = ud_shm_open(UDIG_RING_SM_FNAME, O_CREAT | O_RDWR, 
+		*ring_fd = ud_shm_open(name, O_CREAT | O_RDWR, 
 			S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
 		if(*ring_fd >= 0)
 		{
@@ -157,17 +184,20 @@ int32_t udig_alloc_ring_descriptors(void* ring_descs_id,
 {
 	int* ring_descs_fd = (int*)ring_descs_id;
 	uint32_t mem_size = sizeof(struct ppm_ring_buffer_info) + sizeof(struct udig_ring_buffer_status);
+	char name[UDIG_SHM_NAME_MAX];
+
+	udig_shm_name(UDIG_RING_DESCS_SM_FNAME, name, sizeof(name));
 
 	//
 	// First, try to open an existing ring
 	//
-	*ring_descs_fd = ud_shm_open(UDIG_RING_DESCS_SM_FNAME, O_RDWR, 0);
+	*ring_descs_fd = ud_shm_open(name, O_RDWR, 0);
 	if(*ring_descs_fd < 0)
 	{
 		//
 		// No existing ring file found in /dev/shm, create a new one.
 		//
-		*ring_descs_fd = ud_shm_open(UDIG_RING_DESCS_SM_FNAME, O_CREAT | O_RDWR | O_EXCL, 
+		*ring_descs_fd = ud_shm_open(name, O_CREAT | O_RDWR | O_EXCL, 
 				S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
 		if(*ring_descs_fd >= 0)
 		{
@@ -184,14 +214,14 @@ int32_t udig_alloc_ring_descriptors(void* ring_descs_id,
 			{
 				snprintf(error, SCAP_LASTERR_SIZE, "udig_alloc_ring_descriptors ftruncate error: %s\n", strerror(errno));
 				close(*ring_descs_fd);
-				shm_unlink(UDIG_RING_DESCS_SM_FNAME);
+				shm_unlink(name);
 				return SCAP_FAILURE;
 			}
 		}
 		else
 		{
 			snprintf(error, SCAP_LASTERR_SIZE, "udig_alloc_ring_descriptors shm_open error: %s\n", strerror(errno));
-			shm_unlink(UDIG_RING_DESCS_SM_FNAME);
+			shm_unlink(name);
 			return SCAP_FAILURE;
 		}
 	}
@@ -249,6 +279,379 @@ void udig_free_ring_descriptors(uint8_t* addr)
 	munmap(addr, mem_size);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// The producer rings, see udig_rings.h
+///////////////////////////////////////////////////////////////////////////////
+#define UDIG_RINGS_UNINITIALIZED 0
+#define UDIG_RINGS_INITIALIZING 1
+#define UDIG_RINGS_READY 2
+
+//
+// Open, or create, a shared memory area of at least size bytes
+//
+static int udig_open_shm(const char* fname, uint64_t size, char *error)
+{
+	char name[UDIG_SHM_NAME_MAX];
+	int fd = ud_shm_open(udig_shm_name(fname, name, sizeof(name)), O_RDWR, 0);
+	if(fd < 0)
+	{
+		fd = ud_shm_open(name, O_CREAT | O_RDWR | O_EXCL,
+			S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
+		if(fd >= 0)
+		{
+			//
+			// For some reason, shm_open doesn't always set the write flag for
+			// 'group' and 'other'. Fix it here.
+			//
+			fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
+		}
+		else if(errno == EEXIST)
+		{
+			//
+			// Someone else just created it
+			//
+			fd = ud_shm_open(name, O_RDWR, 0);
+		}
+	}
+
+	if(fd < 0)
+	{
+		snprintf(error, SCAP_LASTERR_SIZE, "udig_open_shm %s shm_open error: %s\n", name, strerror(errno));
+		return -1;
+	}
+
+	struct stat rstat;
+	if(fstat(fd, &rstat) < 0)
+	{
+		snprintf(error, SCAP_LASTERR_SIZE, "udig_open_shm %s fstat error: %s\n", name, strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	//
+	// The new memory is zeroed. Concurrent truncations to the same size are
+	// harmless.
+	//
+	if((uint64_t)rstat.st_size < size && ftruncate(fd, size) < 0)
+	{
+		snprintf(error, SCAP_LASTERR_SIZE, "udig_open_shm %s ftruncate error: %s\n", name, strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static int32_t udig_map_rings_descs(int* descs_fd, struct udig_rings** rings, char *error)
+{
+	*descs_fd = udig_open_shm(UDIG_RINGS_DESCS_SM_FNAME, sizeof(struct udig_rings), error);
+	if(*descs_fd < 0)
+	{
+		return SCAP_FAILURE;
+	}
+
+	*rings = (struct udig_rings*)mmap(NULL, sizeof(struct udig_rings), PROT_READ|PROT_WRITE, MAP_SHARED,
+		*descs_fd, 0);
+	if(*rings == MAP_FAILED)
+	{
+		snprintf(error, SCAP_LASTERR_SIZE, "can't map the udig ring descriptors\n");
+		close(*descs_fd);
+		return SCAP_FAILURE;
+	}
+
+	//
+	// The first one to get here sets the geometry, the others wait for it
+	//
+	if(__sync_bool_compare_and_swap(&((*rings)->m_initialized), UDIG_RINGS_UNINITIALIZED, UDIG_RINGS_INITIALIZING))
+	{
+		(*rings)->m_nrings = UDIG_MAX_PRODUCER_RINGS;
+		(*rings)->m_ring_size = UDIG_PRODUCER_RING_SIZE;
+		__sync_synchronize();
+		(*rings)->m_initialized = UDIG_RINGS_READY;
+	}
+	else
+	{
+		while((*rings)->m_initialized != UDIG_RINGS_READY)
+		{
+			usleep(1000);
+		}
+	}
+
+	if((*rings)->m_nrings > UDIG_MAX_PRODUCER_RINGS)
+	{
+		snprintf(error, SCAP_LASTERR_SIZE, "unsupported number of udig rings %u\n", (*rings)->m_nrings);
+		munmap(*rings, sizeof(struct udig_rings));
+		close(*descs_fd);
+		return SCAP_FAILURE;
+	}
+
+	return SCAP_SUCCESS;
+}
+
+//
+// Map rings [first, first + n), each one twice in a row, in a single
+// contiguous area
+//
+static uint8_t* udig_map_rings(int buf_fd, uint32_t ring_size, uint32_t first, uint32_t n, char *error)
+{
+	uint64_t len = (uint64_t)n * ring_size * 2;
+	uint32_t j;
+
+	//
+	// Reserve the address space first, then map over it
+	//
+	uint8_t* base = (uint8_t*)mmap(NULL, len, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(base == MAP_FAILED)
+	{
+		snprintf(error, SCAP_LASTERR_SIZE, "can't reserve %" PRIu64 " bytes for the udig rings\n", len);
+		return NULL;
+	}
+
+	for(j = 0; j < n; j++)
+	{
+		off_t offset = (off_t)(first + j) * ring_size;
+		uint8_t* ring = base + (uint64_t)j * ring_size * 2;
+
+		if(mmap(ring, ring_size, PROT_READ|PROT_WRITE, MAP_SHARED | MAP_FIXED, buf_fd, offset) != ring ||
+			mmap(ring + ring_size, ring_size, PROT_READ|PROT_WRITE, MAP_SHARED | MAP_FIXED, buf_fd, offset) != ring + ring_size)
+		{
+			snprintf(error, SCAP_LASTERR_SIZE, "can't map udig ring %u: %s\n", first + j, strerror(errno));
+			munmap(base, len);
+			return NULL;
+		}
+	}
+
+	return base;
+}
+
+int32_t udig_alloc_producer_rings(int* descs_fd, int* buf_fd,
+	struct udig_rings** rings,
+	uint8_t** buffers,
+	char *error)
+{
+	if(udig_map_rings_descs(descs_fd, rings, error) != SCAP_SUCCESS)
+	{
+		return SCAP_FAILURE;
+	}
+
+	*buf_fd = udig_open_shm(UDIG_RINGS_SM_FNAME, (uint64_t)(*rings)->m_nrings * (*rings)->m_ring_size, error);
+	if(*buf_fd < 0)
+	{
+		munmap(*rings, sizeof(struct udig_rings));
+		close(*descs_fd);
+		return SCAP_FAILURE;
+	}
+
+	*buffers = udig_map_rings(*buf_fd, (*rings)->m_ring_size, 0, (*rings)->m_nrings, error);
+	if(*buffers == NULL)
+	{
+		munmap(*rings, sizeof(struct udig_rings));
+		close(*descs_fd);
+		close(*buf_fd);
+		return SCAP_FAILURE;
+	}
+
+	return SCAP_SUCCESS;
+}
+
+void udig_free_producer_rings(int descs_fd, int buf_fd, struct udig_rings* rings, uint8_t* buffers)
+{
+	munmap(buffers, (uint64_t)rings->m_nrings * rings->m_ring_size * 2);
+	munmap(rings, sizeof(struct udig_rings));
+	close(buf_fd);
+	close(descs_fd);
+}
+
+//
+// Lock the byte of the descriptors area that stands for the given ring. The
+// lock belongs to the open file description of descs_fd, so it's released
+// by the kernel when the owner goes away, whatever its pid namespace.
+//
+static int udig_lock_ring(int descs_fd, uint32_t ring_id, short type)
+{
+	struct flock fl;
+
+	memset(&fl, 0, sizeof(fl));
+	fl.l_type = type;
+	fl.l_whence = SEEK_SET;
+	fl.l_start = offsetof(struct udig_rings, m_rings) + ring_id * sizeof(struct udig_ring_desc);
+	fl.l_len = 1;
+
+	return fcntl(descs_fd, F_OFD_SETLK, &fl);
+}
+
+//
+// Take ownership of a free ring, or of one whose owner is gone
+//
+static int32_t udig_claim_ring(int descs_fd, struct udig_rings* rings)
+{
+	uint32_t j;
+
+	for(j = 0; j < rings->m_nrings; j++)
+	{
+		if(udig_lock_ring(descs_fd, j, F_WRLCK) != 0)
+		{
+			continue;
+		}
+
+		struct udig_ring_desc* desc = &rings->m_rings[j];
+		desc->m_owner_pid = getpid();
+		desc->m_owner_tid = (int32_t)syscall(SYS_gettid);
+		__atomic_fetch_or(&rings->m_active, 1ULL << j, __ATOMIC_ACQ_REL);
+		return (int32_t)j;
+	}
+
+	return -1;
+}
+
+int32_t udig_producer_open(udig_producer* p, char *error)
+{
+	memset(p, 0, sizeof(*p));
+	p->m_ring_id = -1;
+	p->m_descs_fd = -1;
+	p->m_buf_fd = -1;
+	p->m_status_fd = -1;
+
+	//
+	// The status of the shared ring has the capture settings
+	//
+	if(udig_alloc_ring_descriptors(&p->m_status_fd, &p->m_status_info, &p->m_status, error) != SCAP_SUCCESS)
+	{
+		return SCAP_FAILURE;
+	}
+
+	if(udig_map_rings_descs(&p->m_descs_fd, &p->m_rings, error) != SCAP_SUCCESS)
+	{
+		udig_producer_close(p);
+		return SCAP_FAILURE;
+	}
+
+	p->m_buf_fd = udig_open_shm(UDIG_RINGS_SM_FNAME, (uint64_t)p->m_rings->m_nrings * p->m_rings->m_ring_size, error);
+	if(p->m_buf_fd < 0)
+	{
+		udig_producer_close(p);
+		return SCAP_FAILURE;
+	}
+
+	p->m_ring_id = udig_claim_ring(p->m_descs_fd, p->m_rings);
+	if(p->m_ring_id < 0)
+	{
+		snprintf(error, SCAP_LASTERR_SIZE, "no free udig producer ring\n");
+		udig_producer_close(p);
+		return SCAP_FAILURE;
+	}
+
+	p->m_buffer_size = p->m_rings->m_ring_size;
+	p->m_buffer = udig_map_rings(p->m_buf_fd, p->m_buffer_size, p->m_ring_id, 1, error);
+	if(p->m_buffer == NULL)
+	{
+		udig_producer_close(p);
+		return SCAP_FAILURE;
+	}
+
+	p->m_info = &p->m_rings->m_rings[p->m_ring_id].m_info;
+
+	return SCAP_SUCCESS;
+}
+
+void udig_producer_close(udig_producer* p)
+{
+	if(p->m_buffer != NULL)
+	{
+		munmap(p->m_buffer, (uint64_t)p->m_buffer_size * 2);
+		p->m_buffer = NULL;
+	}
+
+	if(p->m_rings != NULL)
+	{
+		if(p->m_ring_id >= 0)
+		{
+			struct udig_ring_desc* desc = &p->m_rings->m_rings[p->m_ring_id];
+
+			//
+			// Whatever is still in the ring stays there for the consumer,
+			// which retires the ring once it's empty
+			//
+			desc->m_owner_tid = 0;
+			desc->m_owner_pid = 0;
+			__atomic_fetch_or(&p->m_rings->m_active, 1ULL << p->m_ring_id, __ATOMIC_ACQ_REL);
+			udig_lock_ring(p->m_descs_fd, p->m_ring_id, F_UNLCK);
+			p->m_ring_id = -1;
+		}
+
+		munmap(p->m_rings, sizeof(struct udig_rings));
+		p->m_rings = NULL;
+	}
+
+	if(p->m_status_info != NULL)
+	{
+		udig_free_ring_descriptors((uint8_t*)p->m_status_info);
+		p->m_status_info = NULL;
+		p->m_status = NULL;
+	}
+
+	if(p->m_buf_fd >= 0)
+	{
+		close(p->m_buf_fd);
+		p->m_buf_fd = -1;
+	}
+
+	if(p->m_descs_fd >= 0)
+	{
+		close(p->m_descs_fd);
+		p->m_descs_fd = -1;
+	}
+
+	if(p->m_status_fd >= 0)
+	{
+		close(p->m_status_fd);
+		p->m_status_fd = -1;
+	}
+}
+
+//
+// Only the producer rings up to the highest active one are scanned. Called
+// when all the devices have been consumed, so they can be dropped from the
+// end.
+//
+void udig_update_ndevs(scap_t* handle)
+{
+	struct udig_rings* rings = handle->m_udig_rings;
+	uint64_t active = __atomic_load_n(&rings->m_active, __ATOMIC_ACQUIRE);
+	uint64_t left = active;
+
+	//
+	// Retire the rings that nobody owns and that have been read to the
+	// end. A producer that shows up meanwhile sets the bit again, and so
+	// does one that goes away, after its last event, so the bit is checked
+	// again after clearing it.
+	//
+	while(left != 0)
+	{
+		uint32_t j = __builtin_ctzll(left);
+		uint64_t bit = 1ULL << j;
+		struct udig_ring_desc* desc = &rings->m_rings[j];
+
+		left &= ~bit;
+
+		if(desc->m_owner_pid != 0 || desc->m_info.head != desc->m_info.tail)
+		{
+			continue;
+		}
+
+		__atomic_fetch_and(&rings->m_active, ~bit, __ATOMIC_ACQ_REL);
+		if(desc->m_owner_pid != 0 || __atomic_load_n(&desc->m_info.head, __ATOMIC_ACQUIRE) != desc->m_info.tail)
+		{
+			__atomic_fetch_or(&rings->m_active, bit, __ATOMIC_ACQ_REL);
+			continue;
+		}
+
+		active &= ~bit;
+	}
+
+	handle->m_ndevs = (active == 0) ? 1 : 1 + 64 - __builtin_clzll(active);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Capture control helpers.
 ///////////////////////////////////////////////////////////////////////////////
@@ -320,6 +723,19 @@ int32_t udig_begin_capture(scap_t* handle, char *error)
 	rbi->n_evts = 0;
 	rbi->n_drops_buffer = 0;
 
+	//
+	// The producer rings keep their heads, what's left from an earlier
+	// capture is skipped
+	//
+	uint32_t j;
+	for(j = 0; j < handle->m_udig_rings->m_nrings; j++)
+	{
+		rbi = &handle->m_udig_rings->m_rings[j].m_info;
+		rbi->tail = rbi->head;
+		rbi->n_evts = 0;
+		rbi->n_drops_buffer = 0;
+	}
+
 	if(acquire_and_init_ring_status_buffer(handle))
 	{
 		handle->m_udig_capturing = true;
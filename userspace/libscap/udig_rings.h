@@ -0,0 +1,224 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include "scap.h"
+#include "../../driver/ppm_ringbuffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// udig producer rings.
+//
+// On top of the shared udig ring (UDIG_RING_SM_FNAME), whose writers are
+// serialized by udig_ring_buffer_status.m_buffer_lock, udig offers a pool
+// of single-producer rings. A producer thread claims one of them for
+// itself, and from then on writes without locks nor atomic read-modify-write
+// instructions: it's the only one moving the head, the consumer is the only
+// one moving the tail, like for the per-CPU kernel rings. A stalled
+// producer only stalls its own ring.
+//
+// The consumer (scap_open_udig_int) maps all the rings, one scap device
+// each, after the shared one, and merges them by timestamp with the other
+// devices.
+//
+// Shared memory layout:
+//  - UDIG_RINGS_DESCS_SM_FNAME: a struct udig_rings, with the owner and the
+//    ppm_ring_buffer_info of every ring.
+//  - UDIG_RINGS_SM_FNAME: the ring buffers, UDIG_PRODUCER_RING_SIZE bytes
+//    each, back to back. Every ring is mapped twice in a row, so events can
+//    be written and read across the end of the buffer.
+//
+// Usage, in the instrumented process, one producer per thread:
+//
+//   udig_producer p;
+//   if(udig_producer_open(&p, error) == SCAP_SUCCESS)
+//   {
+//       struct ppm_evt_hdr* evt = (struct ppm_evt_hdr*)udig_producer_reserve(&p, len);
+//       if(evt != NULL)
+//       {
+//           ... fill len bytes ...
+//           udig_producer_commit(&p, len);
+//       }
+//       ...
+//       udig_producer_close(&p);
+//   }
+//
+// A producer holds an OFD lock on the descriptor of its ring while it
+// owns it. The kernel drops the lock when the producer goes away, and
+// the ring is reclaimed by the next producer that looks for a free one.
+// m_active has a bit for every ring that is owned or has events left, so
+// the consumer only scans the rings in use.
+//
+// All the shared memory names start with the prefix set by
+// udig_set_shm_prefix(), empty by default. The consumer and the producers
+// must use the same one.
+//
+// Not available on Windows.
+///////////////////////////////////////////////////////////////////////////////
+#define UDIG_RINGS_SM_FNAME "udig_rings_buf"
+#define UDIG_RINGS_DESCS_SM_FNAME "udig_rings_descs"
+#define UDIG_MAX_PRODUCER_RINGS 64
+#define UDIG_PRODUCER_RING_SIZE (4 * 1024 * 1024)
+#define UDIG_SHM_PREFIX_MAX 64
+#define UDIG_SHM_NAME_MAX (UDIG_SHM_PREFIX_MAX + 32)
+
+struct udig_ring_desc {
+	//
+	// Informational, the ownership is the lock
+	//
+	volatile int32_t m_owner_pid;
+	volatile int32_t m_owner_tid;
+	struct ppm_ring_buffer_info m_info;
+	//
+	// Keeps the descriptors of different producers on different cache lines
+	//
+	uint8_t m_pad[64 - (2 * sizeof(int32_t) + sizeof(struct ppm_ring_buffer_info)) % 64];
+};
+
+struct udig_rings {
+	volatile uint64_t m_active; // bit j is set while ring j is owned or not empty
+	volatile int m_initialized;
+	uint32_t m_nrings;
+	uint32_t m_ring_size;
+	uint8_t m_pad[64 - sizeof(uint64_t) - 3 * sizeof(uint32_t)];
+	struct udig_ring_desc m_rings[UDIG_MAX_PRODUCER_RINGS];
+};
+
+typedef struct udig_producer
+{
+	int m_descs_fd;
+	int m_buf_fd;
+	int m_status_fd;
+	struct udig_rings* m_rings;
+	struct ppm_ring_buffer_info* m_status_info;
+	struct udig_ring_buffer_status* m_status;
+	int32_t m_ring_id;
+	struct ppm_ring_buffer_info* m_info;
+	uint8_t* m_buffer;
+	uint32_t m_buffer_size;
+}udig_producer;
+
+//
+// Must be called before opening the consumer or a producer. Lets separate
+// captures, e.g. tests, live side by side.
+//
+void udig_set_shm_prefix(const char* prefix);
+
+//
+// Consumer side, used by scap_open_udig_int
+//
+int32_t udig_alloc_producer_rings(int* descs_fd, int* buf_fd,
+	struct udig_rings** rings,
+	uint8_t** buffers,
+	char *error);
+void udig_free_producer_rings(int descs_fd, int buf_fd, struct udig_rings* rings, uint8_t* buffers);
+
+//
+// Returns the address of the given ring in the buffers mapped by
+// udig_alloc_producer_rings(). Each ring takes twice its size.
+//
+static inline uint8_t* udig_producer_ring_buffer(struct udig_rings* rings, uint8_t* buffers, uint32_t ring_id)
+{
+	return buffers + (uint64_t)ring_id * rings->m_ring_size * 2;
+}
+
+//
+// Producer side
+//
+int32_t udig_producer_open(udig_producer* p, char *error);
+void udig_producer_close(udig_producer* p);
+
+//
+// Whether a consumer is capturing. Nothing gets written otherwise.
+//
+static inline bool udig_producer_is_capturing(udig_producer* p)
+{
+	return p->m_status->m_capturing_pid != 0 && p->m_status->m_stopped == 0;
+}
+
+//
+// The capture settings of the consumer (snaplen, dropping mode...)
+//
+static inline const struct udig_consumer_t* udig_producer_consumer(udig_producer* p)
+{
+	return &p->m_status->m_consumer;
+}
+
+//
+// Returns where to write an event of len bytes, or NULL if nobody is
+// capturing or if the ring is full. A full ring counts as a drop.
+// The space is contiguous, even across the end of the ring.
+//
+static inline uint8_t* udig_producer_reserve(udig_producer* p, uint32_t len)
+{
+	struct ppm_ring_buffer_info* info = p->m_info;
+	uint32_t head = info->head;
+	uint32_t tail;
+	uint32_t used;
+
+	if(!udig_producer_is_capturing(p))
+	{
+		return NULL;
+	}
+
+	//
+	// The tail is moved by the consumer once it's done with the data.
+	// Pairs with the barrier in scap_advance_tail().
+	//
+	tail = __atomic_load_n(&info->tail, __ATOMIC_ACQUIRE);
+	used = (head >= tail) ? head - tail : p->m_buffer_size - tail + head;
+
+	//
+	// head == tail means empty, so the ring can't be filled completely
+	//
+	if(used + len >= p->m_buffer_size)
+	{
+		info->n_drops_buffer++;
+		return NULL;
+	}
+
+	return p->m_buffer + head;
+}
+
+//
+// Publishes the len bytes written after udig_producer_reserve()
+//
+static inline void udig_producer_commit(udig_producer* p, uint32_t len)
+{
+	struct ppm_ring_buffer_info* info = p->m_info;
+	uint32_t head = info->head + len;
+
+	if(head >= p->m_buffer_size)
+	{
+		head -= p->m_buffer_size;
+	}
+
+	info->n_evts++;
+
+	//
+	// The event must be visible before the consumer sees the new head
+	//
+	__atomic_store_n(&info->head, head, __ATOMIC_RELEASE);
+}
+
+#ifdef __cplusplus
+}
+#endif
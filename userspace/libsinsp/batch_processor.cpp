@@ -0,0 +1,224 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "filter.h"
+#include "filterchecks.h"
+#include "batch_processor.h"
+
+extern sinsp_filter_check_list g_filterlist;
+
+#define RECORD_ALIGN(len) (((len) + 7) & ~7U)
+
+sinsp_batch_processor::sinsp_batch_processor(sinsp* inspector, consumer* cons):
+	m_inspector(inspector),
+	m_consumer(cons),
+	m_batch_size(1024),
+	m_max_latency_ns(ONE_SECOND_IN_NS / 10),
+	m_has_cur(false),
+	m_used(0),
+	m_nevts(0),
+	m_first_ts(0),
+	m_n_batches(0),
+	m_n_dropped(0)
+{
+}
+
+sinsp_batch_processor::~sinsp_batch_processor()
+{
+	for(sinsp_filter_check* chk : m_fields)
+	{
+		delete chk;
+	}
+}
+
+void sinsp_batch_processor::add_field(const std::string& field)
+{
+	sinsp_filter_check* chk = g_filterlist.new_filter_check_from_fldname(field, m_inspector, true);
+	if(chk == NULL)
+	{
+		throw sinsp_exception("invalid batch field " + field);
+	}
+
+	chk->parse_field_name(field.c_str(), true, false);
+	m_inspector->get_field_cache().attach(chk, field);
+	m_fields.push_back(chk);
+}
+
+ppm_param_type sinsp_batch_processor::get_field_type(uint32_t j) const
+{
+	return m_fields[j]->get_field_info()->m_type;
+}
+
+void sinsp_batch_processor::add_arena(uint8_t* data, uint32_t size)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_sizes[data] = size;
+	m_free.push_back({data, size});
+}
+
+void sinsp_batch_processor::release_arena(uint8_t* data)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto it = m_sizes.find(data);
+	if(it == m_sizes.end())
+	{
+		throw sinsp_exception("releasing an unknown batch arena");
+	}
+
+	m_free.push_back({data, it->second});
+}
+
+bool sinsp_batch_processor::acquire_arena()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if(m_free.empty())
+	{
+		return false;
+	}
+
+	m_cur = m_free.front();
+	m_free.pop_front();
+	m_has_cur = true;
+	m_used = 0;
+	m_nevts = 0;
+	return true;
+}
+
+void sinsp_batch_processor::flush()
+{
+	if(!m_has_cur || m_nevts == 0)
+	{
+		return;
+	}
+
+	//
+	// The arena is the consumer's from now on, it can come back at any
+	// time
+	//
+	m_has_cur = false;
+	m_n_batches++;
+	m_consumer->on_batch(m_cur.m_data, m_used, m_nevts);
+}
+
+void sinsp_batch_processor::on_capture_start()
+{
+	flush();
+}
+
+bool sinsp_batch_processor::write_record(sinsp_evt* evt)
+{
+	uint8_t* start = m_cur.m_data + m_used;
+	uint32_t avail = m_cur.m_size - m_used;
+	uint32_t len = sizeof(evt_hdr);
+
+	if(len > avail)
+	{
+		return false;
+	}
+
+	for(sinsp_filter_check* chk : m_fields)
+	{
+		uint32_t vlen = 0;
+		uint8_t* val = chk->extract_cached(evt, &vlen);
+
+		if(len + sizeof(uint32_t) > avail ||
+			(val != NULL && vlen > avail - len - sizeof(uint32_t)))
+		{
+			return false;
+		}
+
+		if(val == NULL)
+		{
+			uint32_t missing = FIELD_MISSING;
+			memcpy(start + len, &missing, sizeof(uint32_t));
+			len += sizeof(uint32_t);
+		}
+		else
+		{
+			memcpy(start + len, &vlen, sizeof(uint32_t));
+			len += sizeof(uint32_t);
+			memcpy(start + len, val, vlen);
+			len += vlen;
+		}
+	}
+
+	len = RECORD_ALIGN(len);
+	if(len > avail)
+	{
+		return false;
+	}
+
+	evt_hdr* hdr = (evt_hdr*)start;
+	hdr->m_len = len;
+	hdr->m_type = evt->get_type();
+	hdr->m_cpuid = evt->get_cpuid();
+	hdr->m_num = evt->get_num();
+	hdr->m_ts = evt->get_ts();
+	hdr->m_tid = evt->get_tid();
+
+	if(m_nevts == 0)
+	{
+		m_first_ts = hdr->m_ts;
+	}
+
+	m_used += len;
+	m_nevts++;
+	return true;
+}
+
+void sinsp_batch_processor::process_event(sinsp_evt* evt, libsinsp::event_return rc)
+{
+	if(evt == NULL)
+	{
+		//
+		// Nothing more for now, or ever: don't keep the consumer waiting
+		//
+		flush();
+		return;
+	}
+
+	if(!m_has_cur && !acquire_arena())
+	{
+		m_n_dropped++;
+		return;
+	}
+
+	if(!write_record(evt))
+	{
+		//
+		// Full, try with the next arena unless this one was empty
+		//
+		bool was_empty = m_nevts == 0;
+		flush();
+
+		if(was_empty || !acquire_arena() || !write_record(evt))
+		{
+			m_n_dropped++;
+			return;
+		}
+	}
+
+	if(m_nevts >= m_batch_size ||
+		evt->get_ts() - m_first_ts >= m_max_latency_ns)
+	{
+		flush();
+	}
+}
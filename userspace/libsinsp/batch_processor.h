@@ -0,0 +1,181 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "scap.h"
+#include "include/sinsp_external_processor.h"
+
+class sinsp;
+class sinsp_evt;
+class sinsp_filter_check;
+
+///////////////////////////////////////////////////////////////////////////////
+// External event processor that hands the events over in batches, for
+// consumers that pay a toll every time they're called (another language
+// runtime, another process...).
+//
+// The events are written in arenas owned by the consumer, with the values of
+// the fields it registered already extracted, and a full arena is passed to
+// consumer::on_batch() in one call. The consumer gives the arena back with
+// release_arena(), from any thread, once it's done with it. When no arena is
+// available, the events are dropped and counted.
+//
+// A batch is a sequence of records, each one starting on an 8 byte boundary:
+//
+//   evt_hdr   the event number, timestamp, thread, type and CPU, and the
+//             length of the record, padding included
+//   fields    for each registered field, in registration order, a uint32
+//             length followed by that many bytes of the value as extracted,
+//             in host byte order. FIELD_MISSING as length, and no bytes,
+//             when the field doesn't apply to the event.
+//
+// A batch is delivered when it has batch_size events, when the next record
+// doesn't fit in the arena, when its first event is max_latency older than
+// the current one, when the capture times out (no events for now) and at the
+// end of the capture.
+///////////////////////////////////////////////////////////////////////////////
+class sinsp_batch_processor : public libsinsp::event_processor
+{
+public:
+	struct evt_hdr
+	{
+		uint32_t m_len;
+		uint16_t m_type;
+		uint16_t m_cpuid;
+		uint64_t m_num;
+		uint64_t m_ts;
+		int64_t m_tid;
+	};
+
+	static const uint32_t FIELD_MISSING = 0xffffffff;
+
+	class consumer
+	{
+	public:
+		virtual ~consumer()
+		{
+		}
+
+		//
+		// arena holds nevts records in its first len bytes. It belongs to
+		// the consumer until passed to release_arena().
+		//
+		virtual void on_batch(uint8_t* arena, uint32_t len, uint32_t nevts) = 0;
+	};
+
+	sinsp_batch_processor(sinsp* inspector, consumer* cons);
+	~sinsp_batch_processor();
+
+	//
+	// Adds a field (e.g. "fd.name", "proc.aname[2]") to the records.
+	// Throws if it doesn't exist. Fields are added before the capture starts.
+	//
+	void add_field(const std::string& field);
+
+	uint32_t get_n_fields() const
+	{
+		return (uint32_t)m_fields.size();
+	}
+
+	//
+	// The type of the bytes of field j, a PT_* value
+	//
+	ppm_param_type get_field_type(uint32_t j) const;
+
+	void set_batch_size(uint32_t nevts)
+	{
+		m_batch_size = nevts;
+	}
+
+	void set_max_latency(uint64_t ns)
+	{
+		m_max_latency_ns = ns;
+	}
+
+	//
+	// Gives an arena to the processor. It's never freed by it.
+	//
+	void add_arena(uint8_t* arena, uint32_t size);
+
+	//
+	// Returns an arena passed to on_batch(). Thread safe.
+	//
+	void release_arena(uint8_t* arena);
+
+	//
+	// Delivers the current batch, if any
+	//
+	void flush();
+
+	uint64_t get_n_batches() const
+	{
+		return m_n_batches;
+	}
+
+	//
+	// Events not delivered because no arena was available, or because
+	// their record is larger than an arena
+	//
+	uint64_t get_n_dropped() const
+	{
+		return m_n_dropped;
+	}
+
+	void on_capture_start() override;
+	void process_event(sinsp_evt* evt, libsinsp::event_return rc) override;
+	void add_chisel_metric(statsd_metric* metric) override
+	{
+	}
+
+private:
+	struct arena
+	{
+		uint8_t* m_data;
+		uint32_t m_size;
+	};
+
+	bool acquire_arena();
+	bool write_record(sinsp_evt* evt);
+
+	sinsp* m_inspector;
+	consumer* m_consumer;
+	std::vector<sinsp_filter_check*> m_fields;
+	uint32_t m_batch_size;
+	uint64_t m_max_latency_ns;
+
+	// The arena being filled
+	arena m_cur;
+	bool m_has_cur;
+	uint32_t m_used;
+	uint32_t m_nevts;
+	uint64_t m_first_ts;
+
+	// Protects the arenas that aren't being filled or consumed
+	std::mutex m_mutex;
+	std::deque<arena> m_free;
+	std::unordered_map<uint8_t*, uint32_t> m_sizes;
+
+	uint64_t m_n_batches;
+	uint64_t m_n_dropped;
+};
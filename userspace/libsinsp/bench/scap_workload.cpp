@@ -0,0 +1,523 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <arpa/inet.h>
+#include <cstring>
+#include <stdexcept>
+
+#include "scap.h"
+#include "scap_savefile.h"
+#include "scap_workload.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// scap_workload_writer implementation
+///////////////////////////////////////////////////////////////////////////////
+scap_workload_writer::scap_workload_writer(const std::string& filename, uint32_t num_cpus):
+	m_num_cpus(num_cpus),
+	m_nevts(0)
+{
+	m_f = fopen(filename.c_str(), "wb");
+	if(m_f == NULL)
+	{
+		throw std::runtime_error("can't open " + filename + " for writing");
+	}
+
+	write_header();
+}
+
+scap_workload_writer::~scap_workload_writer()
+{
+	if(m_f != NULL)
+	{
+		fclose(m_f);
+	}
+}
+
+void scap_workload_writer::write_block(uint32_t type, const void* body, uint32_t len)
+{
+	static const char padding[4] = {0};
+	block_header bh;
+	uint32_t padlen = (4 - (len % 4)) % 4;
+
+	bh.block_type = type;
+	bh.block_total_length = sizeof(bh) + len + padlen + 4;
+
+	if(fwrite(&bh, sizeof(bh), 1, m_f) != 1 ||
+		(len != 0 && fwrite(body, len, 1, m_f) != 1) ||
+		(padlen != 0 && fwrite(padding, padlen, 1, m_f) != 1) ||
+		fwrite(&bh.block_total_length, sizeof(uint32_t), 1, m_f) != 1)
+	{
+		throw std::runtime_error("error writing the capture file");
+	}
+}
+
+void scap_workload_writer::write_header()
+{
+	section_header_block shb;
+	shb.byte_order_magic = SHB_MAGIC;
+	shb.major_version = CURRENT_MAJOR_VERSION;
+	shb.minor_version = CURRENT_MINOR_VERSION;
+	shb.section_length = 0xffffffffffffffffLL;
+	write_block(SHB_BLOCK_TYPE, &shb, sizeof(shb));
+
+	scap_machine_info mi;
+	memset(&mi, 0, sizeof(mi));
+	mi.num_cpus = m_num_cpus;
+	mi.memory_size_bytes = 16ULL * 1024 * 1024 * 1024;
+	mi.max_pid = 4194304;
+	strcpy(mi.hostname, "sinsp-bench");
+	write_block(MI_BLOCK_TYPE, &mi, sizeof(mi));
+
+	//
+	// One loopback interface. An empty interface list would be legal, but
+	// it's not something a live capture ever produces.
+	//
+	const char ifname[] = "lo";
+	uint16_t ifnamelen = sizeof(ifname) - 1;
+	std::string il;
+	il += u32(sizeof(uint16_t) * 2 + sizeof(uint32_t) * 3 + sizeof(uint64_t) + ifnamelen);
+	il += u16(SCAP_II_IPV4);
+	il += u16(ifnamelen);
+	il += u32(0x0100007F);
+	il += u32(0x000000FF);
+	il += u32(0x00FFFFFF);
+	il += u64(0);
+	il.append(ifname, ifnamelen);
+	write_block(IL_BLOCK_TYPE_V2, il.data(), il.size());
+
+	write_block(UL_BLOCK_TYPE_V2, NULL, 0);
+}
+
+void scap_workload_writer::write_event(uint64_t ts, int64_t tid, uint16_t type, uint16_t cpuid, const std::vector<param>& params)
+{
+	uint32_t len = sizeof(struct ppm_evt_hdr) + params.size() * sizeof(uint16_t);
+	for(const param& p : params)
+	{
+		len += p.size();
+	}
+
+	m_evbuf.resize(sizeof(uint16_t) + len);
+	char* p = m_evbuf.data();
+
+	memcpy(p, &cpuid, sizeof(uint16_t));
+	p += sizeof(uint16_t);
+
+	struct ppm_evt_hdr hdr;
+	hdr.ts = ts;
+	hdr.tid = tid;
+	hdr.len = len;
+	hdr.type = type;
+	hdr.nparams = params.size();
+	memcpy(p, &hdr, sizeof(hdr));
+	p += sizeof(hdr);
+
+	for(const param& pa : params)
+	{
+		uint16_t plen = pa.size();
+		memcpy(p, &plen, sizeof(uint16_t));
+		p += sizeof(uint16_t);
+	}
+
+	for(const param& pa : params)
+	{
+		memcpy(p, pa.data(), pa.size());
+		p += pa.size();
+	}
+
+	write_block(EV_BLOCK_TYPE_V2, m_evbuf.data(), m_evbuf.size());
+	m_nevts++;
+}
+
+scap_workload_writer::param scap_workload_writer::u8(uint8_t v)
+{
+	return param((const char*)&v, sizeof(v));
+}
+
+scap_workload_writer::param scap_workload_writer::u16(uint16_t v)
+{
+	return param((const char*)&v, sizeof(v));
+}
+
+scap_workload_writer::param scap_workload_writer::u32(uint32_t v)
+{
+	return param((const char*)&v, sizeof(v));
+}
+
+scap_workload_writer::param scap_workload_writer::u64(uint64_t v)
+{
+	return param((const char*)&v, sizeof(v));
+}
+
+scap_workload_writer::param scap_workload_writer::str(const std::string& v)
+{
+	return param(v.c_str(), v.size() + 1);
+}
+
+scap_workload_writer::param scap_workload_writer::buf(const std::string& v)
+{
+	return v;
+}
+
+scap_workload_writer::param scap_workload_writer::strlist(const std::vector<std::string>& v)
+{
+	param res;
+	for(const std::string& s : v)
+	{
+		res.append(s.c_str(), s.size() + 1);
+	}
+	return res;
+}
+
+scap_workload_writer::param scap_workload_writer::tuple4(uint32_t sip, uint16_t sport, uint32_t dip, uint16_t dport)
+{
+	param res = u8(PPM_AF_INET);
+	res += u32(htonl(sip));
+	res += u16(sport);
+	res += u32(htonl(dip));
+	res += u16(dport);
+	return res;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Workload generators
+///////////////////////////////////////////////////////////////////////////////
+namespace
+{
+typedef scap_workload_writer w;
+
+const uint32_t NUM_CPUS = 8;
+const uint32_t SERVER_IP = 0x0a000001;	// 10.0.0.1
+const uint32_t CLIENT_NET = 0x0a010000;	// 10.1.0.0/16
+
+class generator
+{
+public:
+	generator(const std::string& filename, uint32_t seed):
+		m_w(filename, NUM_CPUS),
+		m_rng(seed),
+		m_ts(1600000000000000000ULL)
+	{
+	}
+
+	uint64_t get_num_events() const
+	{
+		return m_w.get_num_events();
+	}
+
+	uint32_t rand(uint32_t max)
+	{
+		return std::uniform_int_distribution<uint32_t>(0, max - 1)(m_rng);
+	}
+
+	void event(int64_t tid, uint16_t type, const std::vector<w::param>& params)
+	{
+		m_ts += 200 + rand(2000);
+		m_w.write_event(m_ts, tid, type, (uint16_t)(tid % NUM_CPUS), params);
+	}
+
+	void syscall(int64_t tid, uint16_t etype, const std::vector<w::param>& eparams, const std::vector<w::param>& xparams)
+	{
+		event(tid, etype, eparams);
+		event(tid, etype + 1, xparams);
+	}
+
+	void execve(int64_t tid, int64_t ptid, const std::string& exe, const std::vector<std::string>& args,
+		const std::vector<std::string>& cgroups)
+	{
+		std::string comm = exe.substr(exe.rfind('/') + 1);
+		syscall(tid, PPME_SYSCALL_EXECVE_19_E,
+			{w::str(exe)},
+			{w::i64(0), w::str(exe), w::strlist(args), w::i64(tid), w::i64(tid), w::i64(ptid),
+			 w::str("/"), w::u64(1024), w::u64(0), w::u64(100), w::u32(10000), w::u32(2000), w::u32(0),
+			 w::str(comm), w::strlist(cgroups), w::strlist({"PATH=/usr/bin:/bin", "HOME=/root"}),
+			 w::i32(0), w::i64(tid), w::i32(-1)});
+	}
+
+	void clone(int64_t ptid, int64_t ctid, const std::string& exe, const std::vector<std::string>& cgroups, uint32_t flags)
+	{
+		int64_t pid = (flags & PPM_CL_CLONE_THREAD) ? ptid : ctid;
+		std::string comm = exe.substr(exe.rfind('/') + 1);
+		auto params = [&](int64_t res, int64_t tid)
+		{
+			return std::vector<w::param>{
+				w::i64(res), w::str(exe), w::strlist({}), w::i64(tid), w::i64(tid == ctid ? pid : ptid), w::i64(ptid),
+				w::str("/"), w::i64(1024), w::u64(0), w::u64(100), w::u32(10000), w::u32(2000), w::u32(0),
+				w::str(comm), w::strlist(cgroups), w::u32(flags), w::u32(0), w::u32(0), w::i64(tid), w::i64(tid)};
+		};
+
+		event(ptid, PPME_SYSCALL_CLONE_20_E, {});
+		event(ptid, PPME_SYSCALL_CLONE_20_X, params(ctid, ptid));
+		event(ctid, PPME_SYSCALL_CLONE_20_X, params(0, ctid));
+	}
+
+	void procexit(int64_t tid)
+	{
+		event(tid, PPME_PROCEXIT_1_E, {w::i64(0)});
+	}
+
+	void open(int64_t tid, int64_t fd, const std::string& name)
+	{
+		syscall(tid, PPME_SYSCALL_OPEN_E, {}, {w::i64(fd), w::str(name), w::u32(1), w::u32(0), w::u32(0x803)});
+	}
+
+	void read(int64_t tid, int64_t fd, const std::string& data)
+	{
+		syscall(tid, PPME_SYSCALL_READ_E, {w::i64(fd), w::u32(data.size())}, {w::i64(data.size()), w::buf(snaplen(data))});
+	}
+
+	void write(int64_t tid, int64_t fd, const std::string& data)
+	{
+		syscall(tid, PPME_SYSCALL_WRITE_E, {w::i64(fd), w::u32(data.size())}, {w::i64(data.size()), w::buf(snaplen(data))});
+	}
+
+	void close(int64_t tid, int64_t fd)
+	{
+		syscall(tid, PPME_SYSCALL_CLOSE_E, {w::i64(fd)}, {w::i64(0)});
+	}
+
+	void container(const std::string& full_id, const std::string& name, const std::string& image)
+	{
+		std::string json = "{\"container\":{\"id\":\"" + full_id.substr(0, 12) +
+			"\",\"full_id\":\"" + full_id +
+			"\",\"type\":0,\"name\":\"" + name +
+			"\",\"image\":\"" + image +
+			"\",\"imagerepo\":\"" + image.substr(0, image.find(':')) +
+			"\",\"imagetag\":\"latest\",\"privileged\":false,\"Mounts\":[],\"env\":[],\"labels\":{}}}";
+		event(-1, PPME_CONTAINER_JSON_E, {w::str(json)});
+	}
+
+	std::string hex_id()
+	{
+		static const char digits[] = "0123456789abcdef";
+		std::string res(64, '0');
+		for(char& c : res)
+		{
+			c = digits[rand(16)];
+		}
+		return res;
+	}
+
+	std::string payload(uint32_t size)
+	{
+		std::string res(size, 'x');
+		for(uint32_t j = 0; j < size; j += 64)
+		{
+			res[j] = 'a' + rand(26);
+		}
+		return res;
+	}
+
+private:
+	// The driver truncates I/O buffers to the snaplen, so do we
+	static std::string snaplen(const std::string& data)
+	{
+		return data.substr(0, 80);
+	}
+
+	scap_workload_writer m_w;
+	std::mt19937 m_rng;
+	uint64_t m_ts;
+};
+
+void web_server(generator& g, uint64_t nevts)
+{
+	const int64_t master = 1000;
+	const uint32_t n_workers = 8;
+	const char* files[] = {"/var/www/index.html", "/var/www/style.css", "/var/www/app.js", "/var/www/logo.png"};
+
+	g.execve(master, 1, "/usr/sbin/nginx", {"-g", "daemon off;"}, {});
+	for(uint32_t j = 0; j < n_workers; j++)
+	{
+		g.clone(master, master + 1 + j, "/usr/sbin/nginx", {}, 0);
+	}
+
+	uint16_t cport = 32768;
+	while(g.get_num_events() < nevts)
+	{
+		int64_t tid = master + 1 + g.rand(n_workers);
+		const char* file = files[g.rand(sizeof(files) / sizeof(files[0]))];
+		uint32_t cip = CLIENT_NET + g.rand(65536);
+		std::string req = std::string("GET ") + (file + 8) + " HTTP/1.1\r\nHost: bench\r\nUser-Agent: curl/7.68.0\r\nAccept: */*\r\n\r\n";
+		std::string resp = "HTTP/1.1 200 OK\r\nServer: nginx\r\nContent-Type: text/html\r\n\r\n" + g.payload(512 + g.rand(4096));
+		w::param tuple = w::tuple4(cip, cport, SERVER_IP, 80);
+		cport = (cport == 60999) ? 32768 : cport + 1;
+
+		g.syscall(tid, PPME_SOCKET_ACCEPT4_5_E, {w::i32(0)}, {w::i64(10), tuple, w::u8(0), w::u32(0), w::u32(511)});
+		g.syscall(tid, PPME_SOCKET_RECVFROM_E, {w::i64(10), w::u32(1024)}, {w::i64(req.size()), w::buf(req.substr(0, 80)), tuple});
+		g.open(tid, 11, file);
+		g.read(tid, 11, g.payload(512 + g.rand(4096)));
+		g.close(tid, 11);
+		g.syscall(tid, PPME_SOCKET_SENDTO_E, {w::i64(10), w::u32(resp.size()), tuple}, {w::i64(resp.size()), w::buf(resp.substr(0, 80))});
+		g.close(tid, 10);
+	}
+}
+
+void fork_storm(generator& g, uint64_t nevts)
+{
+	const int64_t shell = 2000;
+	const char* cmds[] = {"/bin/true", "/bin/ls", "/bin/cat", "/usr/bin/id", "/bin/date"};
+	const std::vector<std::string> cgroups = {
+		"cpuset=/",
+		"cpu=/user.slice",
+		"memory=/user.slice/user-1000.slice/session-2.scope",
+		"pids=/user.slice/user-1000.slice/session-2.scope"};
+
+	g.execve(shell, 1, "/bin/bash", {"-c", "while :; do ...; done"}, cgroups);
+
+	int64_t next_tid = shell + 1;
+	while(g.get_num_events() < nevts)
+	{
+		int64_t child = next_tid++;
+		std::string cmd = cmds[g.rand(sizeof(cmds) / sizeof(cmds[0]))];
+
+		g.clone(shell, child, "/bin/bash", cgroups, 0);
+		g.execve(child, shell, cmd, {"-l"}, cgroups);
+		g.open(child, 3, "/etc/ld.so.cache");
+		g.close(child, 3);
+		g.write(child, 1, g.payload(16 + g.rand(64)));
+		g.procexit(child);
+	}
+}
+
+void container_churn(generator& g, uint64_t nevts)
+{
+	const char* images[] = {"nginx:latest", "redis:6", "busybox:latest", "postgres:13"};
+	int64_t next_tid = 3000;
+
+	while(g.get_num_events() < nevts)
+	{
+		std::string id = g.hex_id();
+		std::string image = images[g.rand(sizeof(images) / sizeof(images[0]))];
+		std::vector<std::string> cgroups = {"cpuset=/docker/" + id, "cpu=/docker/" + id, "memory=/docker/" + id};
+		int64_t init = next_tid++;
+
+		g.container(id, "bench_" + id.substr(0, 8), image);
+		g.execve(init, 1, "/bin/sh", {"-c", "entrypoint.sh"}, cgroups);
+
+		uint32_t nprocs = 1 + g.rand(4);
+		for(uint32_t j = 0; j < nprocs; j++)
+		{
+			int64_t child = next_tid++;
+			g.clone(init, child, "/bin/sh", cgroups, 0);
+			g.execve(child, init, "/usr/local/bin/app", {"--config", "/etc/app.conf"}, cgroups);
+			g.open(child, 3, "/etc/app.conf");
+			g.read(child, 3, g.payload(256));
+			g.close(child, 3);
+			g.procexit(child);
+		}
+
+		g.procexit(init);
+	}
+}
+
+void network_io(generator& g, uint64_t nevts)
+{
+	const int64_t client = 4000;
+	const uint32_t n_threads = 4;
+	const uint32_t n_conns = 16;
+
+	g.execve(client, 1, "/usr/bin/iperf", {"-c", "10.0.0.1"}, {});
+	for(uint32_t j = 1; j < n_threads; j++)
+	{
+		g.clone(client, client + j, "/usr/bin/iperf", {}, PPM_CL_CLONE_THREAD | PPM_CL_CLONE_FILES);
+	}
+
+	for(uint32_t j = 0; j < n_conns; j++)
+	{
+		int64_t tid = client + (j % n_threads);
+		int64_t fd = 3 + j;
+		g.syscall(tid, PPME_SOCKET_SOCKET_E, {w::u32(PPM_AF_INET), w::u32(1), w::u32(0)}, {w::i64(fd)});
+		g.syscall(tid, PPME_SOCKET_CONNECT_E, {w::i64(fd)}, {w::i64(0), w::tuple4(0x0a000002, 40000 + j, SERVER_IP, 5201)});
+	}
+
+	while(g.get_num_events() < nevts)
+	{
+		uint32_t conn = g.rand(n_conns);
+		int64_t tid = client + (conn % n_threads);
+		std::string data = g.payload(8192 + g.rand(57344));
+
+		if(g.rand(4) == 0)
+		{
+			g.read(tid, 3 + conn, data);
+		}
+		else
+		{
+			g.write(tid, 3 + conn, data);
+		}
+	}
+
+	for(uint32_t j = 0; j < n_conns; j++)
+	{
+		g.close(client + (j % n_threads), 3 + j);
+	}
+}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// scap_workload implementation
+///////////////////////////////////////////////////////////////////////////////
+static const char* s_workload_names[scap_workload::TYPE_MAX] =
+{
+	"web_server",
+	"fork_storm",
+	"container_churn",
+	"network_io",
+};
+
+const char* scap_workload::name(type t)
+{
+	return (t < TYPE_MAX) ? s_workload_names[t] : "unknown";
+}
+
+bool scap_workload::from_name(const std::string& name, type* t)
+{
+	for(uint32_t j = 0; j < TYPE_MAX; j++)
+	{
+		if(name == s_workload_names[j])
+		{
+			*t = (type)j;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+uint64_t scap_workload::generate(type t, const std::string& filename, uint64_t nevts, uint32_t seed)
+{
+	generator g(filename, seed);
+
+	switch(t)
+	{
+	case WEB_SERVER:
+		web_server(g, nevts);
+		break;
+	case FORK_STORM:
+		fork_storm(g, nevts);
+		break;
+	case CONTAINER_CHURN:
+		container_churn(g, nevts);
+		break;
+	case NETWORK_IO:
+		network_io(g, nevts);
+		break;
+	default:
+		throw std::runtime_error("unknown workload");
+	}
+
+	return g.get_num_events();
+}
@@ -0,0 +1,108 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+//
+// Writes a scap capture file from scratch, without a scap handle.
+//
+// Only the blocks libscap requires to open a capture are emitted (machine
+// info, interface list, user list), followed by event blocks. Processes are
+// expected to be introduced by the events themselves (execve, clone), which
+// keeps the generated captures fully deterministic and independent from the
+// machine running the generator.
+//
+class scap_workload_writer
+{
+public:
+	typedef std::string param;
+
+	scap_workload_writer(const std::string& filename, uint32_t num_cpus);
+	~scap_workload_writer();
+
+	void write_event(uint64_t ts, int64_t tid, uint16_t type, uint16_t cpuid, const std::vector<param>& params);
+
+	uint64_t get_num_events() const
+	{
+		return m_nevts;
+	}
+
+	//
+	// Parameter encoders, following the driver's wire format
+	//
+	static param u8(uint8_t v);
+	static param u16(uint16_t v);
+	static param u32(uint32_t v);
+	static param u64(uint64_t v);
+	static param i32(int32_t v)
+	{
+		return u32((uint32_t)v);
+	}
+	static param i64(int64_t v)
+	{
+		return u64((uint64_t)v);
+	}
+	// NUL-terminated string (PT_CHARBUF, PT_FSPATH)
+	static param str(const std::string& v);
+	// Raw bytes (PT_BYTEBUF)
+	static param buf(const std::string& v);
+	// Concatenation of NUL-terminated strings (args, env, cgroups)
+	static param strlist(const std::vector<std::string>& v);
+	// IPv4 PT_SOCKTUPLE, addresses and ports in host order
+	static param tuple4(uint32_t sip, uint16_t sport, uint32_t dip, uint16_t dport);
+
+private:
+	void write_block(uint32_t type, const void* body, uint32_t len);
+	void write_header();
+
+	FILE* m_f;
+	uint32_t m_num_cpus;
+	uint64_t m_nevts;
+	std::vector<char> m_evbuf;
+};
+
+//
+// Synthetic workloads. All of them are seeded, so the same workload with
+// the same event count always produces the same capture.
+//
+class scap_workload
+{
+public:
+	enum type
+	{
+		WEB_SERVER = 0,	///< Worker threads accepting, reading files and answering requests.
+		FORK_STORM = 1,	///< A shell spawning short-lived processes.
+		CONTAINER_CHURN = 2,	///< Containers coming and going, each running a few processes.
+		NETWORK_IO = 3,	///< Long-lived connections moving large buffers.
+		TYPE_MAX = 4,
+	};
+
+	static const char* name(type t);
+	static bool from_name(const std::string& name, type* t);
+
+	//
+	// Generate approximately nevts events (a workload never stops in the
+	// middle of a syscall) and return the number of events written.
+	//
+	static uint64_t generate(type t, const std::string& filename, uint64_t nevts, uint32_t seed = 42);
+};
@@ -0,0 +1,58 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+
+#include "scap_workload.h"
+
+static void usage()
+{
+	fprintf(stderr, "usage: scap-workload-gen <workload> <output.scap> [nevents] [seed]\n\nworkloads:\n");
+	for(uint32_t j = 0; j < scap_workload::TYPE_MAX; j++)
+	{
+		fprintf(stderr, "  %s\n", scap_workload::name((scap_workload::type)j));
+	}
+}
+
+int main(int argc, char** argv)
+{
+	scap_workload::type w;
+
+	if(argc < 3 || !scap_workload::from_name(argv[1], &w))
+	{
+		usage();
+		return 1;
+	}
+
+	uint64_t nevts = (argc > 3) ? strtoull(argv[3], NULL, 10) : 1000000;
+	uint32_t seed = (argc > 4) ? strtoul(argv[4], NULL, 10) : 42;
+
+	try
+	{
+		uint64_t written = scap_workload::generate(w, argv[2], nevts, seed);
+		printf("%s: %lu events written to %s\n", argv[1], (unsigned long)written, argv[2]);
+	}
+	catch(const std::exception& e)
+	{
+		fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,978 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+//
+// sinsp-bench: end-to-end and per-component benchmarks of the event
+// pipeline, run on synthetic captures generated at startup.
+//
+// On top of the Google Benchmark flags (--benchmark_filter,
+// --benchmark_format=json, --benchmark_out, ...) it accepts:
+//   --events=N        events per generated capture (default 200000)
+//   --capture_dir=D   where to write the captures (default: a temporary
+//                     directory, removed on exit)
+//
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <malloc.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include <benchmark/benchmark.h>
+
+#include "sinsp.h"
+#include "batch_processor.h"
+#include "filter.h"
+#include "l7_decoder.h"
+#include "scap_workload.h"
+#include "tracers.h"
+#include "udig_rings.h"
+
+namespace
+{
+std::string s_captures[scap_workload::TYPE_MAX];
+uint64_t s_capture_nevts[scap_workload::TYPE_MAX];
+uint64_t s_udig_nevts;
+uint64_t s_span_nevts;
+std::string s_enter_capture;
+
+void set_counters(benchmark::State& state, uint64_t nevts)
+{
+	state.SetItemsProcessed(state.iterations() * nevts);
+
+	// Seconds per event, printed with an SI suffix (e.g. 350n)
+	state.counters["time_per_evt"] = benchmark::Counter(
+		(double)(state.iterations() * nevts),
+		benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+//
+// libscap only: reading and decoding the blocks, no state.
+//
+void bm_scap_next(benchmark::State& state, scap_workload::type w)
+{
+	char error[SCAP_LASTERR_SIZE];
+	int32_t rc;
+	uint64_t nevts = 0;
+
+	for(auto _ : state)
+	{
+		scap_t* h = scap_open_offline(s_captures[w].c_str(), error, &rc);
+		if(h == NULL)
+		{
+			state.SkipWithError(error);
+			return;
+		}
+
+		scap_evt* ev;
+		uint16_t cpuid;
+		nevts = 0;
+		while(scap_next(h, &ev, &cpuid) == SCAP_SUCCESS)
+		{
+			benchmark::DoNotOptimize(ev);
+			nevts++;
+		}
+
+		scap_close(h);
+	}
+
+	set_counters(state, nevts);
+}
+
+//
+// Runs the whole capture through sinsp. The callback, if any, is invoked
+// on every event returned by next().
+//
+template<typename F>
+void run_sinsp(benchmark::State& state, sinsp& inspector, scap_workload::type w, F&& on_evt)
+{
+	uint64_t nevts = 0;
+
+	for(auto _ : state)
+	{
+		inspector.open(s_captures[w]);
+
+		sinsp_evt* evt;
+		nevts = 0;
+		while(true)
+		{
+			int32_t res = inspector.next(&evt);
+			if(res == SCAP_EOF)
+			{
+				break;
+			}
+			else if(res == SCAP_TIMEOUT)
+			{
+				continue;
+			}
+			else if(res != SCAP_SUCCESS)
+			{
+				state.SkipWithError(inspector.getlasterr().c_str());
+				inspector.close();
+				return;
+			}
+
+			on_evt(evt);
+			nevts++;
+		}
+
+		inspector.close();
+	}
+
+	set_counters(state, nevts);
+}
+
+void bm_sinsp_next(benchmark::State& state, scap_workload::type w, bool pipeline_stats)
+{
+	sinsp inspector;
+	inspector.set_pipeline_stats_enabled(pipeline_stats);
+	run_sinsp(state, inspector, w, [](sinsp_evt* evt) {});
+}
+
+//
+// Container resolution on the fork/exec paths, with the static engine so
+// every thread lands in a container. Reports how many resolutions were
+// answered without running the engines.
+//
+void bm_container_resolution(benchmark::State& state, scap_workload::type w)
+{
+	sinsp inspector(true, "bench_static", "bench_static", "bench:latest");
+	run_sinsp(state, inspector, w, [](sinsp_evt* evt) {});
+
+	// The manager outlives the captures, the counters add up over the iterations
+	const sinsp_container_manager& manager = inspector.m_container_manager;
+	state.counters["inherited"] = benchmark::Counter(
+		(double)manager.get_n_inherited(), benchmark::Counter::kAvgIterations);
+	state.counters["cgroup_cache_hits"] = benchmark::Counter(
+		(double)manager.get_n_cgroup_cache_hits(), benchmark::Counter::kAvgIterations);
+}
+
+//
+// Request/response pairing on the socket payloads
+//
+void bm_l7_decoder(benchmark::State& state, scap_workload::type w)
+{
+	sinsp inspector;
+	sinsp_decoder_l7* l7 = (sinsp_decoder_l7*)inspector.require_protodecoder("l7");
+	uint64_t latency_ns = 0;
+	l7->set_record_callback([&](const sinsp_l7_record& rec, sinsp_evt* evt)
+	{
+		latency_ns += rec.m_latency_ns;
+	});
+
+	run_sinsp(state, inspector, w, [](sinsp_evt* evt) {});
+	benchmark::DoNotOptimize(latency_ns);
+
+	state.counters["records"] = benchmark::Counter(
+		(double)l7->get_n_records(), benchmark::Counter::kAvgIterations);
+}
+
+//
+// A consumer that pays for every call what a call from C into another
+// runtime costs (about 100ns for cgo), and gives the arena back right away
+//
+class bench_batch_consumer : public sinsp_batch_processor::consumer
+{
+public:
+	static const uint64_t CROSSING_NS = 100;
+
+	void on_batch(uint8_t* arena, uint32_t len, uint32_t nevts) override
+	{
+		auto end = std::chrono::steady_clock::now() + std::chrono::nanoseconds(CROSSING_NS);
+		while(std::chrono::steady_clock::now() < end)
+		{
+		}
+
+		m_nevts += nevts;
+		m_processor->release_arena(arena);
+	}
+
+	sinsp_batch_processor* m_processor = NULL;
+	uint64_t m_nevts = 0;
+};
+
+//
+// The events handed over with a few fields, state.range(0) at a time: 1 is
+// a call per event
+//
+void bm_batch_processor(benchmark::State& state, scap_workload::type w)
+{
+	sinsp inspector;
+	bench_batch_consumer consumer;
+	sinsp_batch_processor processor(&inspector, &consumer);
+	consumer.m_processor = &processor;
+
+	processor.add_field("evt.type");
+	processor.add_field("thread.tid");
+	processor.add_field("proc.name");
+	processor.add_field("fd.name");
+	processor.set_batch_size(state.range(0));
+	processor.set_max_latency(ONE_SECOND_IN_NS);
+
+	std::vector<uint8_t> arenas[2];
+	for(auto& arena : arenas)
+	{
+		arena.resize(4 * 1024 * 1024);
+		processor.add_arena(arena.data(), arena.size());
+	}
+
+	inspector.register_external_event_processor(processor);
+	run_sinsp(state, inspector, w, [](sinsp_evt* evt) {});
+	benchmark::DoNotOptimize(consumer.m_nevts);
+
+	state.counters["batches"] = benchmark::Counter(
+		(double)processor.get_n_batches(), benchmark::Counter::kAvgIterations);
+	state.counters["dropped"] = benchmark::Counter(
+		(double)processor.get_n_dropped(), benchmark::Counter::kAvgIterations);
+}
+
+//
+// sinsp::next() keeping per-process, per-container and per-connection
+// aggregates instead of handing the events over
+//
+void bm_rollup(benchmark::State& state, scap_workload::type w)
+{
+	sinsp inspector;
+	sinsp_rollup& rollup = inspector.enable_rollups();
+	const std::string io = "evt.dir=< and evt.is_io=true and evt.rawres>0";
+
+	rollup.add_metric({"syscalls", sinsp_rollup::ENTITY_PROCESS, sinsp_rollup::AGG_COUNT, "", "evt.dir=<"});
+	rollup.add_metric({"io_bytes", sinsp_rollup::ENTITY_CONTAINER, sinsp_rollup::AGG_SUM, "evt.rawres", io});
+	rollup.add_metric({"io_sizes", sinsp_rollup::ENTITY_CONNECTION, sinsp_rollup::AGG_HISTOGRAM, "evt.rawres", io});
+	rollup.add_metric({"io_latency", sinsp_rollup::ENTITY_CONNECTION, sinsp_rollup::AGG_HISTOGRAM, "evt.latency", io});
+
+	uint64_t nrows = 0;
+	rollup.set_snapshot_callback([&](const sinsp_rollup& r, uint64_t start_ts, uint64_t end_ts) {
+		for(uint32_t j = 0; j < sinsp_rollup::ENTITY_MAX; j++)
+		{
+			nrows += r.get_n_entities((sinsp_rollup::entity)j);
+		}
+	});
+
+	run_sinsp(state, inspector, w, [](sinsp_evt* evt) {});
+
+	state.counters["rows"] = benchmark::Counter((double)nrows, benchmark::Counter::kAvgIterations);
+}
+
+//
+// A synthetic ruleset in the spirit of a rules file: every rule is scoped
+// to a few event types and mixes string, numeric and container fields.
+//
+struct bench_rule
+{
+	const char* fmt;
+	std::set<uint32_t> evttypes;
+};
+
+const bench_rule s_rule_templates[] =
+{
+	{"evt.type=open and fd.name startswith /etc/shadow%u", {PPME_SYSCALL_OPEN_E, PPME_SYSCALL_OPEN_X}},
+	{"evt.type=execve and proc.name=miner%u and proc.pname in (sh, bash)", {PPME_SYSCALL_EXECVE_19_E, PPME_SYSCALL_EXECVE_19_X}},
+	{"evt.type in (accept, connect) and fd.sport=%u", {PPME_SOCKET_ACCEPT4_5_E, PPME_SOCKET_ACCEPT4_5_X, PPME_SOCKET_CONNECT_E, PPME_SOCKET_CONNECT_X}},
+	{"evt.type=write and fd.num=%u and proc.cmdline contains suspicious", {PPME_SYSCALL_WRITE_E, PPME_SYSCALL_WRITE_X}},
+	{"container.id!=host and evt.type=execve and proc.args contains --mine%u", {PPME_SYSCALL_EXECVE_19_E, PPME_SYSCALL_EXECVE_19_X}},
+	{"evt.type=read and fd.typechar=f and fd.directory=/root/%u", {PPME_SYSCALL_READ_E, PPME_SYSCALL_READ_X}},
+};
+
+void add_rules(sinsp& inspector, sinsp_evttype_filter& ruleset, uint32_t nrules)
+{
+	uint32_t n_templates = sizeof(s_rule_templates) / sizeof(s_rule_templates[0]);
+
+	for(uint32_t j = 0; j < nrules; j++)
+	{
+		const bench_rule& tmpl = s_rule_templates[j % n_templates];
+		char fltstr[256];
+		snprintf(fltstr, sizeof(fltstr), tmpl.fmt, (uint32_t)j);
+
+		sinsp_filter_compiler compiler(&inspector, fltstr);
+		std::string name = "rule_" + std::to_string(j);
+		std::set<uint32_t> evttypes = tmpl.evttypes;
+		std::set<uint32_t> syscalls;
+		std::set<std::string> tags;
+		ruleset.add(name, evttypes, syscalls, tags, compiler.compile());
+	}
+	ruleset.enable(".*", true);
+}
+
+void bm_evttype_filter(benchmark::State& state, scap_workload::type w)
+{
+	sinsp inspector;
+	sinsp_evttype_filter ruleset;
+	add_rules(inspector, ruleset, (uint32_t)state.range(0));
+
+	uint64_t nmatches = 0;
+	run_sinsp(state, inspector, w, [&](sinsp_evt* evt)
+	{
+		nmatches += ruleset.run(evt);
+	});
+	benchmark::DoNotOptimize(nmatches);
+}
+
+//
+// N rules on the command line of the process, on every event: the joined
+// strings are built once per exec, not once per rule and event.
+//
+void bm_proc_cmdline_rules(benchmark::State& state, scap_workload::type w)
+{
+	uint32_t nrules = (uint32_t)state.range(0);
+	sinsp inspector;
+	sinsp_evttype_filter ruleset;
+
+	for(uint32_t j = 0; j < nrules; j++)
+	{
+		std::string fltstr = "proc.cmdline contains \"--flag" + std::to_string(j) +
+			"\" or proc.exeline contains \"/tmp/bin" + std::to_string(j) + "\"";
+
+		sinsp_filter_compiler compiler(&inspector, fltstr);
+		std::set<uint32_t> evttypes;
+		std::set<uint32_t> syscalls;
+		std::set<std::string> tags;
+		std::string name = "rule_" + std::to_string(j);
+		ruleset.add(name, evttypes, syscalls, tags, compiler.compile());
+	}
+	ruleset.enable(".*", true);
+
+	uint64_t nmatches = 0;
+	run_sinsp(state, inspector, w, [&](sinsp_evt* evt)
+	{
+		nmatches += ruleset.run(evt);
+	});
+	benchmark::DoNotOptimize(nmatches);
+}
+
+//
+// N rules on the ancestors of the process, up to 7 levels up and all of
+// them, on every event: the ancestors are looked up once per process, not
+// once per rule, level and event.
+//
+void bm_ancestor_rules(benchmark::State& state, scap_workload::type w)
+{
+	uint32_t nrules = (uint32_t)state.range(0);
+	sinsp inspector;
+	sinsp_evttype_filter ruleset;
+
+	for(uint32_t j = 0; j < nrules; j++)
+	{
+		std::string fltstr = "proc.aname[" + std::to_string(j % 7 + 1) + "]=parent" + std::to_string(j) +
+			" or proc.aname=ancestor" + std::to_string(j);
+
+		sinsp_filter_compiler compiler(&inspector, fltstr);
+		std::set<uint32_t> evttypes;
+		std::set<uint32_t> syscalls;
+		std::set<std::string> tags;
+		std::string name = "rule_" + std::to_string(j);
+		ruleset.add(name, evttypes, syscalls, tags, compiler.compile());
+	}
+	ruleset.enable(".*", true);
+
+	uint64_t nmatches = 0;
+	run_sinsp(state, inspector, w, [&](sinsp_evt* evt)
+	{
+		nmatches += ruleset.run(evt);
+	});
+	benchmark::DoNotOptimize(nmatches);
+}
+
+void bm_formatter(benchmark::State& state, scap_workload::type w, bool json)
+{
+	sinsp inspector;
+	if(json)
+	{
+		inspector.set_buffer_format(sinsp_evt::PF_JSON);
+	}
+
+	sinsp_evt_formatter formatter(&inspector,
+		"%evt.time %proc.name (%proc.pid) %evt.type %evt.args fd=%fd.name container=%container.id");
+	std::string line;
+	run_sinsp(state, inspector, w, [&](sinsp_evt* evt)
+	{
+		formatter.tostring(evt, &line);
+	});
+}
+
+//
+// A reference ruleset the way a rules file expands it: every rule repeats
+// the same macros and lists, and only its tail is its own.
+//
+const char* s_reference_macros[] =
+{
+	// spawned_process and a shell
+	"(evt.type=execve and evt.dir=<) and proc.name in (ash, bash, csh, ksh, sh, tcsh, zsh, dash)",
+	// open_read of a sensitive file
+	"(evt.type in (open, openat) and evt.dir=< and fd.typechar=f and evt.rawres>=0) and "
+		"fd.name in (/etc/shadow, /etc/sudoers, /etc/pam.conf, /etc/security/pwquality.conf)",
+	// inbound connection in a container
+	"(evt.type in (accept, listen) and evt.dir=<) and container.id!=host and "
+		"not fd.sip in (127.0.0.1, 10.0.0.1)",
+	// write below a binary directory
+	"(evt.type in (open, openat) and evt.dir=< and fd.typechar=f and evt.rawres>=0 and evt.arg.flags contains O_WRONLY) and "
+		"fd.directory in (/bin, /sbin, /usr/bin, /usr/sbin)",
+};
+
+void add_reference_rules(sinsp& inspector, sinsp_evttype_filter& ruleset, uint32_t nrules)
+{
+	uint32_t n_macros = sizeof(s_reference_macros) / sizeof(s_reference_macros[0]);
+
+	for(uint32_t j = 0; j < nrules; j++)
+	{
+		std::string fltstr = std::string(s_reference_macros[j % n_macros]) +
+			" and not proc.pname in (allowed_parent_" + std::to_string(j) + ", cron, systemd)";
+
+		sinsp_filter_compiler compiler(&inspector, fltstr);
+		std::string name = "rule_" + std::to_string(j);
+		std::set<uint32_t> evttypes;
+		std::set<uint32_t> syscalls;
+		std::set<std::string> tags;
+		ruleset.add(name, evttypes, syscalls, tags, compiler.compile());
+	}
+	ruleset.enable(".*", true);
+}
+
+//
+// Every rule of the reference ruleset, one ruleset each so that they all
+// run on every event, with and without the common subexpressions shared.
+// The counters report the heap taken by the compiled rules and, when
+// shared, their checks and the ones left after sharing.
+//
+void bm_rules_reference(benchmark::State& state, scap_workload::type w, bool share)
+{
+	uint32_t nrules = (uint32_t)state.range(0);
+	sinsp inspector;
+	sinsp_evttype_filter ruleset;
+	ruleset.set_share_subexpressions(share);
+
+	size_t heap = mallinfo2().uordblks;
+	add_reference_rules(inspector, ruleset, nrules);
+	state.counters["rules_bytes"] = (double)(mallinfo2().uordblks - heap);
+	if(share)
+	{
+		state.counters["checks"] = (double)ruleset.get_cse().get_n_checks();
+		state.counters["shared_checks"] = (double)ruleset.get_cse().get_n_nodes();
+	}
+
+	for(uint32_t j = 0; j < nrules; j++)
+	{
+		ruleset.enable("rule_" + std::to_string(j), true, (uint16_t)(j + 1));
+	}
+
+	uint64_t nmatches = 0;
+	run_sinsp(state, inspector, w, [&](sinsp_evt* evt)
+	{
+		for(uint32_t j = 0; j < nrules; j++)
+		{
+			nmatches += ruleset.run(evt, (uint16_t)(j + 1));
+		}
+	});
+	benchmark::DoNotOptimize(nmatches);
+}
+
+//
+// What a rules engine does: 200 rules, then JSON output for every event.
+// With the field cache, the fields the rules and the output have in
+// common are extracted once per event.
+//
+void bm_rules_json_output(benchmark::State& state, scap_workload::type w, bool field_cache)
+{
+	sinsp inspector;
+	inspector.get_field_cache().set_enabled(field_cache);
+	inspector.set_buffer_format(sinsp_evt::PF_JSON);
+
+	sinsp_evttype_filter ruleset;
+	add_rules(inspector, ruleset, 200);
+
+	sinsp_evt_formatter formatter(&inspector,
+		"%evt.time %proc.name (%proc.pid) %proc.cmdline %evt.type %evt.args fd=%fd.name "
+		"port=%fd.sport container=%container.id");
+	std::string line;
+	uint64_t nmatches = 0;
+	run_sinsp(state, inspector, w, [&](sinsp_evt* evt)
+	{
+		nmatches += ruleset.run(evt);
+		formatter.tostring(evt, &line);
+	});
+	benchmark::DoNotOptimize(nmatches);
+}
+
+//
+// udig producers writing close() enter events, with the capture running in
+// the benchmark thread. Either every producer has its own ring, or they all
+// share the legacy ring, serialized by its spinlock like the instrumented
+// processes do.
+//
+const uint32_t s_udig_evt_len = sizeof(struct ppm_evt_hdr) + sizeof(uint16_t) + sizeof(int64_t);
+
+void udig_fill_evt(uint8_t* buf, int64_t tid, int64_t fd)
+{
+	struct ppm_evt_hdr* hdr = (struct ppm_evt_hdr*)buf;
+	uint16_t plen = sizeof(int64_t);
+
+	hdr->ts = sinsp_utils::get_current_time_ns();
+	hdr->tid = tid;
+	hdr->len = s_udig_evt_len;
+	hdr->type = PPME_SYSCALL_CLOSE_E;
+	hdr->nparams = 1;
+	memcpy(buf + sizeof(struct ppm_evt_hdr), &plen, sizeof(plen));
+	memcpy(buf + sizeof(struct ppm_evt_hdr) + sizeof(plen), &fd, sizeof(fd));
+}
+
+void udig_produce_own_ring(uint64_t nevts)
+{
+	char error[SCAP_LASTERR_SIZE];
+	udig_producer p;
+	int64_t tid = syscall(SYS_gettid);
+
+	if(udig_producer_open(&p, error) != SCAP_SUCCESS)
+	{
+		return;
+	}
+
+	for(uint64_t j = 0; j < nevts; j++)
+	{
+		uint8_t* buf;
+		while((buf = udig_producer_reserve(&p, s_udig_evt_len)) == NULL)
+		{
+			sched_yield();
+		}
+
+		udig_fill_evt(buf, tid, j);
+		udig_producer_commit(&p, s_udig_evt_len);
+	}
+
+	udig_producer_close(&p);
+}
+
+void udig_produce_shared_ring(uint64_t nevts)
+{
+	char error[SCAP_LASTERR_SIZE];
+	int ring_fd;
+	int descs_fd;
+	uint8_t* ring;
+	uint32_t ring_size;
+	struct ppm_ring_buffer_info* info;
+	struct udig_ring_buffer_status* status;
+	int64_t tid = syscall(SYS_gettid);
+
+	if(udig_alloc_ring(&ring_fd, &ring, &ring_size, error) != SCAP_SUCCESS)
+	{
+		return;
+	}
+	if(udig_alloc_ring_descriptors(&descs_fd, &info, &status, error) != SCAP_SUCCESS)
+	{
+		udig_free_ring(ring, ring_size);
+		close(ring_fd);
+		return;
+	}
+
+	for(uint64_t j = 0; j < nevts;)
+	{
+		while(__sync_lock_test_and_set(&status->m_buffer_lock, 1))
+		{
+		}
+
+		uint32_t head = info->head;
+		uint32_t tail = info->tail;
+		uint32_t used = (head >= tail) ? head - tail : ring_size - tail + head;
+		bool written = false;
+		if(used + s_udig_evt_len < ring_size)
+		{
+			udig_fill_evt(ring + head, tid, j);
+			head += s_udig_evt_len;
+			info->n_evts++;
+			__sync_synchronize();
+			info->head = (head >= ring_size) ? head - ring_size : head;
+			written = true;
+		}
+
+		__sync_lock_release(&status->m_buffer_lock);
+
+		if(written)
+		{
+			j++;
+		}
+		else
+		{
+			sched_yield();
+		}
+	}
+
+	udig_free_ring_descriptors((uint8_t*)info);
+	udig_free_ring(ring, ring_size);
+	close(descs_fd);
+	close(ring_fd);
+}
+
+void bm_udig(benchmark::State& state, bool producer_rings)
+{
+	char error[SCAP_LASTERR_SIZE];
+	int32_t rc;
+	scap_open_args args = {};
+	uint32_t nproducers = (uint32_t)state.range(0);
+	uint64_t nevts = s_udig_nevts / nproducers * nproducers;
+	std::string prefix = "udig_bench_" + std::to_string(getpid()) + "_";
+
+	udig_set_shm_prefix(prefix.c_str());
+	args.mode = SCAP_MODE_LIVE;
+	args.udig = true;
+	scap_t* h = scap_open(args, error, &rc);
+	if(h == NULL)
+	{
+		udig_set_shm_prefix("");
+		state.SkipWithError(error);
+		return;
+	}
+
+	for(auto _ : state)
+	{
+		std::vector<std::thread> producers;
+		for(uint32_t j = 0; j < nproducers; j++)
+		{
+			producers.emplace_back(producer_rings ? udig_produce_own_ring : udig_produce_shared_ring,
+				nevts / nproducers);
+		}
+
+		scap_evt* ev;
+		uint16_t cpuid;
+		uint64_t n = 0;
+		while(n < nevts)
+		{
+			if(scap_next(h, &ev, &cpuid) == SCAP_SUCCESS)
+			{
+				benchmark::DoNotOptimize(ev);
+				n++;
+			}
+		}
+
+		for(auto& t : producers)
+		{
+			t.join();
+		}
+	}
+
+	scap_close(h);
+	shm_unlink((prefix + UDIG_RINGS_SM_FNAME).c_str());
+	shm_unlink((prefix + UDIG_RINGS_DESCS_SM_FNAME).c_str());
+	shm_unlink((prefix + UDIG_RING_SM_FNAME).c_str());
+	shm_unlink((prefix + UDIG_RING_DESCS_SM_FNAME).c_str());
+	udig_set_shm_prefix("");
+
+	set_counters(state, nevts);
+}
+
+//
+// The tracer parser alone, with span state tracking on: a service with
+// SPAN_REQUESTS requests in flight, each one with an open span, and
+// database spans that start and end concurrently inside them.
+//
+const uint32_t SPAN_REQUESTS = 64;
+
+std::string span_event(bool json, bool enter, uint32_t id, bool db)
+{
+	char buf[256];
+
+	if(json)
+	{
+		snprintf(buf, sizeof(buf),
+			"[\"%c\", %u, [\"frontend\", \"request\"%s], [{\"query\":\"select name from users where id > 10 order by name limit 100\"}, {\"rows\":\"10\"}]]",
+			enter ? '>' : '<', id, db ? ", \"db\"" : "");
+	}
+	else
+	{
+		snprintf(buf, sizeof(buf), "%c:%u:frontend.request%s:query=select name from users where id > 10 order by name limit 100,rows=10:",
+			enter ? '>' : '<', id, db ? ".db" : "");
+	}
+
+	return buf;
+}
+
+void bm_spans(benchmark::State& state, bool json)
+{
+	sinsp inspector;
+	inspector.request_tracer_state_tracking();
+	sinsp_threadinfo tinfo(&inspector);
+	tinfo.m_tid = tinfo.m_pid = 100;
+	sinsp_tracerparser parser(&inspector);
+	parser.m_tinfo = &tinfo;
+
+	std::vector<std::string> requests;
+	std::vector<std::string> evts;
+	for(uint32_t j = 0; j < SPAN_REQUESTS; j++)
+	{
+		requests.push_back(span_event(json, true, j + 1, false));
+	}
+	for(uint64_t j = 0; j < s_span_nevts / (2 * SPAN_REQUESTS); j++)
+	{
+		for(uint32_t k = 1; k <= SPAN_REQUESTS; k++)
+		{
+			evts.push_back(span_event(json, true, k, true));
+		}
+		for(uint32_t k = 1; k <= SPAN_REQUESTS; k++)
+		{
+			evts.push_back(span_event(json, false, k, true));
+		}
+	}
+
+	for(std::string& e : requests)
+	{
+		parser.process_event_data((char*)e.c_str(), (uint32_t)e.size(), 0);
+	}
+
+	uint64_t nmatched = 0;
+	for(auto _ : state)
+	{
+		uint64_t ts = 0;
+		for(std::string& e : evts)
+		{
+			parser.process_event_data((char*)e.c_str(), (uint32_t)e.size(), ts++);
+			if(e[json ? 2 : 0] == '<' && parser.m_enter_pae != NULL)
+			{
+				nmatched++;
+			}
+		}
+	}
+
+	state.counters["matched"] = (double)nmatched / state.iterations();
+	set_counters(state, evts.size());
+}
+
+//
+// A server with a lot of threads in the middle of the syscalls whose enter
+// event is kept for the exit parser: every thread enters openat() or
+// sendto(), then they all return, over and over.
+//
+const uint32_t ENTER_THREADS = 5000;
+
+uint64_t write_enter_capture(const std::string& filename, uint64_t nevts)
+{
+	typedef scap_workload_writer w;
+	w writer(filename, 1);
+	uint64_t ts = 1600000000000000000ULL;
+	std::string payload(64, 'x');
+
+	while(writer.get_num_events() < nevts)
+	{
+		for(uint32_t j = 0; j < ENTER_THREADS; j++)
+		{
+			int64_t tid = 1000 + j;
+			if(j % 2 == 0)
+			{
+				writer.write_event(ts++, tid, PPME_SYSCALL_OPENAT_E, 0,
+					{w::i64(-100), w::str("/var/lib/app/data/" + std::to_string(j)), w::u32(1), w::u32(0644)});
+			}
+			else
+			{
+				writer.write_event(ts++, tid, PPME_SOCKET_SENDTO_E, 0,
+					{w::i64(3), w::u32(payload.size()), w::tuple4(0x0a000001, 1000 + j, 0x0a000002, 53)});
+			}
+		}
+
+		for(uint32_t j = 0; j < ENTER_THREADS; j++)
+		{
+			int64_t tid = 1000 + j;
+			if(j % 2 == 0)
+			{
+				writer.write_event(ts++, tid, PPME_SYSCALL_OPENAT_X, 0, {w::i64(3)});
+			}
+			else
+			{
+				writer.write_event(ts++, tid, PPME_SOCKET_SENDTO_X, 0, {w::i64(payload.size()), w::buf(payload)});
+			}
+		}
+	}
+
+	return writer.get_num_events();
+}
+
+//
+// The peak_heap counter reports the most heap taken during the replay on
+// top of what was taken before it, the thread table included.
+//
+void bm_enter_events(benchmark::State& state)
+{
+	uint64_t nevts = 0;
+	size_t peak = 0;
+	size_t base = mallinfo2().uordblks;
+	sinsp inspector;
+
+	for(auto _ : state)
+	{
+		inspector.open(s_enter_capture);
+
+		sinsp_evt* evt;
+		nevts = 0;
+		while(inspector.next(&evt) == SCAP_SUCCESS)
+		{
+			if(++nevts % 1024 == 0)
+			{
+				state.PauseTiming();
+				peak = std::max(peak, mallinfo2().uordblks);
+				state.ResumeTiming();
+			}
+		}
+
+		inspector.close();
+	}
+
+	set_counters(state, nevts);
+	state.counters["peak_heap"] = (double)(peak - base);
+}
+
+void register_benchmarks()
+{
+	for(uint32_t j = 0; j < scap_workload::TYPE_MAX; j++)
+	{
+		scap_workload::type w = (scap_workload::type)j;
+		std::string name = scap_workload::name(w);
+
+		benchmark::RegisterBenchmark(("scap_next/" + name).c_str(), bm_scap_next, w)
+			->Unit(benchmark::kMillisecond);
+		benchmark::RegisterBenchmark(("sinsp_next/" + name).c_str(), bm_sinsp_next, w, false)
+			->Unit(benchmark::kMillisecond);
+		benchmark::RegisterBenchmark(("sinsp_next_pipeline_stats/" + name).c_str(), bm_sinsp_next, w, true)
+			->Unit(benchmark::kMillisecond);
+		benchmark::RegisterBenchmark(("container_resolution/" + name).c_str(), bm_container_resolution, w)
+			->Unit(benchmark::kMillisecond);
+		benchmark::RegisterBenchmark(("l7_decoder/" + name).c_str(), bm_l7_decoder, w)
+			->Unit(benchmark::kMillisecond);
+		benchmark::RegisterBenchmark(("batch_processor/" + name).c_str(), bm_batch_processor, w)
+			->Arg(1)->Arg(16)->Arg(256)->Arg(4096)
+			->Unit(benchmark::kMillisecond);
+		benchmark::RegisterBenchmark(("rollup/" + name).c_str(), bm_rollup, w)
+			->Unit(benchmark::kMillisecond);
+		benchmark::RegisterBenchmark(("evttype_filter/" + name).c_str(), bm_evttype_filter, w)
+			->Arg(1)->Arg(10)->Arg(100)->Arg(1000)
+			->Unit(benchmark::kMillisecond);
+		benchmark::RegisterBenchmark(("proc_cmdline_rules/" + name).c_str(), bm_proc_cmdline_rules, w)
+			->Arg(10)->Arg(100)
+			->Unit(benchmark::kMillisecond);
+		benchmark::RegisterBenchmark(("ancestor_rules/" + name).c_str(), bm_ancestor_rules, w)
+			->Arg(10)->Arg(100)
+			->Unit(benchmark::kMillisecond);
+		benchmark::RegisterBenchmark(("rules_reference/" + name).c_str(), bm_rules_reference, w, false)
+			->Arg(100)->Arg(400)
+			->Unit(benchmark::kMillisecond);
+		benchmark::RegisterBenchmark(("rules_reference_shared/" + name).c_str(), bm_rules_reference, w, true)
+			->Arg(100)->Arg(400)
+			->Unit(benchmark::kMillisecond);
+		benchmark::RegisterBenchmark(("formatter_text/" + name).c_str(), bm_formatter, w, false)
+			->Unit(benchmark::kMillisecond);
+		benchmark::RegisterBenchmark(("formatter_json/" + name).c_str(), bm_formatter, w, true)
+			->Unit(benchmark::kMillisecond);
+		benchmark::RegisterBenchmark(("rules_json_output/" + name).c_str(), bm_rules_json_output, w, false)
+			->Unit(benchmark::kMillisecond);
+		benchmark::RegisterBenchmark(("rules_json_output_field_cache/" + name).c_str(), bm_rules_json_output, w, true)
+			->Unit(benchmark::kMillisecond);
+	}
+
+	benchmark::RegisterBenchmark("udig_shared_ring", bm_udig, false)
+		->Arg(1)->Arg(2)->Arg(4)->Arg(8)
+		->UseRealTime()
+		->Unit(benchmark::kMillisecond);
+	benchmark::RegisterBenchmark("udig_producer_rings", bm_udig, true)
+		->Arg(1)->Arg(2)->Arg(4)->Arg(8)
+		->UseRealTime()
+		->Unit(benchmark::kMillisecond);
+
+	benchmark::RegisterBenchmark("spans_simple", bm_spans, false)
+		->Unit(benchmark::kMillisecond);
+	benchmark::RegisterBenchmark("spans_json", bm_spans, true)
+		->Unit(benchmark::kMillisecond);
+
+	benchmark::RegisterBenchmark("enter_events", bm_enter_events)
+		->Unit(benchmark::kMillisecond);
+}
+}
+
+int main(int argc, char** argv)
+{
+	uint64_t nevts = 200000;
+	std::string capture_dir;
+	bool remove_captures = false;
+
+	//
+	// Consume our own flags and leave the rest to Google Benchmark
+	//
+	int n_args = 1;
+	for(int j = 1; j < argc; j++)
+	{
+		if(strncmp(argv[j], "--events=", 9) == 0)
+		{
+			nevts = strtoull(argv[j] + 9, NULL, 10);
+		}
+		else if(strncmp(argv[j], "--capture_dir=", 14) == 0)
+		{
+			capture_dir = argv[j] + 14;
+		}
+		else
+		{
+			argv[n_args++] = argv[j];
+		}
+	}
+	argc = n_args;
+
+	benchmark::Initialize(&argc, argv);
+	if(benchmark::ReportUnrecognizedArguments(argc, argv))
+	{
+		return 1;
+	}
+
+	if(capture_dir.empty())
+	{
+		char tmpl[] = "/tmp/sinsp-bench-XXXXXX";
+		if(mkdtemp(tmpl) == NULL)
+		{
+			fprintf(stderr, "can't create a temporary directory\n");
+			return 1;
+		}
+		capture_dir = tmpl;
+		remove_captures = true;
+	}
+
+	for(uint32_t j = 0; j < scap_workload::TYPE_MAX; j++)
+	{
+		scap_workload::type w = (scap_workload::type)j;
+		s_captures[j] = capture_dir + "/" + scap_workload::name(w) + ".scap";
+		s_capture_nevts[j] = scap_workload::generate(w, s_captures[j], nevts);
+		benchmark::AddCustomContext(std::string("events.") + scap_workload::name(w),
+			std::to_string(s_capture_nevts[j]));
+	}
+
+	s_udig_nevts = nevts;
+	s_span_nevts = nevts;
+	s_enter_capture = capture_dir + "/enter_events.scap";
+	write_enter_capture(s_enter_capture, nevts);
+	register_benchmarks();
+	benchmark::RunSpecifiedBenchmarks();
+
+	if(remove_captures)
+	{
+		for(uint32_t j = 0; j < scap_workload::TYPE_MAX; j++)
+		{
+			unlink(s_captures[j].c_str());
+		}
+		unlink(s_enter_capture.c_str());
+		rmdir(capture_dir.c_str());
+	}
+
+	return 0;
+}
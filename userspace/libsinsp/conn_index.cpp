@@ -0,0 +1,509 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "conn_index.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_log2_histogram implementation
+///////////////////////////////////////////////////////////////////////////////
+void sinsp_log2_histogram::clear()
+{
+	m_count = 0;
+	m_min = 0;
+	m_max = 0;
+	memset(m_buckets, 0, sizeof(m_buckets));
+}
+
+void sinsp_log2_histogram::add(uint64_t val)
+{
+	m_buckets[get_bucket(val)]++;
+
+	if(m_count == 0 || val < m_min)
+	{
+		m_min = val;
+	}
+	if(val > m_max)
+	{
+		m_max = val;
+	}
+
+	m_count++;
+}
+
+uint64_t sinsp_log2_histogram::get_percentile(uint32_t pct) const
+{
+	if(m_count == 0)
+	{
+		return 0;
+	}
+
+	uint64_t rank = (m_count * pct + 99) / 100;
+	if(rank == 0)
+	{
+		rank = 1;
+	}
+
+	uint64_t count = 0;
+	for(uint32_t j = 0; j < N_BUCKETS; j++)
+	{
+		count += m_buckets[j];
+		if(count >= rank)
+		{
+			//
+			// The middle of the bucket, within what has been seen
+			//
+			uint64_t low = (j == 0) ? 0 : (1ULL << (j - 1));
+			uint64_t high = (j == 0) ? 0 : low + (low - 1);
+			uint64_t res = low + (high - low) / 2;
+
+			if(res < m_min)
+			{
+				res = m_min;
+			}
+			if(res > m_max)
+			{
+				res = m_max;
+			}
+
+			return res;
+		}
+	}
+
+	return m_max;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_tcp_stats implementation
+///////////////////////////////////////////////////////////////////////////////
+void sinsp_tcp_stats::clear()
+{
+	m_last_srtt_us = 0;
+	m_n_retransmits = 0;
+	m_n_drops = 0;
+	m_last_ts = 0;
+	m_rtt.clear();
+}
+
+void sinsp_tcp_stats::add_rtt(uint32_t srtt_us)
+{
+	m_rtt.add(srtt_us);
+	m_last_srtt_us = srtt_us;
+}
+
+static inline ipv6addr ipv4_to_key_addr(uint32_t ip)
+{
+	ipv6addr res = ipv6addr::empty_address;
+	res.m_b[0] = ip;
+	return res;
+}
+
+//
+// The tuple parameter of the tcp_* and skb events is 13 bytes for IPv4 and
+// 37 for IPv6, like the ones of the syscalls
+//
+bool sinsp_conn_index::make_key(sinsp_evt_param* parinfo, sinsp_conn_key* key, bool local_is_source)
+{
+	uint8_t* packed_data = (uint8_t*)parinfo->m_val;
+
+	if(parinfo->m_len == 1 + 4 + 2 + 4 + 2)
+	{
+		key->set(ipv4_to_key_addr(*(uint32_t*)(packed_data + 1)), *(uint16_t*)(packed_data + 5),
+			ipv4_to_key_addr(*(uint32_t*)(packed_data + 7)), *(uint16_t*)(packed_data + 11),
+			false);
+	}
+	else if(parinfo->m_len == 1 + 16 + 2 + 16 + 2)
+	{
+		uint8_t* sip = packed_data + 1;
+		uint8_t* dip = packed_data + 19;
+
+		//
+		// The parsers store IPv4-mapped IPv6 connections as IPv4 ones
+		//
+		if(sinsp_utils::is_ipv4_mapped_ipv6(sip) && sinsp_utils::is_ipv4_mapped_ipv6(dip))
+		{
+			key->set(ipv4_to_key_addr(*(uint32_t*)(sip + 12)), *(uint16_t*)(packed_data + 17),
+				ipv4_to_key_addr(*(uint32_t*)(dip + 12)), *(uint16_t*)(packed_data + 35),
+				false);
+		}
+		else
+		{
+			ipv6addr a1;
+			ipv6addr a2;
+			memcpy(a1.m_b, sip, sizeof(a1.m_b));
+			memcpy(a2.m_b, dip, sizeof(a2.m_b));
+			key->set(a1, *(uint16_t*)(packed_data + 17), a2, *(uint16_t*)(packed_data + 35), true);
+		}
+	}
+	else
+	{
+		return false;
+	}
+
+	if(!local_is_source)
+	{
+		std::swap(key->m_ip[0], key->m_ip[1]);
+		std::swap(key->m_port[0], key->m_port[1]);
+	}
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_conn_index implementation
+///////////////////////////////////////////////////////////////////////////////
+sinsp_conn_index::sinsp_conn_index(sinsp* inspector):
+	m_inspector(inspector),
+	m_max_connections(DEFAULT_MAX_CONNECTIONS),
+	m_snapshot_interval_ns(0),
+	m_next_snapshot_ts(0),
+	m_n_resolved(0),
+	m_n_unresolved(0),
+	m_n_dropped_connections(0)
+{
+}
+
+bool sinsp_conn_index::make_key(sinsp_fdinfo_t* fdinfo, sinsp_conn_key* key)
+{
+	if(fdinfo == NULL)
+	{
+		return false;
+	}
+
+	if(fdinfo->m_type == SCAP_FD_IPV4_SOCK)
+	{
+		ipv4tuple& t = fdinfo->m_sockinfo.m_ipv4info;
+		if(t.m_fields.m_l4proto != SCAP_L4_TCP || t.m_fields.m_sport == 0 || t.m_fields.m_dport == 0)
+		{
+			return false;
+		}
+
+		//
+		// The tuples of the fds go from the client to the server
+		//
+		if(fdinfo->is_role_server())
+		{
+			key->set(ipv4_to_key_addr(t.m_fields.m_dip), t.m_fields.m_dport,
+				ipv4_to_key_addr(t.m_fields.m_sip), t.m_fields.m_sport,
+				false);
+		}
+		else
+		{
+			key->set(ipv4_to_key_addr(t.m_fields.m_sip), t.m_fields.m_sport,
+				ipv4_to_key_addr(t.m_fields.m_dip), t.m_fields.m_dport,
+				false);
+		}
+		return true;
+	}
+	else if(fdinfo->m_type == SCAP_FD_IPV6_SOCK)
+	{
+		ipv6tuple& t = fdinfo->m_sockinfo.m_ipv6info;
+		if(t.m_fields.m_l4proto != SCAP_L4_TCP || t.m_fields.m_sport == 0 || t.m_fields.m_dport == 0)
+		{
+			return false;
+		}
+
+		if(fdinfo->is_role_server())
+		{
+			key->set(t.m_fields.m_dip, t.m_fields.m_dport, t.m_fields.m_sip, t.m_fields.m_sport, true);
+		}
+		else
+		{
+			key->set(t.m_fields.m_sip, t.m_fields.m_sport, t.m_fields.m_dip, t.m_fields.m_dport, true);
+		}
+		return true;
+	}
+
+	return false;
+}
+
+void sinsp_conn_index::add(sinsp_threadinfo* tinfo, int64_t fd, sinsp_fdinfo_t* fdinfo)
+{
+	sinsp_conn_key key;
+
+	if(tinfo == NULL || !make_key(fdinfo, &key))
+	{
+		return;
+	}
+
+	auto it = m_conns.find(key);
+	if(it == m_conns.end())
+	{
+		if(m_conns.size() >= m_max_connections)
+		{
+			m_n_dropped_connections++;
+			return;
+		}
+
+		it = m_conns.emplace(key, sinsp_conn()).first;
+	}
+	else if(it->second.m_pid == tinfo->m_pid && it->second.m_fd == fd && !it->second.m_closed)
+	{
+		//
+		// Same connection, e.g. the tuple got known later
+		//
+		return;
+	}
+	else
+	{
+		//
+		// The local endpoint has been reused by a new connection
+		//
+		it->second.m_stats.clear();
+		it->second.m_skb_latency.clear();
+	}
+
+	sinsp_conn& conn = it->second;
+	conn.m_ipv6 = key.m_ipv6;
+	if(key.m_ipv6)
+	{
+		conn.m_tuple = fdinfo->m_sockinfo.m_ipv6info;
+	}
+	else
+	{
+		ipv4tuple& t = fdinfo->m_sockinfo.m_ipv4info;
+		conn.m_tuple.m_fields.m_sip = ipv4_to_key_addr(t.m_fields.m_sip);
+		conn.m_tuple.m_fields.m_dip = ipv4_to_key_addr(t.m_fields.m_dip);
+		conn.m_tuple.m_fields.m_sport = t.m_fields.m_sport;
+		conn.m_tuple.m_fields.m_dport = t.m_fields.m_dport;
+		conn.m_tuple.m_fields.m_l4proto = t.m_fields.m_l4proto;
+	}
+	conn.m_pid = tinfo->m_pid;
+	conn.m_tid = tinfo->m_tid;
+	conn.m_fd = fd;
+	conn.m_closed = false;
+}
+
+void sinsp_conn_index::remove(sinsp_threadinfo* tinfo, int64_t fd, sinsp_fdinfo_t* fdinfo)
+{
+	sinsp_conn_key key;
+
+	if(tinfo == NULL || !make_key(fdinfo, &key))
+	{
+		return;
+	}
+
+	auto it = m_conns.find(key);
+	if(it == m_conns.end() || it->second.m_pid != tinfo->m_pid || it->second.m_fd != fd)
+	{
+		//
+		// Not the owner, e.g. a dup() of the socket
+		//
+		return;
+	}
+
+	if(m_snapshot_cb)
+	{
+		it->second.m_closed = true;
+	}
+	else
+	{
+		m_conns.erase(it);
+	}
+}
+
+const sinsp_conn* sinsp_conn_index::find(sinsp_fdinfo_t* fdinfo) const
+{
+	sinsp_conn_key key;
+
+	if(!make_key(fdinfo, &key))
+	{
+		return NULL;
+	}
+
+	auto it = m_conns.find(key);
+	return (it != m_conns.end()) ? &it->second : NULL;
+}
+
+sinsp_conn* sinsp_conn_index::find(const sinsp_conn_key& key)
+{
+	auto it = m_conns.find(key);
+	return (it != m_conns.end()) ? &it->second : NULL;
+}
+
+int64_t sinsp_conn_index::process_tcp_event(sinsp_evt* evt)
+{
+	uint64_t ts = evt->get_ts();
+	uint16_t etype = evt->get_type();
+	sinsp_conn_key key;
+
+	//
+	// The tuple is the one of the socket: the local endpoint first
+	//
+	if(!make_key(evt->get_param(0), &key))
+	{
+		m_n_unresolved++;
+		return -1;
+	}
+
+	auto it = m_conns.find(key);
+	if(it == m_conns.end())
+	{
+		m_n_unresolved++;
+		return -1;
+	}
+
+	sinsp_conn& conn = it->second;
+
+	switch(etype)
+	{
+	case PPME_TCP_RCV_ESTABLISHED_E:
+	case PPME_TCP_CLOSE_E:
+		{
+			sinsp_evt_param* parinfo = evt->get_param(1);
+			ASSERT(parinfo->m_len == sizeof(uint32_t));
+			conn.m_stats.add_rtt(*(uint32_t*)parinfo->m_val);
+		}
+		break;
+	case PPME_TCP_DROP_E:
+		conn.m_stats.m_n_drops++;
+		break;
+	case PPME_TCP_RETRANCESMIT_SKB_E:
+		conn.m_stats.m_n_retransmits++;
+		break;
+	default:
+		ASSERT(false);
+		break;
+	}
+
+	conn.m_stats.m_last_ts = ts;
+
+	return resolve(evt, key, it);
+}
+
+int64_t sinsp_conn_index::resolve(sinsp_evt* evt, const sinsp_conn_key& key)
+{
+	auto it = m_conns.find(key);
+	if(it == m_conns.end())
+	{
+		m_n_unresolved++;
+		return -1;
+	}
+
+	return resolve(evt, key, it);
+}
+
+int64_t sinsp_conn_index::resolve(sinsp_evt* evt, const sinsp_conn_key& key, conn_map::iterator it)
+{
+	sinsp_conn& conn = it->second;
+
+	if(conn.m_closed)
+	{
+		m_n_unresolved++;
+		return -1;
+	}
+
+	//
+	// The fd table is shared by the threads of the process
+	//
+	threadinfo_map_t::ptr_t tinfo = m_inspector->find_thread(conn.m_tid, true);
+	if(!tinfo)
+	{
+		tinfo = m_inspector->find_thread(conn.m_pid, true);
+	}
+
+	sinsp_fdinfo_t* fdinfo = tinfo ? tinfo->get_fd(conn.m_fd) : NULL;
+	sinsp_conn_key fdkey;
+	if(!make_key(fdinfo, &fdkey) || !(fdkey == key))
+	{
+		//
+		// The owner is gone, or the fd is now something else
+		//
+		if(m_snapshot_cb)
+		{
+			conn.m_closed = true;
+		}
+		else
+		{
+			m_conns.erase(it);
+		}
+
+		m_n_unresolved++;
+		return -1;
+	}
+
+	evt->m_tinfo = tinfo.get();
+	evt->m_fdinfo = fdinfo;
+	m_n_resolved++;
+
+	return conn.m_fd;
+}
+
+void sinsp_conn_index::snapshot(std::vector<sinsp_conn>& conns, bool reset)
+{
+	conns.clear();
+	conns.reserve(m_conns.size());
+
+	for(auto it = m_conns.begin(); it != m_conns.end();)
+	{
+		conns.push_back(it->second);
+
+		if(reset)
+		{
+			if(it->second.m_closed)
+			{
+				it = m_conns.erase(it);
+				continue;
+			}
+
+			it->second.m_stats.clear();
+			it->second.m_skb_latency.clear();
+		}
+
+		++it;
+	}
+}
+
+void sinsp_conn_index::set_snapshot_callback(snapshot_cb cb, uint64_t interval_ns)
+{
+	m_snapshot_cb = cb;
+	m_snapshot_interval_ns = interval_ns;
+	m_next_snapshot_ts = 0;
+}
+
+void sinsp_conn_index::check_snapshot(uint64_t ts)
+{
+	if(m_next_snapshot_ts == 0)
+	{
+		m_next_snapshot_ts = ts + m_snapshot_interval_ns;
+		return;
+	}
+
+	if(ts < m_next_snapshot_ts)
+	{
+		return;
+	}
+
+	snapshot(m_snapshot, true);
+	m_snapshot_cb(m_snapshot, ts);
+
+	m_next_snapshot_ts += m_snapshot_interval_ns;
+	if(m_next_snapshot_ts <= ts)
+	{
+		m_next_snapshot_ts = ts + m_snapshot_interval_ns;
+	}
+}
+
+void sinsp_conn_index::clear()
+{
+	m_conns.clear();
+	m_next_snapshot_ts = 0;
+	m_n_resolved = 0;
+	m_n_unresolved = 0;
+	m_n_dropped_connections = 0;
+}
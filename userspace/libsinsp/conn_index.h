@@ -0,0 +1,316 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "settings.h"
+#include "tuples.h"
+
+class sinsp;
+class sinsp_evt;
+class sinsp_threadinfo;
+
+//
+// Histogram with power of two buckets: bucket 0 counts the samples of 0,
+// bucket i those in [2^(i-1), 2^i)
+//
+struct sinsp_log2_histogram
+{
+	static const uint32_t N_BUCKETS = 64;
+
+	sinsp_log2_histogram()
+	{
+		clear();
+	}
+
+	void clear();
+	void add(uint64_t val);
+
+	//
+	// Bucket j holds the values with j significant bits, the last one the
+	// larger ones
+	//
+	static uint32_t get_bucket(uint64_t val)
+	{
+		uint32_t bucket = 0;
+		for(uint64_t v = val; v != 0 && bucket < N_BUCKETS - 1; v >>= 1)
+		{
+			bucket++;
+		}
+
+		return bucket;
+	}
+
+	//
+	// Estimate of the given percentile (0-100) of the samples, 0 without
+	// samples
+	//
+	uint64_t get_percentile(uint32_t pct) const;
+
+	uint64_t m_count;
+	uint64_t m_min;
+	uint64_t m_max;
+	uint32_t m_buckets[N_BUCKETS];
+};
+
+//
+// TCP health of a connection, from the tcp_* kprobe events
+//
+struct sinsp_tcp_stats
+{
+	sinsp_tcp_stats()
+	{
+		clear();
+	}
+
+	void clear();
+	void add_rtt(uint32_t srtt_us);
+
+	uint32_t m_last_srtt_us;
+	uint64_t m_n_retransmits;
+	uint64_t m_n_drops;
+	uint64_t m_last_ts;
+	//
+	// Smoothed RTTs, in microseconds
+	//
+	sinsp_log2_histogram m_rtt;
+};
+
+//
+// In-kernel latency of the data of a connection, in nanoseconds, from the
+// skb events matched with the socket syscalls by sinsp_skb_correlator
+//
+struct sinsp_skb_latency
+{
+	void clear()
+	{
+		m_ingress.clear();
+		m_egress.clear();
+	}
+
+	//
+	// From the netif_receive_skb of the newest packet a read returns to the
+	// read
+	//
+	sinsp_log2_histogram m_ingress;
+	//
+	// From the write to net_dev_xmit
+	//
+	sinsp_log2_histogram m_egress;
+};
+
+//
+// The two endpoints of a TCP connection, the local one first: when both
+// ends are captured, e.g. on loopback, the client and the server sockets
+// have their own key. IPv4 addresses use m_b[0] only.
+//
+struct sinsp_conn_key
+{
+	ipv6addr m_ip[2];
+	uint16_t m_port[2];
+	bool m_ipv6;
+
+	bool operator==(const sinsp_conn_key& other) const
+	{
+		return m_port[0] == other.m_port[0] &&
+			m_port[1] == other.m_port[1] &&
+			m_ipv6 == other.m_ipv6 &&
+			m_ip[0] == other.m_ip[0] &&
+			m_ip[1] == other.m_ip[1];
+	}
+
+	void set(const ipv6addr& local_ip, uint16_t local_port, const ipv6addr& remote_ip, uint16_t remote_port, bool ipv6)
+	{
+		m_ip[0] = local_ip;
+		m_port[0] = local_port;
+		m_ip[1] = remote_ip;
+		m_port[1] = remote_port;
+		m_ipv6 = ipv6;
+	}
+};
+
+struct sinsp_conn_key_hash
+{
+	size_t operator()(const sinsp_conn_key& k) const
+	{
+		std::hash<ipv6addr> h;
+		return h(k.m_ip[0]) ^ (h(k.m_ip[1]) * 31) ^ (((size_t)k.m_port[0] << 16) | k.m_port[1]);
+	}
+};
+
+//
+// A TCP connection of the capture and the fd that owns it
+//
+struct sinsp_conn
+{
+	//
+	// The tuple as seen by the fd: client (source) and server (destination)
+	//
+	ipv6tuple m_tuple;
+	bool m_ipv6;
+	int64_t m_pid;
+	int64_t m_tid;
+	int64_t m_fd;
+	//
+	// Closed since the last snapshot
+	//
+	bool m_closed;
+	sinsp_tcp_stats m_stats;
+	sinsp_skb_latency m_skb_latency;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// Index of the TCP connections of the capture, from their tuple to the
+// thread and the fd that own them.
+//
+// The socket parsers keep it up to date on connect, accept and close, and
+// from the sockets found in /proc. The tcp_rcv_established, tcp_close,
+// tcp_drop and tcp_retransmit_skb kprobe events only carry a tuple: they
+// are resolved through the index, so their thread, fd and container are
+// those of the owner of the connection, and feed its sinsp_tcp_stats.
+// The stats can be read through the fd.tcp.* fields, on these events as
+// well as on the syscalls of the connection, or through snapshots.
+// The netif_receive_skb and net_dev_xmit events are resolved the same way
+// by sinsp_skb_correlator, which keeps the sinsp_skb_latency of the entries.
+//
+// Entries are removed by sinsp_parser::erase_fd(), on the close of the fd
+// and, for the ones of a process that exits, when remove_thread() erases
+// the fds of its main thread. An entry that a kprobe event resolves to a
+// missing thread, or to an fd that is now something else (e.g. a close
+// that was dropped), is removed then. With a snapshot callback set, a
+// removed entry is only marked closed, and goes away after the snapshot
+// that reports it.
+///////////////////////////////////////////////////////////////////////////////
+class sinsp_conn_index
+{
+public:
+	typedef std::function<void(const std::vector<sinsp_conn>& conns, uint64_t ts)> snapshot_cb;
+
+	static const uint32_t DEFAULT_MAX_CONNECTIONS = 262144;
+
+	sinsp_conn_index(sinsp* inspector);
+
+	//
+	// fd of tinfo now owns the connection of fdinfo. Not TCP sockets
+	// and sockets without a tuple are ignored.
+	//
+	void add(sinsp_threadinfo* tinfo, int64_t fd, sinsp_fdinfo_t* fdinfo);
+
+	//
+	// The fd has been closed
+	//
+	void remove(sinsp_threadinfo* tinfo, int64_t fd, sinsp_fdinfo_t* fdinfo);
+
+	const sinsp_conn* find(sinsp_fdinfo_t* fdinfo) const;
+	sinsp_conn* find(const sinsp_conn_key& key);
+
+	//
+	// Resolves one of the tcp_* kprobe events: updates the stats of its
+	// connection and, if the owner is known, sets the thread and the fd
+	// of the event. Returns the fd number, -1 if unresolved.
+	//
+	int64_t process_tcp_event(sinsp_evt* evt);
+
+	//
+	// Sets the thread and the fd of an event of the connection of key,
+	// if its owner is known. Returns the fd number, -1 if unresolved.
+	//
+	int64_t resolve(sinsp_evt* evt, const sinsp_conn_key& key);
+
+	//
+	// Copies the known connections, including the ones closed since the
+	// last reset. With reset, the closed connections are forgotten and
+	// the stats of the others start again.
+	//
+	void snapshot(std::vector<sinsp_conn>& conns, bool reset);
+
+	//
+	// Delivers a snapshot, with reset, every interval_ns of event time.
+	// Closed connections are kept until the next snapshot only while a
+	// callback is set.
+	//
+	void set_snapshot_callback(snapshot_cb cb, uint64_t interval_ns);
+
+	//
+	// Called by the inspector for every event, so that the snapshots
+	// keep coming without the tcp_* events
+	//
+	inline void on_event(uint64_t ts)
+	{
+		if(m_snapshot_cb && ts >= m_next_snapshot_ts)
+		{
+			check_snapshot(ts);
+		}
+	}
+
+	void set_max_connections(uint32_t max_connections)
+	{
+		m_max_connections = max_connections;
+	}
+
+	void clear();
+
+	size_t size() const
+	{
+		return m_conns.size();
+	}
+
+	uint64_t get_n_resolved() const
+	{
+		return m_n_resolved;
+	}
+
+	uint64_t get_n_unresolved() const
+	{
+		return m_n_unresolved;
+	}
+
+	uint64_t get_n_dropped_connections() const
+	{
+		return m_n_dropped_connections;
+	}
+
+	static bool make_key(sinsp_fdinfo_t* fdinfo, sinsp_conn_key* key);
+
+	//
+	// From a PT_SOCKTUPLE parameter, whose source is the local endpoint
+	// unless local_is_source is false (e.g. a received packet)
+	//
+	static bool make_key(sinsp_evt_param* parinfo, sinsp_conn_key* key, bool local_is_source = true);
+
+private:
+	typedef std::unordered_map<sinsp_conn_key, sinsp_conn, sinsp_conn_key_hash> conn_map;
+
+	int64_t resolve(sinsp_evt* evt, const sinsp_conn_key& key, conn_map::iterator it);
+	void check_snapshot(uint64_t ts);
+
+	sinsp* m_inspector;
+	conn_map m_conns;
+	uint32_t m_max_connections;
+	snapshot_cb m_snapshot_cb;
+	uint64_t m_snapshot_interval_ns;
+	uint64_t m_next_snapshot_ts;
+	std::vector<sinsp_conn> m_snapshot;
+	uint64_t m_n_resolved;
+	uint64_t m_n_unresolved;
+	uint64_t m_n_dropped_connections;
+};
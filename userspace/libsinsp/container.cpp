@@ -45,6 +45,9 @@ using namespace libsinsp;
 sinsp_container_manager::sinsp_container_manager(sinsp* inspector, bool static_container, const std::string static_id, const std::string static_name, const std::string static_image) :
 	m_inspector(inspector),
 	m_last_flush_time_ns(0),
+	m_n_cgroup_cache_hits(0),
+	m_n_inherited(0),
+	m_prefetch_enabled(true),
 	m_static_container(static_container),
 	m_static_id(static_id),
 	m_static_name(static_name),
@@ -74,37 +77,114 @@ bool sinsp_container_manager::remove_inactive_containers()
 
 		g_logger.format(sinsp_logger::SEV_INFO, "Flushing container table");
 
-		set<string> containers_in_use;
+		remove_unused_containers();
+	}
 
-		threadinfo_map_t* threadtable = m_inspector->m_thread_manager->get_threads();
+	return res;
+}
 
-		threadtable->loop([&] (const sinsp_threadinfo& tinfo) {
-			if(!tinfo.m_container_id.empty())
+uint32_t sinsp_container_manager::remove_unused_containers()
+{
+	uint32_t res = 0;
+	set<string> containers_in_use;
+
+	threadinfo_map_t* threadtable = m_inspector->m_thread_manager->get_threads();
+
+	threadtable->loop([&] (const sinsp_threadinfo& tinfo) {
+		if(!tinfo.m_container_id.empty())
+		{
+			containers_in_use.insert(tinfo.m_container_id);
+		}
+		return true;
+	});
+
+	auto containers = m_containers.lock();
+	for(auto it = containers->begin(); it != containers->end();)
+	{
+		if(containers_in_use.find(it->first) == containers_in_use.end())
+		{
+			sinsp_container_info::ptr_t container = it->second;
+			for(const auto &remove_cb : m_remove_callbacks)
 			{
-				containers_in_use.insert(tinfo.m_container_id);
+				remove_cb(*container);
 			}
-			return true;
-		});
+			containers->erase(it++);
+			res++;
+		}
+		else
+		{
+			++it;
+		}
+	}
 
+	for(auto it = m_cgroup_cache.begin(); it != m_cgroup_cache.end();)
+	{
+		if(containers->find(it->second.m_container_id) == containers->end())
+		{
+			it = m_cgroup_cache.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+
+	return res;
+}
+
+uint64_t sinsp_container_manager::get_memory_usage() const
+{
+	const uint64_t node_overhead = 2 * sizeof(void*);
+	uint64_t res = 0;
+
+	{
 		auto containers = m_containers.lock();
-		for(auto it = containers->begin(); it != containers->end();)
+		for(const auto &it : *containers)
 		{
-			if(containers_in_use.find(it->first) == containers_in_use.end())
+			const sinsp_container_info &info = *it.second;
+
+			res += sizeof(std::pair<const std::string, sinsp_container_info::ptr_t>) + node_overhead +
+				sinsp_memory_budget::string_bytes(it.first) +
+				sizeof(sinsp_container_info) + 2 * sizeof(long) + sizeof(void*) +
+				sinsp_memory_budget::string_bytes(info.m_id) +
+				sinsp_memory_budget::string_bytes(info.m_full_id) +
+				sinsp_memory_budget::string_bytes(info.m_name) +
+				sinsp_memory_budget::string_bytes(info.m_image) +
+				sinsp_memory_budget::string_bytes(info.m_imageid) +
+				sinsp_memory_budget::string_bytes(info.m_imagerepo) +
+				sinsp_memory_budget::string_bytes(info.m_imagetag) +
+				sinsp_memory_budget::string_bytes(info.m_imagedigest) +
+				sinsp_memory_budget::string_bytes(info.m_mesos_task_id) +
+				sinsp_memory_budget::string_bytes(info.m_container_user) +
+				sinsp_memory_budget::strings_bytes(info.m_env) +
+				info.m_mounts.capacity() * sizeof(sinsp_container_info::container_mount_info) +
+				info.m_port_mappings.capacity() * sizeof(sinsp_container_info::container_port_mapping);
+
+			for(const auto &mount : info.m_mounts)
 			{
-				sinsp_container_info::ptr_t container = it->second;
-				for(const auto &remove_cb : m_remove_callbacks)
-				{
-					remove_cb(*container);
-				}
-				containers->erase(it++);
+				res += sinsp_memory_budget::string_bytes(mount.m_source) +
+					sinsp_memory_budget::string_bytes(mount.m_dest) +
+					sinsp_memory_budget::string_bytes(mount.m_mode) +
+					sinsp_memory_budget::string_bytes(mount.m_propagation);
 			}
-			else
+
+			for(const auto &label : info.m_labels)
 			{
-				++it;
+				// A map node holds three pointers and a color
+				res += sizeof(label) + 4 * sizeof(void*) +
+					sinsp_memory_budget::string_bytes(label.first) +
+					sinsp_memory_budget::string_bytes(label.second);
 			}
 		}
 	}
 
+	for(const auto &it : m_cgroup_cache)
+	{
+		res += sizeof(it) + node_overhead +
+			sinsp_memory_budget::string_bytes(it.first) +
+			sinsp_memory_budget::string_bytes(it.second.m_container_id);
+	}
+
 	return res;
 }
 
@@ -120,16 +200,74 @@ sinsp_container_info::ptr_t sinsp_container_manager::get_container(const string&
 	return nullptr;
 }
 
+bool sinsp_container_manager::cgroup_cache_key(const sinsp_threadinfo* tinfo, std::string& key)
+{
+	key.clear();
+	for(const auto& cg : tinfo->m_cgroups)
+	{
+		key.append(cg.first);
+		key.push_back('=');
+		key.append(cg.second);
+		key.push_back('\0');
+	}
+
+	//
+	// rkt also looks at the root directory
+	//
+	key.append(tinfo->m_root);
+
+	return !tinfo->m_cgroups.empty();
+}
+
+bool sinsp_container_manager::resolve_from_cgroup_cache(sinsp_threadinfo* tinfo, const std::string& key)
+{
+	auto it = m_cgroup_cache.find(key);
+	if(it == m_cgroup_cache.end())
+	{
+		return false;
+	}
+
+	//
+	// Only a complete container short-circuits the engines: while the
+	// metadata is missing they still have to drive the lookup
+	//
+	sinsp_container_info::ptr_t cinfo = get_container(it->second.m_container_id);
+	if(!cinfo || cinfo->m_type != it->second.m_type || !cinfo->is_successful())
+	{
+		m_cgroup_cache.erase(it);
+		return false;
+	}
+
+	tinfo->m_container_id = it->second.m_container_id;
+	m_n_cgroup_cache_hits++;
+	return true;
+}
+
 bool sinsp_container_manager::resolve_container(sinsp_threadinfo* tinfo, bool query_os_for_missing_info)
 {
 	ASSERT(tinfo);
 	bool matches = false;
+	std::string key;
+	bool cacheable = false;
 
 	tinfo->m_container_id = "";
 	if (m_inspector->m_parser->m_fd_listener)
 	{
 		matches = m_inspector->m_parser->m_fd_listener->on_resolve_container(this, tinfo, query_os_for_missing_info);
 	}
+	else
+	{
+		//
+		// The listener may look at more than the cgroups, so the
+		// cache is only used without one
+		//
+		cacheable = cgroup_cache_key(tinfo, key);
+		if(cacheable && resolve_from_cgroup_cache(tinfo, key))
+		{
+			identify_category(tinfo);
+			return true;
+		}
+	}
 
 	// Delayed so there's a chance to set alternate socket paths,
 	// timeouts, after creation but before inspector open.
@@ -148,12 +286,53 @@ bool sinsp_container_manager::resolve_container(sinsp_threadinfo* tinfo, bool qu
 		}
 	}
 
+	if(matches && cacheable && !tinfo->m_container_id.empty())
+	{
+		sinsp_container_info::ptr_t cinfo = get_container(tinfo->m_container_id);
+		if(cinfo && cinfo->is_successful())
+		{
+			cgroup_resolution& res = m_cgroup_cache[key];
+			res.m_type = cinfo->m_type;
+			res.m_container_id = tinfo->m_container_id;
+		}
+	}
+
 	// Also possibly set the category for the threadinfo
 	identify_category(tinfo);
 
 	return matches;
 }
 
+bool sinsp_container_manager::inherit_container(sinsp_threadinfo* tinfo, const sinsp_threadinfo* ptinfo)
+{
+	ASSERT(tinfo);
+	ASSERT(ptinfo);
+
+	if(m_inspector->m_parser->m_fd_listener ||
+	   tinfo->m_cgroups.empty() ||
+	   tinfo->m_cgroups != ptinfo->m_cgroups ||
+	   tinfo->m_root != ptinfo->m_root)
+	{
+		return false;
+	}
+
+	//
+	// A parent in a container whose lookup is gone (e.g. failed and
+	// flushed) needs a fresh resolution
+	//
+	if(!ptinfo->m_container_id.empty() && !container_exists(ptinfo->m_container_id))
+	{
+		return false;
+	}
+
+	tinfo->m_container_id = ptinfo->m_container_id;
+	m_n_inherited++;
+
+	identify_category(tinfo);
+
+	return true;
+}
+
 string sinsp_container_manager::container_to_json(const sinsp_container_info& container_info)
 {
 	Json::Value obj;
@@ -345,14 +524,14 @@ void sinsp_container_manager::notify_new_container(const sinsp_container_info& c
 	}
 }
 
-void sinsp_container_manager::dump_containers(scap_dumper_t* dumper)
+void sinsp_container_manager::dump_containers(scap_dumper_t* dumper, uint32_t flags)
 {
 	for(const auto& it : (*m_containers.lock()))
 	{
 		sinsp_evt evt;
 		if(container_to_sinsp_event(container_to_json(*it.second), &evt, it.second->get_tinfo(m_inspector)))
 		{
-			int32_t res = scap_dump(m_inspector->m_h, dumper, evt.m_pevt, evt.m_cpuid, 0);
+			int32_t res = scap_dump(m_inspector->m_h, dumper, evt.m_pevt, evt.m_cpuid, flags);
 			if(res != SCAP_SUCCESS)
 			{
 				throw sinsp_exception(scap_getlasterr(m_inspector->m_h));
@@ -614,6 +793,24 @@ void sinsp_container_manager::cleanup()
 	}
 }
 
+void sinsp_container_manager::prefetch_containers()
+{
+	if(!m_prefetch_enabled)
+	{
+		return;
+	}
+
+	if(m_container_engines.size() == 0)
+	{
+		create_engines();
+	}
+
+	for(auto &eng : m_container_engines)
+	{
+		eng->prefetch();
+	}
+}
+
 void sinsp_container_manager::set_docker_socket_path(std::string socket_path)
 {
 #if !defined(MINIMAL_BUILD) && defined(HAS_CAPTURE) && !defined(_WIN32)
@@ -668,3 +865,8 @@ void sinsp_container_manager::set_container_labels_max_len(uint32_t max_label_le
 	sinsp_container_info::m_container_label_max_length = max_label_len;
 }
 
+void sinsp_container_manager::set_container_lookup_workers(uint32_t num_workers)
+{
+	libsinsp::container_engine::container_engine_base::set_lookup_workers(num_workers);
+}
+
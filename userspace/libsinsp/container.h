@@ -65,6 +65,18 @@ public:
 	map_ptr_t get_containers() const;
 	bool remove_inactive_containers();
 
+	/**
+	 * @brief Remove the containers no thread is in, with their cgroup
+	 * cache entries
+	 * @return the number of containers removed
+	 */
+	uint32_t remove_unused_containers();
+
+	/**
+	 * @brief Estimate the bytes taken by the containers and the cgroup cache
+	 */
+	uint64_t get_memory_usage() const;
+
 	/**
 	 * @brief Add/update a container in the manager map, executing on_new_container callbacks
 	 *
@@ -116,7 +128,28 @@ public:
 	 * it may still be happening in the background asynchronously
 	 */
 	bool resolve_container(sinsp_threadinfo* tinfo, bool query_os_for_missing_info);
-	void dump_containers(scap_dumper_t* dumper);
+
+	/**
+	 * @brief Reuse the container of the thread that cloned tinfo
+	 * @param tinfo the new thread
+	 * @param ptinfo the thread that called clone()
+	 * @return true if tinfo got its parent's container, false if
+	 * 		the caller must go through resolve_container()
+	 *
+	 * The parent's resolution can be reused when both threads live in
+	 * the same cgroups and the parent's container is known (or the
+	 * parent is on the host).
+	 */
+	bool inherit_container(sinsp_threadinfo* tinfo, const sinsp_threadinfo* ptinfo);
+
+	/**
+	 * @brief Number of resolve_container() calls answered by the
+	 * cgroup cache, and of threads that inherited their parent's container
+	 */
+	uint64_t get_n_cgroup_cache_hits() const { return m_n_cgroup_cache_hits; }
+	uint64_t get_n_inherited() const { return m_n_inherited; }
+
+	void dump_containers(scap_dumper_t* dumper, uint32_t flags = 0);
 	std::string get_container_name(sinsp_threadinfo* tinfo) const;
 
 	// Set tinfo's m_category based on the container context.  It
@@ -138,6 +171,16 @@ public:
 
 	void create_engines();
 
+	/**
+	 * Start the metadata lookups of all the containers the engines can
+	 * list (e.g. through the Docker API or CRI), so that the metadata is
+	 * there by the time their threads show up. Called when opening a
+	 * live capture, before the /proc scan; the lookups run in the
+	 * background.
+	 */
+	void prefetch_containers();
+	void set_container_prefetch(bool enabled) { m_prefetch_enabled = enabled; }
+
 	/**
 	 * Update the container_info associated with the given type and container_id
 	 * to include the size of the container layer. This is not filled in the
@@ -155,6 +198,7 @@ public:
 	void set_cri_async(bool async);
 	void set_cri_delay(uint64_t delay_ms);
 	void set_container_labels_max_len(uint32_t max_label_len);
+	void set_container_lookup_workers(uint32_t num_workers);
 	sinsp* get_inspector() { return m_inspector; }
 
 	/**
@@ -194,6 +238,16 @@ public:
 		return engine_lookup == container_lookups->second.end();
 	}
 private:
+	// What a set of cgroups resolved to
+	struct cgroup_resolution
+	{
+		sinsp_container_type m_type;
+		std::string m_container_id;
+	};
+
+	static bool cgroup_cache_key(const sinsp_threadinfo* tinfo, std::string& key);
+	bool resolve_from_cgroup_cache(sinsp_threadinfo* tinfo, const std::string& key);
+
 	std::string container_to_json(const sinsp_container_info& container_info);
 	bool container_to_sinsp_event(const std::string& json, sinsp_evt* evt, std::shared_ptr<sinsp_threadinfo> tinfo);
 	std::string get_docker_env(const Json::Value &env_vars, const std::string &mti);
@@ -208,6 +262,14 @@ private:
 	std::list<new_container_cb> m_new_callbacks;
 	std::list<remove_container_cb> m_remove_callbacks;
 
+	// cgroup paths of a thread (see cgroup_cache_key) -> the container
+	// they belong to. Entries are dropped with their container.
+	std::unordered_map<std::string, cgroup_resolution> m_cgroup_cache;
+	uint64_t m_n_cgroup_cache_hits;
+	uint64_t m_n_inherited;
+
+	bool m_prefetch_enabled;
+
 	// indicates whether we should use only the static container engine, or the other engines.
 	// if true, we expect to have the subsequent bits of metadata as well. If this bool is false,
 	// then the values of those metadata are undefined
@@ -24,6 +24,8 @@ namespace libsinsp
 namespace container_engine
 {
 
+uint32_t container_engine_base::s_lookup_workers = 4;
+
 container_engine_base::container_engine_base(container_cache_interface &cache) :
    m_cache(cache)
 {
@@ -38,5 +40,9 @@ void container_engine_base::cleanup()
 {
 }
 
+void container_engine_base::prefetch()
+{
+}
+
 }
 }
@@ -17,6 +17,8 @@ limitations under the License.
 
 #pragma once
 
+#include <stdint.h>
+
 #include "container_engine/container_cache_interface.h"
 
 class sinsp_threadinfo;
@@ -50,6 +52,27 @@ public:
 
 	virtual void cleanup();
 
+	/**
+	 * Start looking up the metadata of all the containers the engine
+	 * knows about, before any thread in them is seen. Called once when
+	 * opening a live capture, must not block on the lookups themselves.
+	 */
+	virtual void prefetch();
+
+	/**
+	 * Number of threads each engine uses for its asynchronous lookups.
+	 * Only affects the engines created afterwards.
+	 */
+	static void set_lookup_workers(uint32_t num_workers)
+	{
+		s_lookup_workers = num_workers;
+	}
+
+	static uint32_t get_lookup_workers()
+	{
+		return s_lookup_workers;
+	}
+
 protected:
 	/**
 	 * Derived class accessor to the cache
@@ -61,6 +84,8 @@ protected:
 
 private:
 	container_cache_interface& m_cache;
+
+	static uint32_t s_lookup_workers;
 };
 }
 }
@@ -245,9 +245,104 @@ void cri::cleanup()
 	{
 		m_async_source->quiesce();
 	}
+	m_pending_limits.clear();
 	s_cri_extra_queries = true;
 }
 
+cri_async_source& cri::async_source()
+{
+	if(!m_async_source)
+	{
+		auto async_source = new cri_async_source(&container_cache(), m_cri.get(), s_cri_timeout, get_lookup_workers());
+		m_async_source = std::unique_ptr<cri_async_source>(async_source);
+	}
+
+	return *m_async_source;
+}
+
+void cri::prefetch()
+{
+	if(!m_cri || !s_async)
+	{
+		return;
+	}
+
+	container_cache_interface *cache = &container_cache();
+	sinsp_container_type ctype = m_cri->get_cri_runtime_type();
+	std::vector<std::string> ids;
+
+	// Go on with what we got if only one of the lists failed
+	m_cri->list_container_ids(ids);
+
+	auto cb = [cache](const libsinsp::cgroup_limits::cgroup_limits_key& key, const sinsp_container_info& res)
+	{
+		cache->notify_new_container(res);
+	};
+
+	uint32_t n_lookups = 0;
+	for(const auto& full_id : ids)
+	{
+		std::string container_id = full_id.substr(0, 12);
+		if(cache->get_container(container_id) || !cache->should_lookup(container_id, ctype))
+		{
+			continue;
+		}
+
+		// containerd reports the limits itself, the other runtimes
+		// need the cgroups of a thread in the container
+		if(ctype != CT_CONTAINERD)
+		{
+			m_pending_limits.insert(container_id);
+		}
+
+		cache->set_lookup_status(container_id, ctype, sinsp_container_lookup_state::STARTED);
+		libsinsp::cgroup_limits::cgroup_limits_key key(container_id, "", "", "");
+		sinsp_container_info result;
+		if(async_source().lookup(key, result, cb))
+		{
+			cb(key, result);
+		}
+		n_lookups++;
+	}
+
+	g_logger.format(sinsp_logger::SEV_DEBUG,
+			"cri: Prefetching %u of %zu running containers and pod sandboxes",
+			n_lookups, ids.size());
+}
+
+void cri::apply_pending_limits(sinsp_threadinfo *tinfo, const std::string& container_id)
+{
+	auto it = m_pending_limits.find(container_id);
+	if(it == m_pending_limits.end())
+	{
+		return;
+	}
+
+	sinsp_container_info::ptr_t existing = container_cache().get_container(container_id);
+	if(!existing)
+	{
+		// Still being looked up, try again with the next thread
+		return;
+	}
+	m_pending_limits.erase(it);
+
+	libsinsp::cgroup_limits::cgroup_limits_key key(
+		container_id,
+		tinfo->get_cgroup("cpu"),
+		tinfo->get_cgroup("memory"),
+		tinfo->get_cgroup("cpuset"));
+	libsinsp::cgroup_limits::cgroup_limits_value limits;
+	libsinsp::cgroup_limits::get_cgroup_resource_limits(key, limits);
+
+	shared_ptr<sinsp_container_info> updated(std::make_shared<sinsp_container_info>(*existing));
+	updated->m_memory_limit = limits.m_memory_limit;
+	updated->m_cpu_shares = limits.m_cpu_shares;
+	updated->m_cpu_quota = limits.m_cpu_quota;
+	updated->m_cpu_period = limits.m_cpu_period;
+	updated->m_cpuset_cpu_count = limits.m_cpuset_cpu_count;
+	container_cache().replace_container(updated);
+}
+
 void cri::set_cri_socket_path(const std::string& path)
 {
 	s_cri_unix_socket_path = path;
@@ -297,6 +392,7 @@ bool cri::resolve(sinsp_threadinfo *tinfo, bool query_os_for_missing_info)
 
 	if(!cache->should_lookup(container_id, m_cri->get_cri_runtime_type()))
 	{
+		apply_pending_limits(tinfo, container_id);
 		return true;
 	}
 
@@ -323,12 +419,6 @@ bool cri::resolve(sinsp_threadinfo *tinfo, bool query_os_for_missing_info)
 			tinfo->get_cgroup("memory"),
 			tinfo->get_cgroup("cpuset"));
 
-		if(!m_async_source)
-		{
-			auto async_source = new cri_async_source(cache, m_cri.get(), s_cri_timeout);
-			m_async_source = std::unique_ptr<cri_async_source>(async_source);
-		}
-
 		cache->set_lookup_status(container_id, m_cri->get_cri_runtime_type(), sinsp_container_lookup_state::STARTED);
 		auto cb = [cache](const libsinsp::cgroup_limits::cgroup_limits_key& key, const sinsp_container_info& res)
 		{
@@ -345,11 +435,11 @@ bool cri::resolve(sinsp_threadinfo *tinfo, bool query_os_for_missing_info)
 		bool done;
 		if(s_async)
 		{
-			done = m_async_source->lookup_delayed(key, result, chrono::milliseconds(s_cri_lookup_delay_ms), cb);
+			done = async_source().lookup_delayed(key, result, chrono::milliseconds(s_cri_lookup_delay_ms), cb);
 		}
 		else
 		{
-			done = m_async_source->lookup_sync(key, result);
+			done = async_source().lookup_sync(key, result);
 		}
 
 		if (done)
@@ -17,6 +17,7 @@ limitations under the License.
 
 #pragma once
 
+#include <set>
 #include <string>
 #include <stdint.h>
 
@@ -51,8 +52,9 @@ class cri_async_source : public sysdig::async_key_value_source<
         sinsp_container_info>
 {
 public:
-	explicit cri_async_source(container_cache_interface *cache, ::libsinsp::cri::cri_interface *cri, uint64_t ttl_ms) :
-		async_key_value_source(NO_WAIT_LOOKUP, ttl_ms),
+	explicit cri_async_source(container_cache_interface *cache, ::libsinsp::cri::cri_interface *cri, uint64_t ttl_ms,
+				  uint32_t num_workers = 1) :
+		async_key_value_source(NO_WAIT_LOOKUP, ttl_ms, num_workers),
 		m_cache(cache),
 		m_cri(cri)
 	{
@@ -81,6 +83,7 @@ public:
 	bool resolve(sinsp_threadinfo *tinfo, bool query_os_for_missing_info) override;
 	void update_with_size(const std::string& container_id) override;
 	void cleanup() override;
+	void prefetch() override;
 	static void set_cri_socket_path(const std::string& path);
 	static void set_cri_timeout(int64_t timeout_ms);
 	static void set_extra_queries(bool extra_queries);
@@ -88,8 +91,18 @@ public:
 	static void set_cri_delay(uint64_t delay_ms);
 
 private:
+	cri_async_source& async_source();
+
+	// Read the cgroup limits of a prefetched container from the
+	// cgroups of its first thread
+	void apply_pending_limits(sinsp_threadinfo *tinfo, const std::string& container_id);
+
 	std::unique_ptr<cri_async_source> m_async_source;
 	std::unique_ptr<::libsinsp::cri::cri_interface> m_cri;
+
+	// Prefetched containers whose limits come from the cgroups,
+	// which were not known at lookup time
+	std::set<std::string> m_pending_limits;
 };
 }
 }
@@ -28,8 +28,9 @@ bool docker_async_source::m_query_image_info = true;
 
 docker_async_source::docker_async_source(uint64_t max_wait_ms,
 					 uint64_t ttl_ms,
-					 container_cache_interface *cache)
-	: async_key_value_source(max_wait_ms, ttl_ms),
+					 container_cache_interface *cache,
+					 uint32_t num_workers)
+	: async_key_value_source(max_wait_ms, ttl_ms, num_workers),
 	  m_cache(cache)
 {
 }
@@ -81,6 +82,42 @@ void docker_async_source::run_impl()
 	}
 }
 
+bool docker_async_source::list_container_ids(const std::string& docker_socket, sinsp_container_type ctype, std::vector<std::string>& ids)
+{
+	std::string json;
+	docker_lookup_request request("", docker_socket, ctype, 0, false);
+
+	if(m_connection.get_docker(request, "/containers/json", json) != docker_connection::RESP_OK)
+	{
+		g_logger.format(sinsp_logger::SEV_DEBUG,
+				"docker_async (%s): Could not list containers",
+				docker_socket.c_str());
+		return false;
+	}
+
+	Json::Value root;
+	Json::Reader reader;
+	if(!reader.parse(json, root) || !root.isArray())
+	{
+		g_logger.format(sinsp_logger::SEV_ERROR,
+				"docker_async (%s): Could not parse container list \"%s\"",
+				docker_socket.c_str(),
+				json.c_str());
+		return false;
+	}
+
+	for(const auto& container : root)
+	{
+		const Json::Value& id = container["Id"];
+		if(id.isString())
+		{
+			ids.push_back(id.asString());
+		}
+	}
+
+	return true;
+}
+
 bool docker_async_source::get_k8s_pod_spec(const Json::Value &config_obj,
 					   Json::Value &spec)
 {
@@ -14,12 +14,16 @@ class container_cache_interface;
 class docker_async_source : public sysdig::async_key_value_source<docker_lookup_request, sinsp_container_info>
 {
 public:
-	docker_async_source(uint64_t max_wait_ms, uint64_t ttl_ms, container_cache_interface *cache);
+	docker_async_source(uint64_t max_wait_ms, uint64_t ttl_ms, container_cache_interface *cache, uint32_t num_workers = 1);
 	virtual ~docker_async_source();
 
 	static void parse_json_mounts(const Json::Value &mnt_obj, std::vector<sinsp_container_info::container_mount_info> &mounts);
 	static void set_query_image_info(bool query_image_info);
 
+	// Synchronously fetch the ids of the running containers
+	// (GET /containers/json)
+	bool list_container_ids(const std::string& docker_socket, sinsp_container_type ctype, std::vector<std::string>& ids);
+
 protected:
 	void run_impl();
 
@@ -9,19 +9,27 @@ void docker_base::cleanup()
 	m_docker_info_source.reset(NULL);
 }
 
-bool
-docker_base::resolve_impl(sinsp_threadinfo *tinfo, const docker_lookup_request& request, bool query_os_for_missing_info)
+docker_async_source& docker_base::info_source()
 {
-	container_cache_interface *cache = &container_cache();
 	if(!m_docker_info_source)
 	{
-		g_logger.log("docker_async: Creating docker async source",
-			     sinsp_logger::SEV_DEBUG);
+		g_logger.format(sinsp_logger::SEV_DEBUG,
+				"docker_async: Creating docker async source with %u workers",
+				get_lookup_workers());
 		uint64_t max_wait_ms = 10000;
-		docker_async_source *src = new docker_async_source(docker_async_source::NO_WAIT_LOOKUP, max_wait_ms, cache);
+		docker_async_source *src = new docker_async_source(docker_async_source::NO_WAIT_LOOKUP, max_wait_ms,
+								   &container_cache(), get_lookup_workers());
 		m_docker_info_source.reset(src);
 	}
 
+	return *m_docker_info_source;
+}
+
+bool
+docker_base::resolve_impl(sinsp_threadinfo *tinfo, const docker_lookup_request& request, bool query_os_for_missing_info)
+{
+	container_cache_interface *cache = &container_cache();
+
 	tinfo->m_container_id = request.container_id;
 
 	sinsp_container_info::ptr_t container_info = cache->get_container(request.container_id);
@@ -58,6 +66,36 @@ docker_base::resolve_impl(sinsp_threadinfo *tinfo, const docker_lookup_request&
 	return container_info->is_successful();
 }
 
+void docker_base::prefetch_impl(const std::string& docker_socket, sinsp_container_type ctype)
+{
+	container_cache_interface *cache = &container_cache();
+	std::vector<std::string> ids;
+
+	if(!info_source().list_container_ids(docker_socket, ctype, ids))
+	{
+		return;
+	}
+
+	uint32_t n_lookups = 0;
+	for(const auto& full_id : ids)
+	{
+		// Threads are matched to the short id, see matches_runc_cgroups()
+		std::string container_id = full_id.substr(0, 12);
+		if(cache->get_container(container_id) || !cache->should_lookup(container_id, ctype))
+		{
+			continue;
+		}
+
+		cache->set_lookup_status(container_id, ctype, sinsp_container_lookup_state::STARTED);
+		parse_docker_async(docker_lookup_request(container_id, docker_socket, ctype, 0, false), cache);
+		n_lookups++;
+	}
+
+	g_logger.format(sinsp_logger::SEV_DEBUG,
+			"docker_async (%s): Prefetching %u of %zu running containers",
+			docker_socket.c_str(), n_lookups, ids.size());
+}
+
 void docker_base::parse_docker_async(const docker_lookup_request& request, container_cache_interface *cache)
 {
 	auto cb = [cache](const docker_lookup_request& request, const sinsp_container_info& res)
@@ -72,7 +110,7 @@ void docker_base::parse_docker_async(const docker_lookup_request& request, conta
 
 	sinsp_container_info result;
 
-	if(m_docker_info_source->lookup(request, result, cb))
+	if(info_source().lookup(request, result, cb))
 	{
 		// if a previous lookup call already found the metadata, process it now
 		cb(request, result);
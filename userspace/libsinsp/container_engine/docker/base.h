@@ -21,6 +21,13 @@ public:
 protected:
 	void parse_docker_async(const docker_lookup_request& request, container_cache_interface *cache);
 
+	// Start a lookup for every container the daemon listening on
+	// docker_socket reports as running
+	void prefetch_impl(const std::string& docker_socket, sinsp_container_type ctype);
+
+	// The async source, created on first use
+	docker_async_source& info_source();
+
 	bool resolve_impl(sinsp_threadinfo *tinfo, const docker_lookup_request& request,
 			  bool query_os_for_missing_info);
 
@@ -6,13 +6,16 @@
 #include <curl/multi.h>
 #endif
 
+#include <mutex>
 #include <string>
+#include <vector>
 
 #include "container_engine/docker/lookup_request.h"
 
 namespace libsinsp {
 namespace container_engine {
 
+// Safe to use from several lookup threads at once
 class docker_connection {
 public:
 	enum docker_response {
@@ -29,14 +32,30 @@ public:
 
 	void set_api_version(const std::string& api_version)
 	{
+		std::lock_guard<std::mutex> lock(m_mutex);
 		m_api_version = api_version;
 	}
 
+	std::string get_api_version() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_api_version;
+	}
+
 private:
+	mutable std::mutex m_mutex;
 	std::string m_api_version;
 
 #ifndef _WIN32
-	CURLM *m_curlm;
+	// A multi handle keeps its connections open between requests, but
+	// can only drive one transfer loop at a time: each request takes
+	// one from the pool (or creates it) and gives it back when done
+	CURLM *acquire_curlm();
+	void release_curlm(CURLM *curlm);
+
+	docker_response get_docker(CURLM *curlm, const docker_lookup_request& request, const std::string& req_url, std::string& json);
+
+	std::vector<CURLM*> m_free_curlm;
 #endif
 };
 
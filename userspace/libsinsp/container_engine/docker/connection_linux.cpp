@@ -33,27 +33,62 @@ size_t docker_curl_write_callback(const char *ptr, size_t size, size_t nmemb, st
 using namespace libsinsp::container_engine;
 
 docker_connection::docker_connection():
-	m_api_version("/v1.24"),
-	m_curlm(nullptr)
+	m_api_version("/v1.24")
 {
-	m_curlm = curl_multi_init();
+}
 
-	if(m_curlm)
+docker_connection::~docker_connection()
+{
+	for(auto curlm : m_free_curlm)
 	{
-		curl_multi_setopt(m_curlm, CURLMOPT_PIPELINING, CURLPIPE_HTTP1|CURLPIPE_MULTIPLEX);
+		curl_multi_cleanup(curlm);
 	}
+	m_free_curlm.clear();
 }
 
-docker_connection::~docker_connection()
+CURLM *docker_connection::acquire_curlm()
 {
-	if(m_curlm)
 	{
-		curl_multi_cleanup(m_curlm);
-		m_curlm = NULL;
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if(!m_free_curlm.empty())
+		{
+			CURLM *curlm = m_free_curlm.back();
+			m_free_curlm.pop_back();
+			return curlm;
+		}
 	}
+
+	CURLM *curlm = curl_multi_init();
+	if(curlm)
+	{
+		curl_multi_setopt(curlm, CURLMOPT_PIPELINING, CURLPIPE_HTTP1|CURLPIPE_MULTIPLEX);
+	}
+	return curlm;
+}
+
+void docker_connection::release_curlm(CURLM *curlm)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_free_curlm.push_back(curlm);
 }
 
 docker_connection::docker_response docker_connection::get_docker(const docker_lookup_request& request, const std::string& req_url, std::string &json)
+{
+	CURLM *curlm = acquire_curlm();
+	if(!curlm)
+	{
+		g_logger.format(sinsp_logger::SEV_WARNING,
+				"docker_async (%s): Failed to initialize curl multi handle",
+				req_url.c_str());
+		return docker_response::RESP_ERROR;
+	}
+
+	docker_response resp = get_docker(curlm, request, req_url, json);
+	release_curlm(curlm);
+	return resp;
+}
+
+docker_connection::docker_response docker_connection::get_docker(CURLM *curlm, const docker_lookup_request& request, const std::string& req_url, std::string &json)
 {
 	CURL* curl = curl_easy_init();
 	if(!curl)
@@ -70,7 +105,7 @@ docker_connection::docker_response docker_connection::get_docker(const docker_lo
 	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, docker_curl_write_callback);
 	curl_easy_setopt(curl, CURLOPT_UNIX_SOCKET_PATH, docker_path.c_str());
 
-	std::string url = "http://localhost" + m_api_version + req_url;
+	std::string url = "http://localhost" + get_api_version() + req_url;
 
 	g_logger.format(sinsp_logger::SEV_DEBUG,
 			"docker_async (%s): Fetching url",
@@ -96,7 +131,7 @@ docker_connection::docker_response docker_connection::get_docker(const docker_lo
 		return docker_response::RESP_ERROR;
 	}
 
-	if(curl_multi_add_handle(m_curlm, curl) != CURLM_OK)
+	if(curl_multi_add_handle(curlm, curl) != CURLM_OK)
 	{
 		g_logger.format(sinsp_logger::SEV_DEBUG,
 				"docker_async (%s): curl_multi_add_handle() failed",
@@ -109,14 +144,14 @@ docker_connection::docker_response docker_connection::get_docker(const docker_lo
 	while(true)
 	{
 		int still_running;
-		CURLMcode res = curl_multi_perform(m_curlm, &still_running);
+		CURLMcode res = curl_multi_perform(curlm, &still_running);
 		if(res != CURLM_OK)
 		{
 			g_logger.format(sinsp_logger::SEV_DEBUG,
 					"docker_async (%s): curl_multi_perform() failed",
 					url.c_str());
 
-			curl_multi_remove_handle(m_curlm, curl);
+			curl_multi_remove_handle(curlm, curl);
 			curl_easy_cleanup(curl);
 			ASSERT(false);
 			return docker_response::RESP_ERROR;
@@ -128,21 +163,21 @@ docker_connection::docker_response docker_connection::get_docker(const docker_lo
 		}
 
 		int numfds;
-		res = curl_multi_wait(m_curlm, NULL, 0, 1000, &numfds);
+		res = curl_multi_wait(curlm, NULL, 0, 1000, &numfds);
 		if(res != CURLM_OK)
 		{
 			g_logger.format(sinsp_logger::SEV_DEBUG,
 					"docker_async (%s): curl_multi_wait() failed",
 					url.c_str());
 
-			curl_multi_remove_handle(m_curlm, curl);
+			curl_multi_remove_handle(curlm, curl);
 			curl_easy_cleanup(curl);
 			ASSERT(false);
 			return docker_response::RESP_ERROR;
 		}
 	}
 
-	if(curl_multi_remove_handle(m_curlm, curl) != CURLM_OK)
+	if(curl_multi_remove_handle(curlm, curl) != CURLM_OK)
 	{
 		g_logger.format(sinsp_logger::SEV_DEBUG,
 				"docker_async (%s): curl_multi_remove_handle() failed",
@@ -50,6 +50,11 @@ bool docker_linux::resolve(sinsp_threadinfo *tinfo, bool query_os_for_missing_in
 		false), query_os_for_missing_info);
 }
 
+void docker_linux::prefetch()
+{
+	prefetch_impl(m_docker_sock, CT_DOCKER);
+}
+
 void docker_linux::update_with_size(const std::string &container_id)
 {
 	auto cb = [this](const docker_lookup_request& instruction, const sinsp_container_info& res) {
@@ -68,5 +73,5 @@ void docker_linux::update_with_size(const std::string &container_id)
 
 	sinsp_container_info result;
 	docker_lookup_request instruction(container_id, m_docker_sock, CT_DOCKER, 0, true /*request rw size*/);
-	(void)m_docker_info_source->lookup(instruction, result, cb);
+	(void)info_source().lookup(instruction, result, cb);
 }
@@ -20,6 +20,8 @@ public:
 
 	void update_with_size(const std::string& container_id) override;
 
+	void prefetch() override;
+
 private:
 	static std::string m_docker_sock;
 };
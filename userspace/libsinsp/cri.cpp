@@ -449,5 +449,47 @@ std::string cri_interface::get_container_image_id(const std::string &image_ref)
 
 	return "";
 }
+
+bool cri_interface::list_container_ids(std::vector<std::string> &ids)
+{
+	runtime::v1alpha2::ListContainersRequest creq;
+	runtime::v1alpha2::ListContainersResponse cresp;
+	creq.mutable_filter()->mutable_state()->set_state(runtime::v1alpha2::CONTAINER_RUNNING);
+	grpc::ClientContext ccontext;
+	auto deadline = std::chrono::system_clock::now() + std::chrono::milliseconds(s_cri_timeout);
+	ccontext.set_deadline(deadline);
+	grpc::Status cstatus = m_cri->ListContainers(&ccontext, creq, &cresp);
+	if(!cstatus.ok())
+	{
+		g_logger.format(sinsp_logger::SEV_DEBUG, "cri: ListContainers failed: %s",
+				cstatus.error_message().c_str());
+		return false;
+	}
+
+	for(const auto &container : cresp.containers())
+	{
+		ids.push_back(container.id());
+	}
+
+	runtime::v1alpha2::ListPodSandboxRequest sreq;
+	runtime::v1alpha2::ListPodSandboxResponse sresp;
+	sreq.mutable_filter()->mutable_state()->set_state(runtime::v1alpha2::SANDBOX_READY);
+	grpc::ClientContext scontext;
+	scontext.set_deadline(deadline);
+	grpc::Status sstatus = m_cri->ListPodSandbox(&scontext, sreq, &sresp);
+	if(!sstatus.ok())
+	{
+		g_logger.format(sinsp_logger::SEV_DEBUG, "cri: ListPodSandbox failed: %s",
+				sstatus.error_message().c_str());
+		return false;
+	}
+
+	for(const auto &sandbox : sresp.items())
+	{
+		ids.push_back(sandbox.id());
+	}
+
+	return true;
+}
 }
 }
@@ -19,6 +19,7 @@ limitations under the License.
 
 #include <memory>
 #include <string>
+#include <vector>
 
 #ifndef MINIMAL_BUILD
 #include "cri.pb.h"
@@ -164,6 +165,13 @@ public:
 	 */
 	std::string get_container_image_id(const std::string &image_ref);
 
+	/**
+	 * @brief list the running containers and the ready pod sandboxes
+	 * @param ids the (full) IDs of all of them
+	 * @return true if both ListContainers and ListPodSandbox succeeded
+	 */
+	bool list_container_ids(std::vector<std::string> &ids);
+
 private:
 
 	std::unique_ptr<runtime::v1alpha2::RuntimeService::Stub> m_cri;
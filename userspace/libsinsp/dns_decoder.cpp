@@ -0,0 +1,455 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <algorithm>
+#ifndef _WIN32
+#include <sys/socket.h>
+#endif
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "dns_decoder.h"
+
+#define DNS_HEADER_LEN 12
+#define DNS_FLAG_QR 0x8000
+#define DNS_OPCODE_MASK 0x7800
+#define DNS_RCODE_MASK 0x000f
+#define DNS_TYPE_A 1
+#define DNS_TYPE_AAAA 28
+#define DNS_CLASS_IN 1
+#define DNS_MAX_NAME_LEN 255
+#define DNS_MAX_POINTERS 16
+#define DNS_PRUNE_INTERVAL_NS (10 * ONE_SECOND_IN_NS)
+
+namespace
+{
+inline uint16_t dns_u16(const uint8_t *p)
+{
+	return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+inline uint32_t dns_u32(const uint8_t *p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+//
+// Read the (possibly compressed) name at offset *pos. On success *pos
+// points right after the name in the record, not after the compression
+// target. name can be NULL to just skip the name.
+//
+bool dns_read_name(const uint8_t *data, uint32_t len, uint32_t *pos, std::string *name)
+{
+	uint32_t cur = *pos;
+	uint32_t n_pointers = 0;
+	bool jumped = false;
+
+	if(name != NULL)
+	{
+		name->clear();
+	}
+
+	while(true)
+	{
+		if(cur >= len)
+		{
+			return false;
+		}
+
+		uint8_t label_len = data[cur];
+
+		if((label_len & 0xc0) == 0xc0)
+		{
+			if(cur + 1 >= len || ++n_pointers > DNS_MAX_POINTERS)
+			{
+				return false;
+			}
+
+			if(!jumped)
+			{
+				*pos = cur + 2;
+				jumped = true;
+			}
+
+			cur = ((label_len & 0x3f) << 8) | data[cur + 1];
+			continue;
+		}
+		else if((label_len & 0xc0) != 0)
+		{
+			return false;
+		}
+
+		if(label_len == 0)
+		{
+			if(!jumped)
+			{
+				*pos = cur + 1;
+			}
+			return true;
+		}
+
+		if(cur + 1 + label_len > len)
+		{
+			return false;
+		}
+
+		if(name != NULL)
+		{
+			if(name->size() + label_len + 1 > DNS_MAX_NAME_LEN)
+			{
+				return false;
+			}
+
+			if(!name->empty())
+			{
+				name->push_back('.');
+			}
+
+			for(uint32_t j = 0; j < label_len; j++)
+			{
+				name->push_back(tolower(data[cur + 1 + j]));
+			}
+		}
+
+		cur += 1 + label_len;
+	}
+}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_decoder_dns implementation
+///////////////////////////////////////////////////////////////////////////////
+sinsp_decoder_dns::sinsp_decoder_dns():
+	m_min_ttl_ns(DEFAULT_MIN_TTL_NS),
+	m_max_entries(DEFAULT_MAX_ENTRIES),
+	m_last_prune_ts(0),
+	m_n_responses(0)
+{
+	m_name = "dns";
+}
+
+sinsp_protodecoder* sinsp_decoder_dns::allocate_new()
+{
+	return (sinsp_protodecoder*) new sinsp_decoder_dns();
+}
+
+void sinsp_decoder_dns::init()
+{
+	register_event_callback(CT_CONNECT);
+}
+
+bool sinsp_decoder_dns::is_dns_socket(sinsp_fdinfo_t* fdinfo)
+{
+	if(fdinfo->m_type == SCAP_FD_IPV4_SOCK)
+	{
+		return fdinfo->m_sockinfo.m_ipv4info.m_fields.m_dport == DNS_PORT ||
+			fdinfo->m_sockinfo.m_ipv4info.m_fields.m_sport == DNS_PORT;
+	}
+	else if(fdinfo->m_type == SCAP_FD_IPV6_SOCK)
+	{
+		return fdinfo->m_sockinfo.m_ipv6info.m_fields.m_dport == DNS_PORT ||
+			fdinfo->m_sockinfo.m_ipv6info.m_fields.m_sport == DNS_PORT;
+	}
+
+	return false;
+}
+
+void sinsp_decoder_dns::watch(sinsp_fdinfo_t* fdinfo)
+{
+	//
+	// Unconnected UDP sockets notify a tuple change on every datagram,
+	// make sure we register only once
+	//
+	if(!fdinfo->has_event_callback(CT_READ, this))
+	{
+		register_read_callback(fdinfo);
+	}
+}
+
+void sinsp_decoder_dns::on_fd_from_proc(sinsp_fdinfo_t* fdinfo)
+{
+	if(fdinfo == NULL)
+	{
+		ASSERT(false);
+		return;
+	}
+
+	if(is_dns_socket(fdinfo))
+	{
+		watch(fdinfo);
+	}
+}
+
+void sinsp_decoder_dns::on_event(sinsp_evt* evt, sinsp_pd_callback_type etype)
+{
+	if(etype == CT_CONNECT ||
+		etype == CT_TUPLE_CHANGE)
+	{
+		sinsp_fdinfo_t* fdinfo = evt->get_fd_info();
+		if(fdinfo == NULL)
+		{
+			return;
+		}
+
+		if(is_dns_socket(fdinfo))
+		{
+			watch(fdinfo);
+		}
+		else if(fdinfo->has_event_callback(CT_READ, this))
+		{
+			unregister_read_callback(fdinfo);
+		}
+	}
+	else
+	{
+		ASSERT(false);
+	}
+}
+
+void sinsp_decoder_dns::on_read(sinsp_evt* evt, char *data, uint32_t len)
+{
+	const uint8_t *msg = (const uint8_t *)data;
+	sinsp_fdinfo_t* fdinfo = evt->get_fd_info();
+
+	//
+	// Over TCP, messages are prefixed by their length
+	//
+	if(fdinfo != NULL && fdinfo->is_tcp_socket())
+	{
+		if(len < 2)
+		{
+			return;
+		}
+
+		msg += 2;
+		len -= 2;
+	}
+
+	parse_response(msg, len, evt->get_ts());
+}
+
+bool sinsp_decoder_dns::parse_response(const uint8_t *data, uint32_t len, uint64_t ts)
+{
+	if(len < DNS_HEADER_LEN)
+	{
+		return false;
+	}
+
+	uint16_t flags = dns_u16(data + 2);
+	uint16_t qdcount = dns_u16(data + 4);
+	uint16_t ancount = dns_u16(data + 6);
+
+	if((flags & DNS_FLAG_QR) == 0 ||
+		(flags & DNS_OPCODE_MASK) != 0 ||
+		(flags & DNS_RCODE_MASK) != 0 ||
+		qdcount != 1)
+	{
+		return false;
+	}
+
+	//
+	// The question is what the application asked for, and the name we
+	// attach the answers to, even when they come through a CNAME chain
+	//
+	std::string qname;
+	uint32_t pos = DNS_HEADER_LEN;
+	if(!dns_read_name(data, len, &pos, &qname) || pos + 4 > len)
+	{
+		return false;
+	}
+	pos += 4;
+
+	m_n_responses++;
+
+	std::vector<uint32_t> v4_addrs;
+	std::vector<ipv6addr> v6_addrs;
+	uint32_t min_ttl = UINT32_MAX;
+
+	//
+	// A truncated buffer is not an error: keep what we managed to read
+	//
+	for(uint32_t j = 0; j < ancount; j++)
+	{
+		if(!dns_read_name(data, len, &pos, NULL) || pos + 10 > len)
+		{
+			break;
+		}
+
+		uint16_t type = dns_u16(data + pos);
+		uint16_t dclass = dns_u16(data + pos + 2);
+		uint32_t ttl = dns_u32(data + pos + 4);
+		uint16_t rdlen = dns_u16(data + pos + 8);
+		pos += 10;
+
+		if(pos + rdlen > len)
+		{
+			break;
+		}
+
+		if(dclass == DNS_CLASS_IN && type == DNS_TYPE_A && rdlen == sizeof(uint32_t))
+		{
+			uint32_t v4;
+			memcpy(&v4, data + pos, sizeof(uint32_t));
+			v4_addrs.push_back(v4);
+			min_ttl = std::min(min_ttl, ttl);
+		}
+		else if(dclass == DNS_CLASS_IN && type == DNS_TYPE_AAAA && rdlen == sizeof(ipv6addr))
+		{
+			ipv6addr v6;
+			memcpy(v6.m_b, data + pos, sizeof(ipv6addr));
+			v6_addrs.push_back(v6);
+			min_ttl = std::min(min_ttl, ttl);
+		}
+
+		pos += rdlen;
+	}
+
+	if(qname.empty() || (v4_addrs.empty() && v6_addrs.empty()))
+	{
+		return true;
+	}
+
+	uint64_t ttl_ns = std::max<uint64_t>((uint64_t)min_ttl * ONE_SECOND_IN_NS, m_min_ttl_ns);
+	learn(qname, v4_addrs, v6_addrs, ts + ttl_ns);
+
+	if(ts > m_last_prune_ts + DNS_PRUNE_INTERVAL_NS)
+	{
+		prune(ts);
+	}
+
+	return true;
+}
+
+void sinsp_decoder_dns::learn(const std::string &name, const std::vector<uint32_t> &v4_addrs,
+			      const std::vector<ipv6addr> &v6_addrs, uint64_t expiration_ts)
+{
+	auto it = m_by_name.find(name);
+	if(it == m_by_name.end())
+	{
+		if(m_by_name.size() >= m_max_entries)
+		{
+			return;
+		}
+
+		it = m_by_name.insert(std::make_pair(name, name_entry())).first;
+	}
+
+	//
+	// The latest answer replaces the previous one, that's what the
+	// application is going to use from now on
+	//
+	name_entry &entry = it->second;
+	entry.m_expiration_ts = expiration_ts;
+	entry.m_v4_addrs = v4_addrs;
+	std::sort(entry.m_v4_addrs.begin(), entry.m_v4_addrs.end());
+	entry.m_v6_addrs = v6_addrs;
+	std::sort(entry.m_v6_addrs.begin(), entry.m_v6_addrs.end());
+
+	for(uint32_t v4 : v4_addrs)
+	{
+		addr_entry &ae = m_by_v4[v4];
+		ae.m_name = name;
+		ae.m_expiration_ts = expiration_ts;
+	}
+
+	for(const ipv6addr &v6 : v6_addrs)
+	{
+		addr_entry &ae = m_by_v6[v6];
+		ae.m_name = name;
+		ae.m_expiration_ts = expiration_ts;
+	}
+}
+
+void sinsp_decoder_dns::prune(uint64_t ts)
+{
+	m_last_prune_ts = ts;
+
+	for(auto it = m_by_name.begin(); it != m_by_name.end();)
+	{
+		it = (it->second.m_expiration_ts < ts) ? m_by_name.erase(it) : std::next(it);
+	}
+
+	for(auto it = m_by_v4.begin(); it != m_by_v4.end();)
+	{
+		it = (it->second.m_expiration_ts < ts) ? m_by_v4.erase(it) : std::next(it);
+	}
+
+	for(auto it = m_by_v6.begin(); it != m_by_v6.end();)
+	{
+		it = (it->second.m_expiration_ts < ts) ? m_by_v6.erase(it) : std::next(it);
+	}
+}
+
+std::string sinsp_decoder_dns::name_of(int af, void *addr, uint64_t ts)
+{
+	if(af == AF_INET)
+	{
+		auto it = m_by_v4.find(*(uint32_t *)addr);
+		if(it != m_by_v4.end() && it->second.m_expiration_ts >= ts)
+		{
+			return it->second.m_name;
+		}
+	}
+	else if(af == AF_INET6)
+	{
+		ipv6addr v6;
+		memcpy(v6.m_b, addr, sizeof(ipv6addr));
+		auto it = m_by_v6.find(v6);
+		if(it != m_by_v6.end() && it->second.m_expiration_ts >= ts)
+		{
+			return it->second.m_name;
+		}
+	}
+
+	return "";
+}
+
+bool sinsp_decoder_dns::match(const char *name, int af, void *addr, uint64_t ts)
+{
+	// Names are learned lowercased
+	std::string lname(name);
+	for(char &c : lname)
+	{
+		c = tolower((unsigned char)c);
+	}
+
+	auto it = m_by_name.find(lname);
+	if(it == m_by_name.end() || it->second.m_expiration_ts < ts)
+	{
+		return false;
+	}
+
+	if(af == AF_INET)
+	{
+		return std::binary_search(it->second.m_v4_addrs.begin(), it->second.m_v4_addrs.end(), *(uint32_t *)addr);
+	}
+	else if(af == AF_INET6)
+	{
+		ipv6addr v6;
+		memcpy(v6.m_b, addr, sizeof(ipv6addr));
+		return std::binary_search(it->second.m_v6_addrs.begin(), it->second.m_v6_addrs.end(), v6);
+	}
+
+	return false;
+}
+
+bool sinsp_decoder_dns::get_info_line(char** res)
+{
+	m_infostr = "dns names=" + std::to_string(m_by_name.size());
+
+	*res = (char*)m_infostr.c_str();
+	return true;
+}
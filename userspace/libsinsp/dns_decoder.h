@@ -0,0 +1,123 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "sinsp.h"
+#include "protodecoder.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Passive DNS decoder.
+//
+// Watches the reads on sockets talking to port 53 and learns name/address
+// pairs from the answers of the DNS responses the applications receive.
+// Entries expire according to the record TTL (with a floor, see
+// set_min_ttl()), measured in event time, so replaying a capture gives the
+// same results as the live run.
+//
+// Only what's in the captured buffer can be decoded: with the default
+// snaplen long responses are truncated, and the records past the snaplen
+// are lost.
+///////////////////////////////////////////////////////////////////////////////
+class sinsp_decoder_dns : public sinsp_protodecoder
+{
+public:
+	static const uint16_t DNS_PORT = 53;
+	static const uint64_t DEFAULT_MIN_TTL_NS = 60 * ONE_SECOND_IN_NS;
+	static const uint32_t DEFAULT_MAX_ENTRIES = 65536;
+
+	sinsp_decoder_dns();
+	sinsp_protodecoder* allocate_new();
+	void init();
+	void on_fd_from_proc(sinsp_fdinfo_t* fdinfo);
+	void on_event(sinsp_evt* evt, sinsp_pd_callback_type etype);
+	void on_read(sinsp_evt* evt, char *data, uint32_t len);
+	bool get_info_line(char** res);
+
+	//
+	// Lookups, ts is the event time. name_of returns an empty string when
+	// the address is unknown or expired.
+	//
+	std::string name_of(int af, void *addr, uint64_t ts);
+	bool match(const char *name, int af, void *addr, uint64_t ts);
+
+	//
+	// Records with a TTL shorter than this are kept for min_ttl_ns
+	// anyway. Kubernetes services often use very short TTLs while the
+	// connections to the resolved address last much longer.
+	//
+	void set_min_ttl(uint64_t min_ttl_ns)
+	{
+		m_min_ttl_ns = min_ttl_ns;
+	}
+
+	void set_max_entries(uint32_t max_entries)
+	{
+		m_max_entries = max_entries;
+	}
+
+	size_t size() const
+	{
+		return m_by_name.size();
+	}
+
+	uint64_t get_n_responses() const
+	{
+		return m_n_responses;
+	}
+
+	//
+	// Parse a DNS response and learn its A/AAAA answers. Returns false if
+	// data is not a valid response. Public for testing.
+	//
+	bool parse_response(const uint8_t *data, uint32_t len, uint64_t ts);
+
+private:
+	struct addr_entry
+	{
+		std::string m_name;
+		uint64_t m_expiration_ts;
+	};
+
+	struct name_entry
+	{
+		uint64_t m_expiration_ts;
+		std::vector<uint32_t> m_v4_addrs;
+		std::vector<ipv6addr> m_v6_addrs;
+	};
+
+	bool is_dns_socket(sinsp_fdinfo_t* fdinfo);
+	void watch(sinsp_fdinfo_t* fdinfo);
+	void learn(const std::string &name, const std::vector<uint32_t> &v4_addrs,
+		   const std::vector<ipv6addr> &v6_addrs, uint64_t expiration_ts);
+	void prune(uint64_t ts);
+
+	uint64_t m_min_ttl_ns;
+	uint32_t m_max_entries;
+	uint64_t m_last_prune_ts;
+	uint64_t m_n_responses;
+
+	std::unordered_map<std::string, name_entry> m_by_name;
+	std::unordered_map<uint32_t, addr_entry> m_by_v4;
+	std::unordered_map<ipv6addr, addr_entry> m_by_v6;
+
+	std::string m_infostr;
+};
@@ -15,6 +15,8 @@ limitations under the License.
 
 */
 
+#include <algorithm>
+
 #include "dns_manager.h"
 
 void sinsp_dns_resolver::refresh(uint64_t erase_timeout, uint64_t base_refresh_timeout, uint64_t max_refresh_timeout, std::future<void> f_exit)
@@ -23,35 +25,43 @@ void sinsp_dns_resolver::refresh(uint64_t erase_timeout, uint64_t base_refresh_t
 	sinsp_dns_manager &manager = sinsp_dns_manager::get();
 	while(true)
 	{
-		if(!manager.m_cache.empty())
+		std::shared_ptr<sinsp_dns_manager::dns_table> table = std::atomic_load(&manager.m_table);
+
+		if(!table->m_by_name.empty())
 		{
 			std::list<std::string> to_delete;
+			std::list<std::shared_ptr<sinsp_dns_manager::dns_info>> to_replace;
 
 			uint64_t ts = sinsp_utils::get_current_time_ns();
 
-			for(auto &it: manager.m_cache)
+			//
+			// Resolutions can be slow, so they run on the snapshot
+			// and only the resulting changes are applied under the
+			// lock
+			//
+			for(auto &it: table->m_by_name)
 			{
 				const std::string &name = it.first;
-				sinsp_dns_manager::dns_info &info = it.second;
+				sinsp_dns_manager::dns_info &info = *it.second;
+				uint64_t last_used_ts = info.m_last_used_ts.load(std::memory_order_relaxed);
 
-				if((ts > info.m_last_used_ts) &&
-				   (ts - info.m_last_used_ts) > erase_timeout)
+				if((ts > last_used_ts) &&
+				   (ts - last_used_ts) > erase_timeout)
 				{
 					// remove the entry if it's hasn't been used for a whole hour
 					to_delete.push_back(name);
 				}
 				else if(ts > (info.m_last_resolve_ts + info.m_timeout))
 				{
-					sinsp_dns_manager::dns_info refreshed_info = manager.resolve(name, ts);
-					refreshed_info.m_timeout = base_refresh_timeout;
-					refreshed_info.m_last_resolve_ts = info.m_last_resolve_ts = ts;
-
-					// dns_info::operator!= will check if some
-					// v4 or v6 addresses are changed from the
-					// last resolution
-					if(refreshed_info != info)
+					std::shared_ptr<sinsp_dns_manager::dns_info> refreshed_info = manager.resolve(name, ts);
+					refreshed_info->m_timeout = base_refresh_timeout;
+					refreshed_info->m_last_resolve_ts = info.m_last_resolve_ts = ts;
+
+					// check if some v4 or v6 addresses are
+					// changed from the last resolution
+					if(!refreshed_info->same_addrs(info))
 					{
-						info = refreshed_info;
+						to_replace.push_back(refreshed_info);
 					}
 					else if(info.m_timeout < max_refresh_timeout)
 					{
@@ -60,17 +70,59 @@ void sinsp_dns_resolver::refresh(uint64_t erase_timeout, uint64_t base_refresh_t
 					}
 				}
 			}
-			if(!to_delete.empty())
+
+			if(!to_delete.empty() || !to_replace.empty())
 			{
-				manager.m_erase_mutex.lock();
+				std::lock_guard<std::mutex> lock(manager.m_write_mutex);
+
+				// match() might have added names in the meantime
+				std::shared_ptr<sinsp_dns_manager::dns_table> cur = std::atomic_load(&manager.m_table);
+				std::shared_ptr<sinsp_dns_manager::dns_table> next = std::make_shared<sinsp_dns_manager::dns_table>();
+				next->m_by_name = cur->m_by_name;
+				next->m_bytes = cur->m_bytes;
+				cur.reset();
+
 				for(const auto &name : to_delete)
 				{
-					manager.m_cache.unsafe_erase(name);
+					auto it = next->m_by_name.find(name);
+					if(it == next->m_by_name.end())
+					{
+						continue;
+					}
+
+					// it could have been used since we looked at it
+					uint64_t last_used_ts = it->second->m_last_used_ts.load(std::memory_order_relaxed);
+					if((ts > last_used_ts) &&
+					   (ts - last_used_ts) > erase_timeout)
+					{
+						next->erase(it);
+					}
+				}
+
+				for(const auto &info : to_replace)
+				{
+					auto it = next->m_by_name.find(info->m_name);
+					if(it != next->m_by_name.end())
+					{
+						info->m_last_used_ts.store(it->second->m_last_used_ts.load(std::memory_order_relaxed),
+									   std::memory_order_relaxed);
+						next->replace(it, info);
+					}
 				}
-				manager.m_erase_mutex.unlock();
+
+				manager.publish(next, false);
 			}
 		}
 
+		// don't keep the old table alive while sleeping
+		table.reset();
+
+		if(manager.m_n_pending.load(std::memory_order_relaxed) != 0)
+		{
+			std::lock_guard<std::mutex> lock(manager.m_write_mutex);
+			manager.flush_pending();
+		}
+
 		if(f_exit.wait_for(std::chrono::nanoseconds(base_refresh_timeout)) == std::future_status::ready)
 		{
 			break;
@@ -80,9 +132,10 @@ void sinsp_dns_resolver::refresh(uint64_t erase_timeout, uint64_t base_refresh_t
 }
 
 #if defined(HAS_CAPTURE) && !defined(CYGWING_AGENT) && !defined(_WIN32)
-inline sinsp_dns_manager::dns_info sinsp_dns_manager::resolve(const std::string &name, uint64_t ts)
+inline std::shared_ptr<sinsp_dns_manager::dns_info> sinsp_dns_manager::resolve(const std::string &name, uint64_t ts)
 {
-	dns_info dinfo;
+	std::shared_ptr<dns_info> dinfo = std::make_shared<dns_info>();
+	dinfo->m_name = name;
 
 	struct addrinfo hints, *result, *rp;
 	memset(&hints, 0, sizeof(struct addrinfo));
@@ -97,56 +150,313 @@ inline sinsp_dns_manager::dns_info sinsp_dns_manager::resolve(const std::string
 		{
 			if(rp->ai_family == AF_INET)
 			{
-				dinfo.m_v4_addrs.insert(((struct sockaddr_in*)rp->ai_addr)->sin_addr.s_addr);
+				dinfo->m_v4_addrs.push_back(((struct sockaddr_in*)rp->ai_addr)->sin_addr.s_addr);
 			}
 			else // AF_INET6
 			{
 				ipv6addr v6;
 				memcpy(v6.m_b, ((struct sockaddr_in6*)rp->ai_addr)->sin6_addr.s6_addr, sizeof(ipv6addr));
-				dinfo.m_v6_addrs.insert(v6);
+				dinfo->m_v6_addrs.push_back(v6);
 			}
 		}
 		freeaddrinfo(result);
 	}
+
+	// getaddrinfo returns one result per socket type, so
+	// the same address usually shows up more than once
+	std::sort(dinfo->m_v4_addrs.begin(), dinfo->m_v4_addrs.end());
+	dinfo->m_v4_addrs.erase(std::unique(dinfo->m_v4_addrs.begin(), dinfo->m_v4_addrs.end()), dinfo->m_v4_addrs.end());
+	dinfo->m_v4_addrs.shrink_to_fit();
+	std::sort(dinfo->m_v6_addrs.begin(), dinfo->m_v6_addrs.end());
+	dinfo->m_v6_addrs.erase(std::unique(dinfo->m_v6_addrs.begin(), dinfo->m_v6_addrs.end()), dinfo->m_v6_addrs.end());
+	dinfo->m_v6_addrs.shrink_to_fit();
+
 	return dinfo;
 }
+
+bool sinsp_dns_manager::dns_info::has_addr(int af, void *addr) const
+{
+	if(af == AF_INET6)
+	{
+		ipv6addr v6;
+		memcpy(v6.m_b, addr, sizeof(ipv6addr));
+		return std::binary_search(m_v6_addrs.begin(), m_v6_addrs.end(), v6);
+	}
+	else if(af == AF_INET)
+	{
+		return std::binary_search(m_v4_addrs.begin(), m_v4_addrs.end(), *(uint32_t *)addr);
+	}
+
+	return false;
+}
+
+void sinsp_dns_manager::dns_table::add(const std::shared_ptr<dns_info>& info)
+{
+	m_by_name[info->m_name] = info;
+	m_bytes += entry_bytes(info->m_name, *info);
+	index(info);
+}
+
+void sinsp_dns_manager::dns_table::erase(name_map::iterator it)
+{
+	m_bytes -= entry_bytes(it->first, *it->second);
+	m_by_name.erase(it);
+}
+
+void sinsp_dns_manager::dns_table::replace(name_map::iterator it, const std::shared_ptr<dns_info>& info)
+{
+	m_bytes -= entry_bytes(it->first, *it->second);
+	m_bytes += entry_bytes(it->first, *info);
+	it->second = info;
+}
+
+void sinsp_dns_manager::dns_table::reindex()
+{
+	m_by_v4.clear();
+	m_by_v6.clear();
+
+	for(const auto &it : m_by_name)
+	{
+		index(it.second);
+	}
+}
+
+void sinsp_dns_manager::dns_table::index(const std::shared_ptr<dns_info>& info)
+{
+	for(uint32_t v4 : info->m_v4_addrs)
+	{
+		auto res = m_by_v4.insert(std::make_pair(v4, info));
+		if(!res.second && info->m_name < res.first->second->m_name)
+		{
+			res.first->second = info;
+		}
+	}
+
+	for(const ipv6addr &v6 : info->m_v6_addrs)
+	{
+		auto res = m_by_v6.insert(std::make_pair(v6, info));
+		if(!res.second && info->m_name < res.first->second->m_name)
+		{
+			res.first->second = info;
+		}
+	}
+}
+
+uint64_t sinsp_dns_manager::dns_table::entry_bytes(const std::string& name, const dns_info& info)
+{
+	const uint64_t node_overhead = 2 * sizeof(void*);
+	// make_shared puts the object and the counts in one block
+	const uint64_t info_bytes = sizeof(dns_info) + 2 * sizeof(long) + sizeof(void*);
+
+	return sizeof(std::pair<const std::string, std::shared_ptr<dns_info>>) + node_overhead +
+		sinsp_memory_budget::string_bytes(name) +
+		info_bytes +
+		sinsp_memory_budget::string_bytes(info.m_name) +
+		info.m_v4_addrs.capacity() * sizeof(uint32_t) +
+		info.m_v6_addrs.capacity() * sizeof(ipv6addr) +
+		info.m_v4_addrs.size() * (sizeof(std::pair<const uint32_t, std::shared_ptr<dns_info>>) + node_overhead) +
+		info.m_v6_addrs.size() * (sizeof(std::pair<const ipv6addr, std::shared_ptr<dns_info>>) + node_overhead);
+}
+
+uint64_t sinsp_dns_manager::dns_table::evict(uint64_t target)
+{
+	if(m_bytes <= target)
+	{
+		return 0;
+	}
+
+	std::vector<std::pair<uint64_t, std::string>> lru;
+	for(const auto &it : m_by_name)
+	{
+		lru.push_back(std::make_pair(it.second->m_last_used_ts.load(std::memory_order_relaxed), it.first));
+	}
+
+	std::sort(lru.begin(), lru.end());
+
+	uint64_t n = 0;
+	for(uint32_t j = 0; j < lru.size() && m_bytes > target; j++)
+	{
+		erase(m_by_name.find(lru[j].second));
+		n++;
+	}
+
+	return n;
+}
+
+const sinsp_dns_manager::dns_table& sinsp_dns_manager::current_table()
+{
+	// The manager is a singleton
+	static thread_local std::shared_ptr<dns_table> t_table;
+	static thread_local uint64_t t_generation = 0;
+
+	uint64_t generation = m_generation.load(std::memory_order_acquire);
+	if(generation != t_generation)
+	{
+		t_table = std::atomic_load(&m_table);
+		t_generation = generation;
+	}
+
+	return *t_table;
+}
+
+std::shared_ptr<sinsp_dns_manager::dns_info> sinsp_dns_manager::find_pending(const std::string &name, uint64_t ts)
+{
+	std::shared_ptr<dns_info> res;
+
+	if(m_n_pending.load(std::memory_order_relaxed) == 0)
+	{
+		return res;
+	}
+
+	std::lock_guard<std::mutex> lock(m_write_mutex);
+
+	auto it = m_pending.find(name);
+	if(it != m_pending.end())
+	{
+		res = it->second;
+	}
+
+	flush_pending_if_due(ts);
+
+	return res;
+}
+
+std::shared_ptr<sinsp_dns_manager::dns_info> sinsp_dns_manager::add_pending(const std::shared_ptr<dns_info> &info, uint64_t ts)
+{
+	std::lock_guard<std::mutex> lock(m_write_mutex);
+
+	// someone else might have added it while we were resolving
+	std::shared_ptr<dns_table> table = std::atomic_load(&m_table);
+	auto it = table->m_by_name.find(info->m_name);
+	if(it != table->m_by_name.end())
+	{
+		return it->second;
+	}
+
+	auto res = m_pending.insert(std::make_pair(info->m_name, info));
+	if(!res.second)
+	{
+		return res.first->second;
+	}
+
+	if(m_pending.size() == 1)
+	{
+		m_pending_since_ts = ts;
+	}
+	m_n_pending.store(m_pending.size(), std::memory_order_relaxed);
+
+	flush_pending_if_due(ts);
+
+	return info;
+}
+
+void sinsp_dns_manager::flush_pending_if_due(uint64_t ts)
+{
+	if(m_pending.size() >= PUBLISH_BATCH ||
+	   (!m_pending.empty() && ts >= m_pending_since_ts + PUBLISH_DELAY_NS))
+	{
+		flush_pending();
+	}
+}
+
+void sinsp_dns_manager::flush_pending()
+{
+	if(m_pending.empty())
+	{
+		return;
+	}
+
+	publish(std::make_shared<dns_table>(*std::atomic_load(&m_table)), true);
+}
+
+void sinsp_dns_manager::publish(const std::shared_ptr<dns_table> &next, bool indexed)
+{
+	for(const auto &it : m_pending)
+	{
+		next->add(it.second);
+	}
+	m_pending.clear();
+	m_n_pending.store(0, std::memory_order_relaxed);
+
+	uint64_t max_memory = m_max_memory;
+	if(max_memory != 0 && next->memory_usage() > max_memory)
+	{
+		uint64_t n = next->evict((uint64_t)(max_memory * sinsp_memory_budget::LOW_WATERMARK));
+		m_n_evicted += n;
+		indexed = indexed && n == 0;
+	}
+
+	if(!indexed)
+	{
+		next->reindex();
+	}
+
+	std::atomic_store(&m_table, next);
+	m_generation.fetch_add(1, std::memory_order_release);
+}
 #endif
 
-bool sinsp_dns_manager::match(const char *name, int af, void *addr, uint64_t ts)
+uint64_t sinsp_dns_manager::get_memory_usage()
 {
 #if defined(HAS_CAPTURE) && !defined(CYGWING_AGENT) && !defined(_WIN32)
-	if(!m_resolver)
+	std::lock_guard<std::mutex> lock(m_write_mutex);
+	uint64_t res = std::atomic_load(&m_table)->memory_usage();
+
+	for(const auto &it : m_pending)
 	{
-		m_resolver = new thread(sinsp_dns_resolver::refresh, m_erase_timeout, m_base_refresh_timeout, m_max_refresh_timeout, m_exit_signal.get_future());
+		res += dns_table::entry_bytes(it.first, *it.second);
 	}
 
-	string sname = string(name);
+	return res;
+#else
+	return 0;
+#endif
+}
 
-	m_erase_mutex.lock();
+size_t sinsp_dns_manager::size()
+{
+#if defined(HAS_CAPTURE) && !defined(CYGWING_AGENT) && !defined(_WIN32)
+	std::lock_guard<std::mutex> lock(m_write_mutex);
+	return std::atomic_load(&m_table)->m_by_name.size() + m_pending.size();
+#else
+	return 0;
+#endif
+}
 
-	if(m_cache.find(sname) == m_cache.end())
+bool sinsp_dns_manager::match(const char *name, int af, void *addr, uint64_t ts)
+{
+#if defined(HAS_CAPTURE) && !defined(CYGWING_AGENT) && !defined(_WIN32)
+	if(!m_resolver)
 	{
-		dns_info dinfo = resolve(sname, ts);
-		dinfo.m_timeout = m_base_refresh_timeout;
-		dinfo.m_last_resolve_ts = ts;
-		m_cache[sname] = dinfo;
+		m_resolver = new thread(sinsp_dns_resolver::refresh, m_erase_timeout, m_base_refresh_timeout, m_max_refresh_timeout, m_exit_signal.get_future());
 	}
 
-	m_cache[sname].m_last_used_ts = ts;
-	dns_info &dinfo = m_cache[sname];
-
-	m_erase_mutex.unlock();
+	string sname = string(name);
 
-	if(af == AF_INET6)
+	const dns_table& table = current_table();
+	auto it = table.m_by_name.find(sname);
+	if(it != table.m_by_name.end())
 	{
-		ipv6addr v6;
-		memcpy(v6.m_b, addr, sizeof(ipv6addr));
-		return dinfo.m_v6_addrs.find(v6) != dinfo.m_v6_addrs.end();
+		dns_info* dinfo = it->second.get();
+		dinfo->m_last_used_ts.store(ts, std::memory_order_relaxed);
+		return dinfo->has_addr(af, addr);
 	}
-	else if(af == AF_INET)
+
+	std::shared_ptr<dns_info> dinfo = find_pending(sname, ts);
+	if(!dinfo)
 	{
-		return dinfo.m_v4_addrs.find(*(uint32_t *)addr) != dinfo.m_v4_addrs.end();
+		std::shared_ptr<dns_info> resolved = resolve(sname, ts);
+		resolved->m_timeout = m_base_refresh_timeout;
+		resolved->m_last_resolve_ts = ts;
+		// the new name is the most recently used one
+		resolved->m_last_used_ts.store(ts, std::memory_order_relaxed);
+
+		dinfo = add_pending(resolved, ts);
 	}
+
+	dinfo->m_last_used_ts.store(ts, std::memory_order_relaxed);
+
+	return dinfo->has_addr(af, addr);
 #endif
 	return false;
 }
@@ -156,33 +466,52 @@ string sinsp_dns_manager::name_of(int af, void *addr, uint64_t ts)
 	string ret;
 
 #if defined(HAS_CAPTURE) && !defined(CYGWING_AGENT) && !defined(_WIN32)
-	if(!m_cache.empty())
+	const dns_table& table = current_table();
+	dns_info *info = NULL;
+
+	if(af == AF_INET6)
 	{
-		m_erase_mutex.lock();
-		for(auto &it: m_cache)
+		ipv6addr v6;
+		memcpy(v6.m_b, addr, sizeof(ipv6addr));
+		auto it = table.m_by_v6.find(v6);
+		if(it != table.m_by_v6.end())
+		{
+			info = it->second.get();
+		}
+	}
+	else if(af == AF_INET)
+	{
+		auto it = table.m_by_v4.find(*(uint32_t *)addr);
+		if(it != table.m_by_v4.end())
 		{
-			const std::string &name = it.first;
-			sinsp_dns_manager::dns_info &info = it.second;
+			info = it->second.get();
+		}
+	}
 
-			if(af == AF_INET6)
-			{
-				ipv6addr v6;
-				memcpy(v6.m_b, addr, sizeof(ipv6addr));
-				if (info.m_v6_addrs.find(v6) != info.m_v6_addrs.end())
-				{
-					info.m_last_used_ts = ts;
-					ret = name;
-					break;
-				}
-			}
-			else if(af == AF_INET && info.m_v4_addrs.find(*(uint32_t *)addr) != info.m_v4_addrs.end())
+	if(info != NULL)
+	{
+		info->m_last_used_ts.store(ts, std::memory_order_relaxed);
+		ret = info->m_name;
+	}
+	else if(m_n_pending.load(std::memory_order_relaxed) != 0)
+	{
+		std::lock_guard<std::mutex> lock(m_write_mutex);
+
+		for(const auto &it : m_pending)
+		{
+			if(it.second->has_addr(af, addr) && (info == NULL || it.first < info->m_name))
 			{
-				info.m_last_used_ts = ts;
-				ret = name;
-				break;
+				info = it.second.get();
 			}
 		}
-		m_erase_mutex.unlock();
+
+		if(info != NULL)
+		{
+			info->m_last_used_ts.store(ts, std::memory_order_relaxed);
+			ret = info->m_name;
+		}
+
+		flush_pending_if_due(ts);
 	}
 #endif
 	return ret;
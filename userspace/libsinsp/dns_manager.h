@@ -22,14 +22,15 @@ limitations under the License.
 #include <sys/socket.h>
 #include <netdb.h>
 #endif
+#include <atomic>
 #include <string>
 #include <thread>
 #include <chrono>
 #include <future>
+#include <memory>
 #include <mutex>
-#if defined(HAS_CAPTURE) && !defined(CYGWING_AGENT) && !defined(_WIN32)
-#include "tbb/concurrent_unordered_map.h"
-#endif
+#include <unordered_map>
+#include <vector>
 #include "sinsp.h"
 
 
@@ -66,54 +67,167 @@ public:
 		m_max_refresh_timeout = ns;
 	};
 
-	size_t size()
+	//
+	// Over bytes, the names used the longest time ago are evicted when a
+	// new one is added, down to sinsp_memory_budget::LOW_WATERMARK of it.
+	// 0 means unlimited, the default.
+	//
+	void set_max_memory(uint64_t bytes)
 	{
-#if defined(HAS_CAPTURE) && !defined(CYGWING_AGENT) && !defined(_WIN32)
-		return m_cache.size();
-#else
-		return 0;
-#endif
-	};
+		m_max_memory = bytes;
+	}
+
+	uint64_t get_memory_usage();
+
+	uint64_t get_n_evicted() const
+	{
+		return m_n_evicted;
+	}
+
+	size_t size();
 
 private:
 
 	sinsp_dns_manager() :
+#if defined(HAS_CAPTURE) && !defined(CYGWING_AGENT) && !defined(_WIN32)
+		m_table(std::make_shared<dns_table>()),
+		m_generation(1),
+		m_n_pending(0),
+		m_pending_since_ts(0),
+#endif
+		m_resolver(NULL),
 		m_erase_timeout(3600 * ONE_SECOND_IN_NS),
 		m_base_refresh_timeout(10 * ONE_SECOND_IN_NS),
-		m_max_refresh_timeout(320 * ONE_SECOND_IN_NS)
+		m_max_refresh_timeout(320 * ONE_SECOND_IN_NS),
+		m_max_memory(0),
+		m_n_evicted(0)
 	{};
         sinsp_dns_manager(sinsp_dns_manager const&) = delete;
         void operator=(sinsp_dns_manager const&) = delete;
 
 #if defined(HAS_CAPTURE) && !defined(CYGWING_AGENT) && !defined(_WIN32)
+	//
+	// A resolved name. The addresses are sorted and never change once
+	// the entry is published: a refresh that finds different addresses
+	// replaces the entry.
+	//
 	struct dns_info
 	{
-		bool operator==(const dns_info &other) const
+		dns_info():
+			m_timeout(0),
+			m_last_resolve_ts(0),
+			m_last_used_ts(0)
 		{
-			return m_v4_addrs == other.m_v4_addrs && m_v6_addrs == other.m_v6_addrs;
-		};
-		bool operator!=(const dns_info &other) const
+		}
+
+		bool same_addrs(const dns_info &other) const
 		{
-			return !operator==(other);
+			return m_v4_addrs == other.m_v4_addrs && m_v6_addrs == other.m_v6_addrs;
 		};
 
+		bool has_addr(int af, void *addr) const;
+
+		std::string m_name;
+
+		// Only touched by the refresh thread
 		uint64_t m_timeout;
 		uint64_t m_last_resolve_ts;
-		uint64_t m_last_used_ts;
-		std::set<uint32_t> m_v4_addrs;
-		std::set<ipv6addr> m_v6_addrs;
+
+		// Bumped by readers, read by the refresh thread
+		std::atomic<uint64_t> m_last_used_ts;
+
+		std::vector<uint32_t> m_v4_addrs;
+		std::vector<ipv6addr> m_v6_addrs;
 	};
 
-	static inline dns_info resolve(const std::string &name, uint64_t ts);
+	//
+	// An immutable snapshot of the cache, indexed both by name and by
+	// address. Writers build a new table, publish it with
+	// std::atomic_store() and bump m_generation. Readers keep a reference
+	// to the table they last saw in a thread_local, and only reload it,
+	// with std::atomic_load(), when the generation changed. Note that
+	// libstdc++ implements the atomic shared_ptr functions with a pool of
+	// mutexes: a lookup takes no lock unless the table was just replaced,
+	// and never waits for a resolution or a refresh.
+	//
+	struct dns_table
+	{
+		dns_table():
+			m_bytes(sizeof(dns_table))
+		{
+		}
+
+		typedef std::unordered_map<std::string, std::shared_ptr<dns_info>> name_map;
+
+		name_map m_by_name;
+
+		// When several names resolve to the same address, the
+		// smallest one wins, so that the result doesn't depend on
+		// the order names were added
+		std::unordered_map<uint32_t, std::shared_ptr<dns_info>> m_by_v4;
+		std::unordered_map<ipv6addr, std::shared_ptr<dns_info>> m_by_v6;
+
+		// Add a name that isn't there yet, indexes included
+		void add(const std::shared_ptr<dns_info>& info);
 
-	typedef tbb::concurrent_unordered_map<std::string, dns_info> c_dns_table;
-	c_dns_table m_cache;
+		// The reverse indexes need to be rebuilt after these
+		void erase(name_map::iterator it);
+		void replace(name_map::iterator it, const std::shared_ptr<dns_info>& info);
+
+		// Rebuild the reverse indexes after m_by_name changed
+		void reindex();
+		void index(const std::shared_ptr<dns_info>& info);
+
+		// Bytes of an entry of m_by_name, its addresses in the reverse
+		// indexes included
+		static uint64_t entry_bytes(const std::string& name, const dns_info& info);
+		uint64_t memory_usage() const
+		{
+			return m_bytes;
+		}
+
+		// Erase the names used the longest time ago until the table
+		// takes at most target bytes, returns how many. The reverse
+		// indexes need to be rebuilt after.
+		uint64_t evict(uint64_t target);
+
+		// Kept up to date by add(), erase() and replace()
+		uint64_t m_bytes;
+	};
+
+	static inline std::shared_ptr<dns_info> resolve(const std::string &name, uint64_t ts);
+
+	// The current table, as seen by this thread
+	const dns_table& current_table();
+
+	//
+	// Publishing a table copies it, so the names resolved by match()
+	// are added in batches: up to PUBLISH_BATCH names, or the ones
+	// resolved over PUBLISH_DELAY_NS of event time. Until then they
+	// are looked up in m_pending, under m_write_mutex.
+	//
+	static const size_t PUBLISH_BATCH = 64;
+	static const uint64_t PUBLISH_DELAY_NS = ONE_SECOND_IN_NS / 10;
+
+	std::shared_ptr<dns_info> find_pending(const std::string &name, uint64_t ts);
+	std::shared_ptr<dns_info> add_pending(const std::shared_ptr<dns_info> &info, uint64_t ts);
+
+	// All the following take m_write_mutex
+	void flush_pending_if_due(uint64_t ts);
+	void flush_pending();
+	// Adds the pending names to next, evicts and publishes it. indexed
+	// tells whether the reverse indexes of next are up to date.
+	void publish(const std::shared_ptr<dns_table> &next, bool indexed);
+
+	std::shared_ptr<dns_table> m_table;
+	std::atomic<uint64_t> m_generation;
+	std::unordered_map<std::string, std::shared_ptr<dns_info>> m_pending;
+	std::atomic<size_t> m_n_pending;
+	uint64_t m_pending_since_ts;
 #endif
 
-	// tbb concurrent unordered map is not thread-safe for deletions,
-	// so we still need a mutex, but the chances of waiting are really
-	// low, since we will almost never do an erase.
-	std::mutex m_erase_mutex;
+	// Serializes writers, readers only go through m_table
+	std::mutex m_write_mutex;
 
 	// used to let m_resolver know when to terminate
 	std::promise<void> m_exit_signal;
@@ -124,5 +238,8 @@ private:
 	uint64_t m_base_refresh_timeout;
 	uint64_t m_max_refresh_timeout;
 
+	std::atomic<uint64_t> m_max_memory;
+	std::atomic<uint64_t> m_n_evicted;
+
 	friend sinsp_dns_resolver;
 };
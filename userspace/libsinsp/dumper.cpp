@@ -27,6 +27,9 @@ sinsp_dumper::sinsp_dumper(sinsp* inspector)
 	m_target_memory_buffer = NULL;
 	m_target_memory_buffer_size = 0;
 	m_nevts = 0;
+	m_checkpoints_enabled = false;
+	m_checkpoint_interval = 0;
+	m_last_checkpoint = 0;
 }
 
 sinsp_dumper::sinsp_dumper(sinsp* inspector, uint8_t* target_memory_buffer, uint64_t target_memory_buffer_size)
@@ -35,6 +38,10 @@ sinsp_dumper::sinsp_dumper(sinsp* inspector, uint8_t* target_memory_buffer, uint
 	m_dumper = NULL;
 	m_target_memory_buffer = target_memory_buffer;
 	m_target_memory_buffer_size = target_memory_buffer_size;
+	m_nevts = 0;
+	m_checkpoints_enabled = false;
+	m_checkpoint_interval = 0;
+	m_last_checkpoint = 0;
 }
 
 sinsp_dumper::~sinsp_dumper()
@@ -81,6 +88,8 @@ void sinsp_dumper::open(const string& filename, bool compress, bool threads_from
 	m_inspector->m_container_manager.dump_containers(m_dumper);
 
 	m_nevts = 0;
+	m_last_checkpoint = 0;
+	m_pending_enters.clear();
 }
 
 void sinsp_dumper::fdopen(int fd, bool compress, bool threads_from_sinsp)
@@ -112,6 +121,8 @@ void sinsp_dumper::fdopen(int fd, bool compress, bool threads_from_sinsp)
 	m_inspector->m_container_manager.dump_containers(m_dumper);
 
 	m_nevts = 0;
+	m_last_checkpoint = 0;
+	m_pending_enters.clear();
 }
 
 void sinsp_dumper::close()
@@ -151,6 +162,84 @@ void sinsp_dumper::dump(sinsp_evt* evt)
 	}
 
 	m_nevts++;
+
+	if(m_checkpoints_enabled)
+	{
+		if(PPME_IS_ENTER(pdevt->type))
+		{
+			std::vector<uint8_t>& pending = m_pending_enters[pdevt->tid];
+			pending.resize(sizeof(uint16_t) + pdevt->len);
+			memcpy(pending.data(), &evt->m_cpuid, sizeof(uint16_t));
+			memcpy(pending.data() + sizeof(uint16_t), pdevt, pdevt->len);
+		}
+		else
+		{
+			m_pending_enters.erase(pdevt->tid);
+		}
+
+		if(m_checkpoint_interval != 0 && next_write_position() - m_last_checkpoint >= m_checkpoint_interval)
+		{
+			checkpoint();
+		}
+	}
+}
+
+void sinsp_dumper::enable_checkpoints(uint64_t interval_bytes)
+{
+	m_checkpoints_enabled = true;
+	m_checkpoint_interval = interval_bytes;
+}
+
+void sinsp_dumper::checkpoint()
+{
+	if(m_dumper == NULL)
+	{
+		throw sinsp_exception("dumper not opened yet");
+	}
+
+	if(!m_checkpoints_enabled)
+	{
+		throw sinsp_exception("checkpoints not enabled");
+	}
+
+	if(scap_dump_checkpoint(m_inspector->m_h, m_dumper) != SCAP_SUCCESS)
+	{
+		throw sinsp_exception(scap_getlasterr(m_inspector->m_h));
+	}
+
+	m_inspector->m_thread_manager->dump_threads_to_file(m_dumper);
+
+	//
+	// Readers starting at the checkpoint need the containers, and the enter
+	// events to parse the exit events that come after it. The others
+	// already saw them.
+	//
+	uint32_t flags = SCAP_DF_STATE_ONLY | SCAP_DF_CHECKPOINT;
+	m_inspector->m_container_manager.dump_containers(m_dumper, flags);
+
+	for(auto it = m_pending_enters.begin(); it != m_pending_enters.end();)
+	{
+		//
+		// Nobody is going to exit
+		//
+		if(m_inspector->get_thread_ref(it->first, false, true) == nullptr)
+		{
+			it = m_pending_enters.erase(it);
+			continue;
+		}
+
+		uint16_t cpuid;
+		memcpy(&cpuid, it->second.data(), sizeof(uint16_t));
+		scap_evt* pevt = (scap_evt*)(it->second.data() + sizeof(uint16_t));
+
+		if(scap_dump(m_inspector->m_h, m_dumper, pevt, cpuid, flags) != SCAP_SUCCESS)
+		{
+			throw sinsp_exception(scap_getlasterr(m_inspector->m_h));
+		}
+		++it;
+	}
+
+	m_last_checkpoint = next_write_position();
 }
 
 uint64_t sinsp_dumper::written_bytes()
@@ -116,6 +116,29 @@ public:
 	*/
 	void dump(sinsp_evt* evt);
 
+	/*!
+	  \brief Enables checkpoints: the thread, fd and container tables of
+	   the inspector, and the enter events still waiting for their exit
+	   event, saved in a section of their own.
+
+	  A capture can be opened at any of its checkpoints (see
+	  sinsp::open_checkpoint()), which is how sinsp_parallel_capture splits
+	  it. Sequential readers skip them.
+
+	  \param interval_bytes dump() writes a checkpoint every time this many
+	   bytes of (uncompressed) data were written since the previous one.
+	   0 means only the explicit checkpoint() calls.
+
+	  \note Must be called before dumping the first event, since the enter
+	   events are tracked from there.
+	*/
+	void enable_checkpoints(uint64_t interval_bytes = 0);
+
+	/*!
+	  \brief Writes a checkpoint now.
+	*/
+	void checkpoint();
+
 	inline uint8_t* get_memory_dump_cur_buf()
 	{
 		return scap_get_memorydumper_curpos(m_dumper);
@@ -132,6 +155,12 @@ private:
 	uint8_t* m_target_memory_buffer;
 	uint64_t m_target_memory_buffer_size;
 	uint64_t m_nevts;
+	bool m_checkpoints_enabled;
+	uint64_t m_checkpoint_interval;
+	uint64_t m_last_checkpoint;
+	// By tid, the cpuid followed by the last enter event dumped, until its
+	// exit event is
+	std::unordered_map<int64_t, std::vector<uint8_t>> m_pending_enters;
 };
 
 /*@}*/
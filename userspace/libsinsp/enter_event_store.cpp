@@ -0,0 +1,230 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "enter_event_store.h"
+
+#define ALL_PARAMS 0xffffffff
+#define PARAM(j) (1U << (j))
+
+sinsp_enter_event_store::sinsp_enter_event_store():
+	m_free(NULL),
+	m_n_slots_used(0),
+	m_n_large(0),
+	m_large_bytes(0),
+	m_max_memory(0),
+	m_n_refused(0)
+{
+	for(uint32_t j = 0; j < PPM_EVENT_MAX; j++)
+	{
+		m_kept_params[j] = ALL_PARAMS;
+	}
+
+	//
+	// The enter parameters read by the exit parsers. When adding a
+	// retrieve_enter_event() call, or reading a new parameter after one,
+	// update this table.
+	//
+	// Only checked for being there by the exit parser
+	m_kept_params[PPME_SYSCALL_OPEN_E] = 0;
+	m_kept_params[PPME_SYSCALL_CREAT_E] = 0;
+	m_kept_params[PPME_SYSCALL_FCNTL_E] = 0;
+	// Not read at all
+	m_kept_params[PPME_SYSCALL_EVENTFD_E] = 0;
+	m_kept_params[PPME_SYSCALL_CHDIR_E] = 0;
+	m_kept_params[PPME_SYSCALL_FCHDIR_E] = 0;
+	m_kept_params[PPME_SOCKET_SHUTDOWN_E] = 0;
+	m_kept_params[PPME_SYSCALL_SETPGID_E] = 0;
+	// dirfd, name, flags
+	m_kept_params[PPME_SYSCALL_OPENAT_E] = PARAM(0) | PARAM(1) | PARAM(2);
+	// domain, type, proto
+	m_kept_params[PPME_SOCKET_SOCKET_E] = PARAM(0) | PARAM(1) | PARAM(2);
+	// tuple
+	m_kept_params[PPME_SOCKET_SENDTO_E] = PARAM(2);
+	m_kept_params[PPME_SOCKET_SENDMSG_E] = PARAM(2);
+	// in_fd
+	m_kept_params[PPME_SYSCALL_SENDFILE_E] = PARAM(1);
+	// resource
+	m_kept_params[PPME_SYSCALL_GETRLIMIT_E] = PARAM(0);
+	m_kept_params[PPME_SYSCALL_SETRLIMIT_E] = PARAM(0);
+	// pid, resource
+	m_kept_params[PPME_SYSCALL_PRLIMIT_E] = PARAM(0) | PARAM(1);
+	// euid, egid
+	m_kept_params[PPME_SYSCALL_SETRESUID_E] = PARAM(1);
+	m_kept_params[PPME_SYSCALL_SETRESGID_E] = PARAM(1);
+	// uid, gid
+	m_kept_params[PPME_SYSCALL_SETUID_E] = PARAM(0);
+	m_kept_params[PPME_SYSCALL_SETGID_E] = PARAM(0);
+	// filename
+	m_kept_params[PPME_SYSCALL_EXECVE_18_E] = PARAM(0);
+	m_kept_params[PPME_SYSCALL_EXECVE_19_E] = PARAM(0);
+}
+
+sinsp_enter_event_store::~sinsp_enter_event_store()
+{
+	for(uint8_t* slab : m_slabs)
+	{
+		free(slab);
+	}
+}
+
+uint8_t* sinsp_enter_event_store::store(scap_evt* evt, uint8_t* prev)
+{
+	uint32_t kept = m_kept_params[evt->type];
+	uint16_t* lens = (uint16_t*)((uint8_t*)evt + sizeof(struct ppm_evt_hdr));
+	uint32_t hdrlen = sizeof(struct ppm_evt_hdr) + evt->nparams * sizeof(uint16_t);
+	uint32_t len;
+
+	if(kept == ALL_PARAMS)
+	{
+		len = evt->len;
+	}
+	else
+	{
+		len = hdrlen;
+		for(uint32_t j = 0; j < evt->nparams && j < 32; j++)
+		{
+			if(kept & PARAM(j))
+			{
+				len += lens[j];
+			}
+		}
+	}
+
+	uint8_t* dst = prev;
+	if(dst == NULL ||
+		((scap_evt*)dst)->len > SLOT_SIZE ||
+		len > SLOT_SIZE)
+	{
+		if(dst != NULL)
+		{
+			release(dst);
+		}
+		dst = alloc(len);
+		if(dst == NULL)
+		{
+			return NULL;
+		}
+	}
+
+	if(kept == ALL_PARAMS)
+	{
+		memcpy(dst, evt, len);
+		return dst;
+	}
+
+	memcpy(dst, evt, sizeof(struct ppm_evt_hdr));
+	((scap_evt*)dst)->len = len;
+
+	uint16_t* dlens = (uint16_t*)(dst + sizeof(struct ppm_evt_hdr));
+	uint8_t* src = (uint8_t*)evt + hdrlen;
+	uint8_t* dval = dst + hdrlen;
+	for(uint32_t j = 0; j < evt->nparams; j++)
+	{
+		if(j < 32 && (kept & PARAM(j)))
+		{
+			memcpy(dval, src, lens[j]);
+			dval += lens[j];
+			dlens[j] = lens[j];
+		}
+		else
+		{
+			dlens[j] = 0;
+		}
+
+		src += lens[j];
+	}
+
+	return dst;
+}
+
+uint8_t* sinsp_enter_event_store::alloc(uint32_t len)
+{
+	if(len > SLOT_SIZE)
+	{
+		if(m_max_memory != 0 && get_memory_usage() + len > m_max_memory)
+		{
+			m_n_refused++;
+			return NULL;
+		}
+
+		m_n_large++;
+		m_large_bytes += len;
+		return (uint8_t*)malloc(len);
+	}
+
+	if(m_free == NULL)
+	{
+		if(m_max_memory != 0 && get_memory_usage() + SLOTS_PER_SLAB * SLOT_SIZE > m_max_memory)
+		{
+			m_n_refused++;
+			return NULL;
+		}
+
+		uint8_t* slab = (uint8_t*)malloc(SLOTS_PER_SLAB * SLOT_SIZE);
+		m_slabs.push_back(slab);
+
+		for(uint32_t j = SLOTS_PER_SLAB; j > 0; j--)
+		{
+			free_slot* slot = (free_slot*)(slab + (j - 1) * SLOT_SIZE);
+			slot->m_next = m_free;
+			m_free = slot;
+		}
+	}
+
+	free_slot* slot = m_free;
+	m_free = slot->m_next;
+	m_n_slots_used++;
+	return (uint8_t*)slot;
+}
+
+void sinsp_enter_event_store::release(uint8_t* data)
+{
+	uint32_t len = ((scap_evt*)data)->len;
+
+	if(len > SLOT_SIZE)
+	{
+		ASSERT(m_n_large > 0);
+		m_n_large--;
+		m_large_bytes -= len;
+		free(data);
+		return;
+	}
+
+	free_slot* slot = (free_slot*)data;
+	slot->m_next = m_free;
+	m_free = slot;
+	ASSERT(m_n_slots_used > 0);
+	m_n_slots_used--;
+}
+
+void sinsp_enter_event_store::trim()
+{
+	if(m_n_slots_used != 0)
+	{
+		return;
+	}
+
+	for(uint8_t* slab : m_slabs)
+	{
+		free(slab);
+	}
+
+	m_slabs.clear();
+	m_free = NULL;
+}
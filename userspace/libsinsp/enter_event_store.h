@@ -0,0 +1,118 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "scap.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Storage for the enter events that the exit parsers read back with
+// sinsp_parser::retrieve_enter_event().
+//
+// An exit parser only reads a couple of parameters of the enter event (the
+// tuple of sendto(), the dirfd and the name of openat(), ...). store() copies
+// the event header and those parameters only, as described by a table
+// indexed by event type, and leaves the other ones empty: the result is
+// still a valid event, just a shorter one. Event types that aren't in the
+// table are stored whole.
+//
+// The copies come from fixed-size slots carved from slabs and recycled
+// through a free list. The rare ones that don't fit in a slot (long paths)
+// are allocated on their own.
+//
+// With a memory budget, the copies that would take more memory than it
+// aren't made: store() returns NULL, and the exit is parsed like the ones
+// of a dropped enter event.
+///////////////////////////////////////////////////////////////////////////////
+class sinsp_enter_event_store
+{
+public:
+	static const uint32_t SLOT_SIZE = 256;
+	static const uint32_t SLOTS_PER_SLAB = 256;
+
+	sinsp_enter_event_store();
+	~sinsp_enter_event_store();
+
+	//
+	// Copies the parameters of evt that are kept for its type, reusing
+	// prev, the previous copy of the same thread, if any. Returns the copy,
+	// NULL if over the memory budget.
+	//
+	uint8_t* store(scap_evt* evt, uint8_t* prev);
+
+	void release(uint8_t* data);
+
+	//
+	// Frees the slabs if no slot is in use
+	//
+	void trim();
+
+	//
+	// Copies currently stored, in a slot or on their own
+	//
+	uint64_t get_n_stored() const
+	{
+		return m_n_slots_used + m_n_large;
+	}
+
+	//
+	// Bytes taken by the slabs and by the copies that didn't fit in a slot
+	//
+	uint64_t get_memory_usage() const
+	{
+		return m_slabs.size() * SLOTS_PER_SLAB * SLOT_SIZE + m_large_bytes;
+	}
+
+	//
+	// 0 means unlimited, the default
+	//
+	void set_max_memory(uint64_t bytes)
+	{
+		m_max_memory = bytes;
+	}
+
+	//
+	// Copies not made because of the memory budget
+	//
+	uint64_t get_n_refused() const
+	{
+		return m_n_refused;
+	}
+
+private:
+	//
+	// A free slot holds the pointer to the next free one
+	//
+	struct free_slot
+	{
+		free_slot* m_next;
+	};
+
+	uint8_t* alloc(uint32_t len);
+
+	// Bit j set when parameter j is kept
+	uint32_t m_kept_params[PPM_EVENT_MAX];
+	free_slot* m_free;
+	std::vector<uint8_t*> m_slabs;
+	uint64_t m_n_slots_used;
+	uint64_t m_n_large;
+	uint64_t m_large_bytes;
+	uint64_t m_max_memory;
+	uint64_t m_n_refused;
+};
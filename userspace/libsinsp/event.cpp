@@ -68,6 +68,7 @@ sinsp_evt::sinsp_evt() :
 {
 	m_flags = EF_NONE;
 	m_tinfo = NULL;
+	m_conn_fd = -1;
 #ifdef _DEBUG
 	m_filtered_out = false;
 #endif
@@ -81,6 +82,7 @@ sinsp_evt::sinsp_evt(sinsp *inspector) :
 	m_inspector = inspector;
 	m_flags = EF_NONE;
 	m_tinfo = NULL;
+	m_conn_fd = -1;
 #ifdef _DEBUG
 	m_filtered_out = false;
 #endif
@@ -145,7 +147,7 @@ int64_t sinsp_evt::get_fd_num()
 {
 	if(m_fdinfo)
 	{
-		return m_tinfo->m_lastevent_fd;
+		return (m_conn_fd != -1) ? m_conn_fd : m_tinfo->m_lastevent_fd;
 	}
 	else
 	{
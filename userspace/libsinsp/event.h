@@ -401,6 +401,7 @@ private:
 		m_flags = EF_NONE;
 		m_info = &(m_event_info_table[m_pevt->type]);
 		m_fdinfo = NULL;
+		m_conn_fd = -1;
 		m_fdinfo_name_changed = false;
 		m_iosize = 0;
 		m_poriginal_evt = NULL;
@@ -419,6 +420,7 @@ private:
 		m_tinfo_ref.reset();
 		m_tinfo = NULL;
 		m_fdinfo = NULL;
+		m_conn_fd = -1;
 		m_fdinfo_name_changed = false;
 		m_iosize = 0;
 		m_cpuid = cpuid;
@@ -494,6 +496,10 @@ VISIBILITY_PRIVATE
 	std::shared_ptr<sinsp_threadinfo> m_tinfo_ref;
 	sinsp_threadinfo* m_tinfo;
 	sinsp_fdinfo_t* m_fdinfo;
+	// The fd of the events that aren't issued by the thread owning it,
+	// like the tcp_* kprobes resolved by sinsp_conn_index. -1 for the
+	// others, whose fd is the last one of the thread.
+	int64_t m_conn_fd;
 
 	// If true, then the associated fdinfo changed names as a part
 	// of parsing this event.
@@ -519,6 +525,7 @@ VISIBILITY_PRIVATE
 	friend class sinsp_dumper;
 	friend class sinsp_analyzer_fd_listener;
 	friend class sinsp_analyzer_parsers;
+	friend class sinsp_conn_index;
 	friend class lua_cbacks;
 	friend class sinsp_container_manager;
 	friend class sinsp_table;
@@ -529,6 +536,7 @@ VISIBILITY_PRIVATE
 	friend class sinsp_memory_dumper;
 	friend class sinsp_memory_dumper_job;
 	friend class protocol_manager;
+	friend class sinsp_evt_handle_pool;
 	friend class test_helpers::event_builder;
 	friend class test_helpers::sinsp_mock;
 };
@@ -0,0 +1,181 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <chrono>
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "event_handle.h"
+
+sinsp_evt_handle::sinsp_evt_handle(sinsp* inspector, sinsp_evt_handle_pool* pool):
+	m_evt(inspector),
+	m_refs(0),
+	m_pool(pool)
+{
+}
+
+sinsp_evt_handle_pool::sinsp_evt_handle_pool(sinsp* inspector):
+	m_inspector(inspector),
+	m_max_wait_ns(0),
+	m_n_exhausted(0)
+{
+}
+
+sinsp_evt_handle_pool::~sinsp_evt_handle_pool()
+{
+	ASSERT(m_free.size() == m_handles.size());
+}
+
+void sinsp_evt_handle_pool::set_size(uint32_t n, uint64_t max_wait_ns)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if(m_free.size() != m_handles.size())
+	{
+		throw sinsp_exception("can't resize the event handles while events are held");
+	}
+
+	m_free.clear();
+	m_handles.clear();
+
+	for(uint32_t j = 0; j < n; j++)
+	{
+		m_handles.emplace_back(new sinsp_evt_handle(m_inspector, this));
+		m_free.push_back(m_handles.back().get());
+	}
+
+	m_max_wait_ns = max_wait_ns;
+}
+
+uint32_t sinsp_evt_handle_pool::get_n_free()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return (uint32_t)m_free.size();
+}
+
+void sinsp_evt_handle_pool::release(sinsp_evt_handle* handle)
+{
+	//
+	// The thread and the fd are dropped when the handle is reused, by the
+	// inspector thread: the last reference to a thread that left the table
+	// would destroy it here
+	//
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_free.push_back(handle);
+	}
+
+	m_released.notify_one();
+}
+
+sinsp_evt_ref sinsp_evt_handle_pool::hold(sinsp_evt* evt)
+{
+	if(m_handles.empty())
+	{
+		return sinsp_evt_ref();
+	}
+
+	sinsp_evt_handle* handle;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		if(m_free.empty() && m_max_wait_ns != 0)
+		{
+			m_released.wait_for(lock, std::chrono::nanoseconds(m_max_wait_ns), [this] {
+				return !m_free.empty();
+			});
+		}
+
+		if(m_free.empty())
+		{
+			m_n_exhausted++;
+			return sinsp_evt_ref();
+		}
+
+		handle = m_free.back();
+		m_free.pop_back();
+	}
+
+	//
+	// The storage, like the fd name, only grows, so after the first events
+	// nothing is allocated
+	//
+	uint32_t len = evt->m_pevt->len;
+	if(handle->m_storage.size() < len)
+	{
+		handle->m_storage.resize(len);
+	}
+
+	memcpy(handle->m_storage.data(), evt->m_pevt, len);
+
+	sinsp_evt& dst = handle->m_evt;
+	dst.m_pevt = (scap_evt*)handle->m_storage.data();
+	dst.m_poriginal_evt = NULL;
+	dst.m_info = evt->m_info;
+	dst.m_cpuid = evt->m_cpuid;
+	dst.m_evtnum = evt->m_evtnum;
+	// The parameters are loaded again, from the copy
+	dst.m_flags = evt->m_flags & ~sinsp_evt::SINSP_EF_PARAMS_LOADED;
+	dst.m_iosize = evt->m_iosize;
+	dst.m_errorcode = evt->m_errorcode;
+	dst.m_rawbuf_str_len = evt->m_rawbuf_str_len;
+	dst.m_fdinfo_name_changed = evt->m_fdinfo_name_changed;
+#ifdef HAS_FILTERING
+	dst.m_filtered_out = evt->m_filtered_out;
+#endif
+
+	//
+	// The thread isn't always in the table (e.g. the synthetic container
+	// events), and when it's not the one in the table it can't be kept
+	//
+	if(evt->m_tinfo_ref)
+	{
+		dst.m_tinfo_ref = evt->m_tinfo_ref;
+	}
+	else if(evt->m_tinfo != NULL)
+	{
+		dst.m_tinfo_ref = m_inspector->get_thread_ref(evt->m_tinfo->m_tid, false, true);
+		if(dst.m_tinfo_ref.get() != evt->m_tinfo)
+		{
+			dst.m_tinfo_ref.reset();
+		}
+	}
+	else
+	{
+		dst.m_tinfo_ref.reset();
+	}
+
+	dst.m_tinfo = dst.m_tinfo_ref.get();
+
+	//
+	// The fd number comes from the thread, which moves on to the next
+	// event: keep it with the fd
+	//
+	if(evt->m_fdinfo != NULL && dst.m_tinfo != NULL)
+	{
+		handle->m_fdinfo.copy_fields(*evt->m_fdinfo);
+		dst.m_fdinfo = &handle->m_fdinfo;
+		dst.m_conn_fd = evt->get_fd_num();
+	}
+	else
+	{
+		dst.m_fdinfo = NULL;
+		dst.m_conn_fd = -1;
+	}
+
+	handle->m_refs.store(1, std::memory_order_relaxed);
+	return sinsp_evt_ref(handle);
+}
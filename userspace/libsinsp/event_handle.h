@@ -0,0 +1,209 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "event.h"
+#include "fdinfo.h"
+
+class sinsp;
+class sinsp_evt_handle_pool;
+
+///////////////////////////////////////////////////////////////////////////////
+// Events that outlive sinsp::next(), for consumers that hand them over to
+// other threads.
+//
+// The event returned by sinsp::next() points into the capture buffers and
+// is only valid until the next call. sinsp::hold_event() copies it in a
+// handle taken from a pool allocated once, when the handles are enabled with
+// sinsp::set_event_handles(): the event bytes, the fd, which is a snapshot
+// without the decoders and the user state of the fd, and a reference to the
+// thread, which keeps it alive after it leaves the thread table. A handle is
+// refcounted by sinsp_evt_ref and goes back to the pool when the last one is
+// gone, from whatever thread that is.
+//
+// When all the handles are held, hold_event() waits for one, up to the
+// configured time, then gives up and returns an empty reference: the
+// inspector stops reading meanwhile, so the capture buffers fill up and the
+// driver drops, like when the consumer is slow.
+//
+// Only the event, its parameters and its fd can be used by another thread.
+// The thread is the one in the table, which the inspector keeps changing
+// with the events that follow: it, and anything else that reads the
+// inspector state (e.g. the proc.* and thread.* filter checks), can only be
+// used on the inspector thread, like before handing the event over.
+///////////////////////////////////////////////////////////////////////////////
+class sinsp_evt_handle
+{
+public:
+	sinsp_evt* get_event()
+	{
+		return &m_evt;
+	}
+
+private:
+	sinsp_evt_handle(sinsp* inspector, sinsp_evt_handle_pool* pool);
+
+	sinsp_evt m_evt;
+	std::vector<uint8_t> m_storage;
+	sinsp_fdinfo_t m_fdinfo;
+	std::atomic<uint32_t> m_refs;
+	sinsp_evt_handle_pool* m_pool;
+
+	friend class sinsp_evt_handle_pool;
+	friend class sinsp_evt_ref;
+};
+
+//
+// A reference to a held event. Copies add a reference, and the handle is
+// released with the last one.
+//
+class sinsp_evt_ref
+{
+public:
+	sinsp_evt_ref():
+		m_handle(NULL)
+	{
+	}
+
+	sinsp_evt_ref(const sinsp_evt_ref& other):
+		m_handle(other.m_handle)
+	{
+		if(m_handle != NULL)
+		{
+			m_handle->m_refs.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	sinsp_evt_ref(sinsp_evt_ref&& other):
+		m_handle(other.m_handle)
+	{
+		other.m_handle = NULL;
+	}
+
+	~sinsp_evt_ref()
+	{
+		reset();
+	}
+
+	sinsp_evt_ref& operator=(sinsp_evt_ref other)
+	{
+		std::swap(m_handle, other.m_handle);
+		return *this;
+	}
+
+	void reset();
+
+	sinsp_evt* get() const
+	{
+		return m_handle != NULL ? &m_handle->m_evt : NULL;
+	}
+
+	sinsp_evt* operator->() const
+	{
+		return get();
+	}
+
+	explicit operator bool() const
+	{
+		return m_handle != NULL;
+	}
+
+private:
+	// Takes over the reference the pool gave to the handle
+	explicit sinsp_evt_ref(sinsp_evt_handle* handle):
+		m_handle(handle)
+	{
+	}
+
+	sinsp_evt_handle* m_handle;
+
+	friend class sinsp_evt_handle_pool;
+};
+
+class sinsp_evt_handle_pool
+{
+public:
+	sinsp_evt_handle_pool(sinsp* inspector);
+	~sinsp_evt_handle_pool();
+
+	//
+	// Allocates n handles, none if 0, the default. An event waits at most
+	// max_wait_ns for a handle. Throws if handles are held.
+	//
+	void set_size(uint32_t n, uint64_t max_wait_ns);
+
+	bool is_enabled() const
+	{
+		return !m_handles.empty();
+	}
+
+	//
+	// Copies evt in a handle. Empty if the handles aren't enabled or if
+	// none got released in time.
+	//
+	sinsp_evt_ref hold(sinsp_evt* evt);
+
+	uint32_t get_size() const
+	{
+		return (uint32_t)m_handles.size();
+	}
+
+	uint32_t get_n_free();
+
+	//
+	// Events not held because no handle was released in time
+	//
+	uint64_t get_n_exhausted() const
+	{
+		return m_n_exhausted;
+	}
+
+private:
+	void release(sinsp_evt_handle* handle);
+
+	sinsp* m_inspector;
+	std::vector<std::unique_ptr<sinsp_evt_handle>> m_handles;
+	uint64_t m_max_wait_ns;
+	uint64_t m_n_exhausted;
+
+	// Protects the free handles, released by any thread
+	std::mutex m_mutex;
+	std::condition_variable m_released;
+	std::vector<sinsp_evt_handle*> m_free;
+
+	friend class sinsp_evt_ref;
+};
+
+inline void sinsp_evt_ref::reset()
+{
+	if(m_handle != NULL)
+	{
+		if(m_handle->m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			m_handle->m_pool->release(m_handle);
+		}
+
+		m_handle = NULL;
+	}
+}
@@ -139,6 +139,7 @@ void sinsp_evt_formatter::set_format(const string& fmt)
 
 			const char * fstart = cfmt + j + 1;
 			uint32_t fsize = chk->parse_field_name(fstart, true, false);
+			m_inspector->get_field_cache().attach(chk, string(fstart, fsize));
 
 			j += fsize;
 			ASSERT(j <= lfmt.length());
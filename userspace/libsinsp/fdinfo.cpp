@@ -295,6 +295,27 @@ template<> void sinsp_fdinfo_t::unregister_event_callback(sinsp_pd_callback_type
 	return;
 }
 
+template<> bool sinsp_fdinfo_t::has_event_callback(sinsp_pd_callback_type etype, sinsp_protodecoder* dec)
+{
+	if(m_callbacks == NULL)
+	{
+		return false;
+	}
+
+	switch(etype)
+	{
+	case CT_READ:
+		return find(m_callbacks->m_read_callbacks.begin(), m_callbacks->m_read_callbacks.end(), dec) !=
+			m_callbacks->m_read_callbacks.end();
+	case CT_WRITE:
+		return find(m_callbacks->m_write_callbacks.begin(), m_callbacks->m_write_callbacks.end(), dec) !=
+			m_callbacks->m_write_callbacks.end();
+	default:
+		ASSERT(false);
+		return false;
+	}
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // sinsp_fdtable implementation
 ///////////////////////////////////////////////////////////////////////////////
@@ -304,6 +325,42 @@ sinsp_fdtable::sinsp_fdtable(sinsp* inspector)
 	reset_cache();
 }
 
+sinsp_fdtable::sinsp_fdtable(const sinsp_fdtable& other):
+	m_inspector(other.m_inspector),
+	m_table(other.m_table),
+	m_tid(other.m_tid)
+{
+	reset_cache();
+	count(m_table.size());
+}
+
+sinsp_fdtable::~sinsp_fdtable()
+{
+	count(-(int64_t)m_table.size());
+}
+
+sinsp_fdtable& sinsp_fdtable::operator=(const sinsp_fdtable& other)
+{
+	if(this != &other)
+	{
+		count(-(int64_t)m_table.size());
+		m_inspector = other.m_inspector;
+		m_table = other.m_table;
+		m_tid = other.m_tid;
+		reset_cache();
+		count(m_table.size());
+	}
+	return *this;
+}
+
+void sinsp_fdtable::count(int64_t delta)
+{
+	if(m_inspector != NULL)
+	{
+		m_inspector->m_memory_budget.add_fds(delta);
+	}
+}
+
 sinsp_fdinfo_t* sinsp_fdtable::add(int64_t fd, sinsp_fdinfo_t* fdinfo)
 {
 	//
@@ -318,7 +375,8 @@ sinsp_fdinfo_t* sinsp_fdtable::add(int64_t fd, sinsp_fdinfo_t* fdinfo)
 	// 2. fd is already in the table, replace it
 	if(it == m_table.end())
 	{
-		if(m_table.size() < m_inspector->m_max_fdtable_size)
+		if(m_table.size() < m_inspector->m_max_fdtable_size &&
+			m_inspector->m_memory_budget.can_add_fd())
 		{
 			//
 			// No entry in the table, this is the normal case
@@ -328,6 +386,7 @@ sinsp_fdinfo_t* sinsp_fdtable::add(int64_t fd, sinsp_fdinfo_t* fdinfo)
 			m_inspector->m_stats.m_n_added_fds++;
 #endif
 			pair<unordered_map<int64_t, sinsp_fdinfo_t>::iterator, bool> insert_res = m_table.emplace(fd, *fdinfo);
+			count(1);
 			return &(insert_res.first->second);
 		}
 		else
@@ -351,7 +410,9 @@ sinsp_fdinfo_t* sinsp_fdtable::add(int64_t fd, sinsp_fdinfo_t* fdinfo)
 			fdinfo->m_flags &= ~sinsp_fdinfo_t::FLAGS_CLOSE_IN_PROGRESS;
 			fdinfo->m_flags |= sinsp_fdinfo_t::FLAGS_CLOSE_CANCELED;
 
+			size_t prev_size = m_table.size();
 			m_table[CANCELED_FD_NUMBER] = it->second;
+			count(m_table.size() - prev_size);
 		}
 		else
 		{
@@ -401,6 +462,7 @@ void sinsp_fdtable::erase(int64_t fd)
 	else
 	{
 		m_table.erase(fdit);
+		count(-1);
 #ifdef GATHER_INTERNAL_STATS
 		m_inspector->m_stats.m_n_noncached_fd_lookups++;
 		m_inspector->m_stats.m_n_removed_fds++;
@@ -410,7 +472,9 @@ void sinsp_fdtable::erase(int64_t fd)
 
 void sinsp_fdtable::clear()
 {
+	count(-(int64_t)m_table.size());
 	m_table.clear();
+	reset_cache();
 }
 
 size_t sinsp_fdtable::size()
@@ -109,16 +109,8 @@ public:
 
 	inline void copy(const sinsp_fdinfo &other, bool free_state)
 	{
-		m_type = other.m_type;
-		m_openflags = other.m_openflags;	
-		m_sockinfo = other.m_sockinfo;
-		m_name = other.m_name;
-		m_oldname = other.m_oldname;
-		m_flags = other.m_flags;
-		m_dev = other.m_dev;
-		m_mount_id = other.m_mount_id;
-		m_ino = other.m_ino;
-		
+		copy_fields(other);
+
 		if(free_state)
 		{
 			if(m_callbacks != NULL)
@@ -152,6 +144,23 @@ public:
 		}
 	}
 
+	/*!
+	  \brief Copy the fd information of other, without its protocol decoder
+	   callbacks and its user state, which stay with the fd in the table.
+	*/
+	inline void copy_fields(const sinsp_fdinfo &other)
+	{
+		m_type = other.m_type;
+		m_openflags = other.m_openflags;
+		m_sockinfo = other.m_sockinfo;
+		m_name = other.m_name;
+		m_oldname = other.m_oldname;
+		m_flags = other.m_flags;
+		m_dev = other.m_dev;
+		m_mount_id = other.m_mount_id;
+		m_ino = other.m_ino;
+	}
+
 	/*!
 	  \brief Return a single ASCII character that identifies the FD type.
 
@@ -283,6 +292,11 @@ public:
 	*/
 	void unregister_event_callback(sinsp_pd_callback_type etype, sinsp_protodecoder* dec);
 
+	/*!
+	  \brief Return true if the given protocol decoder has a callback of this type registered on this FD.
+	*/
+	bool has_event_callback(sinsp_pd_callback_type etype, sinsp_protodecoder* dec);
+
 	/*!
 	  \brief Return true if this FD is a socket server
 	*/
@@ -518,6 +532,9 @@ class sinsp_fdtable
 {
 public:
 	sinsp_fdtable(sinsp* inspector);
+	sinsp_fdtable(const sinsp_fdtable& other);
+	~sinsp_fdtable();
+	sinsp_fdtable& operator=(const sinsp_fdtable& other);
 
 	inline sinsp_fdinfo_t* find(int64_t fd)
 	{
@@ -578,4 +595,7 @@ public:
 
 private:
 	void lookup_device(sinsp_fdinfo_t* fdi, uint64_t fd);
+
+	// Keeps the fd count of the memory budget
+	void count(int64_t delta);
 };
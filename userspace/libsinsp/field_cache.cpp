@@ -0,0 +1,154 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "field_cache.h"
+
+#ifdef HAS_FILTERING
+#include "filterchecks.h"
+
+//
+// Whether extract() changes the values of type when sanitizing
+//
+static bool is_sanitized(ppm_param_type type)
+{
+	switch(type)
+	{
+	case PT_CHARBUF:
+	case PT_FSPATH:
+	case PT_FSRELPATH:
+	case PT_BYTEBUF:
+		return true;
+	default:
+		return false;
+	}
+}
+#endif
+
+sinsp_field_cache::sinsp_field_cache():
+	m_enabled(true),
+	m_n_attached(0)
+{
+}
+
+check_extraction_cache_entry* sinsp_field_cache::get_slot(const std::string& key)
+{
+	auto it = m_slot_ids.find(key);
+	if(it != m_slot_ids.end())
+	{
+		return &m_slots[it->second];
+	}
+
+	m_slot_ids[key] = (uint32_t)m_slots.size();
+	m_slots.emplace_back();
+	return &m_slots.back();
+}
+
+void sinsp_field_cache::attach(sinsp_filter_check* chk, const std::string& field)
+{
+#ifdef HAS_FILTERING
+	if(!m_enabled || field.empty())
+	{
+		return;
+	}
+
+	//
+	// The value of these depends on what the check saw before
+	//
+	if(chk->m_th_state_id != sinsp_filter_check::NO_THREAD_STATE ||
+		chk->m_has_instance_state)
+	{
+		return;
+	}
+
+	//
+	// Someone else (e.g. Falco) manages the cache of this check
+	//
+	if(chk->m_extraction_cache_entry != NULL)
+	{
+		return;
+	}
+
+	const filtercheck_field_info* finfo = chk->get_field_info();
+	if(finfo == NULL)
+	{
+		return;
+	}
+
+	chk->m_extraction_cache_entry = get_slot(field);
+
+	if(is_sanitized(finfo->m_type))
+	{
+		//
+		// A NUL can't be part of a field name
+		//
+		chk->m_sanitized_extraction_cache_entry = get_slot(field + '\0' + "sanitized");
+	}
+	else
+	{
+		chk->m_sanitized_extraction_cache_entry = chk->m_extraction_cache_entry;
+	}
+
+	m_n_attached++;
+#endif
+}
+
+void sinsp_field_cache::attach_sanitized(sinsp_filter_check* chk)
+{
+#ifdef HAS_FILTERING
+	const filtercheck_field_info* finfo = chk->get_field_info();
+	if(finfo == NULL || chk->m_extraction_cache_entry == NULL)
+	{
+		return;
+	}
+
+	if(is_sanitized(finfo->m_type))
+	{
+		//
+		// One per entry of the caller, which decides which checks share
+		// the raw values. Checks created again on the same entries (e.g.
+		// on a rules reload) get the same slots, cleared since they may
+		// have served another field.
+		//
+		auto it = m_sanitized_slot_ids.find(chk->m_extraction_cache_entry);
+		if(it == m_sanitized_slot_ids.end())
+		{
+			it = m_sanitized_slot_ids.emplace(chk->m_extraction_cache_entry, (uint32_t)m_slots.size()).first;
+			m_slots.emplace_back();
+		}
+		else
+		{
+			m_slots[it->second].m_evtnum = UINT64_MAX;
+		}
+
+		chk->m_sanitized_extraction_cache_entry = &m_slots[it->second];
+	}
+	else
+	{
+		chk->m_sanitized_extraction_cache_entry = chk->m_extraction_cache_entry;
+	}
+#endif
+}
+
+void sinsp_field_cache::reset()
+{
+	for(check_extraction_cache_entry& e : m_slots)
+	{
+		e.m_evtnum = UINT64_MAX;
+	}
+}
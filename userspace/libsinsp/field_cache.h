@@ -0,0 +1,116 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class sinsp_filter_check;
+
+//
+// The value of a field for the event m_evtnum. When m_storage is used, the
+// value is a copy that doesn't depend on the check that extracted it.
+//
+class check_extraction_cache_entry
+{
+public:
+	uint64_t m_evtnum = UINT64_MAX;
+	uint8_t* m_res;
+	uint32_t m_len = 0;
+	std::vector<uint8_t> m_storage;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// Per-inspector registry of the extracted field values.
+//
+// The global filter, the event type filters, formatters, tables and chisels
+// each have their own filter checks, and typically ask for the same fields
+// (proc.name, fd.name, container.id, ...) on the same event. The checks
+// that are attached here get a slot per field and argument, shared by all
+// the checks with the same field text, and sinsp_filter_check::extract_cached()
+// runs the extraction once per event and slot.
+//
+// Checks whose value depends on the events they saw before are left out:
+// the ones that keep it in the thread memory (e.g. evt.latency,
+// thread.totexectime) and the ones that set m_has_instance_state (e.g.
+// thread.exectime). String values are cached separately for the sanitized
+// and the raw extraction.
+//
+// Slots are never released, they live as long as the inspector. Their
+// number is bound by the distinct fields, and by the distinct entries for
+// the checks whose cache entry is set by the caller.
+///////////////////////////////////////////////////////////////////////////////
+class sinsp_field_cache
+{
+public:
+	sinsp_field_cache();
+
+	void set_enabled(bool enabled)
+	{
+		m_enabled = enabled;
+	}
+
+	bool is_enabled() const
+	{
+		return m_enabled;
+	}
+
+	//
+	// Connect chk, already parsed, to the slots of field. field is the text
+	// of the field, argument included (e.g. "proc.aname[2]").
+	// Does nothing if the cache is disabled.
+	//
+	void attach(sinsp_filter_check* chk, const std::string& field);
+
+	//
+	// Give chk, whose m_extraction_cache_entry is set by the caller, an
+	// entry for the sanitized values. Strings get the slot of the caller's
+	// entry, the other values are the same sanitized or not.
+	//
+	void attach_sanitized(sinsp_filter_check* chk);
+
+	//
+	// Forget the cached values. Needed when the event numbers restart.
+	//
+	void reset();
+
+	uint32_t get_n_slots() const
+	{
+		return (uint32_t)m_slots.size();
+	}
+
+	uint64_t get_n_attached() const
+	{
+		return m_n_attached;
+	}
+
+private:
+	check_extraction_cache_entry* get_slot(const std::string& key);
+
+	bool m_enabled;
+	uint64_t m_n_attached;
+	std::unordered_map<std::string, uint32_t> m_slot_ids;
+	std::unordered_map<const check_extraction_cache_entry*, uint32_t> m_sanitized_slot_ids;
+	//
+	// A deque so that the entry pointers held by the checks stay valid
+	//
+	std::deque<check_extraction_cache_entry> m_slots;
+};
@@ -135,6 +135,7 @@ sinsp_filter_check* sinsp_filter_check_list::new_filter_check_from_fldname(const
 
 			sinsp_filter_check* newchk = m_check_list[j]->allocate_new();
 			newchk->set_inspector(inspector);
+			newchk->m_field_name = name.substr(0, fldnamelen);
 			return newchk;
 		}
 	}
@@ -156,6 +157,7 @@ sinsp_filter_check* sinsp_filter_check_list::new_filter_check_from_another(sinsp
 	newchk->m_inspector = chk->m_inspector;
 	newchk->m_field_id = chk->m_field_id;
 	newchk->m_field = &chk->m_info.m_fields[chk->m_field_id];
+	newchk->m_field_name = chk->m_field_name;
 
 	newchk->m_boolop = chk->m_boolop;
 	newchk->m_cmpop = chk->m_cmpop;
@@ -646,6 +648,7 @@ sinsp_filter_check::sinsp_filter_check()
 	m_info.m_fields = NULL;
 	m_info.m_nfields = -1;
 	m_val_storage_len = 0;
+	m_th_state_id = NO_THREAD_STATE;
 	m_aggregation = A_NONE;
 	m_merge_aggregation = A_NONE;
 	m_val_storages = vector<vector<uint8_t>> (1, vector<uint8_t>(256));
@@ -1131,7 +1134,7 @@ char* sinsp_filter_check::rawval_to_string(uint8_t* rawval,
 char* sinsp_filter_check::tostring(sinsp_evt* evt)
 {
 	uint32_t len;
-	uint8_t* rawval = extract(evt, &len);
+	uint8_t* rawval = extract_cached(evt, &len);
 
 	if(rawval == NULL)
 	{
@@ -1148,7 +1151,7 @@ Json::Value sinsp_filter_check::tojson(sinsp_evt* evt)
 
 	if(jsonval == Json::nullValue)
 	{
-		uint8_t* rawval = extract(evt, &len);
+		uint8_t* rawval = extract_cached(evt, &len);
 		if(rawval == NULL)
 		{
 			return Json::nullValue;
@@ -1211,6 +1214,9 @@ void sinsp_filter_check::add_filter_value(const char* str, uint32_t len, uint32_
 
 	parsed_len = parse_filter_value(str, len, filter_value_p(i), filter_value(i)->size());
 
+	m_filter_values.append(str, len);
+	m_filter_values.push_back('\0');
+
 	// XXX/mstemm this doesn't work if someone called
 	// add_filter_value more than once for a given index.
 	filter_value_t item(filter_value_p(i), parsed_len);
@@ -1347,22 +1353,55 @@ uint8_t* sinsp_filter_check::extract(gen_event *evt, OUT uint32_t* len, bool san
 
 uint8_t* sinsp_filter_check::extract_cached(sinsp_evt *evt, OUT uint32_t* len, bool sanitize_strings)
 {
-	if(m_extraction_cache_entry != NULL)
+	check_extraction_cache_entry* ce = m_extraction_cache_entry;
+	if(sanitize_strings && ce != NULL)
 	{
-		uint64_t en = ((sinsp_evt *)evt)->get_num();
-
-		if(en != m_extraction_cache_entry->m_evtnum)
+		//
+		// The caller set the cache entry of this check, the sanitized
+		// values need one too
+		//
+		if(m_sanitized_extraction_cache_entry == NULL && m_inspector != NULL)
 		{
-			m_extraction_cache_entry->m_evtnum = en;
-			m_extraction_cache_entry->m_res = extract(evt, len, sanitize_strings);
+			m_inspector->get_field_cache().attach_sanitized(this);
 		}
-
-		return m_extraction_cache_entry->m_res;
+		ce = m_sanitized_extraction_cache_entry;
 	}
-	else
+
+	//
+	// Events that don't come from sinsp::next() have no number
+	//
+	uint64_t en = evt->get_num();
+	if(ce == NULL || en == 0)
 	{
 		return extract(evt, len, sanitize_strings);
 	}
+
+	if(en != ce->m_evtnum)
+	{
+		uint32_t reslen = 0;
+		uint8_t* res = extract(evt, &reslen, sanitize_strings);
+
+		//
+		// The value is copied because the check that extracted it may
+		// overwrite it, or go away, before the other checks read it.
+		// The terminator keeps string values usable as C strings.
+		//
+		ce->m_evtnum = en;
+		ce->m_len = reslen;
+		if(res != NULL)
+		{
+			ce->m_storage.assign(res, res + reslen);
+			ce->m_storage.push_back(0);
+			ce->m_res = ce->m_storage.data();
+		}
+		else
+		{
+			ce->m_res = NULL;
+		}
+	}
+
+	*len = ce->m_len;
+	return ce->m_res;
 }
 
 bool sinsp_filter_check::compare(gen_event *evt)
@@ -1412,6 +1451,119 @@ sinsp_filter::~sinsp_filter()
 {
 }
 
+void sinsp_filter::evttypes(std::vector<bool> &evttypes)
+{
+	if(m_filter == NULL)
+	{
+		evttypes.assign(PPM_EVENT_MAX + 1, true);
+		return;
+	}
+
+	expression_evttypes(m_filter, evttypes);
+}
+
+void sinsp_filter::check_evttypes(gen_event_filter_check* chk, std::vector<bool> &evttypes)
+{
+	sinsp_filter_check_shared* shared = dynamic_cast<sinsp_filter_check_shared*>(chk);
+	if(shared != NULL)
+	{
+		chk = shared->m_node->m_check;
+	}
+
+	gen_event_filter_expression* expr = dynamic_cast<gen_event_filter_expression*>(chk);
+	if(expr != NULL)
+	{
+		expression_evttypes(expr, evttypes);
+		return;
+	}
+
+	//
+	// Only evt.type = and evt.type in narrow the event types down
+	//
+	sinsp_filter_check_event* echk = dynamic_cast<sinsp_filter_check_event*>(chk);
+	if(echk == NULL ||
+		echk->m_field_id != sinsp_filter_check_event::TYPE_TYPE ||
+		(echk->m_cmpop != CO_EQ && echk->m_cmpop != CO_IN))
+	{
+		evttypes.assign(PPM_EVENT_MAX + 1, true);
+		return;
+	}
+
+	const struct ppm_event_info* etable = g_infotables.m_event_info;
+	const struct ppm_syscall_desc* stable = g_infotables.m_syscall_info_table;
+
+	evttypes.assign(PPM_EVENT_MAX + 1, false);
+
+	//
+	// The values are NUL terminated, and can be the name of an event or,
+	// for the generic events, of a syscall
+	//
+	const string& values = echk->m_filter_values;
+	for(size_t pos = 0; pos < values.size(); pos += strlen(values.c_str() + pos) + 1)
+	{
+		const char* val = values.c_str() + pos;
+
+		for(uint32_t j = 0; j < PPM_EVENT_MAX; j++)
+		{
+			if(strcmp(val, etable[j].name) == 0)
+			{
+				evttypes[j] = true;
+			}
+		}
+
+		for(uint32_t j = 0; j < PPM_SC_MAX; j++)
+		{
+			if(strcmp(val, stable[j].name) == 0)
+			{
+				evttypes[PPME_GENERIC_E] = true;
+				evttypes[PPME_GENERIC_X] = true;
+			}
+		}
+	}
+}
+
+//
+// The checks are applied left to right, like in
+// gen_event_filter_expression::compare(). A negated check can't
+// narrow the event types down.
+//
+void sinsp_filter::expression_evttypes(gen_event_filter_expression* expr, std::vector<bool> &evttypes)
+{
+	std::vector<bool> chk_evttypes;
+
+	evttypes.assign(PPM_EVENT_MAX + 1, true);
+
+	for(gen_event_filter_check* chk : expr->m_checks)
+	{
+		switch(chk->m_boolop)
+		{
+		case BO_NONE:
+			check_evttypes(chk, evttypes);
+			break;
+		case BO_NOT:
+		case BO_ORNOT:
+			evttypes.assign(PPM_EVENT_MAX + 1, true);
+			break;
+		case BO_OR:
+			check_evttypes(chk, chk_evttypes);
+			for(uint32_t j = 0; j < PPM_EVENT_MAX; j++)
+			{
+				evttypes[j] = evttypes[j] || chk_evttypes[j];
+			}
+			break;
+		case BO_AND:
+			check_evttypes(chk, chk_evttypes);
+			for(uint32_t j = 0; j < PPM_EVENT_MAX; j++)
+			{
+				evttypes[j] = evttypes[j] && chk_evttypes[j];
+			}
+			break;
+		default:
+			break;
+		}
+	}
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // sinsp_filter_compiler implementation
 ///////////////////////////////////////////////////////////////////////////////
@@ -1795,6 +1947,11 @@ void sinsp_filter_compiler::parse_check()
 
 	chk->parse_field_name((char *)&operand1[0], true, true);
 
+	if(m_inspector != NULL)
+	{
+		m_inspector->get_field_cache().attach(chk, str_operand1);
+	}
+
 	if(co == CO_IN || co == CO_INTERSECTS || co == CO_PMATCH)
 	{
 		//
@@ -2104,7 +2261,9 @@ sinsp_filter* sinsp_filter_compiler::compile_()
 	return m_filter;
 }
 
-sinsp_evttype_filter::sinsp_evttype_filter()
+sinsp_evttype_filter::sinsp_evttype_filter():
+	m_share_subexpressions(true),
+	m_generation(0)
 {
 }
 
@@ -2292,6 +2451,13 @@ void sinsp_evttype_filter::add(string &name,
 			       set<string> &tags,
 			       sinsp_filter *filter)
 {
+	if(m_share_subexpressions)
+	{
+		m_cse.add(filter);
+	}
+
+	m_generation++;
+
 	filter_wrapper *wrap = new filter_wrapper();
 	wrap->filter = filter;
 
@@ -2337,6 +2503,8 @@ void sinsp_evttype_filter::enable(const string &pattern, bool enabled, uint16_t
 		m_rulesets.push_back(new ruleset_filters());
 	}
 
+	m_generation++;
+
 	for(const auto &val : m_filters)
 	{
 		if (regex_match(val.first, re))
@@ -2360,6 +2528,8 @@ void sinsp_evttype_filter::enable_tags(const set<string> &tags, bool enabled, ui
 		m_rulesets.push_back(new ruleset_filters());
 	}
 
+	m_generation++;
+
 	for(const auto &tag : tags)
 	{
 		for(const auto &wrap : m_filter_by_tag[tag])
@@ -2396,6 +2566,34 @@ void sinsp_evttype_filter::syscalls_for_ruleset(std::vector<bool> &syscalls, uin
 	return m_rulesets[ruleset]->syscalls_for_ruleset(syscalls);
 }
 
+void sinsp_evttype_filter::evttypes_for_all_rulesets(std::vector<bool> &evttypes)
+{
+	std::vector<bool> ruleset_evttypes;
+	std::vector<bool> ruleset_syscalls;
+
+	evttypes.assign(PPM_EVENT_MAX + 1, false);
+
+	for(auto &ruleset : m_rulesets)
+	{
+		ruleset->evttypes_for_ruleset(ruleset_evttypes);
+		for(uint32_t j = 0; j < PPM_EVENT_MAX; j++)
+		{
+			evttypes[j] = evttypes[j] || ruleset_evttypes[j];
+		}
+
+		ruleset->syscalls_for_ruleset(ruleset_syscalls);
+		for(uint32_t j = 0; j < PPM_SC_MAX; j++)
+		{
+			if(ruleset_syscalls[j])
+			{
+				evttypes[PPME_GENERIC_E] = true;
+				evttypes[PPME_GENERIC_X] = true;
+				break;
+			}
+		}
+	}
+}
+
 sinsp_filter_factory::sinsp_filter_factory(sinsp *inspector)
 	: m_inspector(inspector)
 {
@@ -23,6 +23,7 @@ limitations under the License.
 #ifdef HAS_FILTERING
 
 #include "gen_filter.h"
+#include "filter_cse.h"
 
 /** @defgroup filter Filtering events
  * Filtering infrastructure.
@@ -38,7 +39,15 @@ public:
 	sinsp_filter(sinsp* inspector);
 	~sinsp_filter();
 
+	// Populate the provided vector, indexed by event type, of the
+	// event types the filter can accept, as told by its evt.type
+	// checks. Every event type is in it when that can't be told.
+	void evttypes(std::vector<bool> &evttypes);
+
 private:
+	static void check_evttypes(gen_event_filter_check* chk, std::vector<bool> &evttypes);
+	static void expression_evttypes(gen_event_filter_expression* expr, std::vector<bool> &evttypes);
+
 	sinsp* m_inspector;
 
 	friend class sinsp_evt_formatter;
@@ -153,6 +162,32 @@ public:
 	// relates to syscall code 10.
 	void syscalls_for_ruleset(std::vector<bool> &syscalls, uint16_t ruleset);
 
+	// Populate the provided vector, indexed by event type, of the
+	// event types associated with any ruleset. The generic events
+	// are in it when a ruleset relates to a syscall code.
+	void evttypes_for_all_rulesets(std::vector<bool> &evttypes);
+
+	// Incremented whenever a filter is added or a ruleset changes,
+	// to tell when the event types above need to be looked at again.
+	uint64_t get_generation() const
+	{
+		return m_generation;
+	}
+
+	// When enabled (the default), the checks of the filters passed
+	// to add() afterwards that are identical to the ones of the
+	// filters added before are shared with them, and evaluated
+	// once per event. See sinsp_filter_cse.
+	void set_share_subexpressions(bool enabled)
+	{
+		m_share_subexpressions = enabled;
+	}
+
+	const sinsp_filter_cse& get_cse() const
+	{
+		return m_cse;
+	}
+
 private:
 
 	struct filter_wrapper {
@@ -199,6 +234,10 @@ private:
 	// This holds all the filters passed to add(), so they can
 	// be cleaned up.
 	map<std::string,filter_wrapper *> m_filters;
+
+	sinsp_filter_cse m_cse;
+	bool m_share_subexpressions;
+	uint64_t m_generation;
 };
 
 /*@}*/
@@ -0,0 +1,215 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "sinsp.h"
+#include "sinsp_int.h"
+
+#ifdef HAS_FILTERING
+#include "filter.h"
+#include "filterchecks.h"
+#include "filter_cse.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_filter_check_shared implementation
+///////////////////////////////////////////////////////////////////////////////
+sinsp_filter_check_shared::sinsp_filter_check_shared(sinsp_filter_cse_node* node, boolop op)
+{
+	m_node = node;
+	m_node->m_refs++;
+	m_boolop = op;
+	m_cmpop = CO_NONE;
+}
+
+sinsp_filter_check_shared::~sinsp_filter_check_shared()
+{
+	m_node->m_cse->release(m_node);
+}
+
+bool sinsp_filter_check_shared::compare(gen_event *evt)
+{
+	sinsp_evt* sevt = (sinsp_evt *)evt;
+	uint64_t evtnum = sevt->get_num();
+	uint64_t evtts = sevt->get_ts();
+
+	if(evtnum != m_node->m_evtnum || evtts != m_node->m_evtts)
+	{
+		int32_t check_id = evt->get_check_id();
+
+		m_node->m_res = m_node->m_check->compare(evt);
+		m_node->m_evtnum = evtnum;
+		m_node->m_evtts = evtts;
+		m_node->m_check_id = (evt->get_check_id() != check_id) ? evt->get_check_id() : 0;
+	}
+	else
+	{
+		evt->set_check_id(m_node->m_check_id);
+	}
+
+	return m_node->m_res;
+}
+
+uint8_t* sinsp_filter_check_shared::extract(gen_event *evt, uint32_t* len, bool sanitize_strings)
+{
+	return m_node->m_check->extract(evt, len, sanitize_strings);
+}
+
+int32_t sinsp_filter_check_shared::get_check_id()
+{
+	return m_node->m_check->get_check_id();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_filter_cse implementation
+///////////////////////////////////////////////////////////////////////////////
+sinsp_filter_cse::sinsp_filter_cse():
+	m_next_id(0),
+	m_n_checks(0),
+	m_n_deduplicated(0)
+{
+}
+
+sinsp_filter_cse::~sinsp_filter_cse()
+{
+	//
+	// The filters own the shared checks, and must be gone by now
+	//
+	ASSERT(m_nodes.empty());
+}
+
+void sinsp_filter_cse::add(sinsp_filter* filter)
+{
+	//
+	// The root belongs to the filter
+	//
+	share_children(filter->m_filter);
+}
+
+//
+// Replaces the children of expr that can be shared with references to
+// their node. Returns true if all of them could.
+//
+bool sinsp_filter_cse::share_children(gen_event_filter_expression* expr)
+{
+	bool all_shared = true;
+
+	for(uint32_t j = 0; j < expr->m_checks.size(); j++)
+	{
+		gen_event_filter_check* chk = expr->m_checks[j];
+
+		if(dynamic_cast<sinsp_filter_check_shared*>(chk) != NULL)
+		{
+			continue;
+		}
+
+		boolop op = chk->m_boolop;
+		sinsp_filter_cse_node* node = intern(chk);
+		if(node == NULL)
+		{
+			all_shared = false;
+			continue;
+		}
+
+		expr->m_checks[j] = new sinsp_filter_check_shared(node, op);
+	}
+
+	return all_shared;
+}
+
+//
+// Returns the node of chk, NULL if chk can't be shared. Unless NULL is
+// returned, chk is either owned by the node or has been deleted.
+//
+sinsp_filter_cse_node* sinsp_filter_cse::intern(gen_event_filter_check* chk)
+{
+	string key;
+
+	m_n_checks++;
+
+	gen_event_filter_expression* expr = dynamic_cast<gen_event_filter_expression*>(chk);
+	if(expr != NULL)
+	{
+		if(!share_children(expr))
+		{
+			return NULL;
+		}
+
+		key = "e" + to_string(expr->get_check_id());
+		for(gen_event_filter_check* child : expr->m_checks)
+		{
+			key += ' ' + to_string(child->m_boolop) + ':' +
+				to_string(((sinsp_filter_check_shared*)child)->m_node->m_id);
+		}
+	}
+	else
+	{
+		sinsp_filter_check* schk = dynamic_cast<sinsp_filter_check*>(chk);
+		if(schk == NULL ||
+			schk->m_field_name.empty() ||
+			schk->m_th_state_id != sinsp_filter_check::NO_THREAD_STATE)
+		{
+			return NULL;
+		}
+
+		//
+		// A NUL can't be part of a field name
+		//
+		key = "l" + to_string(schk->m_cmpop) + ':' + to_string(schk->get_check_id()) + ':' +
+			schk->m_field_name + '\0' + schk->m_filter_values;
+	}
+
+	auto it = m_nodes.find(key);
+	if(it != m_nodes.end())
+	{
+		m_n_deduplicated++;
+		delete chk;
+		return it->second;
+	}
+
+	sinsp_filter_cse_node* node = new sinsp_filter_cse_node();
+	node->m_check = chk;
+	node->m_cse = this;
+	node->m_key = key;
+	node->m_id = m_next_id++;
+	node->m_refs = 0;
+	node->m_evtnum = UINT64_MAX;
+	node->m_evtts = 0;
+	node->m_res = false;
+	node->m_check_id = 0;
+
+	m_nodes[key] = node;
+	return node;
+}
+
+void sinsp_filter_cse::release(sinsp_filter_cse_node* node)
+{
+	ASSERT(node->m_refs > 0);
+
+	if(--node->m_refs != 0)
+	{
+		return;
+	}
+
+	m_nodes.erase(node->m_key);
+
+	//
+	// Releases the children of an expression
+	//
+	delete node->m_check;
+	delete node;
+}
+
+#endif // HAS_FILTERING
@@ -0,0 +1,151 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#ifdef HAS_FILTERING
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include "gen_filter.h"
+
+class sinsp_filter;
+class sinsp_filter_cse;
+
+//
+// A check, leaf or expression, shared by the filters of a sinsp_filter_cse,
+// and its result for the last event it evaluated
+//
+class sinsp_filter_cse_node
+{
+public:
+	gen_event_filter_check* m_check;
+	sinsp_filter_cse* m_cse;
+	std::string m_key;
+	uint32_t m_id;
+	uint32_t m_refs;
+	uint64_t m_evtnum;
+	// With the number, tells apart the events of different captures
+	uint64_t m_evtts;
+	bool m_res;
+	// The check id that the evaluation set on the event, 0 if none
+	int32_t m_check_id;
+};
+
+//
+// Takes the place of a shared check in the expression of a filter. The
+// boolean operator belongs to the position in the expression, so it's kept
+// here and not in the shared check.
+//
+class sinsp_filter_check_shared : public gen_event_filter_check
+{
+public:
+	sinsp_filter_check_shared(sinsp_filter_cse_node* node, boolop op);
+	~sinsp_filter_check_shared();
+
+	int32_t parse_field_name(const char* str, bool alloc_state, bool needed_for_filtering)
+	{
+		return 0;
+	}
+
+	void add_filter_value(const char* str, uint32_t len, uint32_t i = 0 )
+	{
+		return;
+	}
+
+	//
+	// Evaluates the shared check at most once per event
+	//
+	bool compare(gen_event *evt);
+
+	uint8_t* extract(gen_event *evt, uint32_t* len, bool sanitize_strings = true);
+
+	int32_t get_check_id();
+
+	sinsp_filter_cse_node* m_node;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// Common subexpression elimination for a set of filters.
+//
+// Rules files expand the same macros and lists (spawned_process, container,
+// proc.name in (shell_binaries), ...) in hundreds of rules, each one
+// compiled to its own tree of checks with its own copy of the values.
+// add() hash-conses the checks of a filter against the ones of the filters
+// added before: every leaf and expression identical to one already seen is
+// freed and replaced with a reference to the shared one, so the filters
+// end up as a DAG. A shared check is evaluated once per event, whatever the
+// number of filters that use it.
+//
+// Two leaves are identical when they have the same field, operator, values
+// and check id. Two expressions are identical when their children are the
+// same shared checks with the same operators. Leaves with per-thread state
+// (e.g. evt.latency) and the checks that weren't created from a field name
+// are never shared, nor are the expressions that contain them.
+//
+// The shared checks are refcounted and freed with the last filter that
+// uses them.
+///////////////////////////////////////////////////////////////////////////////
+class sinsp_filter_cse
+{
+public:
+	sinsp_filter_cse();
+	~sinsp_filter_cse();
+
+	void add(sinsp_filter* filter);
+
+	//
+	// Checks, leaves and expressions, passed to add()
+	//
+	uint64_t get_n_checks() const
+	{
+		return m_n_checks;
+	}
+
+	//
+	// Checks passed to add() that were identical to a shared one, and
+	// have been freed
+	//
+	uint64_t get_n_deduplicated() const
+	{
+		return m_n_deduplicated;
+	}
+
+	//
+	// Distinct shared checks
+	//
+	size_t get_n_nodes() const
+	{
+		return m_nodes.size();
+	}
+
+private:
+	bool share_children(gen_event_filter_expression* expr);
+	sinsp_filter_cse_node* intern(gen_event_filter_check* chk);
+	void release(sinsp_filter_cse_node* node);
+
+	std::unordered_map<std::string, sinsp_filter_cse_node*> m_nodes;
+	uint32_t m_next_id;
+	uint64_t m_n_checks;
+	uint64_t m_n_deduplicated;
+
+	friend class sinsp_filter_check_shared;
+};
+
+#endif // HAS_FILTERING
@@ -23,6 +23,7 @@ limitations under the License.
 #include "sinsp.h"
 #include "sinsp_int.h"
 #include "dns_manager.h"
+#include "dns_decoder.h"
 
 #ifdef HAS_FILTERING
 #include "filter.h"
@@ -135,12 +136,23 @@ const filtercheck_field_info sinsp_filter_check_fd_fields[] =
 	{PT_INT32, EPF_NONE, PF_HEX, "fd.dev", "device number (major/minor) containing the referenced file"},
 	{PT_INT32, EPF_NONE, PF_DEC, "fd.dev.major", "major device number containing the referenced file"},
 	{PT_INT32, EPF_NONE, PF_DEC, "fd.dev.minor", "minor device number containing the referenced file"},
+	{PT_UINT32, EPF_NONE, PF_DEC, "fd.tcp.srtt", "for TCP connections, the last smoothed round trip time reported by the kernel, in microseconds."},
+	{PT_UINT32, EPF_NONE, PF_DEC, "fd.tcp.rtt.p50", "for TCP connections, the median of the smoothed round trip times since the last connection index snapshot, in microseconds."},
+	{PT_UINT32, EPF_NONE, PF_DEC, "fd.tcp.rtt.p90", "for TCP connections, the 90th percentile of the smoothed round trip times since the last connection index snapshot, in microseconds."},
+	{PT_UINT32, EPF_NONE, PF_DEC, "fd.tcp.rtt.p99", "for TCP connections, the 99th percentile of the smoothed round trip times since the last connection index snapshot, in microseconds."},
+	{PT_UINT64, EPF_NONE, PF_DEC, "fd.tcp.retransmits", "for TCP connections, the number of retransmitted segments since the last connection index snapshot."},
+	{PT_UINT64, EPF_NONE, PF_DEC, "fd.tcp.drops", "for TCP connections, the number of packets dropped by the kernel since the last connection index snapshot."},
+	{PT_RELTIME, EPF_NONE, PF_DEC, "fd.ingress.latency.p50", "for TCP connections with the skb capture enabled, the median time between the reception by the network device of the newest packet a read returns and the read, since the last connection index snapshot, in nanoseconds."},
+	{PT_RELTIME, EPF_NONE, PF_DEC, "fd.ingress.latency.p99", "for TCP connections with the skb capture enabled, the 99th percentile of the time between the reception by the network device of the newest packet a read returns and the read, since the last connection index snapshot, in nanoseconds."},
+	{PT_RELTIME, EPF_NONE, PF_DEC, "fd.egress.latency.p50", "for TCP connections with the skb capture enabled, the median time between a write and the transmission of its data by the network device, since the last connection index snapshot, in nanoseconds."},
+	{PT_RELTIME, EPF_NONE, PF_DEC, "fd.egress.latency.p99", "for TCP connections with the skb capture enabled, the 99th percentile of the time between a write and the transmission of its data by the network device, since the last connection index snapshot, in nanoseconds."},
 };
 
 sinsp_filter_check_fd::sinsp_filter_check_fd()
 {
 	m_tinfo = NULL;
 	m_fdinfo = NULL;
+	m_dns_decoder = NULL;
 
 	m_info.m_name = "fd";
 	m_info.m_fields = sinsp_filter_check_fd_fields;
@@ -153,6 +165,33 @@ sinsp_filter_check* sinsp_filter_check_fd::allocate_new()
 	return (sinsp_filter_check*) new sinsp_filter_check_fd();
 }
 
+sinsp_decoder_dns* sinsp_filter_check_fd::get_dns_decoder()
+{
+	if(m_dns_decoder == NULL)
+	{
+		m_dns_decoder = (sinsp_decoder_dns*)m_inspector->require_protodecoder("dns");
+	}
+
+	return m_dns_decoder;
+}
+
+string sinsp_filter_check_fd::ip_to_name(int af, void *addr, uint64_t ts)
+{
+	string name = get_dns_decoder()->name_of(af, addr, ts);
+	if(name.empty())
+	{
+		name = sinsp_dns_manager::get().name_of(af, addr, ts);
+	}
+
+	return name;
+}
+
+bool sinsp_filter_check_fd::ip_name_match(const char *name, int af, void *addr, uint64_t ts)
+{
+	return get_dns_decoder()->match(name, af, addr, ts) ||
+		sinsp_dns_manager::get().match(name, af, addr, ts);
+}
+
 bool sinsp_filter_check_fd::extract_fdname_from_creator(sinsp_evt *evt, OUT uint32_t* len, bool sanitize_strings)
 {
 	const char* resolved_argstr;
@@ -282,7 +321,8 @@ uint8_t* sinsp_filter_check_fd::extract_from_null_fd(sinsp_evt *evt, OUT uint32_
 	{
 		if(extract_fdname_from_creator(evt, len, sanitize_strings) == true)
 		{
-			m_tstr = m_tinfo->m_container_id + ':' + m_tstr;
+			m_tstr.insert(0, 1, ':');
+			m_tstr.insert(0, m_tinfo->m_container_id);
 			RETURN_EXTRACT_STRING(m_tstr);
 		}
 		else
@@ -315,7 +355,8 @@ uint8_t* sinsp_filter_check_fd::extract_from_null_fd(sinsp_evt *evt, OUT uint32_
 
 			if(m_field_id == TYPE_CONTAINERDIRECTORY)
 			{
-				m_tstr = m_tinfo->m_container_id + ':' + m_tstr;
+				m_tstr.insert(0, 1, ':');
+				m_tstr.insert(0, m_tinfo->m_container_id);
 			}
 
 			RETURN_EXTRACT_STRING(m_tstr);
@@ -426,7 +467,7 @@ uint8_t* sinsp_filter_check_fd::extract(sinsp_evt *evt, OUT uint32_t* len, bool
 	//
 	if(m_field_id == TYPE_FDNUM)
 	{
-		RETURN_EXTRACT_VAR(m_tinfo->m_lastevent_fd);
+		RETURN_EXTRACT_VAR(m_fdnum);
 	}
 
 	switch(m_field_id)
@@ -455,7 +496,9 @@ uint8_t* sinsp_filter_check_fd::extract(sinsp_evt *evt, OUT uint32_t* len, bool
 		if(m_field_id == TYPE_CONTAINERNAME)
 		{
 			ASSERT(m_tinfo != NULL);
-			m_tstr = m_tinfo->m_container_id + ':' + m_fdinfo->m_name;
+			m_tstr = m_tinfo->m_container_id;
+			m_tstr += ':';
+			m_tstr += m_fdinfo->m_name;
 		}
 		else
 		{
@@ -515,7 +558,8 @@ uint8_t* sinsp_filter_check_fd::extract(sinsp_evt *evt, OUT uint32_t* len, bool
 
 			if(m_field_id == TYPE_CONTAINERDIRECTORY)
 			{
-				m_tstr = m_tinfo->m_container_id + ':' + m_tstr;
+				m_tstr.insert(0, 1, ':');
+				m_tstr.insert(0, m_tinfo->m_container_id);
 			}
 
 			RETURN_EXTRACT_STRING(m_tstr);
@@ -604,11 +648,11 @@ uint8_t* sinsp_filter_check_fd::extract(sinsp_evt *evt, OUT uint32_t* len, bool
 			scap_fd_type evt_type = m_fdinfo->m_type;
 			if(evt_type == SCAP_FD_IPV4_SOCK)
 			{
-				m_tstr = sinsp_dns_manager::get().name_of(AF_INET, &m_fdinfo->m_sockinfo.m_ipv4info.m_fields.m_sip, evt->get_ts());
+				m_tstr = ip_to_name(AF_INET, &m_fdinfo->m_sockinfo.m_ipv4info.m_fields.m_sip, evt->get_ts());
 			}
 			else if (evt_type == SCAP_FD_IPV6_SOCK)
 			{
-				m_tstr = sinsp_dns_manager::get().name_of(AF_INET6, &m_fdinfo->m_sockinfo.m_ipv6info.m_fields.m_sip.m_b[0], evt->get_ts());
+				m_tstr = ip_to_name(AF_INET6, &m_fdinfo->m_sockinfo.m_ipv6info.m_fields.m_sip.m_b[0], evt->get_ts());
 			}
 
 			if(!m_tstr.empty())
@@ -667,19 +711,19 @@ uint8_t* sinsp_filter_check_fd::extract(sinsp_evt *evt, OUT uint32_t* len, bool
 			scap_fd_type evt_type = m_fdinfo->m_type;
 			if(evt_type == SCAP_FD_IPV4_SOCK)
 			{
-				m_tstr = sinsp_dns_manager::get().name_of(AF_INET, &m_fdinfo->m_sockinfo.m_ipv4info.m_fields.m_dip, evt->get_ts());
+				m_tstr = ip_to_name(AF_INET, &m_fdinfo->m_sockinfo.m_ipv4info.m_fields.m_dip, evt->get_ts());
 			}
 			else if(evt_type == SCAP_FD_IPV4_SERVSOCK)
 			{
-				m_tstr = sinsp_dns_manager::get().name_of(AF_INET, &m_fdinfo->m_sockinfo.m_ipv4serverinfo.m_ip, evt->get_ts());
+				m_tstr = ip_to_name(AF_INET, &m_fdinfo->m_sockinfo.m_ipv4serverinfo.m_ip, evt->get_ts());
 			}
 			else if (evt_type == SCAP_FD_IPV6_SOCK)
 			{
-				m_tstr = sinsp_dns_manager::get().name_of(AF_INET6, &m_fdinfo->m_sockinfo.m_ipv6info.m_fields.m_dip.m_b[0], evt->get_ts());
+				m_tstr = ip_to_name(AF_INET6, &m_fdinfo->m_sockinfo.m_ipv6info.m_fields.m_dip.m_b[0], evt->get_ts());
 			}
 			else if(evt_type == SCAP_FD_IPV6_SERVSOCK)
 			{
-				m_tstr = sinsp_dns_manager::get().name_of(AF_INET6, &m_fdinfo->m_sockinfo.m_ipv6serverinfo.m_ip.m_b[0], evt->get_ts());
+				m_tstr = ip_to_name(AF_INET6, &m_fdinfo->m_sockinfo.m_ipv6serverinfo.m_ip.m_b[0], evt->get_ts());
 			}
 
 			if(!m_tstr.empty())
@@ -786,22 +830,22 @@ uint8_t* sinsp_filter_check_fd::extract(sinsp_evt *evt, OUT uint32_t* len, bool
 					{
 						if(evt_type == SCAP_FD_IPV4_SOCK)
 						{
-							m_tstr = sinsp_dns_manager::get().name_of(AF_INET, &m_fdinfo->m_sockinfo.m_ipv4info.m_fields.m_sip, evt->get_ts());
+							m_tstr = ip_to_name(AF_INET, &m_fdinfo->m_sockinfo.m_ipv4info.m_fields.m_sip, evt->get_ts());
 						}
 						else
 						{
-							m_tstr = sinsp_dns_manager::get().name_of(AF_INET6, &m_fdinfo->m_sockinfo.m_ipv6info.m_fields.m_sip.m_b[0], evt->get_ts());
+							m_tstr = ip_to_name(AF_INET6, &m_fdinfo->m_sockinfo.m_ipv6info.m_fields.m_sip.m_b[0], evt->get_ts());
 						}
 					}
 					else
 					{
 						if(evt_type == SCAP_FD_IPV4_SOCK)
 						{
-							m_tstr = sinsp_dns_manager::get().name_of(AF_INET, &m_fdinfo->m_sockinfo.m_ipv4info.m_fields.m_dip, evt->get_ts());
+							m_tstr = ip_to_name(AF_INET, &m_fdinfo->m_sockinfo.m_ipv4info.m_fields.m_dip, evt->get_ts());
 						}
 						else
 						{
-							m_tstr = sinsp_dns_manager::get().name_of(AF_INET6, &m_fdinfo->m_sockinfo.m_ipv6info.m_fields.m_dip.m_b[0], evt->get_ts());
+							m_tstr = ip_to_name(AF_INET6, &m_fdinfo->m_sockinfo.m_ipv6info.m_fields.m_dip.m_b[0], evt->get_ts());
 						}
 					}
 				}
@@ -811,22 +855,22 @@ uint8_t* sinsp_filter_check_fd::extract(sinsp_evt *evt, OUT uint32_t* len, bool
 					{
 						if(evt_type == SCAP_FD_IPV4_SOCK)
 						{
-							m_tstr = sinsp_dns_manager::get().name_of(AF_INET, &m_fdinfo->m_sockinfo.m_ipv4info.m_fields.m_dip, evt->get_ts());
+							m_tstr = ip_to_name(AF_INET, &m_fdinfo->m_sockinfo.m_ipv4info.m_fields.m_dip, evt->get_ts());
 						}
 						else
 						{
-							m_tstr = sinsp_dns_manager::get().name_of(AF_INET6, &m_fdinfo->m_sockinfo.m_ipv6info.m_fields.m_dip.m_b[0], evt->get_ts());
+							m_tstr = ip_to_name(AF_INET6, &m_fdinfo->m_sockinfo.m_ipv6info.m_fields.m_dip.m_b[0], evt->get_ts());
 						}
 					}
 					else
 					{
 						if(evt_type == SCAP_FD_IPV4_SOCK)
 						{
-							m_tstr = sinsp_dns_manager::get().name_of(AF_INET, &m_fdinfo->m_sockinfo.m_ipv4info.m_fields.m_sip, evt->get_ts());
+							m_tstr = ip_to_name(AF_INET, &m_fdinfo->m_sockinfo.m_ipv4info.m_fields.m_sip, evt->get_ts());
 						}
 						else
 						{
-							m_tstr = sinsp_dns_manager::get().name_of(AF_INET6, &m_fdinfo->m_sockinfo.m_ipv6info.m_fields.m_sip.m_b[0], evt->get_ts());
+							m_tstr = ip_to_name(AF_INET6, &m_fdinfo->m_sockinfo.m_ipv6info.m_fields.m_sip.m_b[0], evt->get_ts());
 						}
 					}
 				}
@@ -1244,7 +1288,7 @@ uint8_t* sinsp_filter_check_fd::extract(sinsp_evt *evt, OUT uint32_t* len, bool
 			}
 			ASSERT(m_tinfo != NULL);
 
-			m_tstr = to_string(m_tinfo->m_tid) + to_string(m_tinfo->m_lastevent_fd);
+			m_tstr = to_string(m_tinfo->m_tid) + to_string(m_fdnum);
 			RETURN_EXTRACT_STRING(m_tstr);
 		}
 		break;
@@ -1308,6 +1352,81 @@ uint8_t* sinsp_filter_check_fd::extract(sinsp_evt *evt, OUT uint32_t* len, bool
 			RETURN_EXTRACT_VAR(m_tbool);
 		}
 		break;
+	case TYPE_TCP_SRTT:
+	case TYPE_TCP_RTT_P50:
+	case TYPE_TCP_RTT_P90:
+	case TYPE_TCP_RTT_P99:
+	case TYPE_TCP_RETRANSMITS:
+	case TYPE_TCP_DROPS:
+		{
+			if(m_fdinfo == NULL)
+			{
+				return NULL;
+			}
+
+			const sinsp_conn* conn = m_inspector->get_conn_index().find(m_fdinfo);
+			if(conn == NULL)
+			{
+				return NULL;
+			}
+
+			const sinsp_tcp_stats& stats = conn->m_stats;
+			switch(m_field_id)
+			{
+			case TYPE_TCP_SRTT:
+				if(stats.m_rtt.m_count == 0)
+				{
+					return NULL;
+				}
+				m_tbool = stats.m_last_srtt_us;
+				RETURN_EXTRACT_VAR(m_tbool);
+			case TYPE_TCP_RTT_P50:
+			case TYPE_TCP_RTT_P90:
+			case TYPE_TCP_RTT_P99:
+				if(stats.m_rtt.m_count == 0)
+				{
+					return NULL;
+				}
+				m_tbool = (uint32_t)stats.m_rtt.get_percentile(m_field_id == TYPE_TCP_RTT_P50 ? 50 :
+					(m_field_id == TYPE_TCP_RTT_P90 ? 90 : 99));
+				RETURN_EXTRACT_VAR(m_tbool);
+			case TYPE_TCP_RETRANSMITS:
+				m_u64val = stats.m_n_retransmits;
+				RETURN_EXTRACT_VAR(m_u64val);
+			default:
+				m_u64val = stats.m_n_drops;
+				RETURN_EXTRACT_VAR(m_u64val);
+			}
+		}
+		break;
+	case TYPE_INGRESS_LATENCY_P50:
+	case TYPE_INGRESS_LATENCY_P99:
+	case TYPE_EGRESS_LATENCY_P50:
+	case TYPE_EGRESS_LATENCY_P99:
+		{
+			if(m_fdinfo == NULL)
+			{
+				return NULL;
+			}
+
+			const sinsp_conn* conn = m_inspector->get_conn_index().find(m_fdinfo);
+			if(conn == NULL)
+			{
+				return NULL;
+			}
+
+			const sinsp_log2_histogram& hist =
+				(m_field_id == TYPE_INGRESS_LATENCY_P50 || m_field_id == TYPE_INGRESS_LATENCY_P99) ?
+				conn->m_skb_latency.m_ingress : conn->m_skb_latency.m_egress;
+			if(hist.m_count == 0)
+			{
+				return NULL;
+			}
+
+			m_u64val = hist.get_percentile((m_field_id == TYPE_INGRESS_LATENCY_P50 || m_field_id == TYPE_EGRESS_LATENCY_P50) ? 50 : 99);
+			RETURN_EXTRACT_VAR(m_u64val);
+		}
+		break;
 	default:
 		ASSERT(false);
 	}
@@ -1694,7 +1813,7 @@ bool sinsp_filter_check_fd::compare_domain(sinsp_evt *evt)
 		{
 			for (uint16_t i=0; i < m_val_storages.size(); i++)
 			{
-				if(sinsp_dns_manager::get().match((const char *)filter_value_p(i), (evt_type == SCAP_FD_IPV6_SOCK)? AF_INET6 : AF_INET, addr, ts))
+				if(ip_name_match((const char *)filter_value_p(i), (evt_type == SCAP_FD_IPV6_SOCK)? AF_INET6 : AF_INET, addr, ts))
 				{
 					return true;
 				}
@@ -1704,11 +1823,11 @@ bool sinsp_filter_check_fd::compare_domain(sinsp_evt *evt)
 		}
 		else if(m_cmpop == CO_EQ)
 		{
-			return sinsp_dns_manager::get().match((const char *)filter_value_p(), (evt_type == SCAP_FD_IPV6_SOCK)? AF_INET6 : AF_INET, addr, ts);
+			return ip_name_match((const char *)filter_value_p(), (evt_type == SCAP_FD_IPV6_SOCK)? AF_INET6 : AF_INET, addr, ts);
 		}
 		else if(m_cmpop == CO_NE)
 		{
-			return !sinsp_dns_manager::get().match((const char *)filter_value_p(), (evt_type == SCAP_FD_IPV6_SOCK)? AF_INET6 : AF_INET, addr, ts);
+			return !ip_name_match((const char *)filter_value_p(), (evt_type == SCAP_FD_IPV6_SOCK)? AF_INET6 : AF_INET, addr, ts);
 		}
 		else
 		{
@@ -1737,6 +1856,7 @@ bool sinsp_filter_check_fd::extract_fd(sinsp_evt *evt)
 		}
 
 		m_fdinfo = evt->get_fd_info();
+		m_fdnum = m_tinfo->m_lastevent_fd;
 
 		if(m_fdinfo == NULL && m_tinfo->m_lastevent_fd != -1)
 		{
@@ -1745,6 +1865,20 @@ bool sinsp_filter_check_fd::extract_fd(sinsp_evt *evt)
 
 		// We'll check if fd is null below
 	}
+	else if((eflags & EF_NONE_PARSE) && evt->get_fd_info() != NULL)
+	{
+		//
+		// The tcp_* kprobes, resolved to their connection by the parser
+		//
+		m_tinfo = evt->get_thread_info();
+		if(m_tinfo == NULL)
+		{
+			return false;
+		}
+
+		m_fdinfo = evt->get_fd_info();
+		m_fdnum = evt->get_fd_num();
+	}
 	else
 	{
 		return false;
@@ -2005,7 +2139,17 @@ int32_t sinsp_filter_check_thread::parse_field_name(const char* str, bool alloc_
 	}
 	else
 	{
-		return sinsp_filter_check::parse_field_name(str, alloc_state, needed_for_filtering);
+		int32_t res = sinsp_filter_check::parse_field_name(str, alloc_state, needed_for_filtering);
+
+		//
+		// extract_exectime() keeps the last switch of each CPU
+		//
+		if(res != -1 && m_field_id == TYPE_EXECTIME)
+		{
+			m_has_instance_state = true;
+		}
+
+		return res;
 	}
 }
 
@@ -2124,8 +2268,7 @@ uint8_t* sinsp_filter_check_thread::extract(sinsp_evt *evt, OUT uint32_t* len, b
 
 			if(sinfo != NULL)
 			{
-				m_tstr = sinfo->get_comm();
-				RETURN_EXTRACT_STRING(m_tstr);
+				RETURN_EXTRACT_STRING(sinfo->get_comm());
 			}
 			else
 			{
@@ -2154,84 +2297,31 @@ uint8_t* sinsp_filter_check_thread::extract(sinsp_evt *evt, OUT uint32_t* len, b
 
 				// mt has been updated to the highest process that has the same session id.
 				// mt's comm is considered the session leader.
-				m_tstr = mt->get_comm();
-				RETURN_EXTRACT_STRING(m_tstr);
+				RETURN_EXTRACT_STRING(mt->get_comm());
 			}
 		}
 	case TYPE_TTY:
 		RETURN_EXTRACT_VAR(tinfo->m_tty);
+	//
+	// The strings are returned where the thread keeps them, the joined
+	// ones are built once per exec
+	//
 	case TYPE_NAME:
-		m_tstr = tinfo->get_comm();
-		RETURN_EXTRACT_STRING(m_tstr);
+		RETURN_EXTRACT_STRING(tinfo->get_comm());
 	case TYPE_EXE:
-		m_tstr = tinfo->get_exe();
-		RETURN_EXTRACT_STRING(m_tstr);
+		RETURN_EXTRACT_STRING(tinfo->get_exe());
 	case TYPE_EXEPATH:
-		m_tstr = tinfo->get_exepath();
-		RETURN_EXTRACT_STRING(m_tstr);
+		RETURN_EXTRACT_STRING(tinfo->get_exepath());
 	case TYPE_ARGS:
-		{
-			m_tstr.clear();
-
-			uint32_t j;
-			uint32_t nargs = (uint32_t)tinfo->m_args.size();
-
-			for(j = 0; j < nargs; j++)
-			{
-				m_tstr += tinfo->m_args[j];
-				if(j < nargs -1)
-				{
-					m_tstr += ' ';
-				}
-			}
-
-			RETURN_EXTRACT_STRING(m_tstr);
-		}
+		RETURN_EXTRACT_STRING(tinfo->get_args_str());
 	case TYPE_ENV:
-		{
-			m_tstr.clear();
-
-			uint32_t j;
-			const auto& env = tinfo->get_env();
-			uint32_t nargs = (uint32_t)env.size();
-
-			for(j = 0; j < nargs; j++)
-			{
-				m_tstr += env[j];
-				if(j < nargs -1)
-				{
-					m_tstr += ' ';
-				}
-			}
-
-			RETURN_EXTRACT_STRING(m_tstr);
-		}
+		RETURN_EXTRACT_STRING(tinfo->get_env_str());
 	case TYPE_CMDLINE:
-		{
-			sinsp_threadinfo::populate_cmdline(m_tstr, tinfo);
-			RETURN_EXTRACT_STRING(m_tstr);
-		}
+		RETURN_EXTRACT_STRING(tinfo->get_cmdline());
 	case TYPE_EXELINE:
-		{
-			m_tstr = tinfo->get_exe() + " ";
-
-			uint32_t j;
-			uint32_t nargs = (uint32_t)tinfo->m_args.size();
-
-			for(j = 0; j < nargs; j++)
-			{
-				m_tstr += tinfo->m_args[j];
-				if(j < nargs -1)
-				{
-					m_tstr += ' ';
-				}
-			}
-
-			RETURN_EXTRACT_STRING(m_tstr);
-		}
+		RETURN_EXTRACT_STRING(tinfo->get_exeline());
 	case TYPE_CWD:
-		m_tstr = tinfo->get_cwd();
-		RETURN_EXTRACT_STRING(m_tstr);
+		RETURN_EXTRACT_STRING(tinfo->get_cwd());
 	case TYPE_NTHREADS:
 		{
 			sinsp_threadinfo* ptinfo = tinfo->get_main_thread();
@@ -2311,8 +2401,7 @@ uint8_t* sinsp_filter_check_thread::extract(sinsp_evt *evt, OUT uint32_t* len, b
 
 			if(ptinfo != NULL)
 			{
-				m_tstr = ptinfo->get_comm();
-				RETURN_EXTRACT_STRING(m_tstr);
+				RETURN_EXTRACT_STRING(ptinfo->get_comm());
 			}
 			else
 			{
@@ -2326,8 +2415,7 @@ uint8_t* sinsp_filter_check_thread::extract(sinsp_evt *evt, OUT uint32_t* len, b
 
 			if(ptinfo != NULL)
 			{
-				sinsp_threadinfo::populate_cmdline(m_tstr, ptinfo);
-				RETURN_EXTRACT_STRING(m_tstr);
+				RETURN_EXTRACT_STRING(ptinfo->get_cmdline());
 			}
 			else
 			{
@@ -2355,14 +2443,16 @@ uint8_t* sinsp_filter_check_thread::extract(sinsp_evt *evt, OUT uint32_t* len, b
 			//
 			// Search for a specific ancestors
 			//
-			for(int32_t j = 0; j < m_argid; j++)
+			if(m_argid > 0)
 			{
-				mt = mt->get_parent_thread();
+				const vector<sinsp_threadinfo*>& ancestors = mt->get_ancestors();
 
-				if(mt == NULL)
+				if((size_t)m_argid > ancestors.size())
 				{
 					return NULL;
 				}
+
+				mt = ancestors[m_argid - 1];
 			}
 
 			RETURN_EXTRACT_VAR(mt->m_pid);
@@ -2385,18 +2475,19 @@ uint8_t* sinsp_filter_check_thread::extract(sinsp_evt *evt, OUT uint32_t* len, b
 				}
 			}
 
-			for(int32_t j = 0; j < m_argid; j++)
+			if(m_argid > 0)
 			{
-				mt = mt->get_parent_thread();
+				const vector<sinsp_threadinfo*>& ancestors = mt->get_ancestors();
 
-				if(mt == NULL)
+				if((size_t)m_argid > ancestors.size())
 				{
 					return NULL;
 				}
+
+				mt = ancestors[m_argid - 1];
 			}
 
-			m_tstr = mt->get_comm();
-			RETURN_EXTRACT_STRING(m_tstr);
+			RETURN_EXTRACT_STRING(mt->get_comm());
 		}
 	case TYPE_LOGINSHELLID:
 		{
@@ -2685,29 +2776,15 @@ bool sinsp_filter_check_thread::compare_full_apid(sinsp_evt *evt)
 	//
 	// No id specified, search in all of the ancestors
 	//
-	bool found = false;
-	sinsp_threadinfo::visitor_func_t visitor = [this, &found] (sinsp_threadinfo *pt)
+	for(sinsp_threadinfo* pt : mt->get_ancestors())
 	{
-		bool res;
-
-		res = flt_compare(m_cmpop,
-				  PT_PID,
-				  &pt->m_pid);
-
-		if(res == true)
+		if(flt_compare(m_cmpop, PT_PID, &pt->m_pid))
 		{
-			found = true;
-
-			// Can stop traversing parent state
-			return false;
+			return true;
 		}
+	}
 
-		return true;
-	};
-
-	mt->traverse_parent_state(visitor);
-
-	return found;
+	return false;
 }
 
 bool sinsp_filter_check_thread::compare_full_aname(sinsp_evt *evt)
@@ -2738,29 +2815,15 @@ bool sinsp_filter_check_thread::compare_full_aname(sinsp_evt *evt)
 	//
 	// No id specified, search in all of the ancestors
 	//
-	bool found = false;
-	sinsp_threadinfo::visitor_func_t visitor = [this, &found] (sinsp_threadinfo *pt)
+	for(sinsp_threadinfo* pt : mt->get_ancestors())
 	{
-		bool res;
-
-		res = flt_compare(m_cmpop,
-				  PT_CHARBUF,
-				  (void*)pt->m_comm.c_str());
-
-		if(res == true)
+		if(flt_compare(m_cmpop, PT_CHARBUF, (void*)pt->m_comm.c_str()))
 		{
-			found = true;
-
-			// Can stop traversing parent state
-			return false;
+			return true;
 		}
+	}
 
-		return true;
-	};
-
-	mt->traverse_parent_state(visitor);
-
-	return found;
+	return false;
 }
 
 bool sinsp_filter_check_thread::compare(sinsp_evt *evt)
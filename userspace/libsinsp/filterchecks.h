@@ -20,6 +20,7 @@ limitations under the License.
 #include <json/json.h>
 #include "filter_value.h"
 #include "prefix_search.h"
+#include "field_cache.h"
 #if !defined(CYGWING_AGENT) && !defined(MINIMAL_BUILD)
 #include "k8s.h"
 #include "mesos.h"
@@ -29,6 +30,7 @@ limitations under the License.
 #include "gen_filter.h"
 
 class sinsp_filter_check_reference;
+class sinsp_decoder_dns;
 
 bool flt_compare(cmpop op, ppm_param_type type, void* operand1, void* operand2, uint32_t op1_len = 0, uint32_t op2_len = 0);
 bool flt_compare_avg(cmpop op, ppm_param_type type, void* operand1, void* operand2, uint32_t op1_len, uint32_t op2_len, uint32_t cnt1, uint32_t cnt2);
@@ -47,13 +49,6 @@ public:
 	string m_description;
 };
 
-class check_extraction_cache_entry
-{
-public:
-	uint64_t m_evtnum = UINT64_MAX;
-	uint8_t* m_res;
-};
-
 class check_eval_cache_entry
 {
 public:
@@ -70,6 +65,11 @@ public:
 class sinsp_filter_check : public gen_event_filter_check
 {
 public:
+	//
+	// m_th_state_id of the checks that didn't reserve thread memory
+	//
+	static const uint32_t NO_THREAD_STATE = UINT32_MAX;
+
 	sinsp_filter_check();
 
 	virtual ~sinsp_filter_check()
@@ -123,7 +123,8 @@ public:
 
 	//
 	// Wrapper for extract() that implements caching to speed up multiple extractions of the same value,
-	// which are common in Falco.
+	// which are common in Falco. The cache entries are either set by the caller or by the
+	// sinsp_field_cache of the inspector, and are shared by the checks with the same field.
 	//
 	uint8_t* extract_cached(sinsp_evt *evt, OUT uint32_t* len, bool sanitize_strings = true);
 
@@ -155,10 +156,20 @@ public:
 
 	sinsp* m_inspector;
 	bool m_needs_state_tracking = false;
+	//
+	// Set by the checks whose value depends on the events they extracted
+	// before, kept in the check instead of the thread memory (e.g.
+	// thread.exectime). The field cache doesn't share their values.
+	//
+	bool m_has_instance_state = false;
 	sinsp_field_aggregation m_aggregation;
 	sinsp_field_aggregation m_merge_aggregation;
 	check_eval_cache_entry* m_eval_cache_entry = NULL;
 	check_extraction_cache_entry* m_extraction_cache_entry = NULL;
+	//
+	// Used by extract_cached() when sanitize_strings is true
+	//
+	check_extraction_cache_entry* m_sanitized_extraction_cache_entry = NULL;
 
 protected:
 	bool flt_compare(cmpop op, ppm_param_type type, void* operand1, uint32_t op1_len = 0, uint32_t op2_len = 0);
@@ -190,12 +201,23 @@ protected:
 	uint32_t m_th_state_id;
 	uint32_t m_val_storage_len;
 
+	//
+	// The text of the field, argument included, and of the values added
+	// with add_filter_value(), each one followed by a NUL. Used to recognize
+	// identical checks, see sinsp_filter_cse.
+	//
+	string m_field_name;
+	string m_filter_values;
+
 private:
 	void set_inspector(sinsp* inspector);
 
 friend class sinsp_filter_check_list;
 friend class sinsp_filter_optimizer;
 friend class chk_compare_helper;
+friend class sinsp_field_cache;
+friend class sinsp_filter_cse;
+friend class sinsp_filter;
 };
 
 //
@@ -269,6 +291,16 @@ public:
 		TYPE_DEV = 38,
 		TYPE_DEV_MAJOR = 39,
 		TYPE_DEV_MINOR = 40,
+		TYPE_TCP_SRTT = 41,
+		TYPE_TCP_RTT_P50 = 42,
+		TYPE_TCP_RTT_P90 = 43,
+		TYPE_TCP_RTT_P99 = 44,
+		TYPE_TCP_RETRANSMITS = 45,
+		TYPE_TCP_DROPS = 46,
+		TYPE_INGRESS_LATENCY_P50 = 47,
+		TYPE_INGRESS_LATENCY_P99 = 48,
+		TYPE_EGRESS_LATENCY_P50 = 49,
+		TYPE_EGRESS_LATENCY_P99 = 50,
 	};
 
 	enum fd_type
@@ -302,11 +334,21 @@ public:
 	string m_tstr;
 	uint8_t m_tcstr[2];
 	uint32_t m_tbool;
+	uint64_t m_u64val;
+	int64_t m_fdnum;
 
 private:
 	uint8_t* extract_from_null_fd(sinsp_evt *evt, OUT uint32_t* len, bool sanitize_strings);
 	bool extract_fdname_from_creator(sinsp_evt *evt, OUT uint32_t* len, bool sanitize_strings);
 	bool extract_fd(sinsp_evt *evt);
+
+	// Name resolution for the fd.*ip.name fields: what the passive DNS
+	// decoder learned first, then the active resolver
+	sinsp_decoder_dns* get_dns_decoder();
+	string ip_to_name(int af, void *addr, uint64_t ts);
+	bool ip_name_match(const char *name, int af, void *addr, uint64_t ts);
+
+	sinsp_decoder_dns* m_dns_decoder;
 };
 
 //
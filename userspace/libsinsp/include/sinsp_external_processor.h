@@ -1,5 +1,7 @@
 #pragma once
 
+#include <vector>
+
 /**
  * This api defines a relationship between libsinsp and an external event processor.
  * Such external processors should derive from event_processor and register themselves with
@@ -51,6 +53,13 @@ public:
 	 * before the sinsp object is init-ed
 	 */
 	virtual sinsp_threadinfo* build_threadinfo(sinsp* inspector);
+
+	/**
+	 * Populate the provided vector, indexed by event type, with the event
+	 * types the processor needs to see. Used for the automatic event mask,
+	 * see sinsp::set_auto_eventmask(). By default, all of them.
+	 */
+	virtual void get_evttypes(std::vector<bool>& evttypes);
 };
 
 }  // namespace libsinsp
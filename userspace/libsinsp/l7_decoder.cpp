@@ -0,0 +1,815 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <cctype>
+#include <cstdio>
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "http_parser.h"
+#include "l7_decoder.h"
+
+#define L7_DNS_PORT 53
+#define L7_DNS_HEADER_LEN 12
+#define L7_MYSQL_HEADER_LEN 4
+#define L7_PRUNE_INTERVAL_NS (10 * ONE_SECOND_IN_NS)
+
+//
+// Messages that don't look like a request before a protocol is detected.
+// Past this, the fd is left alone.
+//
+#define L7_MAX_DETECTION_ATTEMPTS 8
+
+namespace
+{
+struct l7_message
+{
+	bool m_error;
+	uint32_t m_status;
+	uint16_t m_dns_id;
+	char m_method[sinsp_l7_record::MAX_METHOD_LEN];
+};
+
+inline void set_method(l7_message *msg, const char *method)
+{
+	strncpy(msg->m_method, method, sizeof(msg->m_method) - 1);
+	msg->m_method[sizeof(msg->m_method) - 1] = 0;
+}
+
+inline uint16_t be16(const uint8_t *p)
+{
+	return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// HTTP/1.x, through the bundled http_parser. Only the start line matters,
+// parsing stops being interesting once it's complete.
+///////////////////////////////////////////////////////////////////////////////
+int http_on_start_line(http_parser *parser, const char *at, size_t length)
+{
+	*(bool *)parser->data = true;
+	return 0;
+}
+
+bool http_parse(const uint8_t *data, uint32_t len, bool request, l7_message *msg)
+{
+	if(request)
+	{
+		if(len < 4 || !isupper(data[0]))
+		{
+			return false;
+		}
+	}
+	else if(len < 12 || memcmp(data, "HTTP/1.", 7) != 0)
+	{
+		return false;
+	}
+
+	http_parser_settings settings;
+	memset(&settings, 0, sizeof(settings));
+	if(request)
+	{
+		settings.on_url = http_on_start_line;
+	}
+	else
+	{
+		settings.on_status = http_on_start_line;
+	}
+
+	bool start_line = false;
+	http_parser parser;
+	http_parser_init(&parser, request ? HTTP_REQUEST : HTTP_RESPONSE);
+	parser.data = &start_line;
+	http_parser_execute(&parser, &settings, (const char *)data, len);
+
+	if(HTTP_PARSER_ERRNO(&parser) != HPE_OK)
+	{
+		return false;
+	}
+
+	if(request)
+	{
+		if(!start_line)
+		{
+			return false;
+		}
+
+		set_method(msg, http_method_str((enum http_method)parser.method));
+	}
+	else
+	{
+		//
+		// A status line without a reason phrase doesn't call on_status
+		//
+		if(parser.status_code < 100 || parser.status_code > 999)
+		{
+			return false;
+		}
+
+		msg->m_status = parser.status_code;
+		msg->m_error = (parser.status_code >= 400);
+	}
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Redis (RESP). Requests are arrays of bulk strings, the first one being
+// the command name.
+///////////////////////////////////////////////////////////////////////////////
+bool resp_read_int(const uint8_t *data, uint32_t len, uint32_t *pos, int64_t *val)
+{
+	uint32_t start = *pos;
+	*val = 0;
+
+	while(*pos < len && isdigit(data[*pos]))
+	{
+		if(*pos - start > 9)
+		{
+			return false;
+		}
+
+		*val = *val * 10 + (data[*pos] - '0');
+		(*pos)++;
+	}
+
+	if(*pos == start || *pos + 2 > len || data[*pos] != '\r' || data[*pos + 1] != '\n')
+	{
+		return false;
+	}
+
+	*pos += 2;
+	return true;
+}
+
+bool redis_parse(const uint8_t *data, uint32_t len, bool request, l7_message *msg)
+{
+	if(len < 3)
+	{
+		return false;
+	}
+
+	if(!request)
+	{
+		switch(data[0])
+		{
+		case '-':
+		case '!':
+			msg->m_error = true;
+			return true;
+		case '+':
+		case ':':
+		case '$':
+		case '*':
+		case '_':
+		case ',':
+		case '#':
+		case '(':
+		case '=':
+		case '%':
+		case '~':
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	uint32_t pos = 1;
+	int64_t nargs;
+	int64_t cmdlen;
+	if(data[0] != '*' ||
+		!resp_read_int(data, len, &pos, &nargs) || nargs == 0 ||
+		pos >= len || data[pos++] != '$' ||
+		!resp_read_int(data, len, &pos, &cmdlen) || cmdlen == 0)
+	{
+		return false;
+	}
+
+	//
+	// The command name can be cut by the snaplen, keep what's there
+	//
+	uint32_t j;
+	for(j = 0; j < cmdlen && j < sinsp_l7_record::MAX_METHOD_LEN - 1 && pos + j < len; j++)
+	{
+		if(!isalpha(data[pos + j]))
+		{
+			return false;
+		}
+
+		msg->m_method[j] = toupper(data[pos + j]);
+	}
+	msg->m_method[j] = 0;
+
+	return j > 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// MySQL. A request is a command packet with sequence id 0 that fills the
+// whole syscall, the response starts with sequence id 1.
+///////////////////////////////////////////////////////////////////////////////
+bool mysql_parse(const uint8_t *data, uint32_t len, uint64_t size, bool request, l7_message *msg)
+{
+	if(len < L7_MYSQL_HEADER_LEN + 1)
+	{
+		return false;
+	}
+
+	uint32_t payload_len = data[0] | (data[1] << 8) | (data[2] << 16);
+	uint8_t seq = data[3];
+	uint8_t first = data[4];
+
+	if(payload_len == 0 || payload_len + L7_MYSQL_HEADER_LEN > size)
+	{
+		return false;
+	}
+
+	if(!request)
+	{
+		if(seq != 1)
+		{
+			return false;
+		}
+
+		if(first == 0xff)
+		{
+			msg->m_error = true;
+			if(len >= L7_MYSQL_HEADER_LEN + 3)
+			{
+				msg->m_status = data[5] | (data[6] << 8);
+			}
+		}
+
+		return true;
+	}
+
+	if(seq != 0 || payload_len + L7_MYSQL_HEADER_LEN != size)
+	{
+		return false;
+	}
+
+	//
+	// Only the commands that always get a response. The server greeting
+	// also has sequence id 0, but starts with the protocol version (10).
+	//
+	switch(first)
+	{
+	case 0x02:
+		set_method(msg, "INIT_DB");
+		break;
+	case 0x03:
+		set_method(msg, "QUERY");
+		break;
+	case 0x0e:
+		if(payload_len != 1)
+		{
+			return false;
+		}
+		set_method(msg, "PING");
+		break;
+	case 0x16:
+		set_method(msg, "STMT_PREPARE");
+		break;
+	case 0x17:
+		set_method(msg, "STMT_EXECUTE");
+		break;
+	case 0x1a:
+		set_method(msg, "STMT_RESET");
+		break;
+	default:
+		return false;
+	}
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DNS. Queries and responses are paired by transaction id.
+///////////////////////////////////////////////////////////////////////////////
+const char *dns_qtype_str(uint16_t qtype)
+{
+	switch(qtype)
+	{
+	case 1: return "A";
+	case 2: return "NS";
+	case 5: return "CNAME";
+	case 6: return "SOA";
+	case 12: return "PTR";
+	case 15: return "MX";
+	case 16: return "TXT";
+	case 28: return "AAAA";
+	case 33: return "SRV";
+	case 65: return "HTTPS";
+	default: return NULL;
+	}
+}
+
+bool dns_parse(const uint8_t *data, uint32_t len, bool tcp, bool request, l7_message *msg)
+{
+	//
+	// Over TCP, messages are prefixed by their length
+	//
+	if(tcp)
+	{
+		if(len < 2)
+		{
+			return false;
+		}
+
+		data += 2;
+		len -= 2;
+	}
+
+	if(len < L7_DNS_HEADER_LEN)
+	{
+		return false;
+	}
+
+	uint16_t flags = be16(data + 2);
+	uint16_t qdcount = be16(data + 4);
+	bool qr = (flags & 0x8000) != 0;
+
+	if(qr == request || (flags & 0x7800) != 0 || qdcount == 0)
+	{
+		return false;
+	}
+
+	msg->m_dns_id = be16(data);
+
+	if(!request)
+	{
+		msg->m_status = flags & 0x000f;
+		msg->m_error = (msg->m_status != 0);
+		return true;
+	}
+
+	//
+	// Questions aren't compressed, skip the name to get the type
+	//
+	uint32_t pos = L7_DNS_HEADER_LEN;
+	while(pos < len && data[pos] != 0)
+	{
+		if((data[pos] & 0xc0) != 0)
+		{
+			return false;
+		}
+		pos += data[pos] + 1;
+	}
+
+	if(pos + 3 <= len)
+	{
+		uint16_t qtype = be16(data + pos + 1);
+		const char *qtypestr = dns_qtype_str(qtype);
+		if(qtypestr != NULL)
+		{
+			set_method(msg, qtypestr);
+		}
+		else
+		{
+			snprintf(msg->m_method, sizeof(msg->m_method), "TYPE%u", qtype);
+		}
+	}
+
+	return true;
+}
+
+bool is_dns_fd(sinsp_fdinfo_t *fdinfo)
+{
+	if(fdinfo->m_type == SCAP_FD_IPV4_SOCK)
+	{
+		return fdinfo->m_sockinfo.m_ipv4info.m_fields.m_dport == L7_DNS_PORT ||
+			fdinfo->m_sockinfo.m_ipv4info.m_fields.m_sport == L7_DNS_PORT;
+	}
+	else if(fdinfo->m_type == SCAP_FD_IPV6_SOCK)
+	{
+		return fdinfo->m_sockinfo.m_ipv6info.m_fields.m_dport == L7_DNS_PORT ||
+			fdinfo->m_sockinfo.m_ipv6info.m_fields.m_sport == L7_DNS_PORT;
+	}
+
+	return false;
+}
+
+bool l7_parse(sinsp_l7_record::protocol proto, sinsp_fdinfo_t *fdinfo,
+	      const uint8_t *data, uint32_t len, uint64_t size, bool request, l7_message *msg)
+{
+	switch(proto)
+	{
+	case sinsp_l7_record::L7_HTTP:
+		return http_parse(data, len, request, msg);
+	case sinsp_l7_record::L7_REDIS:
+		return redis_parse(data, len, request, msg);
+	case sinsp_l7_record::L7_MYSQL:
+		return mysql_parse(data, len, size, request, msg);
+	case sinsp_l7_record::L7_DNS:
+		return dns_parse(data, len, fdinfo->is_tcp_socket(), request, msg);
+	default:
+		return false;
+	}
+}
+}
+
+const char* sinsp_l7_record::protocol_to_string(protocol p)
+{
+	switch(p)
+	{
+	case L7_HTTP:
+		return "http";
+	case L7_REDIS:
+		return "redis";
+	case L7_MYSQL:
+		return "mysql";
+	case L7_DNS:
+		return "dns";
+	default:
+		return "unknown";
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_decoder_l7 implementation
+///////////////////////////////////////////////////////////////////////////////
+sinsp_decoder_l7::sinsp_decoder_l7():
+	m_request_timeout_ns(DEFAULT_REQUEST_TIMEOUT_NS),
+	m_max_connections(DEFAULT_MAX_CONNECTIONS),
+	m_last_prune_ts(0),
+	m_n_records(0),
+	m_n_dropped_requests(0),
+	m_n_skipped_connections(0),
+	m_unwatch_pending(false)
+{
+	m_name = "l7";
+}
+
+sinsp_protodecoder* sinsp_decoder_l7::allocate_new()
+{
+	return (sinsp_protodecoder*) new sinsp_decoder_l7();
+}
+
+void sinsp_decoder_l7::init()
+{
+	//
+	// CT_OPEN is what gets us the sockets found in /proc
+	//
+	register_event_callback(CT_OPEN);
+	register_event_callback(CT_CONNECT);
+	register_event_callback(CT_ACCEPT);
+	register_event_callback(CT_CLOSE);
+}
+
+bool sinsp_decoder_l7::is_l7_socket(sinsp_fdinfo_t* fdinfo)
+{
+	if(fdinfo->m_type != SCAP_FD_IPV4_SOCK &&
+		fdinfo->m_type != SCAP_FD_IPV6_SOCK)
+	{
+		return false;
+	}
+
+	//
+	// Of the datagram protocols, only DNS is supported
+	//
+	if(fdinfo->is_udp_socket())
+	{
+		return is_dns_fd(fdinfo);
+	}
+
+	return true;
+}
+
+void sinsp_decoder_l7::watch(sinsp_fdinfo_t* fdinfo)
+{
+	if(!fdinfo->has_event_callback(CT_READ, this))
+	{
+		register_read_callback(fdinfo);
+		register_write_callback(fdinfo);
+	}
+}
+
+void sinsp_decoder_l7::on_fd_from_proc(sinsp_fdinfo_t* fdinfo)
+{
+	if(fdinfo == NULL)
+	{
+		ASSERT(false);
+		return;
+	}
+
+	if(is_l7_socket(fdinfo))
+	{
+		watch(fdinfo);
+	}
+}
+
+void sinsp_decoder_l7::on_event(sinsp_evt* evt, sinsp_pd_callback_type etype)
+{
+	if(etype == CT_OPEN)
+	{
+		return;
+	}
+
+	connection_key key;
+	if(etype == CT_CLOSE)
+	{
+		//
+		// After a shutdown the other direction can still carry the
+		// responses, keep the connection until they're in
+		//
+		if(get_key(evt, &key))
+		{
+			auto it = m_connections.find(key);
+			if(it != m_connections.end() &&
+				(evt->get_type() != PPME_SOCKET_SHUTDOWN_X || it->second.m_pending.empty()))
+			{
+				m_n_dropped_requests += it->second.m_pending.size();
+				m_connections.erase(it);
+			}
+		}
+		return;
+	}
+
+	sinsp_fdinfo_t* fdinfo = evt->get_fd_info();
+	if(fdinfo == NULL)
+	{
+		return;
+	}
+
+	//
+	// A new connection on an fd number we may have seen before. Tuple
+	// changes are not: unconnected UDP sockets report one per datagram.
+	//
+	if((etype == CT_CONNECT || etype == CT_ACCEPT) && get_key(evt, &key))
+	{
+		m_connections.erase(key);
+	}
+
+	if(is_l7_socket(fdinfo))
+	{
+		watch(fdinfo);
+	}
+	else if(fdinfo->has_event_callback(CT_READ, this))
+	{
+		unregister_read_callback(fdinfo);
+		unregister_write_callback(fdinfo);
+	}
+}
+
+bool sinsp_decoder_l7::get_key(sinsp_evt* evt, connection_key* key)
+{
+	sinsp_threadinfo* tinfo = evt->get_thread_info();
+	if(tinfo == NULL)
+	{
+		return false;
+	}
+
+	//
+	// Threads share the fd table of their process
+	//
+	key->m_pid = tinfo->m_pid;
+	key->m_fd = tinfo->m_lastevent_fd;
+	return true;
+}
+
+void sinsp_decoder_l7::on_read(sinsp_evt* evt, char *data, uint32_t len)
+{
+	on_data(evt, (const uint8_t *)data, len, true);
+}
+
+void sinsp_decoder_l7::on_write(sinsp_evt* evt, char *data, uint32_t len)
+{
+	on_data(evt, (const uint8_t *)data, len, false);
+}
+
+void sinsp_decoder_l7::on_data(sinsp_evt* evt, const uint8_t *data, uint32_t len, bool is_read)
+{
+	sinsp_fdinfo_t* fdinfo = evt->get_fd_info();
+	connection_key key;
+	if(len == 0 || fdinfo == NULL || !get_key(evt, &key))
+	{
+		return;
+	}
+
+	uint64_t ts = evt->get_ts();
+	if(ts > m_last_prune_ts + L7_PRUNE_INTERVAL_NS)
+	{
+		prune(ts);
+	}
+
+	//
+	// The syscall size, the buffer can be truncated
+	//
+	sinsp_evt_param *parinfo = evt->get_param(0);
+	ASSERT(parinfo->m_len == sizeof(int64_t));
+	int64_t size = *(int64_t *)parinfo->m_val;
+	if(size <= 0)
+	{
+		return;
+	}
+
+	l7_message msg;
+	memset(&msg, 0, sizeof(msg));
+	bool detected = false;
+
+	auto it = m_connections.find(key);
+	if(it == m_connections.end() || it->second.m_protocol == sinsp_l7_record::L7_UNKNOWN)
+	{
+		//
+		// Protocol detection, on requests only
+		//
+		sinsp_l7_record::protocol proto = sinsp_l7_record::L7_UNKNOWN;
+		if(is_dns_fd(fdinfo))
+		{
+			if(dns_parse(data, len, fdinfo->is_tcp_socket(), true, &msg))
+			{
+				proto = sinsp_l7_record::L7_DNS;
+			}
+		}
+		else if(http_parse(data, len, true, &msg))
+		{
+			proto = sinsp_l7_record::L7_HTTP;
+		}
+		else if(redis_parse(data, len, true, &msg))
+		{
+			proto = sinsp_l7_record::L7_REDIS;
+		}
+		else if(mysql_parse(data, len, size, true, &msg))
+		{
+			proto = sinsp_l7_record::L7_MYSQL;
+		}
+
+		if(it == m_connections.end())
+		{
+			if(m_connections.size() >= m_max_connections)
+			{
+				//
+				// Stop looking at this fd too, so that it's counted
+				// once. It's watched again when it's reused.
+				//
+				m_n_skipped_connections++;
+				m_unwatch_pending = true;
+				m_inspector->protodecoder_register_reset(this);
+				return;
+			}
+
+			it = m_connections.insert(std::make_pair(key, connection())).first;
+		}
+
+		connection& conn = it->second;
+		conn.m_last_ts = ts;
+
+		if(proto == sinsp_l7_record::L7_UNKNOWN)
+		{
+			//
+			// Probably TLS or a protocol we don't know, stop looking
+			// at this fd until it's reused
+			//
+			if(++conn.m_n_attempts >= L7_MAX_DETECTION_ATTEMPTS)
+			{
+				//
+				// We're being called while the parser walks the fd
+				// callbacks, unregister once it's done with the event
+				//
+				m_connections.erase(it);
+				m_unwatch_pending = true;
+				m_inspector->protodecoder_register_reset(this);
+			}
+			return;
+		}
+
+		conn.m_protocol = proto;
+		conn.m_req_is_read = is_read;
+		detected = true;
+	}
+
+	connection& conn = it->second;
+	conn.m_last_ts = ts;
+
+	if(is_read == conn.m_req_is_read)
+	{
+		if(!detected && !l7_parse(conn.m_protocol, fdinfo, data, len, size, true, &msg))
+		{
+			return;
+		}
+
+		if(conn.m_pending.size() >= DEFAULT_MAX_PENDING)
+		{
+			conn.m_pending.pop_front();
+			m_n_dropped_requests++;
+		}
+
+		pending_request req;
+		req.m_ts = ts;
+		req.m_len = (uint32_t)size;
+		req.m_dns_id = msg.m_dns_id;
+		memcpy(req.m_method, msg.m_method, sizeof(req.m_method));
+		conn.m_pending.push_back(req);
+		return;
+	}
+
+	if(conn.m_pending.empty() ||
+		!l7_parse(conn.m_protocol, fdinfo, data, len, size, false, &msg))
+	{
+		return;
+	}
+
+	auto req = conn.m_pending.begin();
+	if(conn.m_protocol == sinsp_l7_record::L7_DNS)
+	{
+		for(; req != conn.m_pending.end(); ++req)
+		{
+			if(req->m_dns_id == msg.m_dns_id)
+			{
+				break;
+			}
+		}
+
+		if(req == conn.m_pending.end())
+		{
+			return;
+		}
+	}
+
+	m_n_records++;
+
+	if(m_record_cb)
+	{
+		sinsp_l7_record rec;
+		rec.m_protocol = conn.m_protocol;
+		rec.m_is_server = conn.m_req_is_read;
+		rec.m_error = msg.m_error;
+		rec.m_tid = evt->get_tid();
+		rec.m_fd = key.m_fd;
+		rec.m_req_ts = req->m_ts;
+		rec.m_latency_ns = ts - req->m_ts;
+		rec.m_req_len = req->m_len;
+		rec.m_resp_len = (uint32_t)size;
+		rec.m_status = msg.m_status;
+		memcpy(rec.m_method, req->m_method, sizeof(rec.m_method));
+
+		m_record_cb(rec, evt);
+	}
+
+	conn.m_pending.erase(req);
+}
+
+void sinsp_decoder_l7::on_reset(sinsp_evt* evt)
+{
+	if(!m_unwatch_pending)
+	{
+		return;
+	}
+
+	m_unwatch_pending = false;
+
+	sinsp_fdinfo_t* fdinfo = evt->get_fd_info();
+	if(fdinfo != NULL && fdinfo->has_event_callback(CT_READ, this))
+	{
+		unregister_read_callback(fdinfo);
+		unregister_write_callback(fdinfo);
+	}
+}
+
+void sinsp_decoder_l7::prune(uint64_t ts)
+{
+	m_last_prune_ts = ts;
+
+	for(auto it = m_connections.begin(); it != m_connections.end();)
+	{
+		connection& conn = it->second;
+
+		if(conn.m_last_ts + m_request_timeout_ns < ts)
+		{
+			m_n_dropped_requests += conn.m_pending.size();
+			it = m_connections.erase(it);
+			continue;
+		}
+
+		while(!conn.m_pending.empty() &&
+			conn.m_pending.front().m_ts + m_request_timeout_ns < ts)
+		{
+			conn.m_pending.pop_front();
+			m_n_dropped_requests++;
+		}
+
+		++it;
+	}
+}
+
+bool sinsp_decoder_l7::get_info_line(char** res)
+{
+	m_infostr = "l7 connections=" + std::to_string(m_connections.size()) +
+		" skipped=" + std::to_string(m_n_skipped_connections) +
+		" records=" + std::to_string(m_n_records);
+
+	*res = (char*)m_infostr.c_str();
+	return true;
+}
@@ -0,0 +1,235 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <unordered_map>
+
+#include "sinsp.h"
+#include "protodecoder.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// A completed request/response pair. Fixed size and without payload bytes,
+// so it can be copied around or queued cheaply.
+///////////////////////////////////////////////////////////////////////////////
+struct sinsp_l7_record
+{
+	enum protocol
+	{
+		L7_UNKNOWN = 0,
+		L7_HTTP,
+		L7_REDIS,
+		L7_MYSQL,
+		L7_DNS,
+	};
+
+	static const uint32_t MAX_METHOD_LEN = 16;
+
+	protocol m_protocol;
+	//
+	// true if the process answered the request, false if it issued it
+	//
+	bool m_is_server;
+	//
+	// true if the response reports a failure (HTTP 4xx and 5xx, RESP error, MySQL
+	// ERR packet, DNS rcode other than NOERROR)
+	//
+	bool m_error;
+	int64_t m_tid;
+	int64_t m_fd;
+	//
+	// Exit time of the syscall that carried the request, and the time
+	// between it and the exit of the syscall that carried the start of
+	// the response
+	//
+	uint64_t m_req_ts;
+	uint64_t m_latency_ns;
+	//
+	// Syscall sizes, not the captured ones
+	//
+	uint32_t m_req_len;
+	uint32_t m_resp_len;
+	//
+	// HTTP status code, MySQL error code, DNS rcode. 0 for Redis.
+	//
+	uint32_t m_status;
+	//
+	// HTTP method, Redis command, MySQL command, DNS query type.
+	// Always NUL terminated.
+	//
+	char m_method[MAX_METHOD_LEN];
+
+	static const char* protocol_to_string(protocol p);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// Layer 7 latency decoder.
+//
+// Follows the TCP and UDP sockets of the capture, recognizes HTTP/1.x,
+// Redis, MySQL and DNS exchanges from the first bytes of each read and
+// write, and pairs every request with its response. The protocol is
+// detected on the first recognized request of a connection and sticks.
+//
+// Requests can be sent from either side: the direction that carries the
+// request is learned from the traffic, so it works for clients and
+// servers, and doesn't need the socket role. Pipelined requests are
+// answered in order; DNS responses are matched by transaction id instead.
+//
+// Latency is measured to the first byte of the response, and only the
+// syscall that begins a message is looked at, so snaplen truncation
+// doesn't matter. Completed pairs are delivered through the record
+// callback, synchronously, while the response event is being parsed.
+//
+// This decoder is not attached by default:
+//
+//   sinsp_decoder_l7* l7 = (sinsp_decoder_l7*)inspector.require_protodecoder("l7");
+//   l7->set_record_callback(...);
+//
+// Do it before open() so that the sockets found in /proc are followed too.
+///////////////////////////////////////////////////////////////////////////////
+class sinsp_decoder_l7 : public sinsp_protodecoder
+{
+public:
+	typedef std::function<void(const sinsp_l7_record& rec, sinsp_evt* evt)> record_cb;
+
+	static const uint32_t DEFAULT_MAX_CONNECTIONS = 65536;
+	static const uint32_t DEFAULT_MAX_PENDING = 32;
+	static const uint64_t DEFAULT_REQUEST_TIMEOUT_NS = 60 * ONE_SECOND_IN_NS;
+
+	sinsp_decoder_l7();
+	sinsp_protodecoder* allocate_new();
+	void init();
+	void on_fd_from_proc(sinsp_fdinfo_t* fdinfo);
+	void on_event(sinsp_evt* evt, sinsp_pd_callback_type etype);
+	void on_read(sinsp_evt* evt, char *data, uint32_t len);
+	void on_write(sinsp_evt* evt, char *data, uint32_t len);
+	void on_reset(sinsp_evt* evt);
+	bool get_info_line(char** res);
+
+	//
+	// The callback receives the event carrying the response, which gives
+	// access to the thread, the fd and its tuple
+	//
+	void set_record_callback(record_cb cb)
+	{
+		m_record_cb = cb;
+	}
+
+	//
+	// Requests without a response after this long are dropped, and so
+	// are connections that have been idle for as long
+	//
+	void set_request_timeout(uint64_t timeout_ns)
+	{
+		m_request_timeout_ns = timeout_ns;
+	}
+
+	void set_max_connections(uint32_t max_connections)
+	{
+		m_max_connections = max_connections;
+	}
+
+	size_t get_n_connections() const
+	{
+		return m_connections.size();
+	}
+
+	uint64_t get_n_records() const
+	{
+		return m_n_records;
+	}
+
+	uint64_t get_n_dropped_requests() const
+	{
+		return m_n_dropped_requests;
+	}
+
+	//
+	// Connections that weren't followed because there were already
+	// max_connections
+	//
+	uint64_t get_n_skipped_connections() const
+	{
+		return m_n_skipped_connections;
+	}
+
+private:
+	struct pending_request
+	{
+		uint64_t m_ts;
+		uint32_t m_len;
+		uint16_t m_dns_id;
+		char m_method[sinsp_l7_record::MAX_METHOD_LEN];
+	};
+
+	struct connection
+	{
+		connection():
+			m_protocol(sinsp_l7_record::L7_UNKNOWN),
+			m_req_is_read(false),
+			m_n_attempts(0),
+			m_last_ts(0)
+		{
+		}
+
+		sinsp_l7_record::protocol m_protocol;
+		bool m_req_is_read;
+		uint32_t m_n_attempts;
+		uint64_t m_last_ts;
+		std::deque<pending_request> m_pending;
+	};
+
+	struct connection_key
+	{
+		int64_t m_pid;
+		int64_t m_fd;
+
+		bool operator==(const connection_key& other) const
+		{
+			return m_pid == other.m_pid && m_fd == other.m_fd;
+		}
+	};
+
+	struct connection_key_hash
+	{
+		size_t operator()(const connection_key& k) const
+		{
+			return std::hash<int64_t>()(k.m_pid) ^ (std::hash<int64_t>()(k.m_fd) << 1);
+		}
+	};
+
+	bool is_l7_socket(sinsp_fdinfo_t* fdinfo);
+	void watch(sinsp_fdinfo_t* fdinfo);
+	bool get_key(sinsp_evt* evt, connection_key* key);
+	void on_data(sinsp_evt* evt, const uint8_t *data, uint32_t len, bool is_read);
+	void prune(uint64_t ts);
+
+	record_cb m_record_cb;
+	uint64_t m_request_timeout_ns;
+	uint32_t m_max_connections;
+	uint64_t m_last_prune_ts;
+	uint64_t m_n_records;
+	uint64_t m_n_dropped_requests;
+	uint64_t m_n_skipped_connections;
+	bool m_unwatch_pending;
+
+	std::unordered_map<connection_key, connection, connection_key_hash> m_connections;
+
+	std::string m_infostr;
+};
@@ -0,0 +1,203 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "load_shedder.h"
+#include "../../driver/ppm_ringbuffer.h"
+
+sinsp_load_shedder::sinsp_load_shedder(actuator* act):
+	m_actuator(act),
+	m_snaplen(DEFAULT_SNAPLEN),
+	m_buffer_size(RING_BUF_SIZE),
+	m_tick_interval_ns(ONE_SECOND_IN_NS / 10),
+	m_low_watermark(0.25),
+	m_high_watermark(0.75),
+	m_max_cpu(0.9),
+	m_calm_ticks(10)
+{
+	memset(m_priorities, PRIORITY_NORMAL, sizeof(m_priorities));
+	reset();
+}
+
+void sinsp_load_shedder::set_priority(uint16_t evttype, priority prio)
+{
+	//
+	// Enter events are even, the exit event follows
+	//
+	uint16_t enter = evttype & ~1;
+
+	if(enter + 1 >= PPM_EVENT_MAX)
+	{
+		throw sinsp_exception("invalid event type " + std::to_string(evttype));
+	}
+
+	m_priorities[enter] = prio;
+	m_priorities[enter + 1] = prio;
+}
+
+void sinsp_load_shedder::set_thresholds(double low_watermark, double high_watermark, double max_cpu, uint32_t calm_ticks)
+{
+	if(low_watermark >= high_watermark || high_watermark > 1)
+	{
+		throw sinsp_exception("invalid load shedding watermarks");
+	}
+
+	m_low_watermark = low_watermark;
+	m_high_watermark = high_watermark;
+	m_max_cpu = max_cpu;
+	m_calm_ticks = calm_ticks;
+}
+
+void sinsp_load_shedder::reset()
+{
+	m_level = LEVEL_NONE;
+	m_next_tick = 0;
+	m_has_prev = false;
+	m_n_calm = 0;
+	m_n_escalations = 0;
+}
+
+void sinsp_load_shedder::update(const sample& s)
+{
+	m_next_tick = s.m_ts + m_tick_interval_ns;
+
+	if(!m_has_prev || s.m_ts <= m_prev.m_ts)
+	{
+		m_prev = s;
+		m_has_prev = true;
+		return;
+	}
+
+	double used = (double)s.m_max_buf_used / m_buffer_size;
+	bool growing = s.m_max_buf_used > m_prev.m_max_buf_used;
+	bool dropping = s.m_n_drops > m_prev.m_n_drops;
+	double cpu = (double)(s.m_cpu_ns - m_prev.m_cpu_ns) / (s.m_ts - m_prev.m_ts);
+	m_prev = s;
+
+	if(used >= m_high_watermark || dropping || cpu >= m_max_cpu)
+	{
+		m_n_calm = 0;
+
+		if(m_level < LEVEL_MAX)
+		{
+			m_n_escalations++;
+			apply(m_level, (level)(m_level + 1));
+		}
+	}
+	else if(used < m_low_watermark && !growing && cpu < m_max_cpu / 2)
+	{
+		//
+		// A ring that fills up, even slowly, means that the level below
+		// would overflow it
+		//
+		if(++m_n_calm >= m_calm_ticks && m_level > LEVEL_NONE)
+		{
+			m_n_calm = 0;
+			apply(m_level, (level)(m_level - 1));
+		}
+	}
+	else
+	{
+		m_n_calm = 0;
+	}
+}
+
+uint32_t sinsp_load_shedder::snaplen(level l) const
+{
+	uint32_t min = m_snaplen < MIN_SNAPLEN ? m_snaplen : MIN_SNAPLEN;
+
+	switch(l)
+	{
+	case LEVEL_NONE:
+		return m_snaplen;
+	case LEVEL_SNAPLEN:
+		return std::max(m_snaplen / 4, min);
+	default:
+		return min;
+	}
+}
+
+void sinsp_load_shedder::apply(level from, level to)
+{
+	g_logger.format(sinsp_logger::SEV_INFO, "load shedding level %d -> %d", (int)from, (int)to);
+
+	if(snaplen(from) != snaplen(to))
+	{
+		m_actuator->set_snaplen(snaplen(to));
+	}
+
+	bool was_masked = from >= LEVEL_MASK_LOW;
+	if(was_masked != (to >= LEVEL_MASK_LOW))
+	{
+		for(uint32_t j = 0; j < PPM_EVENT_MAX; j++)
+		{
+			if(m_priorities[j] == PRIORITY_LOW)
+			{
+				m_actuator->set_eventmask(j, was_masked);
+			}
+		}
+	}
+
+	if(sampling_ratio(from) != sampling_ratio(to))
+	{
+		m_actuator->set_sampling_ratio(sampling_ratio(to));
+	}
+
+	m_level = to;
+}
+
+void sinsp_load_shedder_inspector_actuator::set_snaplen(uint32_t snaplen)
+{
+	m_inspector->apply_snaplen(snaplen);
+}
+
+void sinsp_load_shedder_inspector_actuator::set_eventmask(uint32_t evttype, bool enabled)
+{
+	if(enabled)
+	{
+#ifdef HAS_FILTERING
+		//
+		// Masked by the automatic event mask too
+		//
+		const std::vector<bool>& eventmask = m_inspector->m_eventmask;
+		if(!eventmask.empty() && !eventmask[evttype])
+		{
+			return;
+		}
+#endif
+		m_inspector->set_eventmask(evttype);
+	}
+	else
+	{
+		m_inspector->unset_eventmask(evttype);
+	}
+}
+
+void sinsp_load_shedder_inspector_actuator::set_sampling_ratio(uint32_t ratio)
+{
+#ifndef _WIN32
+	if(ratio == 1)
+	{
+		m_inspector->stop_dropping_mode();
+	}
+	else
+	{
+		m_inspector->start_dropping_mode(ratio);
+	}
+#endif
+}
@@ -0,0 +1,226 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <cstdint>
+#include "scap.h"
+
+class sinsp;
+
+///////////////////////////////////////////////////////////////////////////////
+// Feedback controller that sheds load when the consumer falls behind the
+// driver.
+//
+// Once per tick it looks at how full the fullest ring is, at the drops the
+// driver reported since the previous tick and at the CPU time spent by the
+// event loop, and moves one step on a ladder that loses progressively more
+// information:
+//
+//  1. a shorter snaplen, then the minimal one
+//  2. the event types declared low priority masked in the driver
+//  3. sampling, with a ratio doubling at every step
+//
+// It goes back down one step at a time after a few calm ticks, so that it
+// doesn't flap around a threshold.
+//
+// The controller doesn't touch the driver itself, it goes through an
+// actuator: sinsp passes one that forwards to the driver, the tests one that
+// simulates a producer.
+///////////////////////////////////////////////////////////////////////////////
+class sinsp_load_shedder
+{
+public:
+	enum priority
+	{
+		// Never masked
+		PRIORITY_CRITICAL = 0,
+		PRIORITY_NORMAL = 1,
+		// Masked before sampling kicks in
+		PRIORITY_LOW = 2,
+	};
+
+	enum level
+	{
+		LEVEL_NONE = 0,
+		LEVEL_SNAPLEN = 1,
+		LEVEL_SNAPLEN_MIN = 2,
+		LEVEL_MASK_LOW = 3,
+		// LEVEL_SAMPLING + j samples 1 event every 2^(j+1)
+		LEVEL_SAMPLING = 4,
+		LEVEL_MAX = LEVEL_SAMPLING + 6,
+	};
+
+	static const uint32_t MIN_SNAPLEN = 16;
+
+	class actuator
+	{
+	public:
+		virtual ~actuator()
+		{
+		}
+
+		virtual void set_snaplen(uint32_t snaplen) = 0;
+		virtual void set_eventmask(uint32_t evttype, bool enabled) = 0;
+		// 1 means no sampling
+		virtual void set_sampling_ratio(uint32_t ratio) = 0;
+	};
+
+	//
+	// What the controller looks at, taken at every tick. The counters are
+	// cumulative.
+	//
+	struct sample
+	{
+		uint64_t m_ts;
+		uint64_t m_max_buf_used;
+		uint64_t m_n_drops;
+		uint64_t m_cpu_ns;
+	};
+
+	sinsp_load_shedder(actuator* act);
+
+	//
+	// The priority covers the enter and the exit event of evttype.
+	// Everything is PRIORITY_NORMAL by default.
+	//
+	void set_priority(uint16_t evttype, priority prio);
+	priority get_priority(uint16_t evttype) const
+	{
+		return (priority)m_priorities[evttype];
+	}
+
+	//
+	// The snaplen set when not shedding
+	//
+	void set_snaplen(uint32_t snaplen)
+	{
+		m_snaplen = snaplen;
+	}
+
+	//
+	// The snaplen of the current level
+	//
+	uint32_t get_snaplen() const
+	{
+		return snaplen(m_level);
+	}
+
+	//
+	// The size of a ring, RING_BUF_SIZE by default
+	//
+	void set_buffer_size(uint64_t size)
+	{
+		m_buffer_size = size;
+	}
+
+	void set_tick_interval(uint64_t interval_ns)
+	{
+		m_tick_interval_ns = interval_ns;
+	}
+
+	//
+	// Shedding starts above high_watermark of the ring used or above
+	// max_cpu of the time spent in the event loop, and stops after
+	// calm_ticks with the ring below low_watermark and not growing, and
+	// the event loop below max_cpu / 2.
+	//
+	void set_thresholds(double low_watermark, double high_watermark, double max_cpu, uint32_t calm_ticks);
+
+	//
+	// True once the tick interval is over since the previous update
+	//
+	bool is_due(uint64_t ts) const
+	{
+		return ts >= m_next_tick;
+	}
+
+	void update(const sample& s);
+
+	//
+	// Goes back to LEVEL_NONE, e.g. when a new capture is opened
+	//
+	void reset();
+
+	level get_level() const
+	{
+		return m_level;
+	}
+
+	//
+	// True if evttype is masked because of the load
+	//
+	bool is_masked(uint16_t evttype) const
+	{
+		return m_level >= LEVEL_MASK_LOW && m_priorities[evttype] == PRIORITY_LOW;
+	}
+
+	uint32_t get_sampling_ratio() const
+	{
+		return sampling_ratio(m_level);
+	}
+
+	uint64_t get_n_escalations() const
+	{
+		return m_n_escalations;
+	}
+
+private:
+	static uint32_t sampling_ratio(level l)
+	{
+		return l < LEVEL_SAMPLING ? 1 : 2U << (l - LEVEL_SAMPLING);
+	}
+
+	uint32_t snaplen(level l) const;
+	void apply(level from, level to);
+
+	actuator* m_actuator;
+	uint8_t m_priorities[PPM_EVENT_MAX];
+	uint32_t m_snaplen;
+	uint64_t m_buffer_size;
+	uint64_t m_tick_interval_ns;
+	double m_low_watermark;
+	double m_high_watermark;
+	double m_max_cpu;
+	uint32_t m_calm_ticks;
+
+	level m_level;
+	uint64_t m_next_tick;
+	bool m_has_prev;
+	sample m_prev;
+	uint32_t m_n_calm;
+	uint64_t m_n_escalations;
+};
+
+//
+// Forwards to the driver of a live capture
+//
+class sinsp_load_shedder_inspector_actuator : public sinsp_load_shedder::actuator
+{
+public:
+	sinsp_load_shedder_inspector_actuator(sinsp* inspector):
+		m_inspector(inspector)
+	{
+	}
+
+	void set_snaplen(uint32_t snaplen) override;
+	void set_eventmask(uint32_t evttype, bool enabled) override;
+	void set_sampling_ratio(uint32_t ratio) override;
+
+private:
+	sinsp* m_inspector;
+};
@@ -0,0 +1,306 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <algorithm>
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "memory_budget.h"
+#include "dns_manager.h"
+
+//
+// What the hash tables add to an entry: the node link and the bucket
+//
+#define HASH_NODE_OVERHEAD (2 * sizeof(void*))
+
+//
+// The thread object, its shared_ptr control block and its hash table node
+//
+#define THREAD_FIXED_BYTES (sizeof(sinsp_threadinfo) + 2 * sizeof(long) + sizeof(void*) + \
+	sizeof(std::pair<const int64_t, threadinfo_map_t::ptr_t>) + HASH_NODE_OVERHEAD)
+
+#define FD_FIXED_BYTES (sizeof(std::pair<const int64_t, sinsp_fdinfo_t>) + HASH_NODE_OVERHEAD)
+
+sinsp_memory_budget::sinsp_memory_budget(sinsp* inspector):
+	m_inspector(inspector),
+	m_enabled(false),
+	m_n_fds(0),
+	m_thread_avg(THREAD_FIXED_BYTES),
+	m_fd_avg(FD_FIXED_BYTES),
+	m_next_check_ts(0),
+	m_next_slow_check_ts(0)
+{
+	memset(m_budget, 0, sizeof(m_budget));
+	memset(m_n_evicted, 0, sizeof(m_n_evicted));
+	memset(m_n_refused, 0, sizeof(m_n_refused));
+}
+
+void sinsp_memory_budget::set_budget(component comp, uint64_t bytes)
+{
+	if(comp >= COMP_MAX)
+	{
+		throw sinsp_exception("invalid memory budget component " + std::to_string(comp));
+	}
+
+	m_budget[comp] = bytes;
+
+	//
+	// The stores of the enter events and of the DNS names enforce their
+	// own budget
+	//
+	if(comp == COMP_ENTER_EVENTS)
+	{
+		m_inspector->m_enter_store.set_max_memory(bytes);
+	}
+	else if(comp == COMP_DNS)
+	{
+		sinsp_dns_manager::get().set_max_memory(bytes);
+	}
+
+	m_enabled = m_budget[COMP_THREADS] != 0 ||
+		m_budget[COMP_FDS] != 0 ||
+		m_budget[COMP_CONTAINERS] != 0;
+
+	if(m_enabled)
+	{
+		measure();
+	}
+}
+
+sinsp_memory_budget::usage sinsp_memory_budget::get_usage()
+{
+	usage res;
+
+	measure();
+
+	res.m_bytes[COMP_THREADS] = thread_bytes();
+	res.m_bytes[COMP_FDS] = fd_bytes();
+	res.m_bytes[COMP_ENTER_EVENTS] = m_inspector->m_enter_store.get_memory_usage();
+	res.m_bytes[COMP_CONTAINERS] = m_inspector->m_container_manager.get_memory_usage();
+	res.m_bytes[COMP_DNS] = sinsp_dns_manager::get().get_memory_usage();
+
+	memcpy(res.m_budget, m_budget, sizeof(m_budget));
+	memcpy(res.m_n_evicted, m_n_evicted, sizeof(m_n_evicted));
+	memcpy(res.m_n_refused, m_n_refused, sizeof(m_n_refused));
+	res.m_n_refused[COMP_ENTER_EVENTS] = m_inspector->m_enter_store.get_n_refused();
+	res.m_n_evicted[COMP_DNS] = sinsp_dns_manager::get().get_n_evicted();
+
+	return res;
+}
+
+void sinsp_memory_budget::measure()
+{
+	uint64_t nthreads = 0;
+	uint64_t tbytes = 0;
+	uint64_t nfds = 0;
+	uint64_t fbytes = 0;
+
+	m_inspector->m_thread_manager->get_threads()->loop([&] (sinsp_threadinfo& tinfo) {
+		nthreads++;
+		tbytes += THREAD_FIXED_BYTES +
+			string_bytes(tinfo.m_comm) +
+			string_bytes(tinfo.m_exe) +
+			string_bytes(tinfo.m_exepath) +
+			string_bytes(tinfo.m_container_id) +
+			string_bytes(tinfo.m_root) +
+			string_bytes(tinfo.m_cwd) +
+			string_bytes(tinfo.m_args_str) +
+			string_bytes(tinfo.m_env_str) +
+			string_bytes(tinfo.m_cmdline) +
+			string_bytes(tinfo.m_exeline) +
+			strings_bytes(tinfo.m_args) +
+			strings_bytes(tinfo.m_env) +
+			tinfo.m_cgroups.capacity() * sizeof(tinfo.m_cgroups[0]) +
+			tinfo.m_ancestry.capacity() * sizeof(void*) +
+			tinfo.m_private_state.capacity() * sizeof(void*);
+
+		for(const auto& cg : tinfo.m_cgroups)
+		{
+			tbytes += string_bytes(cg.first) + string_bytes(cg.second);
+		}
+
+		//
+		// The threads of a process share the table of the main one
+		//
+		if(tinfo.is_main_thread())
+		{
+			sinsp_fdtable* fdtable = tinfo.get_fd_table();
+			tbytes += fdtable->m_table.bucket_count() * sizeof(void*);
+
+			for(auto& it : fdtable->m_table)
+			{
+				nfds++;
+				fbytes += FD_FIXED_BYTES +
+					string_bytes(it.second.m_name) +
+					string_bytes(it.second.m_oldname);
+
+				if(it.second.has_decoder_callbacks())
+				{
+					fbytes += sizeof(fd_callbacks_info);
+				}
+			}
+		}
+
+		return true;
+	});
+
+	if(nthreads != 0)
+	{
+		m_thread_avg = tbytes / nthreads;
+	}
+
+	if(nfds != 0)
+	{
+		m_fd_avg = fbytes / nfds;
+	}
+}
+
+uint64_t sinsp_memory_budget::thread_bytes() const
+{
+	return m_inspector->m_thread_manager->get_thread_count() * m_thread_avg;
+}
+
+void sinsp_memory_budget::check(uint64_t ts)
+{
+	m_next_check_ts = ts + EVICTION_INTERVAL_NS;
+
+	bool slow_check = ts >= m_next_slow_check_ts;
+	if(slow_check)
+	{
+		m_next_slow_check_ts = ts + CHECK_INTERVAL_NS;
+		measure();
+	}
+
+	//
+	// The fds first: they're what gets out of hand, and evicting threads
+	// evicts their fds too
+	//
+	uint64_t budget = m_budget[COMP_FDS];
+	if(budget != 0 && fd_bytes() > budget * HIGH_WATERMARK)
+	{
+		evict_fds((uint64_t)(budget * LOW_WATERMARK));
+	}
+
+	budget = m_budget[COMP_THREADS];
+	if(budget != 0 && thread_bytes() > budget * HIGH_WATERMARK)
+	{
+		evict_threads((uint64_t)(budget * LOW_WATERMARK));
+	}
+
+	if(slow_check)
+	{
+		budget = m_budget[COMP_CONTAINERS];
+		if(budget != 0 && m_inspector->m_container_manager.get_memory_usage() > budget * HIGH_WATERMARK)
+		{
+			m_n_evicted[COMP_CONTAINERS] += m_inspector->m_container_manager.remove_unused_containers();
+		}
+	}
+}
+
+void sinsp_memory_budget::evict_threads(uint64_t target)
+{
+	sinsp_thread_manager* manager = m_inspector->m_thread_manager;
+	std::vector<std::pair<uint64_t, int64_t>> candidates;
+
+	//
+	// The ones with children would stay in the table anyway. They become
+	// candidates when their children are gone.
+	//
+	manager->get_threads()->loop([&] (sinsp_threadinfo& tinfo) {
+		if(tinfo.m_nchilds == 0
+#if defined(HAS_CAPTURE)
+			&& tinfo.m_pid != m_inspector->m_sysdig_pid
+#endif
+			)
+		{
+			candidates.push_back(std::make_pair(tinfo.m_lastaccess_ts, tinfo.m_tid));
+		}
+		return true;
+	});
+
+	std::sort(candidates.begin(), candidates.end());
+
+	uint64_t nthreads = manager->get_thread_count();
+	uint64_t n = target / m_thread_avg;
+	for(uint32_t j = 0; j < candidates.size() && nthreads > n; j++)
+	{
+		manager->remove_thread(candidates[j].second, false);
+		nthreads = manager->get_thread_count();
+		m_n_evicted[COMP_THREADS]++;
+	}
+
+	g_logger.format(sinsp_logger::SEV_INFO, "Thread table over its memory budget, evicted down to %" PRIu64 " threads",
+		nthreads);
+}
+
+void sinsp_memory_budget::evict_fds(uint64_t target)
+{
+	//
+	// A process is as recent as its most recent thread
+	//
+	std::unordered_map<int64_t, uint64_t> last_access;
+
+	m_inspector->m_thread_manager->get_threads()->loop([&] (sinsp_threadinfo& tinfo) {
+		uint64_t& ts = last_access[tinfo.m_pid];
+		ts = std::max(ts, tinfo.m_lastaccess_ts);
+		return true;
+	});
+
+	std::vector<std::pair<uint64_t, int64_t>> candidates;
+	for(const auto& it : last_access)
+	{
+		candidates.push_back(std::make_pair(it.second, it.first));
+	}
+
+	std::sort(candidates.begin(), candidates.end());
+
+	uint64_t n = target / m_fd_avg;
+	for(uint32_t j = 0; j < candidates.size() && m_n_fds > n; j++)
+	{
+		sinsp_threadinfo* tinfo = m_inspector->find_thread(candidates[j].second, true).get();
+		if(tinfo == NULL)
+		{
+			continue;
+		}
+
+		sinsp_fdtable* fdtable = tinfo->get_fd_table();
+		if(fdtable == NULL || fdtable->size() == 0)
+		{
+			continue;
+		}
+
+		//
+		// Like when the process goes away
+		//
+		erase_fd_params eparams;
+		eparams.m_remove_from_table = false;
+		eparams.m_tinfo = tinfo;
+		eparams.m_ts = m_inspector->m_lastevent_ts;
+
+		for(auto& it : fdtable->m_table)
+		{
+			eparams.m_fd = it.first;
+			eparams.m_fdinfo = &it.second;
+			m_inspector->m_parser->erase_fd(&eparams);
+		}
+
+		m_n_evicted[COMP_FDS] += fdtable->size();
+		fdtable->clear();
+	}
+
+	g_logger.format(sinsp_logger::SEV_INFO, "FD tables over their memory budget, evicted down to %" PRIu64 " fds",
+		m_n_fds);
+}
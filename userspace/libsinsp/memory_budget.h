@@ -0,0 +1,204 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class sinsp;
+
+///////////////////////////////////////////////////////////////////////////////
+// Byte accounting of the state kept by the inspector, and budgets on it.
+//
+// Walking the tables at every change would cost more than the events
+// themselves, so the two that grow with the load are accounted as a number
+// of entries times the average size of an entry: the threads, counted by the
+// thread table, and the fds, counted by the fd tables as they change. The
+// averages are measured by walking the tables in measure(), once per
+// CHECK_INTERVAL_NS when there's a budget and whenever the usage is queried. The enter events are
+// accounted by their store. The containers and the DNS cache, which only
+// grow with the environment, are measured when queried and checked once per
+// CHECK_INTERVAL_NS.
+//
+// A budget is enforced twice:
+//  - the threads and the fds over it aren't added, like the ones over the
+//    table size limits, and the enter events over it aren't stored, like
+//    when the thread is unknown. This is the hard limit.
+//  - at the beginning of an event, a component over HIGH_WATERMARK of its
+//    budget evicts its least recently used entries down to LOW_WATERMARK of
+//    it, so that the hard limit is only hit by bursts: the threads
+//    without children seen the longest time ago, then the fd tables of the
+//    processes seen the longest time ago, and the containers no thread
+//    refers to. The DNS cache evicts its names on its own when resolving a
+//    new one (see sinsp_dns_manager::set_max_memory()).
+///////////////////////////////////////////////////////////////////////////////
+class sinsp_memory_budget
+{
+public:
+	enum component
+	{
+		COMP_THREADS = 0,
+		COMP_FDS = 1,
+		COMP_ENTER_EVENTS = 2,
+		COMP_CONTAINERS = 3,
+		COMP_DNS = 4,
+		COMP_MAX = 5,
+	};
+
+	struct usage
+	{
+		uint64_t m_bytes[COMP_MAX];
+		// 0 when unlimited
+		uint64_t m_budget[COMP_MAX];
+		// Entries evicted to get back under the budget
+		uint64_t m_n_evicted[COMP_MAX];
+		// Entries not added because of the budget
+		uint64_t m_n_refused[COMP_MAX];
+	};
+
+	static const uint64_t CHECK_INTERVAL_NS = 1000000000;
+	static const uint64_t EVICTION_INTERVAL_NS = 100000000;
+	static constexpr double HIGH_WATERMARK = 0.9;
+	static constexpr double LOW_WATERMARK = 0.75;
+
+	sinsp_memory_budget(sinsp* inspector);
+
+	//
+	// 0 means unlimited, the default
+	//
+	void set_budget(component comp, uint64_t bytes);
+	uint64_t get_budget(component comp) const
+	{
+		return m_budget[comp];
+	}
+
+	//
+	// True if the threads, the fds or the containers have a budget
+	//
+	bool is_enabled() const
+	{
+		return m_enabled;
+	}
+
+	//
+	// Walks the tables to refresh the averages, then returns the bytes of
+	// every component
+	//
+	usage get_usage();
+
+	//
+	// Refreshes the average size of a thread and of an fd
+	//
+	void measure();
+
+	//
+	// The hard limits, checked before adding an entry
+	//
+	inline bool can_add_thread()
+	{
+		if(m_budget[COMP_THREADS] != 0 &&
+			thread_bytes() >= m_budget[COMP_THREADS])
+		{
+			m_n_refused[COMP_THREADS]++;
+			return false;
+		}
+		return true;
+	}
+
+	inline bool can_add_fd()
+	{
+		if(m_budget[COMP_FDS] != 0 &&
+			fd_bytes() >= m_budget[COMP_FDS])
+		{
+			m_n_refused[COMP_FDS]++;
+			return false;
+		}
+		return true;
+	}
+
+	//
+	// Kept by the fd tables
+	//
+	void add_fds(int64_t delta)
+	{
+		m_n_fds += delta;
+	}
+
+	uint64_t get_n_fds() const
+	{
+		return m_n_fds;
+	}
+
+	//
+	// Called at the beginning of every event, when nothing points into the
+	// tables. Looks at the budgets once per EVICTION_INTERVAL_NS.
+	//
+	inline void enforce(uint64_t ts)
+	{
+		if(m_enabled && ts >= m_next_check_ts)
+		{
+			check(ts);
+		}
+	}
+
+	//
+	// Heap taken by a string, on top of the object itself
+	//
+	static uint64_t string_bytes(const std::string& str)
+	{
+		const char* obj = (const char*)&str;
+		if(str.data() >= obj && str.data() < obj + sizeof(str))
+		{
+			return 0;
+		}
+		return str.capacity() + 1;
+	}
+
+	static uint64_t strings_bytes(const std::vector<std::string>& strs)
+	{
+		uint64_t res = strs.capacity() * sizeof(std::string);
+		for(const auto& str : strs)
+		{
+			res += string_bytes(str);
+		}
+		return res;
+	}
+
+private:
+	uint64_t thread_bytes() const;
+	uint64_t fd_bytes() const
+	{
+		return m_n_fds * m_fd_avg;
+	}
+
+	void check(uint64_t ts);
+	void evict_threads(uint64_t target);
+	void evict_fds(uint64_t target);
+
+	sinsp* m_inspector;
+	bool m_enabled;
+	uint64_t m_budget[COMP_MAX];
+	uint64_t m_n_evicted[COMP_MAX];
+	uint64_t m_n_refused[COMP_MAX];
+	uint64_t m_n_fds;
+	uint64_t m_thread_avg;
+	uint64_t m_fd_avg;
+	uint64_t m_next_check_ts;
+	uint64_t m_next_slow_check_ts;
+};
@@ -0,0 +1,53 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "parallel_capture.h"
+
+sinsp_parallel_capture::sinsp_parallel_capture(const std::string& filename):
+	m_filename(filename)
+{
+	char error[SCAP_LASTERR_SIZE];
+	uint64_t* offsets;
+	uint32_t noffsets;
+
+	if(scap_find_checkpoints(filename.c_str(), error, &offsets, &noffsets) != SCAP_SUCCESS)
+	{
+		throw sinsp_exception(error);
+	}
+
+	m_segments.push_back({0, 0});
+	for(uint32_t j = 0; j < noffsets; j++)
+	{
+		m_segments.push_back({j + 1, offsets[j]});
+	}
+
+	free(offsets);
+}
+
+void sinsp_parallel_capture::open(sinsp& inspector, const segment& seg) const
+{
+	inspector.open_checkpoint(m_filename, seg.m_offset);
+}
+
+std::unique_ptr<sinsp> sinsp_parallel_capture::new_inspector(const segment& seg) const
+{
+	std::unique_ptr<sinsp> inspector(new sinsp());
+	open(*inspector, seg);
+	return inspector;
+}
@@ -0,0 +1,184 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sinsp_public.h"
+
+class sinsp;
+
+///////////////////////////////////////////////////////////////////////////////
+// Offline analysis of a capture split at its checkpoints (see
+// sinsp_dumper::checkpoint()).
+//
+// Every segment, from a checkpoint to the next one, is read by an inspector
+// of its own that starts from the state saved in the checkpoint, so the
+// segments can be processed in parallel. The results of the segments are
+// merged in capture order, as soon as the segments before them are done.
+//
+// A capture without checkpoints is a single segment. The capture must be
+// uncompressed: a segment of a gzip file can only be reached by
+// decompressing everything before it.
+///////////////////////////////////////////////////////////////////////////////
+class SINSP_PUBLIC sinsp_parallel_capture
+{
+public:
+	struct segment
+	{
+		uint32_t m_index;
+		// Of the checkpoint, 0 for the first segment
+		uint64_t m_offset;
+	};
+
+	//
+	// Looks for the checkpoints of the file. Throws a sinsp_exception if
+	// it can't be read or is compressed.
+	//
+	sinsp_parallel_capture(const std::string& filename);
+
+	const std::vector<segment>& get_segments() const
+	{
+		return m_segments;
+	}
+
+	//
+	// Opens the inspector on the segment. Reading ends with SCAP_EOF at the
+	// end of the segment.
+	//
+	void open(sinsp& inspector, const segment& seg) const;
+
+	//
+	// Processes every segment with process(), on an inspector of its own
+	// already opened on it, using up to nworkers threads. Calls merge() on
+	// this thread with the results, in segment order.
+	//
+	// If process() throws for a segment, the segments after it aren't
+	// merged and the exception is rethrown here, once the workers are done.
+	//
+	template<typename T>
+	void run(uint32_t nworkers,
+		 const std::function<T(sinsp&, const segment&)>& process,
+		 const std::function<void(T&)>& merge) const;
+
+private:
+	std::unique_ptr<sinsp> new_inspector(const segment& seg) const;
+
+	std::string m_filename;
+	std::vector<segment> m_segments;
+};
+
+template<typename T>
+void sinsp_parallel_capture::run(uint32_t nworkers,
+				 const std::function<T(sinsp&, const segment&)>& process,
+				 const std::function<void(T&)>& merge) const
+{
+	size_t nsegments = m_segments.size();
+	std::vector<std::unique_ptr<T>> results(nsegments);
+	std::vector<std::exception_ptr> errors(nsegments);
+	std::atomic<size_t> next(0);
+	std::atomic<bool> stop(false);
+	std::mutex mtx;
+	std::condition_variable done;
+
+	auto worker = [&]()
+	{
+		size_t j;
+		while(!stop && (j = next++) < nsegments)
+		{
+			std::unique_ptr<T> res;
+			std::exception_ptr err;
+
+			try
+			{
+				std::unique_ptr<sinsp> inspector = new_inspector(m_segments[j]);
+				res.reset(new T(process(*inspector, m_segments[j])));
+			}
+			catch(...)
+			{
+				err = std::current_exception();
+			}
+
+			std::lock_guard<std::mutex> lock(mtx);
+			results[j] = std::move(res);
+			errors[j] = err;
+			done.notify_one();
+		}
+	};
+
+	if(nworkers == 0)
+	{
+		nworkers = 1;
+	}
+	if(nworkers > nsegments)
+	{
+		nworkers = (uint32_t)nsegments;
+	}
+
+	std::vector<std::thread> workers;
+	for(uint32_t j = 0; j < nworkers; j++)
+	{
+		workers.emplace_back(worker);
+	}
+
+	std::exception_ptr err;
+	for(size_t j = 0; j < nsegments && !err; j++)
+	{
+		std::unique_ptr<T> res;
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			done.wait(lock, [&]() { return results[j] || errors[j]; });
+			res = std::move(results[j]);
+			err = errors[j];
+		}
+
+		if(err)
+		{
+			stop = true;
+			break;
+		}
+
+		try
+		{
+			merge(*res);
+		}
+		catch(...)
+		{
+			err = std::current_exception();
+			stop = true;
+		}
+	}
+
+	for(auto& w : workers)
+	{
+		w.join();
+	}
+
+	if(err)
+	{
+		std::rethrow_exception(err);
+	}
+}
@@ -75,12 +75,6 @@ sinsp_parser::~sinsp_parser()
 		delete m_protodecoders[j];
 	}
 
-	while(!m_tmp_events_buffer.empty())
-	{
-		auto ptr = m_tmp_events_buffer.top();
-		free(ptr);
-		m_tmp_events_buffer.pop();
-	}
 	m_protodecoders.clear();
 
 	free(m_k8s_metaevents_state.m_piscapevt);
@@ -233,6 +227,16 @@ void sinsp_parser::process_event(sinsp_evt *evt)
 	evt->m_filtered_out = false;
 #endif
 
+	//
+	// With the skb capture on, the writes to sockets start the egress
+	// latency of their data
+	//
+	if(m_inspector->m_skb_correlator.is_active() && evt->m_fdinfo != NULL &&
+		PPME_IS_ENTER(etype) && (evt->get_info_flags() & EF_WRITES_TO_FD))
+	{
+		m_inspector->m_skb_correlator.on_send(evt->m_fdinfo, evt->get_ts());
+	}
+
 	//
 	// Route the event to the proper function
 	//
@@ -306,12 +310,6 @@ void sinsp_parser::process_event(sinsp_evt *evt)
 	case PPME_SYSCALL_OPENAT_2_X:
 		parse_open_openat_creat_exit(evt);
 		break;
-	case PPME_SYSCALL_SELECT_E:
-	case PPME_SYSCALL_POLL_E:
-	case PPME_SYSCALL_PPOLL_E:
-	case PPME_SYSCALL_EPOLLWAIT_E:
-		parse_select_poll_epollwait_enter(evt);
-		break;
 	case PPME_SYSCALL_CLONE_11_X:
 	case PPME_SYSCALL_CLONE_16_X:
 	case PPME_SYSCALL_CLONE_17_X:
@@ -512,7 +510,7 @@ void sinsp_parser::event_cleanup(sinsp_evt *evt)
 	if(evt->get_direction() == SCAP_ED_OUT &&
 	   evt->m_tinfo && evt->m_tinfo->m_lastevent_data)
 	{
-		free_event_buffer(evt->m_tinfo->m_lastevent_data);
+		m_inspector->m_enter_store.release(evt->m_tinfo->m_lastevent_data);
 		evt->m_tinfo->m_lastevent_data = NULL;
 		evt->m_tinfo->set_lastevent_data_validity(false);
 	}
@@ -559,6 +557,7 @@ bool sinsp_parser::reset(sinsp_evt *evt)
 	ppm_event_flags eflags = evt->get_info_flags();
 
 	evt->m_fdinfo = NULL;
+	evt->m_conn_fd = -1;
 	evt->m_errorcode = 0;
 
 	//
@@ -616,6 +615,24 @@ bool sinsp_parser::reset(sinsp_evt *evt)
 		evt->m_tinfo = &*m_inspector->get_thread_ref(evt->m_pevt->tid, query_os, false);
 	}
 
+	//
+	// The tcp_* kprobes and the skb events get the thread and the fd of
+	// their connection here, before the filters run
+	//
+	if(etype == PPME_TCP_RCV_ESTABLISHED_E ||
+		etype == PPME_TCP_CLOSE_E ||
+		etype == PPME_TCP_DROP_E ||
+		etype == PPME_TCP_RETRANCESMIT_SKB_E)
+	{
+		parse_tcp_event(evt);
+		return false;
+	}
+	else if(etype == PPME_NETIF_RECEIVE_SKB_E || etype == PPME_NET_DEV_XMIT_E)
+	{
+		parse_skb_event(evt);
+		return false;
+	}
+
 	if(etype == PPME_SCHEDSWITCH_6_E || (evt->get_info_flags() & EF_NONE_PARSE))
 	{
 		return false;
@@ -786,28 +803,11 @@ void sinsp_parser::store_event(sinsp_evt *evt)
 		return;
 	}
 
-	uint32_t elen;
-
 	//
-	// Make sure the event data is going to fit
-	//
-	elen = scap_event_getlen(evt->m_pevt);
-
-	if(elen > SP_EVT_BUF_SIZE)
-	{
-		ASSERT(false);
-		return;
-	}
-
-	//
-	// Copy the data
+	// Copy the parameters the exit parser will need
 	//
 	auto tinfo = evt->m_tinfo;
-	if(tinfo->m_lastevent_data == NULL)
-	{
-		tinfo->m_lastevent_data = reserve_event_buffer();
-	}
-	memcpy(tinfo->m_lastevent_data, evt->m_pevt, elen);
+	tinfo->m_lastevent_data = m_inspector->m_enter_store.store(evt->m_pevt, tinfo->m_lastevent_data);
 	tinfo->m_lastevent_cpuid = evt->get_cpuid();
 
 #ifdef GATHER_INTERNAL_STATS
@@ -896,6 +896,12 @@ void sinsp_parser::register_event_callback(sinsp_pd_callback_type etype, sinsp_p
 	case CT_CONNECT:
 		m_connect_callbacks.push_back(dec);
 		break;
+	case CT_ACCEPT:
+		m_accept_callbacks.push_back(dec);
+		break;
+	case CT_CLOSE:
+		m_close_callbacks.push_back(dec);
+		break;
 	default:
 		ASSERT(false);
 		break;
@@ -1505,7 +1511,11 @@ void sinsp_parser::parse_clone_exit(sinsp_evt *evt)
 		case PPME_SYSCALL_CLONE_20_X:
 			parinfo = evt->get_param(14);
 			tinfo->set_cgroups(parinfo->m_val, parinfo->m_len);
-			m_inspector->m_container_manager.resolve_container(tinfo, m_inspector->is_live());
+			if(!valid_parent ||
+			   !m_inspector->m_container_manager.inherit_container(tinfo, ptinfo))
+			{
+				m_inspector->m_container_manager.resolve_container(tinfo, m_inspector->is_live());
+			}
 			break;
 	}
 
@@ -1626,6 +1636,7 @@ void sinsp_parser::parse_execve_exit(sinsp_evt *evt)
 		parinfo = evt->get_param(5);
 		ASSERT(parinfo->m_len == sizeof(uint64_t));
 		evt->m_tinfo->m_ptid = *(uint64_t *)parinfo->m_val;
+		m_inspector->m_thread_manager->invalidate_ancestry();
 	}
 
 	// Get the fdlimit
@@ -2722,6 +2733,8 @@ void sinsp_parser::parse_connect_exit(sinsp_evt *evt)
 
     fill_client_socket_info(evt, packed_data);
 
+	m_inspector->m_conn_index.add(evt->m_tinfo, evt->m_tinfo->m_lastevent_fd, evt->m_fdinfo);
+
 	//
 	// Call the protocol decoder callbacks associated to this event
 	//
@@ -2861,6 +2874,19 @@ void sinsp_parser::parse_accept_exit(sinsp_evt *evt)
 	// Add the entry to the table
 	//
 	evt->m_fdinfo = evt->m_tinfo->add_fd(fd, &fdi);
+	if(evt->m_fdinfo != NULL)
+	{
+		m_inspector->m_conn_index.add(evt->m_tinfo, fd, evt->m_fdinfo);
+	}
+
+	//
+	// Call the protocol decoder callbacks associated to this event
+	//
+	vector<sinsp_protodecoder*>::iterator it;
+	for(it = m_accept_callbacks.begin(); it != m_accept_callbacks.end(); ++it)
+	{
+		(*it)->on_event(evt, CT_ACCEPT);
+	}
 }
 
 void sinsp_parser::parse_close_enter(sinsp_evt *evt)
@@ -2901,6 +2927,8 @@ void sinsp_parser::erase_fd(erase_fd_params* params)
 		return;
 	}
 
+	m_inspector->m_conn_index.remove(params->m_tinfo, params->m_fd, params->m_fdinfo);
+
 	//
 	// Schedule the fd for removal
 	//
@@ -2954,6 +2982,15 @@ void sinsp_parser::parse_close_exit(sinsp_evt *evt)
 		{
 			eparams.m_fd = evt->m_tinfo->m_lastevent_fd;
 			eparams.m_fdinfo = evt->m_fdinfo;
+
+			//
+			// Call the protocol decoder callbacks associated to this event
+			//
+			vector<sinsp_protodecoder*>::iterator it;
+			for(it = m_close_callbacks.begin(); it != m_close_callbacks.end(); ++it)
+			{
+				(*it)->on_event(evt, CT_CLOSE);
+			}
 		}
 
 		//
@@ -3339,6 +3376,21 @@ bool sinsp_parser::update_fd(sinsp_evt *evt, sinsp_evt_param *parinfo)
 	return true;
 }
 
+//
+// The tcp_* kprobes are issued by whatever thread the kernel is running,
+// often none of the capture: the connection index gives them the thread
+// and the fd that own their connection.
+//
+void sinsp_parser::parse_tcp_event(sinsp_evt *evt)
+{
+	evt->m_conn_fd = m_inspector->m_conn_index.process_tcp_event(evt);
+}
+
+void sinsp_parser::parse_skb_event(sinsp_evt *evt)
+{
+	evt->m_conn_fd = m_inspector->m_skb_correlator.process_skb_event(evt);
+}
+
 void sinsp_parser::swap_addresses(sinsp_fdinfo_t* fdinfo)
 {
 	if(fdinfo->m_type == SCAP_FD_IPV4_SOCK)
@@ -3661,6 +3713,11 @@ void sinsp_parser::parse_rw_exit(sinsp_evt *evt)
 			datalen = parinfo->m_len;
 			data = parinfo->m_val;
 
+			if(m_inspector->m_skb_correlator.is_active())
+			{
+				m_inspector->m_skb_correlator.on_recv(evt->m_fdinfo, evt->get_ts());
+			}
+
 			//
 			// If there's an fd listener, call it now
 			//
@@ -4021,6 +4078,12 @@ void sinsp_parser::parse_shutdown_exit(sinsp_evt *evt)
 			return;
 		}
 
+		vector<sinsp_protodecoder*>::iterator it;
+		for(it = m_close_callbacks.begin(); it != m_close_callbacks.end(); ++it)
+		{
+			(*it)->on_event(evt, CT_CLOSE);
+		}
+
 		if(m_fd_listener)
 		{
 			m_fd_listener->on_socket_shutdown(evt);
@@ -4349,20 +4412,6 @@ void sinsp_parser::parse_prlimit_exit(sinsp_evt *evt)
 	}
 }
 
-void sinsp_parser::parse_select_poll_epollwait_enter(sinsp_evt *evt)
-{
-	if(evt->m_tinfo == NULL)
-	{
-		ASSERT(false);
-		return;
-	}
-
-	if(evt->m_tinfo->m_lastevent_data == NULL)
-	{
-		evt->m_tinfo->m_lastevent_data = reserve_event_buffer();
-	}
-	*(uint64_t*)evt->m_tinfo->m_lastevent_data = evt->get_ts();
-}
 void sinsp_parser::parse_fcntl_enter(sinsp_evt *evt)
 {
 	if(!evt->m_tinfo)
@@ -4912,20 +4961,6 @@ void sinsp_parser::parse_cpu_hotplug_enter(sinsp_evt *evt)
 	}
 }
 
-uint8_t* sinsp_parser::reserve_event_buffer()
-{
-	if(m_tmp_events_buffer.empty())
-	{
-		return (uint8_t*)malloc(sizeof(uint8_t)*SP_EVT_BUF_SIZE);
-	}
-	else
-	{
-		auto ptr = m_tmp_events_buffer.top();
-		m_tmp_events_buffer.pop();
-		return ptr;
-	}
-}
-
 #if !defined(CYGWING_AGENT) && !defined(MINIMAL_BUILD)
 int sinsp_parser::get_k8s_version(const std::string& json)
 {
@@ -5125,15 +5160,3 @@ void sinsp_parser::parse_getsockopt_exit(sinsp_evt *evt)
 		}
 	}
 }
-
-void sinsp_parser::free_event_buffer(uint8_t *ptr)
-{
-	if(m_tmp_events_buffer.size() < m_inspector->m_thread_manager->m_threadtable.size())
-	{
-		m_tmp_events_buffer.push(ptr);
-	}
-	else
-	{
-		free(ptr);
-	}
-}
@@ -71,6 +71,8 @@ public:
 	//
 	vector<sinsp_protodecoder*> m_open_callbacks;
 	vector<sinsp_protodecoder*> m_connect_callbacks;
+	vector<sinsp_protodecoder*> m_accept_callbacks;
+	vector<sinsp_protodecoder*> m_close_callbacks;
 
 	ppm_event_flags m_drop_event_flags;
 
@@ -122,7 +124,6 @@ private:
 	void parse_inotify_init_exit(sinsp_evt* evt);
 	void parse_getrlimit_setrlimit_exit(sinsp_evt* evt);
 	void parse_prlimit_exit(sinsp_evt* evt);
-	void parse_select_poll_epollwait_enter(sinsp_evt *evt);
 	void parse_fcntl_enter(sinsp_evt* evt);
 	void parse_fcntl_exit(sinsp_evt* evt);
 	void parse_context_switch(sinsp_evt* evt);
@@ -157,9 +158,9 @@ private:
 	bool set_ipv6_addresses_and_ports(sinsp_fdinfo_t* fdinfo, uint8_t* packed_data);
 	bool set_unix_info(sinsp_fdinfo_t* fdinfo, uint8_t* packed_data);
 
+	void parse_tcp_event(sinsp_evt* evt);
+	void parse_skb_event(sinsp_evt* evt);
 	void swap_addresses(sinsp_fdinfo_t* fdinfo);
-	uint8_t* reserve_event_buffer();
-	void free_event_buffer(uint8_t*);
 
 	//
 	// Pointers to inspector context
@@ -188,10 +189,10 @@ private:
 	int              m_k8s_capture_version = -1;
 	metaevents_state m_mesos_metaevents_state;
 
-	stack<uint8_t*> m_tmp_events_buffer;
 	friend class sinsp_analyzer;
 	friend class sinsp_analyzer_fd_listener;
 	friend class sinsp_protodecoder;
 	friend class sinsp_baseliner;
 	friend class sinsp_container_manager;
+	friend class sinsp;
 };
@@ -0,0 +1,412 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <inttypes.h>
+#include <thread>
+
+#include "pipeline_stats.h"
+#include "sinsp_exception.h"
+#include "scap.h"
+
+namespace
+{
+
+const char* const s_stage_names[sinsp_pipeline_stats::STAGE_MAX] =
+{
+	"scap_next",
+	"parse",
+	"filter",
+	"dump",
+	"processor",
+};
+
+// Unique id of every sinsp_pipeline_stats instance, so that the thread
+// local shard cache can never match a destroyed instance reusing the
+// same address.
+std::atomic<uint64_t> s_next_instance_id(1);
+
+//
+// Single-writer increment. Only the thread owning the shard writes it, so
+// there's no need for a locked read-modify-write.
+//
+inline void bump(std::atomic<uint64_t>& counter, uint64_t delta)
+{
+	counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+inline uint64_t get(const std::atomic<uint64_t>& counter)
+{
+	return counter.load(std::memory_order_relaxed);
+}
+
+void subtract(sinsp_pipeline_stats::histogram& h, const sinsp_pipeline_stats::histogram& base)
+{
+	h.m_count -= base.m_count;
+	h.m_sum_ns -= base.m_sum_ns;
+	for(uint32_t j = 0; j < sinsp_pipeline_stats::N_LATENCY_BUCKETS; j++)
+	{
+		h.m_buckets[j] -= base.m_buckets[j];
+	}
+}
+
+}
+
+struct sinsp_pipeline_stats::shard
+{
+	struct atomic_histogram
+	{
+		std::atomic<uint64_t> m_count;
+		std::atomic<uint64_t> m_sum_ns;
+		std::atomic<uint64_t> m_buckets[N_LATENCY_BUCKETS];
+
+		void add(uint64_t ns)
+		{
+			bump(m_count, 1);
+			bump(m_sum_ns, ns);
+			bump(m_buckets[bucket_of(ns)], 1);
+		}
+
+		void read_into(histogram& h) const
+		{
+			h.m_count += get(m_count);
+			h.m_sum_ns += get(m_sum_ns);
+			for(uint32_t j = 0; j < N_LATENCY_BUCKETS; j++)
+			{
+				h.m_buckets[j] += get(m_buckets[j]);
+			}
+		}
+	};
+
+	struct atomic_evttype_stats
+	{
+		std::atomic<uint64_t> m_count;
+		std::atomic<uint64_t> m_stage_ns[STAGE_MAX];
+		atomic_histogram m_latency;
+	};
+
+	struct atomic_cpu_stats
+	{
+		std::atomic<uint64_t> m_count;
+		std::atomic<uint64_t> m_scap_next_ns;
+	};
+
+	std::thread::id m_owner;
+	std::atomic<uint64_t> m_n_evts;
+	std::atomic<uint64_t> m_n_sampled_evts;
+	atomic_histogram m_stages[STAGE_MAX];
+	atomic_evttype_stats m_evttypes[PPM_EVENT_MAX];
+	atomic_cpu_stats m_cpus[MAX_CPUS];
+};
+
+uint64_t sinsp_pipeline_stats::histogram::percentile(double pct) const
+{
+	if(m_count == 0)
+	{
+		return 0;
+	}
+
+	uint64_t target = (uint64_t)(m_count * pct / 100);
+	uint64_t seen = 0;
+
+	for(uint32_t j = 0; j < N_LATENCY_BUCKETS; j++)
+	{
+		seen += m_buckets[j];
+		if(seen > target || seen == m_count)
+		{
+			return (j == 0) ? 0 : ((uint64_t)1 << j);
+		}
+	}
+
+	return (uint64_t)1 << (N_LATENCY_BUCKETS - 1);
+}
+
+std::string sinsp_pipeline_stats::snapshot::to_string() const
+{
+	std::string res;
+	char line[256];
+
+	snprintf(line, sizeof(line), "evts: %" PRIu64 " (%" PRIu64 " timed)\n",
+		m_n_evts, m_n_sampled_evts);
+	res += line;
+
+	for(uint32_t j = 0; j < STAGE_MAX; j++)
+	{
+		const histogram& h = m_stages[j];
+		snprintf(line, sizeof(line),
+			"stage %s: n:%" PRIu64 " avg:%" PRIu64 "ns p50:%" PRIu64 "ns p99:%" PRIu64 "ns\n",
+			s_stage_names[j],
+			h.m_count,
+			h.m_count ? h.m_sum_ns / h.m_count : 0,
+			h.percentile(50),
+			h.percentile(99));
+		res += line;
+	}
+
+	for(uint32_t j = 0; j < m_evttypes.size(); j++)
+	{
+		const evttype_stats& et = m_evttypes[j];
+		if(et.m_count == 0)
+		{
+			continue;
+		}
+
+		snprintf(line, sizeof(line),
+			"evttype %" PRIu32 ": n:%" PRIu64 " p50:%" PRIu64 "ns p99:%" PRIu64 "ns\n",
+			j,
+			et.m_count,
+			et.m_latency.percentile(50),
+			et.m_latency.percentile(99));
+		res += line;
+	}
+
+	for(uint32_t j = 0; j < m_cpus.size(); j++)
+	{
+		if(m_cpus[j].m_count == 0)
+		{
+			continue;
+		}
+
+		snprintf(line, sizeof(line),
+			"cpu %" PRIu32 ": n:%" PRIu64 " scap_next:%" PRIu64 "ns\n",
+			j,
+			m_cpus[j].m_count,
+			m_cpus[j].m_scap_next_ns);
+		res += line;
+	}
+
+	return res;
+}
+
+sinsp_pipeline_stats::sinsp_pipeline_stats():
+	m_enabled(false),
+	m_sampling_mask(DEFAULT_SAMPLING_RATIO - 1),
+	m_n_begun(0),
+	m_instance_id(s_next_instance_id++)
+{
+}
+
+sinsp_pipeline_stats::~sinsp_pipeline_stats()
+{
+}
+
+void sinsp_pipeline_stats::set_enabled(bool enabled)
+{
+	m_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void sinsp_pipeline_stats::set_sampling_ratio(uint32_t sampling_ratio)
+{
+	if(sampling_ratio == 0 || (sampling_ratio & (sampling_ratio - 1)) != 0)
+	{
+		throw sinsp_exception("pipeline stats sampling ratio must be a power of two, got " +
+				      std::to_string(sampling_ratio));
+	}
+
+	m_sampling_mask = sampling_ratio - 1;
+}
+
+sinsp_pipeline_stats::shard* sinsp_pipeline_stats::get_shard()
+{
+	struct shard_cache
+	{
+		uint64_t m_instance_id;
+		shard* m_shard;
+	};
+	static thread_local shard_cache s_cache = {0, NULL};
+
+	if(s_cache.m_instance_id == m_instance_id)
+	{
+		return s_cache.m_shard;
+	}
+
+	//
+	// Slow path, taken the first time a thread reports to this
+	// instance, or when a thread alternates between instances.
+	//
+	std::lock_guard<std::mutex> lock(m_shards_mutex);
+	std::thread::id self = std::this_thread::get_id();
+	shard* sh = NULL;
+
+	for(auto& it : m_shards)
+	{
+		if(it->m_owner == self)
+		{
+			sh = it.get();
+			break;
+		}
+	}
+
+	if(sh == NULL)
+	{
+		// Value-initialization zeroes all the counters
+		m_shards.emplace_back(new shard());
+		sh = m_shards.back().get();
+		sh->m_owner = self;
+	}
+
+	s_cache.m_instance_id = m_instance_id;
+	s_cache.m_shard = sh;
+	return sh;
+}
+
+void sinsp_pipeline_stats::on_event(const sample& s, uint16_t evttype, uint16_t cpuid)
+{
+	shard* sh = get_shard();
+	shard::atomic_evttype_stats* et = (evttype < PPM_EVENT_MAX) ? &sh->m_evttypes[evttype] : NULL;
+	shard::atomic_cpu_stats& cpu = sh->m_cpus[(cpuid < MAX_CPUS) ? cpuid : MAX_CPUS - 1];
+
+	bump(sh->m_n_evts, 1);
+	bump(cpu.m_count, 1);
+	if(et)
+	{
+		bump(et->m_count, 1);
+	}
+
+	if(!s.m_timed)
+	{
+		return;
+	}
+
+	bump(sh->m_n_sampled_evts, 1);
+
+	uint64_t total_ns = 0;
+	for(uint32_t j = 0; j < STAGE_MAX; j++)
+	{
+		uint64_t ns = s.m_stage_ns[j];
+
+		// Stages that didn't run for this event are left out of
+		// the histograms
+		if(ns == 0)
+		{
+			continue;
+		}
+
+		total_ns += ns;
+		sh->m_stages[j].add(ns);
+		if(et)
+		{
+			bump(et->m_stage_ns[j], ns);
+		}
+	}
+
+	if(et)
+	{
+		et->m_latency.add(total_ns);
+	}
+
+	bump(cpu.m_scap_next_ns, s.m_stage_ns[STAGE_SCAP_NEXT]);
+}
+
+void sinsp_pipeline_stats::add_shard_to(snapshot& snap, const shard& sh) const
+{
+	snap.m_n_evts += get(sh.m_n_evts);
+	snap.m_n_sampled_evts += get(sh.m_n_sampled_evts);
+
+	for(uint32_t j = 0; j < STAGE_MAX; j++)
+	{
+		sh.m_stages[j].read_into(snap.m_stages[j]);
+	}
+
+	for(uint32_t j = 0; j < PPM_EVENT_MAX; j++)
+	{
+		const shard::atomic_evttype_stats& src = sh.m_evttypes[j];
+		evttype_stats& dst = snap.m_evttypes[j];
+
+		dst.m_count += get(src.m_count);
+		for(uint32_t k = 0; k < STAGE_MAX; k++)
+		{
+			dst.m_stage_ns[k] += get(src.m_stage_ns[k]);
+		}
+		src.m_latency.read_into(dst.m_latency);
+	}
+
+	for(uint32_t j = 0; j < MAX_CPUS; j++)
+	{
+		snap.m_cpus[j].m_count += get(sh.m_cpus[j].m_count);
+		snap.m_cpus[j].m_scap_next_ns += get(sh.m_cpus[j].m_scap_next_ns);
+	}
+}
+
+sinsp_pipeline_stats::snapshot sinsp_pipeline_stats::get_snapshot() const
+{
+	snapshot res = snapshot();
+	res.m_evttypes.resize(PPM_EVENT_MAX, evttype_stats());
+	res.m_cpus.resize(MAX_CPUS, cpu_stats());
+
+	std::lock_guard<std::mutex> lock(m_shards_mutex);
+
+	for(const auto& it : m_shards)
+	{
+		add_shard_to(res, *it);
+	}
+
+	//
+	// Counters are never written by the reader, so reset() is
+	// implemented by remembering where they were.
+	//
+	if(!m_baseline.m_evttypes.empty())
+	{
+		res.m_n_evts -= m_baseline.m_n_evts;
+		res.m_n_sampled_evts -= m_baseline.m_n_sampled_evts;
+
+		for(uint32_t j = 0; j < STAGE_MAX; j++)
+		{
+			subtract(res.m_stages[j], m_baseline.m_stages[j]);
+		}
+
+		for(uint32_t j = 0; j < PPM_EVENT_MAX; j++)
+		{
+			res.m_evttypes[j].m_count -= m_baseline.m_evttypes[j].m_count;
+			for(uint32_t k = 0; k < STAGE_MAX; k++)
+			{
+				res.m_evttypes[j].m_stage_ns[k] -= m_baseline.m_evttypes[j].m_stage_ns[k];
+			}
+			subtract(res.m_evttypes[j].m_latency, m_baseline.m_evttypes[j].m_latency);
+		}
+
+		for(uint32_t j = 0; j < MAX_CPUS; j++)
+		{
+			res.m_cpus[j].m_count -= m_baseline.m_cpus[j].m_count;
+			res.m_cpus[j].m_scap_next_ns -= m_baseline.m_cpus[j].m_scap_next_ns;
+		}
+	}
+
+	size_t ncpus = res.m_cpus.size();
+	while(ncpus > 0 && res.m_cpus[ncpus - 1].m_count == 0)
+	{
+		ncpus--;
+	}
+	res.m_cpus.resize(ncpus);
+
+	return res;
+}
+
+void sinsp_pipeline_stats::reset()
+{
+	snapshot raw = snapshot();
+	raw.m_evttypes.resize(PPM_EVENT_MAX, evttype_stats());
+	raw.m_cpus.resize(MAX_CPUS, cpu_stats());
+
+	std::lock_guard<std::mutex> lock(m_shards_mutex);
+
+	for(const auto& it : m_shards)
+	{
+		add_shard_to(raw, *it);
+	}
+
+	m_baseline = raw;
+}
@@ -0,0 +1,210 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "sinsp_public.h"
+
+//
+// Always-available pipeline instrumentation.
+//
+// Unlike sinsp_stats, which only exists when GATHER_INTERNAL_STATS is
+// defined at compile time, this layer is compiled in unconditionally and
+// toggled at runtime. When disabled the cost on the event path is a single
+// predictable branch.
+//
+// Every writing thread gets its own shard of counters. Writes are plain
+// relaxed load/store pairs on the owner shard, so the hot path never takes
+// a lock and never issues a locked instruction. Readers build a snapshot by
+// summing all the shards.
+//
+// Event counts are updated for every event, while stage latencies are only
+// measured on one event every m_sampling_ratio, which keeps clock reads off
+// most of the events.
+//
+class SINSP_PUBLIC sinsp_pipeline_stats
+{
+public:
+	enum stage
+	{
+		STAGE_SCAP_NEXT = 0,	///< Reading the event from libscap.
+		STAGE_PARSE = 1,	///< State update in sinsp_parser, filtering excluded.
+		STAGE_FILTER = 2,	///< Global filter and event type filters.
+		STAGE_DUMP = 3,	///< Writing the event to a capture file.
+		STAGE_PROCESSOR = 4,	///< The registered external event processor.
+		STAGE_MAX = 5,
+	};
+
+	//
+	// Latency histograms use power-of-two buckets: bucket i counts the
+	// samples in [2^(i-1), 2^i) ns, bucket 0 counts 0ns samples and the
+	// last bucket absorbs everything above ~1s.
+	//
+	static const uint32_t N_LATENCY_BUCKETS = 32;
+	static const uint32_t MAX_CPUS = 512;
+	static const uint32_t DEFAULT_SAMPLING_RATIO = 16;
+
+	struct histogram
+	{
+		uint64_t m_count;
+		uint64_t m_sum_ns;
+		uint64_t m_buckets[N_LATENCY_BUCKETS];
+
+		//
+		// Returns an upper bound, in nanoseconds, of the given
+		// percentile (0-100).
+		//
+		uint64_t percentile(double pct) const;
+	};
+
+	struct evttype_stats
+	{
+		uint64_t m_count;
+		uint64_t m_stage_ns[STAGE_MAX];
+		histogram m_latency;
+	};
+
+	struct cpu_stats
+	{
+		uint64_t m_count;
+		uint64_t m_scap_next_ns;
+	};
+
+	struct snapshot
+	{
+		uint64_t m_n_evts;
+		uint64_t m_n_sampled_evts;
+		histogram m_stages[STAGE_MAX];
+
+		// Indexed by event type, always PPM_EVENT_MAX entries
+		std::vector<evttype_stats> m_evttypes;
+
+		// Indexed by CPU id, trimmed after the last CPU that saw events
+		std::vector<cpu_stats> m_cpus;
+
+		std::string to_string() const;
+	};
+
+	//
+	// Per-event timing scratchpad, filled by the pipeline and committed
+	// with on_event().
+	//
+	struct sample
+	{
+		bool m_timed;
+		uint64_t m_stage_ns[STAGE_MAX];
+	};
+
+	sinsp_pipeline_stats();
+	~sinsp_pipeline_stats();
+
+	void set_enabled(bool enabled);
+	inline bool is_enabled() const
+	{
+		return m_enabled.load(std::memory_order_relaxed);
+	}
+
+	//
+	// Only one event every sampling_ratio gets timed. Must be a power
+	// of two, 1 times every event.
+	//
+	void set_sampling_ratio(uint32_t sampling_ratio);
+
+	//
+	// Hot path
+	//
+	inline void begin_event(sample& s)
+	{
+		uint64_t n = m_n_begun.load(std::memory_order_relaxed) + 1;
+		m_n_begun.store(n, std::memory_order_relaxed);
+		s.m_timed = ((n & m_sampling_mask) == 0);
+		for(uint32_t j = 0; j < STAGE_MAX; j++)
+		{
+			s.m_stage_ns[j] = 0;
+		}
+	}
+
+	static inline uint64_t now_ns()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	inline uint64_t stage_start(const sample& s) const
+	{
+		return s.m_timed ? now_ns() : 0;
+	}
+
+	inline void stage_end(sample& s, stage st, uint64_t start) const
+	{
+		if(s.m_timed)
+		{
+			s.m_stage_ns[st] += now_ns() - start;
+		}
+	}
+
+	void on_event(const sample& s, uint16_t evttype, uint16_t cpuid);
+
+	//
+	// Read side, can be called from any thread
+	//
+	snapshot get_snapshot() const;
+	void reset();
+
+private:
+	struct shard;
+
+	shard* get_shard();
+	void add_shard_to(snapshot& snap, const shard& sh) const;
+
+	static inline uint32_t bucket_of(uint64_t ns)
+	{
+#ifdef _WIN32
+		uint32_t b = 0;
+		while(ns != 0)
+		{
+			ns >>= 1;
+			b++;
+		}
+#else
+		uint32_t b = (ns == 0) ? 0 : 64 - __builtin_clzll(ns);
+#endif
+		return (b < N_LATENCY_BUCKETS) ? b : N_LATENCY_BUCKETS - 1;
+	}
+
+	std::atomic<bool> m_enabled;
+	uint64_t m_sampling_mask;
+
+	//
+	// Only drives the sampling decision. Concurrent threads can lose
+	// increments, which is harmless, so no read-modify-write here.
+	//
+	std::atomic<uint64_t> m_n_begun;
+	const uint64_t m_instance_id;
+
+	mutable std::mutex m_shards_mutex;
+	std::vector<std::unique_ptr<shard>> m_shards;
+	snapshot m_baseline;
+};
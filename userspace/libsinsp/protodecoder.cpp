@@ -22,6 +22,8 @@ limitations under the License.
 #include "sinsp.h"
 #include "sinsp_int.h"
 #include "protodecoder.h"
+#include "dns_decoder.h"
+#include "l7_decoder.h"
 
 extern sinsp_protodecoder_list g_decoderlist;
 
@@ -96,6 +98,8 @@ sinsp_protodecoder_list::sinsp_protodecoder_list()
 	// ADD NEW DECODER CLASSES HERE
 	//////////////////////////////////////////////////////////////////////////////
 	add_protodecoder(new sinsp_decoder_syslog());
+	add_protodecoder(new sinsp_decoder_dns());
+	add_protodecoder(new sinsp_decoder_l7());
 }
 
 sinsp_protodecoder_list::~sinsp_protodecoder_list()
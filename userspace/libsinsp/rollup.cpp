@@ -0,0 +1,353 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "filter.h"
+#include "filterchecks.h"
+#include "rollup.h"
+
+extern sinsp_filter_check_list g_filterlist;
+
+sinsp_rollup::sinsp_rollup(sinsp* inspector):
+	m_inspector(inspector),
+	m_interval_ns(DEFAULT_INTERVAL_NS),
+	m_max_entities(DEFAULT_MAX_ENTITIES),
+	m_start_ts(0),
+	m_next_ts(0),
+	m_n_dropped(0)
+{
+	for(table& t : m_tables)
+	{
+		t.m_stride = 0;
+		t.m_n_rows = 0;
+	}
+}
+
+sinsp_rollup::~sinsp_rollup()
+{
+	for(metric_state& m : m_metrics)
+	{
+		delete m.m_field;
+		delete m.m_filter;
+	}
+}
+
+uint32_t sinsp_rollup::add_metric(const metric& m)
+{
+	if(m.m_entity >= ENTITY_MAX)
+	{
+		throw sinsp_exception("invalid entity for metric " + m.m_name);
+	}
+
+	metric_state state;
+	state.m_def = m;
+	state.m_field = NULL;
+	state.m_filter = NULL;
+
+	if(m.m_aggregation != AGG_COUNT)
+	{
+		sinsp_filter_check* chk = g_filterlist.new_filter_check_from_fldname(m.m_field, m_inspector, true);
+		if(chk == NULL)
+		{
+			throw sinsp_exception("invalid field " + m.m_field + " for metric " + m.m_name);
+		}
+
+		chk->parse_field_name(m.m_field.c_str(), true, false);
+
+		switch(chk->get_field_info()->m_type)
+		{
+		case PT_INT8:
+		case PT_INT16:
+		case PT_INT32:
+		case PT_INT64:
+		case PT_ERRNO:
+		case PT_FD:
+		case PT_PID:
+		case PT_UINT8:
+		case PT_UINT16:
+		case PT_UINT32:
+		case PT_UINT64:
+		case PT_RELTIME:
+		case PT_ABSTIME:
+		case PT_BOOL:
+			break;
+		default:
+			delete chk;
+			throw sinsp_exception("field " + m.m_field + " of metric " + m.m_name + " isn't numeric");
+		}
+
+		m_inspector->get_field_cache().attach(chk, m.m_field);
+		state.m_field = chk;
+	}
+
+	if(!m.m_filter.empty())
+	{
+		try
+		{
+			sinsp_filter_compiler compiler(m_inspector, m.m_filter);
+			state.m_filter = compiler.compile();
+		}
+		catch(...)
+		{
+			delete state.m_field;
+			throw;
+		}
+	}
+
+	table& t = m_tables[m.m_entity];
+	state.m_offset = t.m_stride;
+	t.m_stride += (m.m_aggregation == AGG_HISTOGRAM) ? HISTOGRAM_BUCKETS : 1;
+
+	m_metrics.push_back(state);
+	return (uint32_t)m_metrics.size() - 1;
+}
+
+void sinsp_rollup::get_evttypes(std::vector<bool>& evttypes) const
+{
+	std::vector<bool> needed;
+
+	evttypes.assign(PPM_EVENT_MAX + 1, false);
+
+	for(const metric_state& m : m_metrics)
+	{
+		if(m.m_filter == NULL)
+		{
+			evttypes.assign(PPM_EVENT_MAX + 1, true);
+			return;
+		}
+
+		m.m_filter->evttypes(needed);
+		for(uint32_t j = 0; j < PPM_EVENT_MAX; j++)
+		{
+			evttypes[j] = evttypes[j] || needed[j];
+		}
+	}
+}
+
+bool sinsp_rollup::extract(sinsp_filter_check* chk, sinsp_evt* evt, uint64_t* val)
+{
+	uint32_t len;
+	uint8_t* v = chk->extract_cached(evt, &len);
+	if(v == NULL)
+	{
+		return false;
+	}
+
+	//
+	// The signed ones are sign extended: the sums wrap back, the histograms
+	// put them in the first bucket
+	//
+	switch(chk->get_field_info()->m_type)
+	{
+	case PT_INT8:
+		*val = (uint64_t)(int64_t)*(int8_t*)v;
+		break;
+	case PT_INT16:
+		*val = (uint64_t)(int64_t)*(int16_t*)v;
+		break;
+	case PT_INT32:
+		*val = (uint64_t)(int64_t)*(int32_t*)v;
+		break;
+	case PT_INT64:
+	case PT_ERRNO:
+	case PT_FD:
+	case PT_PID:
+		*val = (uint64_t)*(int64_t*)v;
+		break;
+	case PT_UINT8:
+	case PT_BOOL:
+		*val = *(uint8_t*)v;
+		break;
+	case PT_UINT16:
+		*val = *(uint16_t*)v;
+		break;
+	case PT_UINT32:
+		*val = *(uint32_t*)v;
+		break;
+	default:
+		*val = *(uint64_t*)v;
+		break;
+	}
+
+	return true;
+}
+
+template<typename K, typename H>
+int64_t sinsp_rollup::find_row(keys<K, H>& k, table& t, const K& key)
+{
+	auto it = k.m_index.find(key);
+	if(it != k.m_index.end())
+	{
+		return it->second;
+	}
+
+	if(t.m_n_rows >= m_max_entities)
+	{
+		m_n_dropped++;
+		return -1;
+	}
+
+	//
+	// The rows stay allocated from one interval to the next
+	//
+	uint32_t row = t.m_n_rows++;
+	k.m_index[key] = row;
+	k.m_keys.push_back(key);
+
+	if(t.m_values.size() < t.m_n_rows * t.m_stride)
+	{
+		t.m_values.resize(t.m_n_rows * t.m_stride);
+	}
+
+	memset(&t.m_values[row * t.m_stride], 0, t.m_stride * sizeof(uint64_t));
+	return row;
+}
+
+int64_t sinsp_rollup::find_row(entity e, sinsp_evt* evt)
+{
+	sinsp_threadinfo* tinfo = evt->get_thread_info();
+
+	switch(e)
+	{
+	case ENTITY_PROCESS:
+		if(tinfo == NULL)
+		{
+			return -1;
+		}
+		return find_row(m_pids, m_tables[e], tinfo->m_pid);
+	case ENTITY_CONTAINER:
+		if(tinfo == NULL)
+		{
+			return -1;
+		}
+		return find_row(m_containers, m_tables[e], tinfo->m_container_id);
+	case ENTITY_CONNECTION:
+	{
+		sinsp_conn_key key;
+		if(!sinsp_conn_index::make_key(evt->get_fd_info(), &key))
+		{
+			return -1;
+		}
+		return find_row(m_connections, m_tables[e], key);
+	}
+	default:
+		return -1;
+	}
+}
+
+void sinsp_rollup::process_event(sinsp_evt* evt)
+{
+	uint64_t ts = evt->get_ts();
+
+	if(ts >= m_next_ts)
+	{
+		if(m_next_ts != 0)
+		{
+			flush();
+		}
+
+		m_start_ts = ts - ts % m_interval_ns;
+		m_next_ts = m_start_ts + m_interval_ns;
+	}
+
+	//
+	// An event usually feeds several metrics of the same entity: look it up
+	// once
+	//
+	int64_t rows[ENTITY_MAX];
+	bool found[ENTITY_MAX] = {false, false, false};
+
+	for(metric_state& m : m_metrics)
+	{
+		if(m.m_filter != NULL && !m.m_filter->run(evt))
+		{
+			continue;
+		}
+
+		uint64_t val = 1;
+		if(m.m_field != NULL && !extract(m.m_field, evt, &val))
+		{
+			continue;
+		}
+
+		entity e = m.m_def.m_entity;
+		if(!found[e])
+		{
+			rows[e] = find_row(e, evt);
+			found[e] = true;
+		}
+
+		if(rows[e] == -1)
+		{
+			continue;
+		}
+
+		table& t = m_tables[e];
+		uint64_t* counters = &t.m_values[rows[e] * t.m_stride + m.m_offset];
+
+		switch(m.m_def.m_aggregation)
+		{
+		case AGG_COUNT:
+			counters[0]++;
+			break;
+		case AGG_SUM:
+			counters[0] += val;
+			break;
+		case AGG_HISTOGRAM:
+			counters[(int64_t)val < 0 ? 0 : sinsp_log2_histogram::get_bucket(val)]++;
+			break;
+		}
+	}
+}
+
+void sinsp_rollup::flush()
+{
+	bool empty = true;
+	for(const table& t : m_tables)
+	{
+		empty &= t.m_n_rows == 0;
+	}
+
+	if(!empty && m_snapshot_cb)
+	{
+		m_snapshot_cb(*this, m_start_ts, m_next_ts);
+	}
+
+	clear();
+}
+
+void sinsp_rollup::clear()
+{
+	for(table& t : m_tables)
+	{
+		t.m_n_rows = 0;
+	}
+
+	m_pids.m_index.clear();
+	m_pids.m_keys.clear();
+	m_containers.m_index.clear();
+	m_containers.m_keys.clear();
+	m_connections.m_index.clear();
+	m_connections.m_keys.clear();
+}
+
+void sinsp_rollup::on_capture_start()
+{
+	clear();
+	m_next_ts = 0;
+}
@@ -0,0 +1,232 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "conn_index.h"
+
+class sinsp;
+class sinsp_evt;
+class sinsp_filter;
+class sinsp_filter_check;
+
+///////////////////////////////////////////////////////////////////////////////
+// Per-entity aggregates computed while the events are parsed, for consumers
+// that only need them and not the events.
+//
+// A metric counts the events of an entity, or sums or makes a histogram of a
+// numeric field of them, optionally only for the events that match a filter:
+//
+//   sinsp_rollup& r = inspector.enable_rollups();
+//   r.add_metric({"write_bytes", sinsp_rollup::ENTITY_CONTAINER,
+//       sinsp_rollup::AGG_SUM, "evt.rawres", "evt.type=write and evt.rawres>0"});
+//
+// The entities are the processes (by pid), the containers (by id, "" for the
+// host) and the TCP connections (by endpoints, like sinsp_conn_index). Each
+// one has a flat row of counters, get_stride() of them, updated in place: a
+// count and a sum take one counter, a histogram HISTOGRAM_BUCKETS of them,
+// bucketed like sinsp_log2_histogram, negative values in the first one.
+//
+// Every interval, aligned on the event timestamps, and at the end of the
+// capture, the snapshot callback is given the rows of the interval, then
+// they're cleared. At most max_entities entities of each kind are kept per
+// interval; the events of the others are counted as dropped.
+///////////////////////////////////////////////////////////////////////////////
+class sinsp_rollup
+{
+public:
+	enum entity
+	{
+		ENTITY_PROCESS = 0,
+		ENTITY_CONTAINER = 1,
+		ENTITY_CONNECTION = 2,
+		ENTITY_MAX = 3,
+	};
+
+	enum aggregation
+	{
+		AGG_COUNT = 0,
+		AGG_SUM = 1,
+		AGG_HISTOGRAM = 2,
+	};
+
+	struct metric
+	{
+		std::string m_name;
+		entity m_entity;
+		aggregation m_aggregation;
+		// Numeric field summed or bucketed, unused by AGG_COUNT
+		std::string m_field;
+		// Empty for all the events
+		std::string m_filter;
+	};
+
+	//
+	// Called with the rollup, whose rows can be read, and the interval
+	// they cover
+	//
+	typedef std::function<void(const sinsp_rollup& rollup, uint64_t start_ts, uint64_t end_ts)> snapshot_cb;
+
+	static const uint32_t HISTOGRAM_BUCKETS = sinsp_log2_histogram::N_BUCKETS;
+	static const uint64_t DEFAULT_INTERVAL_NS = 10000000000ULL;
+	static const uint32_t DEFAULT_MAX_ENTITIES = 65536;
+
+	sinsp_rollup(sinsp* inspector);
+	~sinsp_rollup();
+
+	//
+	// Returns the index of the metric. Throws if the field isn't numeric or
+	// the filter is invalid. Metrics are added before the capture starts.
+	//
+	uint32_t add_metric(const metric& m);
+
+	uint32_t get_n_metrics() const
+	{
+		return (uint32_t)m_metrics.size();
+	}
+
+	const metric& get_metric(uint32_t j) const
+	{
+		return m_metrics[j].m_def;
+	}
+
+	//
+	// Position of the counters of metric j in the rows of its entity
+	//
+	uint32_t get_offset(uint32_t j) const
+	{
+		return m_metrics[j].m_offset;
+	}
+
+	uint32_t get_stride(entity e) const
+	{
+		return m_tables[e].m_stride;
+	}
+
+	void set_interval(uint64_t ns)
+	{
+		m_interval_ns = ns;
+	}
+
+	void set_max_entities(uint32_t n)
+	{
+		m_max_entities = n;
+	}
+
+	void set_snapshot_callback(snapshot_cb cb)
+	{
+		m_snapshot_cb = cb;
+	}
+
+	//
+	// The rows, valid in the snapshot callback
+	//
+	uint32_t get_n_entities(entity e) const
+	{
+		return (uint32_t)m_tables[e].m_n_rows;
+	}
+
+	const uint64_t* get_row(entity e, uint32_t row) const
+	{
+		return &m_tables[e].m_values[row * m_tables[e].m_stride];
+	}
+
+	int64_t get_pid(uint32_t row) const
+	{
+		return m_pids.m_keys[row];
+	}
+
+	const std::string& get_container_id(uint32_t row) const
+	{
+		return m_containers.m_keys[row];
+	}
+
+	const sinsp_conn_key& get_connection(uint32_t row) const
+	{
+		return m_connections.m_keys[row];
+	}
+
+	//
+	// Events not accounted because their entity was over max_entities
+	//
+	uint64_t get_n_dropped() const
+	{
+		return m_n_dropped;
+	}
+
+	//
+	// Sets, in evttypes, the event types the metrics need: those of their
+	// filters, all of them for a metric without one. Used for the automatic
+	// event mask, see sinsp::set_auto_eventmask().
+	//
+	void get_evttypes(std::vector<bool>& evttypes) const;
+
+	void on_capture_start();
+	void process_event(sinsp_evt* evt);
+
+	//
+	// Delivers the current interval, if anything happened in it
+	//
+	void flush();
+
+private:
+	struct metric_state
+	{
+		metric m_def;
+		uint32_t m_offset;
+		sinsp_filter_check* m_field;
+		sinsp_filter* m_filter;
+	};
+
+	struct table
+	{
+		uint32_t m_stride;
+		uint32_t m_n_rows;
+		std::vector<uint64_t> m_values;
+	};
+
+	template<typename K, typename H = std::hash<K>>
+	struct keys
+	{
+		std::unordered_map<K, uint32_t, H> m_index;
+		std::vector<K> m_keys;
+	};
+
+	bool extract(sinsp_filter_check* chk, sinsp_evt* evt, uint64_t* val);
+	int64_t find_row(entity e, sinsp_evt* evt);
+	template<typename K, typename H>
+	int64_t find_row(keys<K, H>& k, table& t, const K& key);
+	void clear();
+
+	sinsp* m_inspector;
+	std::vector<metric_state> m_metrics;
+	table m_tables[ENTITY_MAX];
+	keys<int64_t> m_pids;
+	keys<std::string> m_containers;
+	keys<sinsp_conn_key, sinsp_conn_key_hash> m_connections;
+	uint64_t m_interval_ns;
+	uint32_t m_max_entities;
+	snapshot_cb m_snapshot_cb;
+	uint64_t m_start_ts;
+	uint64_t m_next_ts;
+	uint64_t m_n_dropped;
+};
@@ -23,8 +23,7 @@ limitations under the License.
 #define INCLUDE_UNKNOWN_SOCKET_FDS
 
 //
-// Memory storage size for an entry in the event storage LIFO.
-// Events bigger than SP_EVT_BUF_SIZE won't be be stored in the LIFO.
+// Memory storage size for the k8s and mesos metaevents.
 //
 #define SP_EVT_BUF_SIZE 4096
 
@@ -67,6 +67,10 @@ sinsp::sinsp(bool static_container, const std::string static_id, const std::stri
 	m_external_event_processor(),
 	m_evt(this),
 	m_lastevent_ts(0),
+	m_conn_index(this),
+	m_skb_correlator(&m_conn_index),
+	m_memory_budget(this),
+	m_evt_handles(this),
 	m_container_manager(this, static_container, static_id, static_name, static_image),
 	m_suppressed_comms()
 {
@@ -91,6 +95,8 @@ sinsp::sinsp(bool static_container, const std::string static_id, const std::stri
 #ifdef HAS_FILTERING
 	m_filter = NULL;
 	m_evttype_filter = NULL;
+	m_auto_eventmask = false;
+	m_auto_eventmask_generation = 0;
 #endif
 
 	m_fds_to_remove = new vector<int64_t>;
@@ -117,11 +123,13 @@ sinsp::sinsp(bool static_container, const std::string static_id, const std::stri
 	m_get_procs_cpu_from_driver = false;
 	m_is_tracers_capture_enabled = false;
 	m_file_start_offset = 0;
+	m_stop_at_checkpoints = false;
 	m_flush_memory_dump = false;
 	m_next_stats_print_time_ns = 0;
 	m_large_envs_enabled = false;
 	m_increased_snaplen_port_range = DEFAULT_INCREASE_SNAPLEN_PORT_RANGE;
 	m_statsd_port = -1;
+	m_pipeline_sample.m_timed = false;
 
 	// Unless the cmd line arg "-pc" or "-pcontainer" is supplied this is false
 	m_print_container_data = false;
@@ -218,6 +226,7 @@ sinsp::~sinsp()
 void sinsp::add_protodecoders()
 {
 	m_parser->add_protodecoder("syslog");
+	m_parser->add_protodecoder("dns");
 }
 
 void sinsp::filter_proc_table_when_saving(bool filter)
@@ -309,6 +318,9 @@ void sinsp::init()
 #endif
 
 	m_nevts = 0;
+	m_field_cache.reset();
+	m_conn_index.clear();
+	m_skb_correlator.clear();
 	m_tid_to_remove = -1;
 	m_lastevent_ts = 0;
 #ifdef HAS_FILTERING
@@ -324,6 +336,7 @@ void sinsp::init()
 		m_partial_tracers_pool->push(*it);
 	}
 	m_partial_tracers_list.clear();
+	m_partial_tracers_index.clear();
 
 	//
 	// If we're reading from file, we try to pre-parse the container events before
@@ -402,6 +415,14 @@ void sinsp::init()
 	{
 		m_external_event_processor->on_capture_start();
 	}
+	//
+	// The driver starts without shedding anything
+	//
+	if(m_load_shedder)
+	{
+		m_load_shedder->reset();
+	}
+
 	//
 	// If m_snaplen was modified, we set snaplen now
 	//
@@ -409,6 +430,19 @@ void sinsp::init()
 	{
 		set_snaplen(m_snaplen);
 	}
+
+	if(m_rollup)
+	{
+		m_rollup->on_capture_start();
+	}
+
+#ifdef HAS_FILTERING
+	m_eventmask.clear();
+	if(m_auto_eventmask)
+	{
+		update_eventmask();
+	}
+#endif
 	// If env was set, open the skb capture
 	const char *skb_capture = getenv(KINDLING_SKB_CAPTURE_ENV);
 	if(skb_capture != nullptr)
@@ -494,6 +528,18 @@ void sinsp::open_live_common(uint32_t timeout_ms, scap_mode_t mode)
 
 	add_suppressed_comms(oargs);
 
+	oargs.warm_state_file = NULL;
+	if(!m_warm_state_file.empty())
+	{
+		load_warm_containers();
+		oargs.warm_state_file = m_warm_state_file.c_str();
+	}
+
+	//
+	// Get the container metadata coming while scap_open() scans /proc
+	//
+	m_container_manager.prefetch_containers();
+
 	int32_t scap_rc;
 	m_h = scap_open(oargs, error, &scap_rc);
 
@@ -548,6 +594,15 @@ void sinsp::open_nodriver()
 	oargs.proc_scan_timeout_ms = m_proc_scan_timeout_ms;
 	oargs.proc_scan_log_interval_ms = m_proc_scan_log_interval_ms;
 
+	oargs.warm_state_file = NULL;
+	if(!m_warm_state_file.empty())
+	{
+		load_warm_containers();
+		oargs.warm_state_file = m_warm_state_file.c_str();
+	}
+
+	m_container_manager.prefetch_containers();
+
 	int32_t scap_rc;
 	m_h = scap_open(oargs, error, &scap_rc);
 
@@ -692,6 +747,7 @@ void sinsp::open_int()
 	oargs.debug_log_fn = &sinsp_scap_debug_log_fn;
 	oargs.proc_scan_timeout_ms = m_proc_scan_timeout_ms;
 	oargs.proc_scan_log_interval_ms = m_proc_scan_log_interval_ms;
+	oargs.warm_state_file = NULL;
 
 	int32_t scap_rc;
 	m_h = scap_open(oargs, error, &scap_rc);
@@ -701,6 +757,8 @@ void sinsp::open_int()
 		throw scap_open_exception(error, scap_rc);
 	}
 
+	scap_set_stop_at_checkpoints(m_h, m_stop_at_checkpoints);
+
 	if(m_input_fd != 0)
 	{
 		// We can't get a reliable filesize
@@ -728,12 +786,25 @@ void sinsp::open(const std::string &filename)
 	}
 
 	m_input_filename = filename;
+	m_file_start_offset = 0;
+	m_stop_at_checkpoints = false;
 
 	g_logger.log("starting offline capture");
 
 	open_int();
 }
 
+void sinsp::open_checkpoint(const std::string &filename, uint64_t offset)
+{
+	m_input_filename = filename;
+	m_file_start_offset = offset;
+	m_stop_at_checkpoints = true;
+
+	g_logger.format("starting offline capture at checkpoint %" PRIu64, offset);
+
+	open_int();
+}
+
 void sinsp::fdopen(int fd)
 {
 	m_input_fd = fd;
@@ -806,6 +877,94 @@ void sinsp::autodump_start(const string& dump_filename, bool compress)
 	m_container_manager.dump_containers(m_dumper);
 }
 
+void sinsp::save_state(const std::string& filename)
+{
+	if(NULL == m_h)
+	{
+		throw sinsp_exception("inspector not opened yet");
+	}
+
+	std::string tmp_filename = filename + ".tmp";
+	scap_dumper_t* dumper = scap_dump_open(m_h, tmp_filename.c_str(), SCAP_COMPRESSION_NONE, true);
+	if(NULL == dumper)
+	{
+		throw sinsp_exception(scap_getlasterr(m_h));
+	}
+
+	std::vector<int64_t> tids;
+	m_thread_manager->get_threads()->loop([&] (sinsp_threadinfo& tinfo) {
+		tids.push_back(tinfo.m_tid);
+		return true;
+	});
+
+	try
+	{
+		m_thread_manager->dump_threads_to_file(dumper);
+
+		if(scap_write_proc_starttimes(m_h, dumper, tids.data(), (uint32_t)tids.size()) != SCAP_SUCCESS)
+		{
+			throw sinsp_exception(scap_getlasterr(m_h));
+		}
+
+		m_container_manager.dump_containers(dumper);
+	}
+	catch(...)
+	{
+		scap_dump_close(dumper);
+		remove(tmp_filename.c_str());
+		throw;
+	}
+
+	scap_dump_close(dumper);
+
+#ifdef _WIN32
+	remove(filename.c_str());
+#endif
+	if(rename(tmp_filename.c_str(), filename.c_str()) != 0)
+	{
+		remove(tmp_filename.c_str());
+		throw sinsp_exception("can't write " + filename + ": " + strerror(errno));
+	}
+}
+
+//
+// The containers of a state are CONTAINER_JSON events, as in a capture.
+// scap_open() takes care of the threads and fds.
+//
+void sinsp::load_warm_containers()
+{
+	char error[SCAP_LASTERR_SIZE];
+	int32_t scap_rc;
+	scap_open_args oargs = {};
+
+	oargs.mode = SCAP_MODE_CAPTURE;
+	oargs.fname = m_warm_state_file.c_str();
+	oargs.proc_callback = [](void*, scap_t*, int64_t, scap_threadinfo*, scap_fdinfo*) {};
+	oargs.import_users = false;
+
+	scap_t* h = scap_open(oargs, error, &scap_rc);
+	if(h == NULL)
+	{
+		// A state without containers has no events at all
+		g_logger.format(sinsp_logger::SEV_DEBUG, "no containers loaded from %s: %s", m_warm_state_file.c_str(), error);
+		return;
+	}
+
+	scap_evt* pevt;
+	uint16_t cpuid;
+	while(scap_next(h, &pevt, &cpuid) == SCAP_SUCCESS)
+	{
+		if(pevt->type == PPME_CONTAINER_JSON_E)
+		{
+			sinsp_evt evt(this);
+			evt.init((uint8_t*)pevt, cpuid);
+			m_parser->parse_container_json_evt(&evt);
+		}
+	}
+
+	scap_close(h);
+}
+
 void sinsp::autodump_next_file()
 {
 	autodump_stop();
@@ -1082,6 +1241,60 @@ uint64_t sinsp::max_buf_used()
 	}
 }
 
+sinsp_rollup& sinsp::enable_rollups()
+{
+	if(!m_rollup)
+	{
+		m_rollup.reset(new sinsp_rollup(this));
+	}
+
+	return *m_rollup;
+}
+
+sinsp_load_shedder& sinsp::enable_load_shedding()
+{
+	if(!m_load_shedder)
+	{
+		m_load_shedder_actuator.reset(new sinsp_load_shedder_inspector_actuator(this));
+		m_load_shedder.reset(new sinsp_load_shedder(m_load_shedder_actuator.get()));
+		m_load_shedder->set_snaplen(m_snaplen);
+	}
+
+	return *m_load_shedder;
+}
+
+void sinsp::update_load_shedder(uint64_t ts)
+{
+	sinsp_load_shedder::sample sample;
+	scap_stats stats;
+
+	sample.m_ts = ts;
+	sample.m_max_buf_used = scap_max_buf_used(m_h);
+	sample.m_n_drops = 0;
+	if(scap_get_stats(m_h, &stats) == SCAP_SUCCESS)
+	{
+		sample.m_n_drops = stats.n_drops;
+	}
+
+	sample.m_cpu_ns = 0;
+#ifndef _WIN32
+	struct timespec cpu;
+	if(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu) == 0)
+	{
+		sample.m_cpu_ns = cpu.tv_sec * ONE_SECOND_IN_NS + cpu.tv_nsec;
+	}
+#endif
+
+	try
+	{
+		m_load_shedder->update(sample);
+	}
+	catch(const sinsp_exception& e)
+	{
+		g_logger.format(sinsp_logger::SEV_WARNING, "load shedding failed: %s", e.what());
+	}
+}
+
 void sinsp::get_procs_cpu_from_driver(uint64_t ts)
 {
 	if(ts <= m_next_flush_time_ns)
@@ -1124,10 +1337,58 @@ void sinsp::get_procs_cpu_from_driver(uint64_t ts)
 	}
 }
 
+namespace
+{
+//
+// Commits the pipeline stats of the event being returned by sinsp::next(),
+// whatever the return path.
+//
+class pipeline_stats_commit
+{
+public:
+	pipeline_stats_commit(sinsp_pipeline_stats& stats, sinsp_pipeline_stats::sample& sample):
+		m_stats(stats),
+		m_sample(sample),
+		m_evt(NULL)
+	{
+	}
+
+	~pipeline_stats_commit()
+	{
+		if(m_evt != NULL)
+		{
+			m_stats.on_event(m_sample, m_evt->get_type(), m_evt->get_cpuid());
+		}
+	}
+
+	void set_evt(sinsp_evt* evt)
+	{
+		m_evt = evt;
+	}
+
+private:
+	sinsp_pipeline_stats& m_stats;
+	sinsp_pipeline_stats::sample& m_sample;
+	sinsp_evt* m_evt;
+};
+}
+
 int32_t sinsp::next(OUT sinsp_evt **puevt)
 {
 	sinsp_evt* evt;
 	int32_t res;
+	uint64_t stage_start;
+	bool pipeline_stats_enabled = m_pipeline_stats.is_enabled();
+	pipeline_stats_commit pstats_commit(m_pipeline_stats, m_pipeline_sample);
+
+	if(pipeline_stats_enabled)
+	{
+		m_pipeline_stats.begin_event(m_pipeline_sample);
+	}
+	else
+	{
+		m_pipeline_sample.m_timed = false;
+	}
 
 	//
 	// Check if there are fake cpu events to  events
@@ -1171,7 +1432,9 @@ int32_t sinsp::next(OUT sinsp_evt **puevt)
 		//
 		// Get the event from libscap
 		//
+		stage_start = m_pipeline_stats.stage_start(m_pipeline_sample);
 		res = scap_next(m_h, &(evt->m_pevt), &(evt->m_cpuid));
+		m_pipeline_stats.stage_end(m_pipeline_sample, sinsp_pipeline_stats::STAGE_SCAP_NEXT, stage_start);
 
 		if(res != SCAP_SUCCESS)
 		{
@@ -1190,6 +1453,11 @@ int32_t sinsp::next(OUT sinsp_evt **puevt)
 				{
 					m_external_event_processor->process_event(NULL, libsinsp::EVENT_RETURN_EOF);
 				}
+
+				if(m_rollup)
+				{
+					m_rollup->flush();
+				}
 			}
 			else if(res == SCAP_UNEXPECTED_BLOCK)
 			{
@@ -1207,6 +1475,11 @@ int32_t sinsp::next(OUT sinsp_evt **puevt)
 		}
 	}
 
+	if(pipeline_stats_enabled)
+	{
+		pstats_commit.set_evt(evt);
+	}
+
 	uint64_t ts = evt->get_ts();
 
 	if(m_firstevent_ts == 0 && evt->m_pevt->type != PPME_CONTAINER_JSON_E)
@@ -1222,6 +1495,25 @@ int32_t sinsp::next(OUT sinsp_evt **puevt)
 		get_procs_cpu_from_driver(ts);
 	}
 
+	//
+	// If load shedding is on, check once per tick whether we keep up
+	// with the driver
+	//
+	if(m_load_shedder && is_live() && m_load_shedder->is_due(ts))
+	{
+		update_load_shedder(ts);
+	}
+
+#ifdef HAS_FILTERING
+	//
+	// Follow the changes of the filters with the driver event mask
+	//
+	if(m_auto_eventmask && get_filters_generation() != m_auto_eventmask_generation)
+	{
+		update_eventmask();
+	}
+#endif
+
 	//
 	// Store a couple of values that we'll need later inside the event.
 	//
@@ -1229,6 +1521,8 @@ int32_t sinsp::next(OUT sinsp_evt **puevt)
 	evt->m_evtnum = m_nevts;
 	m_lastevent_ts = ts;
 
+	m_memory_budget.enforce(ts);
+
 	if (m_automatic_threadtable_purging)
 	{
 		//
@@ -1316,6 +1610,11 @@ int32_t sinsp::next(OUT sinsp_evt **puevt)
 		m_fds_to_remove->clear();
 	}
 
+	//
+	// The connection snapshots go by event time, whatever the events
+	//
+	m_conn_index.on_event(ts);
+
 #ifdef SIMULATE_DROP_MODE
 	bool sd = false;
 	bool sw = false;
@@ -1331,6 +1630,7 @@ int32_t sinsp::next(OUT sinsp_evt **puevt)
 	//
 	// Run the state engine
 	//
+	stage_start = m_pipeline_stats.stage_start(m_pipeline_sample);
 #ifdef SIMULATE_DROP_MODE
 	if(!sd || m_isdropping)
 	{
@@ -1345,6 +1645,21 @@ int32_t sinsp::next(OUT sinsp_evt **puevt)
 #else
 	m_parser->process_event(evt);
 #endif
+	if(m_pipeline_sample.m_timed)
+	{
+		// Filtering is run by the parser but accounted separately
+		m_pipeline_stats.stage_end(m_pipeline_sample, sinsp_pipeline_stats::STAGE_PARSE, stage_start);
+		m_pipeline_sample.m_stage_ns[sinsp_pipeline_stats::STAGE_PARSE] -=
+			m_pipeline_sample.m_stage_ns[sinsp_pipeline_stats::STAGE_FILTER];
+	}
+
+	//
+	// Update the rollups from the state just parsed
+	//
+	if(m_rollup)
+	{
+		m_rollup->process_event(evt);
+	}
 
 	//
 	// If needed, dump the event to file
@@ -1385,7 +1700,9 @@ int32_t sinsp::next(OUT sinsp_evt **puevt)
 
 		scap_evt* pdevt = (evt->m_poriginal_evt)? evt->m_poriginal_evt : evt->m_pevt;
 
+		stage_start = m_pipeline_stats.stage_start(m_pipeline_sample);
 		res = scap_dump(m_h, m_dumper, pdevt, evt->m_cpuid, dflags);
+		m_pipeline_stats.stage_end(m_pipeline_sample, sinsp_pipeline_stats::STAGE_DUMP, stage_start);
 
 		if(SCAP_SUCCESS != res)
 		{
@@ -1413,7 +1730,9 @@ int32_t sinsp::next(OUT sinsp_evt **puevt)
 	//
 	if (m_external_event_processor)
 	{
+		stage_start = m_pipeline_stats.stage_start(m_pipeline_sample);
 		m_external_event_processor->process_event(evt, libsinsp::EVENT_RETURN_NONE);
+		m_pipeline_stats.stage_end(m_pipeline_sample, sinsp_pipeline_stats::STAGE_PROCESSOR, stage_start);
 	}
 
 	// Clean parse related event data after analyzer did its parsing too
@@ -1550,18 +1869,44 @@ void sinsp::set_container_labels_max_len(uint32_t max_label_len)
 	m_container_manager.set_container_labels_max_len(max_label_len);
 }
 
+void sinsp::set_container_lookup_workers(uint32_t num_workers)
+{
+	m_container_manager.set_container_lookup_workers(num_workers);
+}
+
+void sinsp::set_container_prefetch(bool enabled)
+{
+	m_container_manager.set_container_prefetch(enabled);
+}
+
 void sinsp::set_snaplen(uint32_t snaplen)
 {
 	//
-	// If set_snaplen is called before opening of the inspector,
-	// we register the value to be set after its initialization.
+	// Saved in any case: it's the one restored when the load shedding
+	// stops, and the one set after the initialization if set_snaplen
+	// is called before opening of the inspector.
 	//
+	m_snaplen = snaplen;
+
+	//
+	// While shedding, the driver keeps the reduced one
+	//
+	if(m_load_shedder)
+	{
+		m_load_shedder->set_snaplen(snaplen);
+		snaplen = m_load_shedder->get_snaplen();
+	}
+
 	if(m_h == NULL)
 	{
-		m_snaplen = snaplen;
 		return;
 	}
 
+	apply_snaplen(snaplen);
+}
+
+void sinsp::apply_snaplen(uint32_t snaplen)
+{
 	if(is_live() && scap_set_snaplen(m_h, snaplen) != SCAP_SUCCESS)
 	{
 		throw sinsp_exception(scap_getlasterr(m_h));
@@ -1668,6 +2013,11 @@ void sinsp::set_filter(sinsp_filter* filter)
 	}
 
 	m_filter = filter;
+
+	if(m_auto_eventmask)
+	{
+		update_eventmask();
+	}
 }
 
 void sinsp::set_filter(const string& filter)
@@ -1681,6 +2031,11 @@ void sinsp::set_filter(const string& filter)
 	sinsp_filter_compiler compiler(this, filter);
 	m_filter = compiler.compile();
 	m_filterstring = filter;
+
+	if(m_auto_eventmask)
+	{
+		update_eventmask();
+	}
 }
 
 const string sinsp::get_filter()
@@ -1705,22 +2060,190 @@ void sinsp::add_evttype_filter(string &name,
 
 bool sinsp::run_filters_on_evt(sinsp_evt *evt)
 {
+	bool res = false;
+	uint64_t stage_start = m_pipeline_stats.stage_start(m_pipeline_sample);
+
 	//
 	// First run the global filter, if there is one.
 	//
 	if(m_filter && m_filter->run(evt) == true)
 	{
-		return true;
+		res = true;
 	}
-
 	//
 	// Then run the evttype filter, if there is one.
-	if(m_evttype_filter && m_evttype_filter->run(evt) == true)
+	//
+	else if(m_evttype_filter && m_evttype_filter->run(evt) == true)
 	{
-		return true;
+		res = true;
 	}
 
-	return false;
+	m_pipeline_stats.stage_end(m_pipeline_sample, sinsp_pipeline_stats::STAGE_FILTER, stage_start);
+	return res;
+}
+
+void sinsp::set_auto_eventmask(bool enabled)
+{
+	m_auto_eventmask = enabled;
+	update_eventmask();
+}
+
+void sinsp::add_auto_eventmask_filter(sinsp_evttype_filter* filter)
+{
+	m_auto_eventmask_filters.push_back(filter);
+
+	if(m_auto_eventmask)
+	{
+		update_eventmask();
+	}
+}
+
+void sinsp::get_auto_eventmask(std::vector<bool>& evttypes)
+{
+	std::vector<bool> needed;
+	bool has_consumers = false;
+
+	evttypes.assign(PPM_EVENT_MAX + 1, false);
+
+	auto add = [&](const std::vector<bool>& more)
+	{
+		for(uint32_t j = 0; j < PPM_EVENT_MAX; j++)
+		{
+			evttypes[j] = evttypes[j] || more[j];
+		}
+		has_consumers = true;
+	};
+
+	if(m_filter != NULL)
+	{
+		m_filter->evttypes(needed);
+		add(needed);
+	}
+
+	if(m_evttype_filter != NULL)
+	{
+		m_evttype_filter->evttypes_for_all_rulesets(needed);
+		add(needed);
+	}
+
+	for(sinsp_evttype_filter* filter : m_auto_eventmask_filters)
+	{
+		filter->evttypes_for_all_rulesets(needed);
+		add(needed);
+	}
+
+	if(m_external_event_processor)
+	{
+		m_external_event_processor->get_evttypes(needed);
+		add(needed);
+	}
+
+	if(m_rollup && m_rollup->get_n_metrics() != 0)
+	{
+		m_rollup->get_evttypes(needed);
+		add(needed);
+	}
+
+	//
+	// Nobody told what they need
+	//
+	if(!has_consumers)
+	{
+		evttypes.assign(PPM_EVENT_MAX + 1, true);
+		return;
+	}
+
+	//
+	// What the parsers need to keep the thread and fd tables right. The
+	// driver never masks the events that modify the state anyway.
+	//
+	for(uint32_t j = 0; j < PPM_EVENT_MAX; j++)
+	{
+		const struct ppm_event_info* info = &g_infotables.m_event_info[j];
+
+		if((info->flags & EF_MODIFIES_STATE) || (info->category & EC_INTERNAL))
+		{
+			evttypes[j] = true;
+		}
+	}
+
+	//
+	// The tracers write their spans to /dev/null
+	//
+	if(m_is_tracers_capture_enabled)
+	{
+		evttypes[PPME_SYSCALL_WRITE_E] = true;
+		evttypes[PPME_SYSCALL_WRITE_X] = true;
+	}
+}
+
+uint64_t sinsp::get_filters_generation()
+{
+	uint64_t generation = 0;
+
+	if(m_evttype_filter != NULL)
+	{
+		generation += m_evttype_filter->get_generation();
+	}
+
+	for(sinsp_evttype_filter* filter : m_auto_eventmask_filters)
+	{
+		generation += filter->get_generation();
+	}
+
+	return generation;
+}
+
+void sinsp::update_eventmask()
+{
+	std::vector<bool> evttypes;
+
+	m_auto_eventmask_generation = get_filters_generation();
+
+	if(m_h == NULL || !is_live())
+	{
+		return;
+	}
+
+	if(m_auto_eventmask)
+	{
+		get_auto_eventmask(evttypes);
+	}
+	else
+	{
+		evttypes.assign(PPM_EVENT_MAX + 1, true);
+	}
+
+	try
+	{
+		for(uint32_t j = 0; j < PPM_EVENT_MAX; j++)
+		{
+			bool enabled = m_eventmask.empty() || m_eventmask[j];
+			if(evttypes[j] == enabled)
+			{
+				continue;
+			}
+
+			if(!evttypes[j])
+			{
+				unset_eventmask(j);
+			}
+			//
+			// The load shedder unmasks it when the load goes away
+			//
+			else if(!m_load_shedder || !m_load_shedder->is_masked(j))
+			{
+				set_eventmask(j);
+			}
+		}
+	}
+	catch(const sinsp_exception& e)
+	{
+		g_logger.format(sinsp_logger::SEV_WARNING, "cannot set the event mask: %s", e.what());
+		return;
+	}
+
+	m_eventmask = evttypes;
 }
 #endif
 
@@ -2476,6 +2999,18 @@ bool sinsp_thread_manager::remove_inactive_threads()
 #endif
 				to_delete[tinfo.m_tid] = closed;
 			}
+			else if(tinfo.m_lastevent_data != NULL &&
+				m_inspector->m_lastevent_ts > tinfo.m_lastaccess_ts + m_inspector->m_inactive_thread_scan_time_ns)
+			{
+				//
+				// Idle for a whole scan, e.g. blocked in the syscall:
+				// free the enter event it stored. Its exit, if it ever
+				// comes, is handled like the ones of a dropped enter.
+				//
+				m_inspector->m_enter_store.release(tinfo.m_lastevent_data);
+				tinfo.m_lastevent_data = NULL;
+				tinfo.set_lastevent_data_validity(false);
+			}
 			return true;
 		});
 
@@ -2489,6 +3024,8 @@ bool sinsp_thread_manager::remove_inactive_threads()
 		// exited but that are stuck because of reference counting.
 		//
 		recreate_child_dependencies();
+
+		m_inspector->m_enter_store.trim();
 	}
 
 	return res;
@@ -2552,3 +3089,8 @@ libsinsp::event_processor::build_threadinfo(sinsp* inspector)
 {
 	return new sinsp_threadinfo(inspector);
 }
+
+void libsinsp::event_processor::get_evttypes(std::vector<bool>& evttypes)
+{
+	evttypes.assign(PPM_EVENT_MAX + 1, true);
+}
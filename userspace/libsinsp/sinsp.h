@@ -72,8 +72,16 @@ using namespace std;
 #include "logger.h"
 #include "event.h"
 #include "filter.h"
+#include "field_cache.h"
+#include "enter_event_store.h"
+#include "conn_index.h"
+#include "skb_correlator.h"
+#include "load_shedder.h"
+#include "memory_budget.h"
+#include "rollup.h"
 #include "dumper.h"
 #include "stats.h"
+#include "pipeline_stats.h"
 #include "ifinfo.h"
 #include "container.h"
 #include "viewinfo.h"
@@ -92,6 +100,7 @@ using namespace std;
 #include "tuples.h"
 #include "fdinfo.h"
 #include "threadinfo.h"
+#include "event_handle.h"
 #include "ifinfo.h"
 #include "eventformatter.h"
 #include "sinsp_pd_callback_type.h"
@@ -230,6 +239,19 @@ public:
 	*/
 	void open(const std::string &filename);
 
+	/*!
+	  \brief Start an event capture from a checkpoint of a trace file,
+	   with the state it contains, up to the next checkpoint.
+
+	  \param filename the trace file name.
+	  \param offset the offset of the checkpoint, as returned by
+	   scap_find_checkpoints(), or 0 for the beginning of the file.
+
+	  @throws a sinsp_exception containing the error string is thrown in case
+	   of failure.
+	*/
+	void open_checkpoint(const std::string &filename, uint64_t offset);
+
 	/*!
 	  \brief Start an event capture from a file descriptor.
 
@@ -365,6 +387,30 @@ public:
 				sinsp_filter* filter);
 
 	bool run_filters_on_evt(sinsp_evt *evt);
+
+	/*!
+	  \brief When enabled, the driver only captures the event types that
+	   the capture filter, the rulesets of the evttype filters, the
+	   external event processor and the rollup metrics need, plus the ones
+	   that keep the thread and fd tables right. The mask follows the
+	   changes of the filters.
+
+	  \note It only affects live captures.
+	*/
+	void set_auto_eventmask(bool enabled);
+
+	/*!
+	  \brief Take the enabled rulesets of the given evttype filter into
+	   account for the automatic event mask. The filter must outlive the
+	   inspector, or the capture.
+	*/
+	void add_auto_eventmask_filter(sinsp_evttype_filter* filter);
+
+	/*!
+	  \brief Populate the provided vector, indexed by event type, with the
+	   event types the automatic event mask lets through.
+	*/
+	void get_auto_eventmask(std::vector<bool>& evttypes);
 #endif
 
 	/*!
@@ -459,6 +505,31 @@ public:
 	*/
 	void autodump_stop();
 
+	/*!
+	  \brief Save the thread and fd tables and the containers to a state
+	   file, for the next start to pass to \ref set_warm_restart_state.
+
+	  \note the file is written aside and renamed over filename, so that an
+	   existing state is only replaced by a complete one.
+
+	  @throws a sinsp_exception containing the error string is thrown in case
+	   of failure.
+	*/
+	void save_state(const std::string& filename);
+
+	/*!
+	  \brief Start the next live capture from a state saved by \ref save_state.
+	   The containers are loaded from the file, and the threads and fds that
+	   are still there are taken from it instead of being read from /proc.
+
+	  \param filename the state file. Empty, or if the file can't be read,
+	   means a cold start.
+	*/
+	void set_warm_restart_state(const std::string& filename)
+	{
+		m_warm_state_file = filename;
+	}
+
 	/*!
 	  \brief Populate the given vector with the full list of filter check fields
 	   that this version of the library supports.
@@ -545,6 +616,164 @@ public:
 	sinsp_stats get_stats();
 #endif
 
+	/*!
+	  \brief Enable or disable the pipeline instrumentation at runtime.
+
+	  \note When enabled, every event returned by next() is counted per
+	   event type and per CPU ring, and one event every
+	   sampling ratio (see sinsp_pipeline_stats::set_sampling_ratio())
+	   gets its scap read, parse, filter, dump and external processor
+	   latencies measured.
+	*/
+	void set_pipeline_stats_enabled(bool enabled)
+	{
+		m_pipeline_stats.set_enabled(enabled);
+	}
+
+	/*!
+	  \brief Return the pipeline instrumentation, to configure it or to
+	   take snapshots. Snapshots can be taken from any thread.
+	*/
+	sinsp_pipeline_stats& get_pipeline_stats()
+	{
+		return m_pipeline_stats;
+	}
+
+	/*!
+	  \brief Return the registry that lets the filter checks of the
+	   filters, formatters, tables and chisels created on this inspector
+	   share the fields they extract, so that every field is extracted
+	   at most once per event.
+
+	  \note It's enabled by default. Disabling it only affects the checks
+	   created afterwards.
+	*/
+	sinsp_field_cache& get_field_cache()
+	{
+		return m_field_cache;
+	}
+
+	/*!
+	  \brief Return the storage of the enter events that the exit parsers
+	   read back, with its memory usage.
+	*/
+	const sinsp_enter_event_store& get_enter_event_store() const
+	{
+		return m_enter_store;
+	}
+
+	/*!
+	  \brief Return the index of the TCP connections of the capture, which
+	   resolves the tcp_* kprobe events to the thread and the fd owning
+	   their connection and keeps the per-connection TCP health stats.
+	*/
+	sinsp_conn_index& get_conn_index()
+	{
+		return m_conn_index;
+	}
+
+	/*!
+	  \brief Return the stage that pairs the skb capture events with the
+	   socket syscalls to measure the in-kernel latency of the connections
+	   of the connection index.
+	*/
+	sinsp_skb_correlator& get_skb_correlator()
+	{
+		return m_skb_correlator;
+	}
+
+	/*!
+	  \brief Turn on the adaptive load shedding of live captures: when the
+	   rings fill up, the driver drops events or the event loop runs out of
+	   CPU, the snaplen is reduced, then the low priority event types are
+	   masked, then the driver samples. Use the returned controller to set
+	   the priorities of the event types and the thresholds.
+
+	  \note The snaplen restored when the load goes away is the last one
+	   passed to set_snaplen().
+	*/
+	sinsp_load_shedder& enable_load_shedding();
+
+	/*!
+	  \brief Return the load shedding controller, NULL if load shedding
+	   isn't enabled.
+	*/
+	sinsp_load_shedder* get_load_shedder()
+	{
+		return m_load_shedder.get();
+	}
+
+	/*!
+	  \brief Set the byte budget of a component of the inspector state, 0
+	   for none, the default. Over it, the new entries are refused and the
+	   least recently used ones evicted (see memory_budget.h).
+	*/
+	void set_memory_budget(sinsp_memory_budget::component comp, uint64_t bytes)
+	{
+		m_memory_budget.set_budget(comp, bytes);
+	}
+
+	/*!
+	  \brief Return the bytes taken by every component of the inspector
+	   state, with their budget and the entries evicted and refused because
+	   of it. The tables are walked, so don't call it for every event.
+	*/
+	sinsp_memory_budget::usage get_memory_usage()
+	{
+		return m_memory_budget.get_usage();
+	}
+
+	const sinsp_memory_budget& get_memory_budget() const
+	{
+		return m_memory_budget;
+	}
+
+	/*!
+	  \brief Allocate n handles to hold events beyond the next call to
+	   next(), none if 0, the default. When all are held, hold_event()
+	   waits up to max_wait_ns for one to be released.
+
+	  \note Throws if events are held.
+	*/
+	void set_event_handles(uint32_t n, uint64_t max_wait_ns = 0)
+	{
+		m_evt_handles.set_size(n, max_wait_ns);
+	}
+
+	/*!
+	  \brief Keep evt, the event just returned by next(), with its thread
+	   and fd, until the returned reference and its copies are gone. They
+	   can be passed to and released by other threads, which can read the
+	   event and its fd but not its thread (see event_handle.h).
+
+	  \return An empty reference if the handles aren't enabled or none is
+	   available.
+	*/
+	sinsp_evt_ref hold_event(sinsp_evt* evt)
+	{
+		return m_evt_handles.hold(evt);
+	}
+
+	sinsp_evt_handle_pool& get_event_handles()
+	{
+		return m_evt_handles;
+	}
+
+	/*!
+	  \brief Turn on the per-entity rollups, computed while the events are
+	   parsed. Use the returned engine to add the metrics, before open(), and
+	   to set the snapshot callback (see rollup.h).
+	*/
+	sinsp_rollup& enable_rollups();
+
+	/*!
+	  \brief Return the rollup engine, NULL if the rollups aren't enabled.
+	*/
+	sinsp_rollup* get_rollups()
+	{
+		return m_rollup.get();
+	}
+
 	libsinsp::event_processor* m_external_event_processor;
 
 	sinsp_threadinfo* build_threadinfo()
@@ -949,6 +1178,10 @@ public:
 	void set_cri_async(bool async);
 	void set_cri_delay(uint64_t delay_ms);
 	void set_container_labels_max_len(uint32_t max_label_len);
+	// Threads used by each container engine to fetch metadata
+	void set_container_lookup_workers(uint32_t num_workers);
+	// Look up all the running containers when opening a live capture
+	void set_container_prefetch(bool enabled);
 
 	uint64_t get_lastevent_ts() const { return m_lastevent_ts; }
 
@@ -1014,6 +1247,7 @@ private:
 	}
 
 	void add_suppressed_comms(scap_open_args &oargs);
+	void load_warm_containers();
 
 	bool increased_snaplen_port_range_set() const
 	{
@@ -1022,6 +1256,15 @@ private:
 	}
 
 	void get_procs_cpu_from_driver(uint64_t ts);
+	void update_load_shedder(uint64_t ts);
+	//
+	// Set the snaplen in the driver only, see set_snaplen()
+	//
+	void apply_snaplen(uint32_t snaplen);
+#ifdef HAS_FILTERING
+	uint64_t get_filters_generation();
+	void update_eventmask();
+#endif
 
 	scap_t* m_h;
 	uint32_t m_nevts;
@@ -1059,10 +1302,23 @@ private:
 	const scap_machine_info* m_machine_info;
 	uint32_t m_num_cpus;
 	sinsp_thread_privatestate_manager m_thread_privatestate_manager;
+	sinsp_enter_event_store m_enter_store;
+	sinsp_field_cache m_field_cache;
+	sinsp_conn_index m_conn_index;
+	sinsp_skb_correlator m_skb_correlator;
+	std::unique_ptr<sinsp_load_shedder_inspector_actuator> m_load_shedder_actuator;
+	std::unique_ptr<sinsp_load_shedder> m_load_shedder;
+	sinsp_memory_budget m_memory_budget;
+	sinsp_evt_handle_pool m_evt_handles;
+	std::unique_ptr<sinsp_rollup> m_rollup;
 	bool m_is_tracers_capture_enabled;
 	// This is used to support reading merged files, where the capture needs to
 	// restart in the middle of the file.
 	uint64_t m_file_start_offset;
+	// Set when reading a single segment between two checkpoints
+	bool m_stop_at_checkpoints;
+	// Set with set_warm_restart_state()
+	std::string m_warm_state_file;
 	bool m_flush_memory_dump;
 	bool m_large_envs_enabled;
 
@@ -1122,6 +1378,15 @@ public:
 	sinsp_evttype_filter *m_evttype_filter;
 	std::string m_filterstring;
 
+	//
+	// Automatic event mask
+	//
+	bool m_auto_eventmask;
+	std::vector<sinsp_evttype_filter*> m_auto_eventmask_filters;
+	uint64_t m_auto_eventmask_generation;
+	// The event types enabled in the driver, empty when all of them are
+	std::vector<bool> m_eventmask;
+
 #endif
 
 	//
@@ -1130,6 +1395,8 @@ public:
 #ifdef GATHER_INTERNAL_STATS
 	sinsp_stats m_stats;
 #endif
+	sinsp_pipeline_stats m_pipeline_stats;
+	sinsp_pipeline_stats::sample m_pipeline_sample;
 #ifdef HAS_ANALYZER
 	std::vector<uint64_t> m_tid_collisions;
 #endif
@@ -1194,6 +1461,8 @@ public:
 	bool m_track_tracers_state;
 	list<sinsp_partial_tracer*> m_partial_tracers_list;
 	simple_lifo_queue<sinsp_partial_tracer>* m_partial_tracers_pool;
+	// Enter spans by hash of (ID, tags), see sinsp_tracerparser
+	unordered_map<uint64_t, sinsp_partial_tracer*> m_partial_tracers_index;
 
 	//
 	// Protocol decoding state
@@ -1247,11 +1516,13 @@ public:
 	friend class sinsp_evt;
 	friend class sinsp_threadinfo;
 	friend class sinsp_fdtable;
+	friend class sinsp_memory_budget;
 	friend class sinsp_thread_manager;
 	friend class sinsp_container_manager;
 	friend class sinsp_dumper;
 	friend class sinsp_analyzer_fd_listener;
 	friend class sinsp_chisel;
+	friend class sinsp_conn_index;
 	friend class sinsp_tracerparser;
 	friend class sinsp_filter_check_event;
 	friend class sinsp_protodecoder;
@@ -1268,6 +1539,7 @@ public:
 	friend class sinsp_memory_dumper;
 	friend class sinsp_network_interfaces;
 	friend class test_helper;
+	friend class sinsp_load_shedder_inspector_actuator;
 
 	template<class TKey,class THash,class TCompare> friend class sinsp_connection_manager;
 
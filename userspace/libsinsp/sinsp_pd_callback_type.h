@@ -27,4 +27,6 @@ typedef enum sinsp_pd_callback_type
 	CT_READ,
 	CT_WRITE,
 	CT_TUPLE_CHANGE,
+	CT_ACCEPT,
+	CT_CLOSE,
 }sinsp_pd_callback_type;
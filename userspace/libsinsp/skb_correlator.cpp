@@ -0,0 +1,211 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "skb_correlator.h"
+
+sinsp_skb_correlator::sinsp_skb_correlator(sinsp_conn_index* conn_index):
+	m_conn_index(conn_index),
+	m_active(false),
+	m_window_ns(DEFAULT_WINDOW_NS),
+	m_max_pending(DEFAULT_MAX_PENDING),
+	m_next_sweep_ts(0),
+	m_n_matched(0),
+	m_n_expired(0)
+{
+}
+
+int64_t sinsp_skb_correlator::process_skb_event(sinsp_evt* evt)
+{
+	uint64_t ts = evt->get_ts();
+	sinsp_conn_key key;
+
+	m_active = true;
+
+	sweep(ts);
+
+	//
+	// The tuple is the last parameter of both events, the one of the
+	// packet: a received one comes from the remote endpoint
+	//
+	bool ingress = evt->get_type() == PPME_NETIF_RECEIVE_SKB_E;
+	if(!sinsp_conn_index::make_key(evt->get_param(4), &key, !ingress))
+	{
+		return -1;
+	}
+
+	sinsp_conn* conn = m_conn_index->find(key);
+	if(conn != NULL)
+	{
+		if(ingress)
+		{
+			push(m_pending[key].m_ingress, ts);
+		}
+		else
+		{
+			auto it = m_pending.find(key);
+			if(it != m_pending.end())
+			{
+				//
+				// One transmission per write: when the device sends
+				// more than one segment per write, the extra ones
+				// find the queue empty
+				//
+				std::deque<uint64_t>& q = it->second.m_egress;
+				expire(q, ts);
+				if(!q.empty() && q.front() <= ts)
+				{
+					conn->m_skb_latency.m_egress.add(ts - q.front());
+					q.pop_front();
+					m_n_matched++;
+				}
+			}
+		}
+	}
+
+	return m_conn_index->resolve(evt, key);
+}
+
+void sinsp_skb_correlator::on_recv(sinsp_fdinfo_t* fdinfo, uint64_t ts)
+{
+	sinsp_conn_key key;
+
+	if(m_pending.empty() || !sinsp_conn_index::make_key(fdinfo, &key))
+	{
+		return;
+	}
+
+	auto it = m_pending.find(key);
+	if(it == m_pending.end())
+	{
+		return;
+	}
+
+	//
+	// The read returns everything that has been received so far, but the
+	// packets include the ACKs of what was sent, which don't wait for a
+	// read: only the newest one, received since the previous read, is
+	// measured
+	//
+	std::deque<uint64_t>& q = it->second.m_ingress;
+	expire(q, ts);
+	if(!q.empty() && q.front() <= ts)
+	{
+		uint64_t newest = q.front();
+		while(!q.empty() && q.front() <= ts)
+		{
+			newest = q.front();
+			q.pop_front();
+		}
+
+		sinsp_conn* conn = m_conn_index->find(key);
+		if(conn != NULL)
+		{
+			conn->m_skb_latency.m_ingress.add(ts - newest);
+			m_n_matched++;
+		}
+	}
+
+	if(it->second.m_ingress.empty() && it->second.m_egress.empty())
+	{
+		m_pending.erase(it);
+	}
+}
+
+void sinsp_skb_correlator::on_send(sinsp_fdinfo_t* fdinfo, uint64_t ts)
+{
+	sinsp_conn_key key;
+
+	if(!m_active || !sinsp_conn_index::make_key(fdinfo, &key))
+	{
+		return;
+	}
+
+	if(m_conn_index->find(key) == NULL)
+	{
+		return;
+	}
+
+	push(m_pending[key].m_egress, ts);
+}
+
+void sinsp_skb_correlator::push(std::deque<uint64_t>& q, uint64_t ts)
+{
+	expire(q, ts);
+
+	if(q.size() >= m_max_pending)
+	{
+		q.pop_front();
+		m_n_expired++;
+	}
+
+	q.push_back(ts);
+}
+
+void sinsp_skb_correlator::expire(std::deque<uint64_t>& q, uint64_t ts)
+{
+	while(!q.empty() && q.front() + m_window_ns < ts)
+	{
+		q.pop_front();
+		m_n_expired++;
+	}
+}
+
+//
+// Once per window, forgets the queues of the idle and of the closed
+// connections
+//
+void sinsp_skb_correlator::sweep(uint64_t ts)
+{
+	if(ts < m_next_sweep_ts)
+	{
+		return;
+	}
+
+	m_next_sweep_ts = ts + m_window_ns;
+
+	for(auto it = m_pending.begin(); it != m_pending.end();)
+	{
+		if(m_conn_index->find(it->first) == NULL)
+		{
+			m_n_expired += it->second.m_ingress.size() + it->second.m_egress.size();
+			it = m_pending.erase(it);
+			continue;
+		}
+
+		expire(it->second.m_ingress, ts);
+		expire(it->second.m_egress, ts);
+
+		if(it->second.m_ingress.empty() && it->second.m_egress.empty())
+		{
+			it = m_pending.erase(it);
+			continue;
+		}
+
+		++it;
+	}
+}
+
+void sinsp_skb_correlator::clear()
+{
+	m_pending.clear();
+	m_active = false;
+	m_next_sweep_ts = 0;
+	m_n_matched = 0;
+	m_n_expired = 0;
+}
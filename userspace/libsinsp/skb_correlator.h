@@ -0,0 +1,134 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+
+#include "conn_index.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Pairs the skb events of the skb capture (KINDLING_SKB_CAPTURE) with the
+// socket syscalls of the same connection, to measure how long the data
+// waits in the kernel:
+//  - ingress: from netif_receive_skb to the read/recv that returns it, one
+//    value per read, from the newest packet received since the previous one
+//  - egress: from the write/send that queues it to net_dev_xmit, one value
+//    per write, from the first transmission that follows it
+//
+// The skb events don't tell the data from the pure ACKs, which take part in
+// both. The ACKs received before the newest packet are ignored, but when
+// the newest is an ACK the ingress value is lower than the wait of the
+// data. An ACK transmitted between a write and its data takes the place of
+// the data, so the egress values are lower bounds too.
+// The latencies go to the sinsp_skb_latency of the sinsp_conn_index entry
+// of the connection, and can be read through the fd.ingress.latency.* and
+// fd.egress.latency.* fields or the connection index snapshots.
+//
+// Each direction of a socket keeps the timestamps that wait for their match
+// in a queue. The queues are keyed like the index, by the local endpoint
+// first, so when both ends are captured (e.g. on loopback) a packet goes to
+// the sender's egress and to the receiver's ingress, never to the same
+// queue. The queues are bounded both in time (a timestamp older
+// than the window is dropped as expired) and in length, and only exist for
+// the connections of the index, so the memory stays bounded whatever the
+// traffic.
+//
+// Nothing is done until the first skb event shows up.
+///////////////////////////////////////////////////////////////////////////////
+class sinsp_skb_correlator
+{
+public:
+	static const uint64_t DEFAULT_WINDOW_NS = 1000000000ULL;
+	static const uint32_t DEFAULT_MAX_PENDING = 256;
+
+	sinsp_skb_correlator(sinsp_conn_index* conn_index);
+
+	//
+	// A netif_receive_skb or net_dev_xmit event. Sets the thread and the
+	// fd of the event like sinsp_conn_index::process_tcp_event() does.
+	// Returns the fd number, -1 if unresolved.
+	//
+	int64_t process_skb_event(sinsp_evt* evt);
+
+	//
+	// A successful read from the socket fdinfo
+	//
+	void on_recv(sinsp_fdinfo_t* fdinfo, uint64_t ts);
+
+	//
+	// A write to the socket fdinfo starting at ts
+	//
+	void on_send(sinsp_fdinfo_t* fdinfo, uint64_t ts);
+
+	inline bool is_active() const
+	{
+		return m_active;
+	}
+
+	void set_window(uint64_t window_ns)
+	{
+		m_window_ns = window_ns;
+	}
+
+	void set_max_pending(uint32_t max_pending)
+	{
+		m_max_pending = max_pending;
+	}
+
+	void clear();
+
+	size_t get_n_pending_connections() const
+	{
+		return m_pending.size();
+	}
+
+	uint64_t get_n_matched() const
+	{
+		return m_n_matched;
+	}
+
+	//
+	// Timestamps dropped because too old or because of a full queue
+	//
+	uint64_t get_n_expired() const
+	{
+		return m_n_expired;
+	}
+
+private:
+	struct pending
+	{
+		std::deque<uint64_t> m_ingress;
+		std::deque<uint64_t> m_egress;
+	};
+
+	void push(std::deque<uint64_t>& q, uint64_t ts);
+	void expire(std::deque<uint64_t>& q, uint64_t ts);
+	void sweep(uint64_t ts);
+
+	sinsp_conn_index* m_conn_index;
+	std::unordered_map<sinsp_conn_key, pending, sinsp_conn_key_hash> m_pending;
+	bool m_active;
+	uint64_t m_window_ns;
+	uint32_t m_max_pending;
+	uint64_t m_next_sweep_ts;
+	uint64_t m_n_matched;
+	uint64_t m_n_expired;
+};
@@ -0,0 +1,165 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <atomic>
+#include <map>
+#include <gtest.h>
+#include "sinsp.h"
+#include "async_key_value_source.h"
+
+namespace
+{
+//
+// Doubles its keys, taking a while to do so, and keeps track of how many
+// lookups ran at the same time
+//
+class slow_source : public sysdig::async_key_value_source<int, int>
+{
+public:
+	slow_source(uint32_t num_workers):
+		async_key_value_source(NO_WAIT_LOOKUP, 10000, num_workers),
+		m_running(0),
+		m_max_running(0)
+	{
+	}
+
+	~slow_source()
+	{
+		stop();
+	}
+
+	uint32_t get_max_running() const
+	{
+		return m_max_running;
+	}
+
+	uint32_t get_n_lookups(int key)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_n_lookups[key];
+	}
+
+protected:
+	void run_impl() override
+	{
+		int key;
+		while(dequeue_next_key(key))
+		{
+			uint32_t running = ++m_running;
+			uint32_t max_running = m_max_running;
+			while(running > max_running && !m_max_running.compare_exchange_weak(max_running, running))
+			{
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_n_lookups[key]++;
+			}
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			m_running--;
+			store_value(key, key * 2);
+		}
+	}
+
+private:
+	std::atomic<uint32_t> m_running;
+	std::atomic<uint32_t> m_max_running;
+	std::mutex m_mutex;
+	std::map<int, uint32_t> m_n_lookups;
+};
+
+class results
+{
+public:
+	void add(int key, int value)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_values[key] = value;
+		m_cond.notify_all();
+	}
+
+	bool wait_for(size_t n)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		return m_cond.wait_for(lock, std::chrono::seconds(10), [&] { return m_values.size() >= n; });
+	}
+
+	int get(int key)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_values[key];
+	}
+
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+	std::map<int, int> m_values;
+};
+
+void lookup_all(slow_source& source, results& res, int nkeys)
+{
+	for(int j = 0; j < nkeys; j++)
+	{
+		int value;
+		EXPECT_FALSE(source.lookup(j, value, [&res](const int& key, const int& value) {
+			res.add(key, value);
+		}));
+	}
+}
+}
+
+TEST(async_key_value_source, single_worker)
+{
+	results res;
+	slow_source source(1);
+
+	lookup_all(source, res, 4);
+	ASSERT_TRUE(res.wait_for(4));
+	EXPECT_EQ(1u, source.get_num_workers());
+	EXPECT_EQ(1u, source.get_max_running());
+	EXPECT_EQ(6, res.get(3));
+}
+
+TEST(async_key_value_source, worker_pool)
+{
+	results res;
+	slow_source source(4);
+
+	lookup_all(source, res, 16);
+	ASSERT_TRUE(res.wait_for(16));
+	EXPECT_LT(1u, source.get_max_running());
+	EXPECT_GE(4u, source.get_max_running());
+
+	for(int j = 0; j < 16; j++)
+	{
+		EXPECT_EQ(j * 2, res.get(j));
+		EXPECT_EQ(1u, source.get_n_lookups(j));
+	}
+}
+
+TEST(async_key_value_source, dedup)
+{
+	results res;
+	slow_source source(4);
+
+	// Pending requests for the same key are merged
+	lookup_all(source, res, 1);
+	lookup_all(source, res, 1);
+	ASSERT_TRUE(res.wait_for(1));
+	EXPECT_EQ(1u, source.get_n_lookups(0));
+}
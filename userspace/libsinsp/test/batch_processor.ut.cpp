@@ -0,0 +1,225 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest.h>
+#include "sinsp.h"
+#include "batch_processor.h"
+#include "capture_test.h"
+
+namespace
+{
+typedef scap_workload_writer w;
+typedef sinsp_batch_processor bp;
+
+const uint64_t MS = 1000000;
+
+struct record
+{
+	bp::evt_hdr m_hdr;
+	std::vector<std::string> m_fields;
+};
+
+//
+// Decodes the batches, and gives the arenas back right away unless told
+// to keep them
+//
+class test_consumer : public bp::consumer
+{
+public:
+	test_consumer():
+		m_processor(NULL),
+		m_keep(false)
+	{
+	}
+
+	void on_batch(uint8_t* arena, uint32_t len, uint32_t nevts) override
+	{
+		m_batch_sizes.push_back(nevts);
+
+		uint32_t pos = 0;
+		for(uint32_t j = 0; j < nevts; j++)
+		{
+			record r;
+			memcpy(&r.m_hdr, arena + pos, sizeof(r.m_hdr));
+
+			uint32_t fpos = pos + sizeof(bp::evt_hdr);
+			for(uint32_t k = 0; k < m_processor->get_n_fields(); k++)
+			{
+				uint32_t flen;
+				memcpy(&flen, arena + fpos, sizeof(flen));
+				fpos += sizeof(flen);
+				if(flen == bp::FIELD_MISSING)
+				{
+					r.m_fields.push_back("<NA>");
+				}
+				else
+				{
+					r.m_fields.push_back(std::string((char*)arena + fpos, flen));
+					fpos += flen;
+				}
+			}
+
+			EXPECT_LE(fpos, pos + r.m_hdr.m_len);
+			EXPECT_EQ(0u, r.m_hdr.m_len % 8);
+			pos += r.m_hdr.m_len;
+			m_records.push_back(r);
+		}
+
+		EXPECT_EQ(len, pos);
+
+		if(m_keep)
+		{
+			m_kept.push_back(arena);
+		}
+		else
+		{
+			m_processor->release_arena(arena);
+		}
+	}
+
+	bp* m_processor;
+	bool m_keep;
+	std::vector<uint8_t*> m_kept;
+	std::vector<uint32_t> m_batch_sizes;
+	std::vector<record> m_records;
+};
+
+//
+// Process 100 opening 50 files, one every millisecond
+//
+class batch_processor_test : public capture_test
+{
+protected:
+	void SetUp() override
+	{
+		w writer(m_capture, 1);
+		uint64_t ts = MS;
+
+		for(int64_t fd = 3; fd < 53; fd++)
+		{
+			std::string name = "/etc/file" + std::to_string(fd);
+			writer.write_event(ts, 100, PPME_SYSCALL_OPENAT_E, 0,
+				{w::i64(-100), w::str(name), w::u32(1), w::u32(0)});
+			writer.write_event(ts + 1000, 100, PPME_SYSCALL_OPENAT_X, 0,
+				{w::i64(fd), w::i64(-100), w::str(name), w::u32(1), w::u32(0), w::u32(0)});
+			ts += MS;
+		}
+
+		m_consumer.m_processor = &m_processor;
+	}
+
+	void replay()
+	{
+		m_inspector.register_external_event_processor(m_processor);
+		m_inspector.open(m_capture);
+
+		sinsp_evt* evt;
+		int32_t res;
+		while((res = m_inspector.next(&evt)) != SCAP_EOF)
+		{
+			EXPECT_EQ(SCAP_SUCCESS, res);
+		}
+
+		m_inspector.close();
+	}
+
+	sinsp m_inspector;
+	test_consumer m_consumer;
+	bp m_processor{&m_inspector, &m_consumer};
+	uint8_t m_arenas[2][4096];
+};
+}
+
+TEST_F(batch_processor_test, records)
+{
+	m_processor.add_field("evt.type");
+	m_processor.add_field("fd.num");
+	m_processor.add_field("fd.name");
+	EXPECT_EQ(PT_CHARBUF, m_processor.get_field_type(0));
+	EXPECT_EQ(PT_INT64, m_processor.get_field_type(1));
+	EXPECT_THROW(m_processor.add_field("fd.nope"), sinsp_exception);
+
+	m_processor.set_batch_size(8);
+	m_processor.set_max_latency(ONE_SECOND_IN_NS);
+	m_processor.add_arena(m_arenas[0], sizeof(m_arenas[0]));
+	m_processor.add_arena(m_arenas[1], sizeof(m_arenas[1]));
+	replay();
+
+	// 100 events in batches of 8, the rest at the end of the capture
+	ASSERT_EQ(100u, m_consumer.m_records.size());
+	EXPECT_EQ(13u, m_processor.get_n_batches());
+	EXPECT_EQ(8u, m_consumer.m_batch_sizes[0]);
+	EXPECT_EQ(4u, m_consumer.m_batch_sizes.back());
+	EXPECT_EQ(0u, m_processor.get_n_dropped());
+
+	const record& enter = m_consumer.m_records[0];
+	EXPECT_EQ(PPME_SYSCALL_OPENAT_E, enter.m_hdr.m_type);
+	EXPECT_EQ(100, enter.m_hdr.m_tid);
+	EXPECT_EQ(MS, enter.m_hdr.m_ts);
+	EXPECT_EQ(1u, enter.m_hdr.m_num);
+	EXPECT_EQ("openat", enter.m_fields[0]);
+	EXPECT_EQ("<NA>", enter.m_fields[2]);
+
+	const record& exit = m_consumer.m_records[99];
+	EXPECT_EQ(PPME_SYSCALL_OPENAT_X, exit.m_hdr.m_type);
+	int64_t fd;
+	ASSERT_EQ(sizeof(fd), exit.m_fields[1].size());
+	memcpy(&fd, exit.m_fields[1].data(), sizeof(fd));
+	EXPECT_EQ(52, fd);
+	EXPECT_EQ("/etc/file52", exit.m_fields[2]);
+}
+
+TEST_F(batch_processor_test, latency)
+{
+	m_processor.set_batch_size(1000);
+	m_processor.set_max_latency(5 * MS);
+	m_processor.add_arena(m_arenas[0], sizeof(m_arenas[0]));
+	m_processor.add_arena(m_arenas[1], sizeof(m_arenas[1]));
+	replay();
+
+	// An enter and an exit every millisecond
+	ASSERT_EQ(100u, m_consumer.m_records.size());
+	EXPECT_EQ(11u, m_consumer.m_batch_sizes[0]);
+
+	// Without fields, a record is just its header
+	EXPECT_EQ(sizeof(bp::evt_hdr), m_consumer.m_records[0].m_hdr.m_len);
+}
+
+TEST_F(batch_processor_test, arenas)
+{
+	// Room for 20 records of 48 bytes per arena, and the consumer doesn't
+	// give them back
+	m_processor.add_field("evt.num");
+	m_processor.set_batch_size(1000);
+	m_processor.set_max_latency(ONE_SECOND_IN_NS);
+	m_processor.add_arena(m_arenas[0], 960);
+	m_processor.add_arena(m_arenas[1], 960);
+	m_consumer.m_keep = true;
+	replay();
+
+	EXPECT_EQ(2u, m_processor.get_n_batches());
+	EXPECT_EQ(40u, m_consumer.m_records.size());
+	EXPECT_EQ(60u, m_processor.get_n_dropped());
+
+	// Given back, it's used again
+	m_processor.release_arena(m_consumer.m_kept[0]);
+	replay();
+	EXPECT_EQ(60u, m_consumer.m_records.size());
+
+	uint8_t unknown[64];
+	EXPECT_THROW(m_processor.release_arena(unknown), sinsp_exception);
+}
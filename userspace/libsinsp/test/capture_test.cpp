@@ -0,0 +1,61 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <unistd.h>
+#include "sinsp.h"
+#include "capture_test.h"
+
+temp_file::temp_file(const std::string& prefix)
+{
+	std::string path = "/tmp/" + prefix + "_XXXXXX";
+	int fd = mkstemp(&path[0]);
+	if(fd < 0)
+	{
+		ADD_FAILURE() << "can't create " << path;
+		return;
+	}
+
+	close(fd);
+	m_path = path;
+}
+
+temp_file::~temp_file()
+{
+	if(!m_path.empty())
+	{
+		unlink(m_path.c_str());
+	}
+}
+
+capture_test::capture_test():
+	m_capture_file(testing::UnitTest::GetInstance()->current_test_info()->test_suite_name()),
+	m_capture(m_capture_file.path())
+{
+}
+
+void write_execve(scap_workload_writer& writer, uint64_t ts, int64_t tid, const std::string& exe,
+	const std::vector<std::string>& args, const std::vector<std::string>& env, int64_t ptid)
+{
+	typedef scap_workload_writer w;
+	std::string comm = exe.substr(exe.rfind('/') + 1);
+
+	writer.write_event(ts, tid, PPME_SYSCALL_EXECVE_19_E, 0, {w::str(exe)});
+	writer.write_event(ts + 1, tid, PPME_SYSCALL_EXECVE_19_X, 0,
+		{w::i64(0), w::str(exe), w::strlist(args), w::i64(tid), w::i64(tid), w::i64(ptid),
+		 w::str("/"), w::u64(1024), w::u64(0), w::u64(0), w::u32(0), w::u32(0), w::u32(0),
+		 w::str(comm), w::strlist({}), w::strlist(env), w::i32(0), w::i64(tid), w::i32(-1)});
+}
@@ -0,0 +1,64 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <gtest.h>
+#include "bench/scap_workload.h"
+
+//
+// A file in /tmp, created empty and removed when this goes away
+//
+class temp_file
+{
+public:
+	explicit temp_file(const std::string& prefix);
+	~temp_file();
+
+	const std::string& path() const
+	{
+		return m_path;
+	}
+
+private:
+	std::string m_path;
+};
+
+//
+// Fixture of the tests that write a capture: m_capture is an empty file
+// named after the test suite, removed at the end of the test
+//
+class capture_test : public testing::Test
+{
+protected:
+	capture_test();
+
+private:
+	temp_file m_capture_file;
+
+protected:
+	const std::string m_capture;
+};
+
+//
+// The execve of a process that is its own main thread, the enter event at
+// ts and the exit at ts + 1. The comm is the last component of exe.
+//
+void write_execve(scap_workload_writer& writer, uint64_t ts, int64_t tid, const std::string& exe,
+	const std::vector<std::string>& args = {}, const std::vector<std::string>& env = {}, int64_t ptid = 1);
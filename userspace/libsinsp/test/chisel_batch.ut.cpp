@@ -0,0 +1,187 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <fstream>
+#include <sstream>
+#include <gtest.h>
+#include "sinsp.h"
+#include "chisel.h"
+#include "capture_test.h"
+
+namespace
+{
+typedef scap_workload_writer w;
+
+const uint64_t TS = 1600000000000000000ULL;
+const uint64_t MS = 1000000ULL;
+const uint64_t S = 1000000000ULL;
+const int64_t TID = 100;
+
+void write_close(w& writer, uint64_t ts, int64_t fd)
+{
+	writer.write_event(ts, TID, PPME_SYSCALL_CLOSE_E, 0, {w::i64(fd)});
+	writer.write_event(ts + 1, TID, PPME_SYSCALL_CLOSE_X, 0, {w::i64(0)});
+}
+
+//
+// Each batch is written as one line with the column types and, for
+// every row, the event type, tid, return value and is_io flag
+//
+const char* BATCH_CHISEL =
+	"description = 'batch test'\n"
+	"short_description = 'batch test'\n"
+	"category = 'test'\n"
+	"args = {}\n"
+	"local out\n"
+	"function on_init()\n"
+	"	out = io.open(out_path, 'w')\n"
+	"	local num = chisel.request_field('evt.num')\n"
+	"	local tid = chisel.request_field('thread.tid')\n"
+	"	local etype = chisel.request_field('evt.type')\n"
+	"	local res = chisel.request_field('evt.rawres')\n"
+	"	local is_io = chisel.request_field('evt.is_io')\n"
+	"	chisel.request_batch(4, {num, tid, etype, res, is_io})\n"
+	"	chisel.set_filter('evt.type=close')\n"
+	"	chisel.set_interval_s(1)\n"
+	"	return true\n"
+	"end\n"
+	"function on_event()\n"
+	"	out:write('event\\n')\n"
+	"	return true\n"
+	"end\n"
+	"function on_batch(batch)\n"
+	"	local line = 'batch ' .. #batch\n"
+	"	for c = 1, 5 do line = line .. ' ' .. batch:type(c) end\n"
+	"	local nums = batch:column(1)\n"
+	"	for i = 2, #nums do\n"
+	"		if nums[i] ~= nums[i - 1] + 1 then line = line .. ' gap' end\n"
+	"	end\n"
+	"	local types = batch:column(3)\n"
+	"	for i = 1, #batch do\n"
+	"		line = line .. ' ' .. types[i] .. ':' .. batch:get(2, i) .. ':' ..\n"
+	"			tostring(batch:get(4, i)) .. ':' .. tostring(batch:get(5, i))\n"
+	"	end\n"
+	"	if nums[0] ~= nil or nums[#batch + 1] ~= nil then line = line .. ' oob' end\n"
+	"	local ok, ffi = pcall(require, 'ffi')\n"
+	"	if ok then\n"
+	"		local tids = ffi.cast('int64_t*', batch:data(2))\n"
+	"		local valid = ffi.cast('uint8_t*', batch:valid(4))\n"
+	"		for i = 0, #batch - 1 do\n"
+	"			if tonumber(tids[i]) ~= batch:get(2, i + 1) then line = line .. ' ffi' end\n"
+	"			if (valid[i] ~= 0) ~= (batch:get(4, i + 1) ~= nil) then line = line .. ' ffi' end\n"
+	"		end\n"
+	"	end\n"
+	"	out:write(line .. '\\n')\n"
+	"end\n"
+	"function on_interval(ts_s, ts_ns, delta)\n"
+	"	out:write('interval\\n')\n"
+	"	return true\n"
+	"end\n"
+	"function on_capture_end(ts_s, ts_ns, delta)\n"
+	"	out:write('end\\n')\n"
+	"	out:close()\n"
+	"	return true\n"
+	"end\n";
+
+class chisel_batch_test : public capture_test
+{
+protected:
+	chisel_batch_test():
+		m_chisel("chisel_batch_ut"),
+		m_out("chisel_batch_ut")
+	{
+	}
+
+	void write_chisel(const std::string& script)
+	{
+		std::ofstream os(m_chisel.path());
+		os << "out_path = '" << m_out.path() << "'\n" << script;
+	}
+
+	std::vector<std::string> read_out()
+	{
+		std::vector<std::string> lines;
+		std::ifstream is(m_out.path());
+		std::string line;
+		while(std::getline(is, line))
+		{
+			lines.push_back(line);
+		}
+		return lines;
+	}
+
+	temp_file m_chisel;
+	temp_file m_out;
+};
+}
+
+TEST_F(chisel_batch_test, on_batch)
+{
+	{
+		w writer(m_capture, 1);
+
+		write_execve(writer, TS, TID, "cat");
+
+		// A full batch, then two events left when the interval ends
+		write_close(writer, TS + 1 * MS, 3);
+		write_close(writer, TS + 2 * MS, 4);
+		write_close(writer, TS + 3 * MS, 5);
+
+		// Left when the capture ends
+		write_close(writer, TS + 1 * S + 1 * MS, 6);
+	}
+
+	write_chisel(BATCH_CHISEL);
+
+	sinsp inspector;
+	inspector.open(m_capture);
+
+	sinsp_chisel ch(&inspector, m_chisel.path());
+	ch.on_init();
+
+	sinsp_evt* evt;
+	while(inspector.next(&evt) != SCAP_EOF)
+	{
+		ch.run(evt);
+	}
+
+	ch.on_capture_end();
+	inspector.close();
+
+	const std::string types = "uint64 int64 string int64 bool";
+	std::vector<std::string> out = read_out();
+	ASSERT_EQ(5u, out.size());
+	EXPECT_EQ("batch 4 " + types + " close:100:nil:false close:100:0:false close:100:nil:false close:100:0:false", out[0]);
+	EXPECT_EQ("batch 2 " + types + " close:100:nil:false close:100:0:false", out[1]);
+	EXPECT_EQ("interval", out[2]);
+	EXPECT_EQ("batch 2 " + types + " close:100:nil:false close:100:0:false", out[3]);
+	EXPECT_EQ("end", out[4]);
+}
+
+TEST_F(chisel_batch_test, no_on_batch)
+{
+	write_chisel(
+		"args = {}\n"
+		"function on_init()\n"
+		"	chisel.request_batch(4, {chisel.request_field('evt.num')})\n"
+		"	return true\n"
+		"end\n");
+
+	sinsp inspector;
+	sinsp_chisel ch(&inspector, m_chisel.path());
+	EXPECT_THROW(ch.on_init(), sinsp_exception);
+}
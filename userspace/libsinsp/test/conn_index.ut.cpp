@@ -0,0 +1,326 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <memory>
+#include <arpa/inet.h>
+#include <gtest.h>
+#include "sinsp.h"
+#include "filter.h"
+#include "capture_test.h"
+
+namespace
+{
+typedef scap_workload_writer w;
+
+const uint32_t CLIENT_IP = 0x0a000005;	// 10.0.0.5
+const uint32_t SERVER_IP = 0x0a000001;	// 10.0.0.1
+const uint64_t TS = 1600000000000000000ULL;
+const uint64_t MS = 1000000ULL;
+
+// The kprobes run in whatever context the kernel is in, e.g. softirqs
+const int64_t KERNEL_TID = 0;
+
+void write_connect(w& writer, uint64_t ts, int64_t tid, int64_t fd, uint16_t sport, uint16_t dport,
+	uint32_t cip = CLIENT_IP, uint32_t sip = SERVER_IP)
+{
+	writer.write_event(ts, tid, PPME_SOCKET_SOCKET_E, 0, {w::u32(PPM_AF_INET), w::u32(1), w::u32(0)});
+	writer.write_event(ts + 1, tid, PPME_SOCKET_SOCKET_X, 0, {w::i64(fd)});
+	writer.write_event(ts + 2, tid, PPME_SOCKET_CONNECT_E, 0, {w::i64(fd)});
+	writer.write_event(ts + 3, tid, PPME_SOCKET_CONNECT_X, 0, {w::i64(0), w::tuple4(cip, sport, sip, dport)});
+}
+
+void write_accept(w& writer, uint64_t ts, int64_t tid, int64_t fd, uint16_t sport, uint16_t dport,
+	uint32_t cip = CLIENT_IP, uint32_t sip = SERVER_IP)
+{
+	writer.write_event(ts, tid, PPME_SOCKET_ACCEPT4_5_E, 0, {w::i32(0)});
+	writer.write_event(ts + 1, tid, PPME_SOCKET_ACCEPT4_5_X, 0,
+		{w::i64(fd), w::tuple4(cip, sport, sip, dport), w::u8(0), w::u32(0), w::u32(511)});
+}
+
+void write_close(w& writer, uint64_t ts, int64_t tid, int64_t fd)
+{
+	writer.write_event(ts, tid, PPME_SYSCALL_CLOSE_E, 0, {w::i64(fd)});
+	writer.write_event(ts + 1, tid, PPME_SYSCALL_CLOSE_X, 0, {w::i64(0)});
+}
+
+void write_rtt(w& writer, uint64_t ts, uint32_t sip, uint16_t sport, uint32_t dip, uint16_t dport, uint32_t srtt_us)
+{
+	writer.write_event(ts, KERNEL_TID, PPME_TCP_RCV_ESTABLISHED_E, 0, {w::tuple4(sip, sport, dip, dport), w::u32(srtt_us)});
+}
+
+class conn_index_test : public capture_test
+{
+};
+}
+
+TEST(log2_histogram, percentiles)
+{
+	sinsp_log2_histogram hist;
+	EXPECT_EQ(0u, hist.get_percentile(50));
+
+	for(uint32_t j = 0; j < 90; j++)
+	{
+		hist.add(1000);
+	}
+	for(uint32_t j = 0; j < 10; j++)
+	{
+		hist.add(100000);
+	}
+
+	EXPECT_EQ(100u, hist.m_count);
+	EXPECT_EQ(1000u, hist.m_min);
+	EXPECT_EQ(100000u, hist.m_max);
+	// Within the power of two of the samples
+	EXPECT_LE(512u, hist.get_percentile(50));
+	EXPECT_GT(1024u, hist.get_percentile(90));
+	EXPECT_LE(65536u, hist.get_percentile(99));
+	EXPECT_GE(100000u, hist.get_percentile(99));
+}
+
+TEST_F(conn_index_test, resolve_kprobes)
+{
+	{
+		w writer(m_capture, 1);
+		int64_t client = 100;
+		int64_t server = 200;
+
+		write_execve(writer, TS, client, "curl");
+		write_execve(writer, TS + 2, server, "nginx");
+		write_connect(writer, TS + 10, client, 3, 40000, 80);
+		write_accept(writer, TS + 20, server, 7, 40000, 80);
+
+		//
+		// Seen from both ends: the tuple of the kprobes starts with the
+		// endpoint of their socket
+		//
+		write_rtt(writer, TS + 1 * MS, SERVER_IP, 80, CLIENT_IP, 40000, 1000);
+		write_rtt(writer, TS + 2 * MS, CLIENT_IP, 40000, SERVER_IP, 80, 3000);
+		writer.write_event(TS + 3 * MS, KERNEL_TID, PPME_TCP_RETRANCESMIT_SKB_E, 0, {w::tuple4(SERVER_IP, 80, CLIENT_IP, 40000)});
+		writer.write_event(TS + 4 * MS, KERNEL_TID, PPME_TCP_DROP_E, 0, {w::tuple4(CLIENT_IP, 40000, SERVER_IP, 80)});
+
+		// A connection nobody owns
+		write_rtt(writer, TS + 5 * MS, CLIENT_IP, 40001, SERVER_IP, 80, 1000);
+
+		write_close(writer, TS + 6 * MS, server, 7);
+		write_rtt(writer, TS + 7 * MS, SERVER_IP, 80, CLIENT_IP, 40000, 1000);
+	}
+
+	sinsp inspector;
+	sinsp_filter_compiler compiler(&inspector, "fd.num=7 and proc.name=nginx and fd.sport=80");
+	std::unique_ptr<sinsp_filter> filter(compiler.compile());
+	sinsp_evt_formatter formatter(&inspector, "%fd.num %proc.name %fd.tcp.srtt %fd.tcp.rtt.p50 %fd.tcp.retransmits %fd.tcp.drops");
+
+	inspector.open(m_capture);
+
+	std::vector<std::string> out;
+	std::vector<bool> matched;
+	sinsp_evt* evt;
+	int32_t res;
+	while((res = inspector.next(&evt)) != SCAP_EOF)
+	{
+		EXPECT_EQ(SCAP_SUCCESS, res);
+		if(evt->get_info_flags() & EF_NONE_PARSE)
+		{
+			std::string line;
+			formatter.tostring(evt, &line);
+			out.push_back(line);
+			matched.push_back(filter->run(evt));
+		}
+	}
+
+	ASSERT_EQ(6u, out.size());
+	EXPECT_EQ("7 nginx 1000 1000 0 0", out[0]);
+	EXPECT_TRUE(matched[0]);
+	EXPECT_EQ("3 curl 3000 3000 0 0", out[1]);
+	EXPECT_FALSE(matched[1]);
+	EXPECT_EQ("7 nginx 1000 1000 1 0", out[2]);
+	EXPECT_TRUE(matched[2]);
+	EXPECT_EQ("3 curl 3000 3000 0 1", out[3]);
+	EXPECT_EQ(std::string::npos, out[4].find("nginx"));
+	EXPECT_FALSE(matched[4]);
+	// Closed
+	EXPECT_FALSE(matched[5]);
+
+	sinsp_conn_index& index = inspector.get_conn_index();
+	EXPECT_EQ(4u, index.get_n_resolved());
+	EXPECT_EQ(2u, index.get_n_unresolved());
+
+	inspector.close();
+}
+
+TEST_F(conn_index_test, snapshots)
+{
+	{
+		w writer(m_capture, 1);
+		int64_t client = 100;
+
+		write_execve(writer, TS, client, "curl");
+		write_connect(writer, TS + 10, client, 3, 40000, 80);
+		write_connect(writer, TS + 20, client, 4, 40001, 443);
+
+		write_rtt(writer, TS + 1 * MS, CLIENT_IP, 40000, SERVER_IP, 80, 1000);
+		write_rtt(writer, TS + 2 * MS, CLIENT_IP, 40001, SERVER_IP, 443, 2000);
+		write_close(writer, TS + 3 * MS, client, 4);
+		// Past the first interval
+		write_rtt(writer, TS + 11 * MS, CLIENT_IP, 40000, SERVER_IP, 80, 4000);
+		write_rtt(writer, TS + 22 * MS, CLIENT_IP, 40000, SERVER_IP, 80, 4000);
+	}
+
+	sinsp inspector;
+	std::vector<std::vector<sinsp_conn>> snapshots;
+	inspector.get_conn_index().set_snapshot_callback([&](const std::vector<sinsp_conn>& conns, uint64_t ts)
+	{
+		snapshots.push_back(conns);
+	}, 10 * MS);
+
+	inspector.open(m_capture);
+
+	sinsp_evt* evt;
+	while(inspector.next(&evt) != SCAP_EOF)
+	{
+	}
+
+	//
+	// The first one still has the closed connection, the second one
+	// only the rtt of its own interval
+	//
+	ASSERT_EQ(2u, snapshots.size());
+	ASSERT_EQ(2u, snapshots[0].size());
+	for(const sinsp_conn& conn : snapshots[0])
+	{
+		EXPECT_EQ(100, conn.m_pid);
+		EXPECT_EQ(1u, conn.m_stats.m_rtt.m_count);
+		EXPECT_EQ(htonl(CLIENT_IP), conn.m_tuple.m_fields.m_sip.m_b[0]);
+		if(conn.m_fd == 4)
+		{
+			EXPECT_TRUE(conn.m_closed);
+			EXPECT_EQ(443, conn.m_tuple.m_fields.m_dport);
+		}
+		else
+		{
+			EXPECT_FALSE(conn.m_closed);
+			EXPECT_EQ(1000u, conn.m_stats.m_last_srtt_us);
+		}
+	}
+
+	ASSERT_EQ(1u, snapshots[1].size());
+	EXPECT_EQ(3, snapshots[1][0].m_fd);
+	EXPECT_EQ(1u, snapshots[1][0].m_stats.m_rtt.m_count);
+	EXPECT_EQ(4000u, snapshots[1][0].m_stats.m_last_srtt_us);
+
+	std::vector<sinsp_conn> conns;
+	inspector.get_conn_index().snapshot(conns, false);
+	ASSERT_EQ(1u, conns.size());
+	EXPECT_EQ(1u, conns[0].m_stats.m_rtt.m_count);
+
+	inspector.close();
+}
+
+//
+// Both ends on the same host: the accept of the server doesn't take the
+// connection of the client over
+//
+TEST_F(conn_index_test, loopback)
+{
+	const uint32_t LOCALHOST = 0x7f000001;
+
+	{
+		w writer(m_capture, 1);
+		int64_t client = 100;
+		int64_t server = 200;
+
+		write_execve(writer, TS, client, "curl");
+		write_execve(writer, TS + 2, server, "nginx");
+		write_connect(writer, TS + 10, client, 3, 40000, 8080, LOCALHOST, LOCALHOST);
+		write_rtt(writer, TS + 1 * MS, LOCALHOST, 40000, LOCALHOST, 8080, 1000);
+		write_accept(writer, TS + 2 * MS, server, 7, 40000, 8080, LOCALHOST, LOCALHOST);
+		write_rtt(writer, TS + 3 * MS, LOCALHOST, 40000, LOCALHOST, 8080, 2000);
+		write_rtt(writer, TS + 4 * MS, LOCALHOST, 8080, LOCALHOST, 40000, 5000);
+	}
+
+	sinsp inspector;
+	sinsp_evt_formatter formatter(&inspector, "%fd.num %proc.name %fd.tcp.srtt %fd.tcp.rtt.p50");
+	inspector.open(m_capture);
+
+	std::vector<std::string> out;
+	sinsp_evt* evt;
+	while(inspector.next(&evt) != SCAP_EOF)
+	{
+		if(evt->get_info_flags() & EF_NONE_PARSE)
+		{
+			std::string line;
+			formatter.tostring(evt, &line);
+			out.push_back(line);
+		}
+	}
+
+	ASSERT_EQ(3u, out.size());
+	EXPECT_EQ("3 curl 1000 1000", out[0]);
+	// Still with the sample from before the accept
+	EXPECT_EQ("3 curl 2000 1000", out[1]);
+	EXPECT_EQ("7 nginx 5000 5000", out[2]);
+
+	std::vector<sinsp_conn> conns;
+	inspector.get_conn_index().snapshot(conns, false);
+	EXPECT_EQ(2u, conns.size());
+	EXPECT_EQ(3u, inspector.get_conn_index().get_n_resolved());
+
+	inspector.close();
+}
+
+//
+// Without the tcp_* events, the snapshots still come and the closed
+// connections are forgotten
+//
+TEST_F(conn_index_test, snapshots_without_kprobes)
+{
+	{
+		w writer(m_capture, 1);
+		int64_t client = 100;
+
+		write_execve(writer, TS, client, "curl");
+		for(int64_t j = 0; j < 20; j++)
+		{
+			write_connect(writer, TS + j * MS, client, 3, (uint16_t)(40000 + j), 80);
+			write_close(writer, TS + j * MS + 100, client, 3);
+		}
+	}
+
+	sinsp inspector;
+	sinsp_conn_index& index = inspector.get_conn_index();
+	index.set_max_connections(8);
+	std::vector<size_t> snapshots;
+	index.set_snapshot_callback([&](const std::vector<sinsp_conn>& conns, uint64_t ts)
+	{
+		snapshots.push_back(conns.size());
+	}, 5 * MS);
+
+	inspector.open(m_capture);
+
+	sinsp_evt* evt;
+	while(inspector.next(&evt) != SCAP_EOF)
+	{
+	}
+
+	// A snapshot every 5 connections, none dropped
+	ASSERT_EQ(3u, snapshots.size());
+	EXPECT_EQ(5u, snapshots[0]);
+	EXPECT_EQ(5u, snapshots[1]);
+	EXPECT_EQ(0u, index.get_n_dropped_connections());
+
+	inspector.close();
+}
@@ -0,0 +1,118 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest.h>
+#include "sinsp.h"
+#include "capture_test.h"
+
+namespace
+{
+const char STATIC_ID[] = "static_id";
+
+void set_cgroups(sinsp_threadinfo& tinfo, const std::string& id)
+{
+	tinfo.m_cgroups.clear();
+	tinfo.m_cgroups.push_back(std::make_pair("cpuset", "/docker/" + id));
+	tinfo.m_cgroups.push_back(std::make_pair("memory", "/docker/" + id));
+}
+}
+
+TEST(container_cache, cgroup_cache)
+{
+	sinsp inspector(true, STATIC_ID, "static_name", "static_image");
+	sinsp_container_manager& manager = inspector.m_container_manager;
+	sinsp_threadinfo first(&inspector);
+	sinsp_threadinfo second(&inspector);
+	sinsp_threadinfo other(&inspector);
+
+	set_cgroups(first, "aaaa");
+	set_cgroups(second, "aaaa");
+	set_cgroups(other, "bbbb");
+
+	EXPECT_TRUE(manager.resolve_container(&first, false));
+	EXPECT_EQ(0u, manager.get_n_cgroup_cache_hits());
+	EXPECT_TRUE(manager.resolve_container(&second, false));
+	EXPECT_EQ(1u, manager.get_n_cgroup_cache_hits());
+	EXPECT_EQ(STATIC_ID, second.m_container_id);
+	EXPECT_TRUE(manager.resolve_container(&other, false));
+	EXPECT_EQ(1u, manager.get_n_cgroup_cache_hits());
+
+	// Threads without cgroups are never cached
+	sinsp_threadinfo nocg(&inspector);
+	manager.resolve_container(&nocg, false);
+	manager.resolve_container(&nocg, false);
+	EXPECT_EQ(1u, manager.get_n_cgroup_cache_hits());
+}
+
+TEST(container_cache, inherit_container)
+{
+	sinsp inspector;
+	sinsp_container_manager& manager = inspector.m_container_manager;
+	sinsp_threadinfo parent(&inspector);
+	sinsp_threadinfo child(&inspector);
+
+	set_cgroups(parent, "aaaa");
+	set_cgroups(child, "aaaa");
+
+	// Host parent, the (empty) container id is inherited
+	EXPECT_TRUE(manager.inherit_container(&child, &parent));
+	EXPECT_EQ("", child.m_container_id);
+
+	// Unknown container, the child must go through the engines
+	parent.m_container_id = "aaaa";
+	EXPECT_FALSE(manager.inherit_container(&child, &parent));
+
+	auto container = std::make_shared<sinsp_container_info>();
+	container->m_id = "aaaa";
+	container->m_type = CT_DOCKER;
+	manager.add_container(container, &parent);
+	EXPECT_TRUE(manager.inherit_container(&child, &parent));
+	EXPECT_EQ("aaaa", child.m_container_id);
+
+	// The child moved to another cgroup
+	set_cgroups(child, "bbbb");
+	EXPECT_FALSE(manager.inherit_container(&child, &parent));
+	EXPECT_EQ(2u, manager.get_n_inherited());
+}
+
+TEST(container_cache, capture_replay)
+{
+	temp_file capture("container_cache_ut");
+
+	scap_workload::generate(scap_workload::CONTAINER_CHURN, capture.path(), 20000);
+
+	sinsp inspector(true, STATIC_ID, "static_name", "static_image");
+	inspector.open(capture.path());
+
+	sinsp_evt* evt;
+	int32_t res;
+	while((res = inspector.next(&evt)) != SCAP_EOF)
+	{
+		ASSERT_EQ(SCAP_SUCCESS, res);
+		sinsp_threadinfo* tinfo = evt->get_thread_info(false);
+		if(tinfo != NULL && !tinfo->m_cgroups.empty())
+		{
+			ASSERT_EQ(STATIC_ID, tinfo->m_container_id);
+		}
+	}
+
+	// Clones inherit, the execs that follow them hit the cache
+	EXPECT_LT(0u, inspector.m_container_manager.get_n_inherited());
+	EXPECT_LT(0u, inspector.m_container_manager.get_n_cgroup_cache_hits());
+
+	inspector.close();
+}
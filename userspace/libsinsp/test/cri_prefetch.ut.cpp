@@ -0,0 +1,213 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <unistd.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <gtest.h>
+#include "cri.pb.h"
+#include "cri.grpc.pb.h"
+#include "sinsp.h"
+
+#ifdef GRPC_INCLUDE_IS_GRPCPP
+#	include <grpcpp/grpcpp.h>
+#else
+#	include <grpc++/grpc++.h>
+#endif
+
+namespace
+{
+using namespace runtime::v1alpha2;
+
+//
+// Just enough of the CRI runtime service: the version, the lists of
+// running containers and ready pod sandboxes, and the status of each of
+// them, the container ones taking a while
+//
+class fake_cri : public RuntimeService::Service
+{
+public:
+	fake_cri(const std::vector<std::string>& ids, const std::string& sandbox_id, uint32_t delay_ms):
+		m_ids(ids),
+		m_sandbox_id(sandbox_id),
+		m_delay_ms(delay_ms),
+		m_running(0),
+		m_max_running(0)
+	{
+	}
+
+	bool start(const std::string& path)
+	{
+		grpc::ServerBuilder builder;
+		builder.AddListeningPort("unix://" + path, grpc::InsecureServerCredentials());
+		builder.RegisterService(this);
+		m_server = builder.BuildAndStart();
+		return m_server != nullptr;
+	}
+
+	void stop()
+	{
+		if(m_server)
+		{
+			m_server->Shutdown();
+			m_server->Wait();
+			m_server.reset();
+		}
+	}
+
+	bool wait_for_lookups(size_t n)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		return m_cond.wait_for(lock, std::chrono::seconds(10), [&] { return m_looked_up.size() >= n; });
+	}
+
+	uint32_t get_max_running() const
+	{
+		return m_max_running;
+	}
+
+	grpc::Status Version(grpc::ServerContext* context, const VersionRequest* request, VersionResponse* response) override
+	{
+		response->set_runtime_name("containerd");
+		response->set_runtime_version("1.4.0");
+		return grpc::Status::OK;
+	}
+
+	grpc::Status ListContainers(grpc::ServerContext* context, const ListContainersRequest* request, ListContainersResponse* response) override
+	{
+		EXPECT_EQ(CONTAINER_RUNNING, request->filter().state().state());
+		for(const auto& id : m_ids)
+		{
+			response->add_containers()->set_id(id);
+		}
+		return grpc::Status::OK;
+	}
+
+	grpc::Status ListPodSandbox(grpc::ServerContext* context, const ListPodSandboxRequest* request, ListPodSandboxResponse* response) override
+	{
+		EXPECT_EQ(SANDBOX_READY, request->filter().state().state());
+		response->add_items()->set_id(m_sandbox_id);
+		return grpc::Status::OK;
+	}
+
+	grpc::Status ContainerStatus(grpc::ServerContext* context, const ContainerStatusRequest* request, ContainerStatusResponse* response) override
+	{
+		std::string id = request->container_id();
+		if(id != m_sandbox_id.substr(0, 12))
+		{
+			uint32_t running = ++m_running;
+			uint32_t max_running = m_max_running;
+			while(running > max_running && !m_max_running.compare_exchange_weak(max_running, running))
+			{
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(m_delay_ms));
+			m_running--;
+		}
+
+		for(const auto& full_id : m_ids)
+		{
+			if(full_id.compare(0, id.size(), id) == 0)
+			{
+				response->mutable_status()->set_id(full_id);
+				response->mutable_status()->mutable_metadata()->set_name("fake_" + id);
+				looked_up(id);
+				return grpc::Status::OK;
+			}
+		}
+		return grpc::Status(grpc::StatusCode::NOT_FOUND, "no such container");
+	}
+
+	grpc::Status PodSandboxStatus(grpc::ServerContext* context, const PodSandboxStatusRequest* request, PodSandboxStatusResponse* response) override
+	{
+		std::string id = request->pod_sandbox_id();
+		if(m_sandbox_id.compare(0, id.size(), id) != 0)
+		{
+			return grpc::Status(grpc::StatusCode::NOT_FOUND, "no such pod sandbox");
+		}
+		response->mutable_status()->set_id(m_sandbox_id);
+		looked_up(id);
+		return grpc::Status::OK;
+	}
+
+private:
+	void looked_up(const std::string& id)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_looked_up.insert(id);
+		m_cond.notify_all();
+	}
+
+	std::vector<std::string> m_ids;
+	std::string m_sandbox_id;
+	uint32_t m_delay_ms;
+	std::unique_ptr<grpc::Server> m_server;
+	std::atomic<uint32_t> m_running;
+	std::atomic<uint32_t> m_max_running;
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+	std::set<std::string> m_looked_up;
+};
+}
+
+TEST(cri_prefetch, concurrent_lookups)
+{
+	char dir[] = "/tmp/cri_prefetch_ut_XXXXXX";
+	ASSERT_NE(nullptr, mkdtemp(dir));
+	std::string sock = std::string(dir) + "/cri.sock";
+
+	std::vector<std::string> ids;
+	for(char c = 'a'; c < 'i'; c++)
+	{
+		ids.push_back(std::string(64, c));
+	}
+	std::string sandbox_id(64, 'z');
+
+	fake_cri server(ids, sandbox_id, 200);
+	ASSERT_TRUE(server.start(sock));
+
+	{
+		sinsp inspector;
+		inspector.set_cri_socket_path(sock);
+		inspector.set_cri_extra_queries(false);
+		inspector.set_container_lookup_workers(4);
+		inspector.m_container_manager.prefetch_containers();
+
+		for(const auto& id : ids)
+		{
+			EXPECT_TRUE(inspector.m_container_manager.container_exists(id.substr(0, 12)));
+		}
+		EXPECT_TRUE(inspector.m_container_manager.container_exists(sandbox_id.substr(0, 12)));
+
+		// Every container, and the sandbox once its status failed
+		EXPECT_TRUE(server.wait_for_lookups(ids.size() + 1));
+		EXPECT_LT(1u, server.get_max_running());
+
+		inspector.m_container_manager.cleanup();
+
+		// These are process-wide, back to the defaults
+		inspector.set_cri_socket_path("/run/containerd/containerd.sock");
+		inspector.set_cri_extra_queries(true);
+		inspector.set_container_lookup_workers(4);
+	}
+
+	server.stop();
+	unlink(sock.c_str());
+	rmdir(dir);
+}
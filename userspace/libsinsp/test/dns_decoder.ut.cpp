@@ -0,0 +1,138 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <arpa/inet.h>
+#include <gtest.h>
+#include "sinsp.h"
+#include "dns_decoder.h"
+#include "capture_test.h"
+
+namespace
+{
+typedef scap_workload_writer w;
+
+const uint32_t CLIENT_IP = 0x0a000005;	// 10.0.0.5
+const uint32_t RESOLVER_IP = 0x0a60000a;	// 10.96.0.10
+const uint32_t SERVER_IP = 0x5db8d822;	// 93.184.216.34
+const uint64_t TS = 1600000000000000000ULL;
+
+//
+// A response for example.com going through a CNAME, with name compression
+//
+std::string dns_response(uint32_t ttl)
+{
+	const uint8_t hdr[] = {0x12, 0x34, 0x81, 0x80, 0, 1, 0, 2, 0, 0, 0, 0};
+	const uint8_t question[] = {7, 'e', 'x', 'a', 'm', 'p', 'l', 'e', 3, 'c', 'o', 'm', 0, 0, 1, 0, 1};
+	const uint8_t cname[] = {0xc0, 0x0c, 0, 5, 0, 1, 0, 0, 0x0e, 0x10, 0, 6, 3, 'w', 'w', 'w', 0xc0, 0x0c};
+	const uint8_t a_hdr[] = {0xc0, 0x29, 0, 1, 0, 1};
+	uint32_t nttl = htonl(ttl);
+	uint16_t rdlen = htons(4);
+	uint32_t addr = htonl(SERVER_IP);
+
+	std::string res((const char*)hdr, sizeof(hdr));
+	res.append((const char*)question, sizeof(question));
+	res.append((const char*)cname, sizeof(cname));
+	res.append((const char*)a_hdr, sizeof(a_hdr));
+	res.append((const char*)&nttl, sizeof(nttl));
+	res.append((const char*)&rdlen, sizeof(rdlen));
+	res.append((const char*)&addr, sizeof(addr));
+	return res;
+}
+
+void write_connect(w& writer, uint64_t ts, int64_t tid, int64_t fd, uint32_t type, uint32_t dip, uint16_t sport, uint16_t dport)
+{
+	writer.write_event(ts, tid, PPME_SOCKET_SOCKET_E, 0, {w::u32(PPM_AF_INET), w::u32(type), w::u32(0)});
+	writer.write_event(ts + 1, tid, PPME_SOCKET_SOCKET_X, 0, {w::i64(fd)});
+	writer.write_event(ts + 2, tid, PPME_SOCKET_CONNECT_E, 0, {w::i64(fd)});
+	writer.write_event(ts + 3, tid, PPME_SOCKET_CONNECT_X, 0, {w::i64(0), w::tuple4(CLIENT_IP, sport, dip, dport)});
+}
+}
+
+TEST(dns_decoder, parse_response)
+{
+	sinsp_decoder_dns decoder;
+	std::string resp = dns_response(30);
+	uint32_t addr = htonl(SERVER_IP);
+
+	ASSERT_TRUE(decoder.parse_response((const uint8_t*)resp.data(), resp.size(), TS));
+	EXPECT_EQ(1u, decoder.size());
+	EXPECT_EQ("example.com", decoder.name_of(AF_INET, &addr, TS));
+	EXPECT_TRUE(decoder.match("example.com", AF_INET, &addr, TS));
+	EXPECT_TRUE(decoder.match("Example.COM", AF_INET, &addr, TS));
+	EXPECT_FALSE(decoder.match("www.example.com", AF_INET, &addr, TS));
+
+	// TTLs shorter than the floor are extended
+	EXPECT_EQ("example.com", decoder.name_of(AF_INET, &addr, TS + 59 * ONE_SECOND_IN_NS));
+	EXPECT_EQ("", decoder.name_of(AF_INET, &addr, TS + 61 * ONE_SECOND_IN_NS));
+
+	// Queries and truncated headers are ignored
+	std::string query = resp.substr(0, 29);
+	query[2] = 0x01;
+	EXPECT_FALSE(decoder.parse_response((const uint8_t*)query.data(), query.size(), TS));
+	EXPECT_FALSE(decoder.parse_response((const uint8_t*)resp.data(), 8, TS));
+
+	// A response truncated in the middle of the answers keeps what's complete
+	sinsp_decoder_dns truncated;
+	EXPECT_TRUE(truncated.parse_response((const uint8_t*)resp.data(), resp.size() - 2, TS));
+	EXPECT_EQ(0u, truncated.size());
+}
+
+TEST(dns_decoder, capture_replay)
+{
+	temp_file capture("dns_decoder_ut");
+
+	{
+		w writer(capture.path(), 1);
+		int64_t tid = 100;
+		std::string query = dns_response(0).substr(0, 29);
+		query[2] = 0x01;
+		query[3] = 0x00;
+		query[7] = 0;
+		std::string resp = dns_response(3600);
+		w::param tuple = w::tuple4(CLIENT_IP, 40000, RESOLVER_IP, 53);
+
+		write_execve(writer, TS, tid, "/usr/bin/curl", {"example.com"});
+
+		write_connect(writer, TS + 10, tid, 3, 2, RESOLVER_IP, 40000, 53);
+		writer.write_event(TS + 20, tid, PPME_SOCKET_SENDTO_E, 0, {w::i64(3), w::u32(query.size()), tuple});
+		writer.write_event(TS + 21, tid, PPME_SOCKET_SENDTO_X, 0, {w::i64(query.size()), w::buf(query)});
+		writer.write_event(TS + 30, tid, PPME_SOCKET_RECVFROM_E, 0, {w::i64(3), w::u32(512)});
+		writer.write_event(TS + 31, tid, PPME_SOCKET_RECVFROM_X, 0, {w::i64(resp.size()), w::buf(resp), tuple});
+
+		write_connect(writer, TS + 40, tid, 4, 1, SERVER_IP, 40001, 443);
+	}
+
+	sinsp inspector;
+	inspector.open(capture.path());
+
+	sinsp_evt_formatter formatter(&inspector, "%fd.sip.name");
+	std::string server_name;
+	sinsp_evt* evt;
+	int32_t res;
+	while((res = inspector.next(&evt)) != SCAP_EOF)
+	{
+		ASSERT_EQ(SCAP_SUCCESS, res);
+		if(evt->get_type() == PPME_SOCKET_CONNECT_X && evt->get_fd_num() == 4)
+		{
+			formatter.tostring(evt, &server_name);
+		}
+	}
+
+	inspector.close();
+
+	EXPECT_EQ("example.com", server_name);
+}
@@ -0,0 +1,96 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <arpa/inet.h>
+#include <gtest.h>
+#include "dns_manager.h"
+
+TEST(dns_manager, forward_and_reverse)
+{
+	sinsp_dns_manager &manager = sinsp_dns_manager::get();
+	uint64_t ts = sinsp_utils::get_current_time_ns();
+	uint32_t localhost = htonl(INADDR_LOOPBACK);
+	uint32_t other = htonl(0x0a000001);
+
+	// Nothing is known until a name is looked up
+	EXPECT_EQ("", manager.name_of(AF_INET, &localhost, ts));
+
+	EXPECT_TRUE(manager.match("localhost", AF_INET, &localhost, ts));
+	EXPECT_FALSE(manager.match("localhost", AF_INET, &other, ts));
+	EXPECT_EQ(1u, manager.size());
+
+	EXPECT_EQ("localhost", manager.name_of(AF_INET, &localhost, ts));
+	EXPECT_EQ("", manager.name_of(AF_INET, &other, ts));
+
+	manager.cleanup();
+}
+
+//
+// New names are published in batches, and can be looked up before
+//
+TEST(dns_manager, batches)
+{
+	sinsp_dns_manager &manager = sinsp_dns_manager::get();
+	uint64_t ts = sinsp_utils::get_current_time_ns();
+	size_t n = manager.size();
+
+	for(uint32_t j = 1; j <= 150; j++)
+	{
+		std::string name = "127.0.1." + std::to_string(j);
+		uint32_t addr = htonl(0x7f000100 + j);
+
+		EXPECT_TRUE(manager.match(name.c_str(), AF_INET, &addr, ts)) << name;
+		EXPECT_EQ(name, manager.name_of(AF_INET, &addr, ts));
+		EXPECT_EQ(n + j, manager.size());
+	}
+
+	// The last ones get published once the delay passed
+	uint32_t last = htonl(0x7f000100 + 150);
+	ts += ONE_SECOND_IN_NS;
+	EXPECT_TRUE(manager.match("127.0.1.150", AF_INET, &last, ts));
+	EXPECT_EQ("127.0.1.150", manager.name_of(AF_INET, &last, ts));
+	EXPECT_EQ(n + 150, manager.size());
+
+	manager.cleanup();
+}
+
+TEST(dns_manager, max_memory)
+{
+	sinsp_dns_manager &manager = sinsp_dns_manager::get();
+	uint64_t ts = sinsp_utils::get_current_time_ns();
+	uint64_t max_memory = 16 * 1024;
+	uint64_t n_evicted = manager.get_n_evicted();
+
+	manager.set_max_memory(max_memory);
+	for(uint32_t j = 1; j <= 200; j++)
+	{
+		std::string name = "127.0.2." + std::to_string(j);
+		uint32_t addr = htonl(0x7f000200 + j);
+		EXPECT_TRUE(manager.match(name.c_str(), AF_INET, &addr, ts + j));
+	}
+
+	EXPECT_GT(manager.get_n_evicted(), n_evicted);
+	// The names not published yet aren't evicted
+	EXPECT_LT(manager.get_memory_usage(), 2 * max_memory);
+
+	// The most recently used ones stay
+	uint32_t addr = htonl(0x7f000200 + 192);
+	EXPECT_EQ("127.0.2.192", manager.name_of(AF_INET, &addr, ts + 200));
+
+	manager.set_max_memory(0);
+	manager.cleanup();
+}
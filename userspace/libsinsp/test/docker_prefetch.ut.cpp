@@ -0,0 +1,223 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstring>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <gtest.h>
+#include "sinsp.h"
+
+namespace
+{
+//
+// Just enough of the Docker API on a unix socket: the container list and
+// the inspection of every container in it, each taking a while
+//
+class fake_docker
+{
+public:
+	fake_docker(const std::string& path, const std::vector<std::string>& ids, uint32_t delay_ms):
+		m_path(path),
+		m_ids(ids),
+		m_delay_ms(delay_ms),
+		m_fd(-1),
+		m_running(0),
+		m_max_running(0)
+	{
+	}
+
+	~fake_docker()
+	{
+		stop();
+	}
+
+	bool start()
+	{
+		struct sockaddr_un addr = {};
+		addr.sun_family = AF_UNIX;
+		strncpy(addr.sun_path, m_path.c_str(), sizeof(addr.sun_path) - 1);
+
+		m_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if(m_fd < 0 ||
+		   bind(m_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+		   listen(m_fd, 64) != 0)
+		{
+			return false;
+		}
+
+		m_accept_thread = std::thread(&fake_docker::accept_loop, this);
+		return true;
+	}
+
+	void stop()
+	{
+		if(m_fd < 0)
+		{
+			return;
+		}
+
+		shutdown(m_fd, SHUT_RDWR);
+		m_accept_thread.join();
+		close(m_fd);
+		m_fd = -1;
+
+		for(auto& t : m_handlers)
+		{
+			t.join();
+		}
+		m_handlers.clear();
+		unlink(m_path.c_str());
+	}
+
+	bool wait_for_lookups(size_t n)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		return m_cond.wait_for(lock, std::chrono::seconds(10), [&] { return m_looked_up.size() >= n; });
+	}
+
+	uint32_t get_max_running() const
+	{
+		return m_max_running;
+	}
+
+private:
+	void accept_loop()
+	{
+		int fd;
+		while((fd = accept(m_fd, NULL, NULL)) >= 0)
+		{
+			m_handlers.emplace_back(&fake_docker::handle, this, fd);
+		}
+	}
+
+	void handle(int fd)
+	{
+		std::string req;
+		char buf[1024];
+		ssize_t n;
+		while(req.find("\r\n\r\n") == std::string::npos && (n = read(fd, buf, sizeof(buf))) > 0)
+		{
+			req.append(buf, n);
+		}
+
+		// GET /v1.24/containers/<id>/json HTTP/1.1
+		std::string url = req.substr(0, req.find(" HTTP/"));
+		std::string body;
+		std::string status = "200 OK";
+		if(url.size() > 16 && url.compare(url.size() - 16, 16, "/containers/json") == 0)
+		{
+			body = "[";
+			for(const auto& id : m_ids)
+			{
+				body += std::string(body.size() > 1 ? "," : "") + "{\"Id\":\"" + id + "\"}";
+			}
+			body += "]";
+		}
+		else if(url.find("/containers/") != std::string::npos)
+		{
+			std::string id = url.substr(url.find("/containers/") + 12, 12);
+			uint32_t running = ++m_running;
+			uint32_t max_running = m_max_running;
+			while(running > max_running && !m_max_running.compare_exchange_weak(max_running, running))
+			{
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(m_delay_ms));
+			m_running--;
+
+			body = "{\"Id\":\"" + id + "\",\"Name\":\"/fake_" + id + "\",\"Image\":\"sha256:0123\","
+				"\"Created\":\"2021-01-01T00:00:00Z\",\"Config\":{\"Image\":\"busybox:latest\",\"Labels\":{}},"
+				"\"HostConfig\":{},\"NetworkSettings\":{}}";
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_looked_up.insert(id);
+			m_cond.notify_all();
+		}
+		else
+		{
+			status = "404 Not Found";
+		}
+
+		std::string resp = "HTTP/1.1 " + status + "\r\nContent-Type: application/json\r\n"
+			"Content-Length: " + std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+		if(write(fd, resp.data(), resp.size()) < 0)
+		{
+			ADD_FAILURE() << "write failed";
+		}
+		close(fd);
+	}
+
+	std::string m_path;
+	std::vector<std::string> m_ids;
+	uint32_t m_delay_ms;
+	int m_fd;
+	std::thread m_accept_thread;
+	std::vector<std::thread> m_handlers;
+	std::atomic<uint32_t> m_running;
+	std::atomic<uint32_t> m_max_running;
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+	std::set<std::string> m_looked_up;
+};
+}
+
+TEST(docker_prefetch, concurrent_lookups)
+{
+	char dir[] = "/tmp/docker_prefetch_ut_XXXXXX";
+	ASSERT_NE(nullptr, mkdtemp(dir));
+	std::string sock = std::string(dir) + "/docker.sock";
+
+	std::vector<std::string> ids;
+	for(char c = 'a'; c < 'i'; c++)
+	{
+		ids.push_back(std::string(64, c));
+	}
+
+	fake_docker server(sock, ids, 200);
+	ASSERT_TRUE(server.start());
+
+	{
+		sinsp inspector;
+		inspector.set_docker_socket_path(sock);
+		inspector.set_query_docker_image_info(false);
+		inspector.set_container_lookup_workers(4);
+		inspector.m_container_manager.prefetch_containers();
+
+		for(const auto& id : ids)
+		{
+			EXPECT_TRUE(inspector.m_container_manager.container_exists(id.substr(0, 12)));
+		}
+
+		EXPECT_TRUE(server.wait_for_lookups(ids.size()));
+		EXPECT_LT(1u, server.get_max_running());
+
+		inspector.m_container_manager.cleanup();
+
+		// These are process-wide, back to the defaults
+		inspector.set_docker_socket_path("/var/run/docker.sock");
+		inspector.set_query_docker_image_info(true);
+		inspector.set_container_lookup_workers(4);
+	}
+
+	server.stop();
+	rmdir(dir);
+}
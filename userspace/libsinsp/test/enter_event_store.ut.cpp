@@ -0,0 +1,162 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest.h>
+#include "sinsp.h"
+#include "capture_test.h"
+
+namespace
+{
+typedef scap_workload_writer w;
+
+std::vector<uint8_t> make_evt(uint16_t type, const std::vector<w::param>& params)
+{
+	std::vector<uint8_t> buf(sizeof(struct ppm_evt_hdr) + params.size() * sizeof(uint16_t));
+	for(uint32_t j = 0; j < params.size(); j++)
+	{
+		uint16_t len = (uint16_t)params[j].size();
+		memcpy(&buf[sizeof(struct ppm_evt_hdr) + j * sizeof(uint16_t)], &len, sizeof(len));
+		buf.insert(buf.end(), params[j].begin(), params[j].end());
+	}
+
+	scap_evt* hdr = (scap_evt*)&buf[0];
+	hdr->ts = 1;
+	hdr->tid = 2;
+	hdr->len = buf.size();
+	hdr->type = type;
+	hdr->nparams = params.size();
+	return buf;
+}
+
+uint16_t param_len(uint8_t* evt, uint32_t j)
+{
+	return ((uint16_t*)(evt + sizeof(struct ppm_evt_hdr)))[j];
+}
+}
+
+TEST(enter_event_store, kept_params)
+{
+	sinsp_enter_event_store store;
+
+	std::vector<uint8_t> openat = make_evt(PPME_SYSCALL_OPENAT_E,
+		{w::i64(-100), w::str("/etc/passwd"), w::u32(1), w::u32(0644)});
+	uint8_t* data = store.store((scap_evt*)&openat[0], NULL);
+
+	// The mode isn't used by the exit parser
+	EXPECT_EQ(openat.size() - sizeof(uint32_t), ((scap_evt*)data)->len);
+	EXPECT_EQ(PPME_SYSCALL_OPENAT_E, ((scap_evt*)data)->type);
+	EXPECT_EQ(4u, ((scap_evt*)data)->nparams);
+	EXPECT_EQ(12u, param_len(data, 1));
+	EXPECT_EQ(0u, param_len(data, 3));
+	uint32_t vals = sizeof(struct ppm_evt_hdr) + 4 * sizeof(uint16_t);
+	EXPECT_EQ(0, memcmp(&openat[vals], data + vals, ((scap_evt*)data)->len - vals));
+
+	// Only the tuple of sendto(), in the slot of the previous event
+	std::vector<uint8_t> sendto = make_evt(PPME_SOCKET_SENDTO_E,
+		{w::i64(3), w::u32(100), w::tuple4(0x0a000001, 1000, 0x0a000002, 53)});
+	EXPECT_EQ(data, store.store((scap_evt*)&sendto[0], data));
+	EXPECT_EQ(0u, param_len(data, 0));
+	EXPECT_EQ(0u, param_len(data, 1));
+	EXPECT_EQ(13u, param_len(data, 2));
+	EXPECT_EQ(1u, store.get_n_stored());
+
+	// Not in the table, stored whole
+	std::vector<uint8_t> read = make_evt(PPME_SYSCALL_READ_E, {w::i64(3), w::u32(100)});
+	data = store.store((scap_evt*)&read[0], data);
+	EXPECT_EQ(0, memcmp(&read[0], data, read.size()));
+
+	store.release(data);
+	EXPECT_EQ(0u, store.get_n_stored());
+}
+
+TEST(enter_event_store, slots)
+{
+	sinsp_enter_event_store store;
+	std::vector<uint8_t*> stored;
+
+	std::vector<uint8_t> execve = make_evt(PPME_SYSCALL_EXECVE_19_E, {w::str("/usr/bin/make")});
+	for(uint32_t j = 0; j < sinsp_enter_event_store::SLOTS_PER_SLAB + 1; j++)
+	{
+		stored.push_back(store.store((scap_evt*)&execve[0], NULL));
+	}
+	EXPECT_EQ(2u * sinsp_enter_event_store::SLOTS_PER_SLAB * sinsp_enter_event_store::SLOT_SIZE,
+		store.get_memory_usage());
+
+	// Too long for a slot
+	std::string path(1000, 'a');
+	std::vector<uint8_t> long_execve = make_evt(PPME_SYSCALL_EXECVE_19_E, {w::str(path)});
+	stored.push_back(store.store((scap_evt*)&long_execve[0], NULL));
+	EXPECT_EQ(0, memcmp(&long_execve[0], stored.back(), long_execve.size()));
+	EXPECT_EQ(sinsp_enter_event_store::SLOTS_PER_SLAB + 2, store.get_n_stored());
+
+	for(uint8_t* data : stored)
+	{
+		store.trim();
+		store.release(data);
+	}
+	EXPECT_EQ(0u, store.get_n_stored());
+
+	store.trim();
+	EXPECT_EQ(0u, store.get_memory_usage());
+}
+
+TEST(enter_event_store, exit_parsers)
+{
+	temp_file capture("enter_event_store_ut");
+
+	{
+		w writer(capture.path(), 1);
+
+		// Every thread enters openat() before any of them returns
+		for(int64_t tid = 100; tid < 110; tid++)
+		{
+			writer.write_event(tid, tid, PPME_SYSCALL_OPENAT_E, 0,
+				{w::i64(-100), w::str("/etc/file" + std::to_string(tid)), w::u32(1), w::u32(0)});
+		}
+		for(int64_t tid = 100; tid < 110; tid++)
+		{
+			writer.write_event(tid + 100, tid, PPME_SYSCALL_OPENAT_X, 0, {w::i64(3)});
+		}
+	}
+
+	sinsp inspector;
+	sinsp_evt_formatter formatter(&inspector, "%thread.tid %fd.name");
+	inspector.open(capture.path());
+
+	std::vector<std::string> out;
+	uint64_t max_stored = 0;
+	sinsp_evt* evt;
+	int32_t res;
+	while((res = inspector.next(&evt)) != SCAP_EOF)
+	{
+		EXPECT_EQ(SCAP_SUCCESS, res);
+		max_stored = std::max(max_stored, inspector.get_enter_event_store().get_n_stored());
+		if(evt->get_type() == PPME_SYSCALL_OPENAT_X)
+		{
+			std::string line;
+			formatter.tostring(evt, &line);
+			out.push_back(line);
+		}
+	}
+
+	EXPECT_EQ(10u, max_stored);
+	ASSERT_EQ(10u, out.size());
+	EXPECT_EQ("100 /etc/file100", out[0]);
+	EXPECT_EQ("109 /etc/file109", out[9]);
+
+	inspector.close();
+}
@@ -0,0 +1,210 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <gtest.h>
+#include "sinsp.h"
+#include "capture_test.h"
+
+namespace
+{
+typedef scap_workload_writer w;
+
+const uint64_t MS = 1000000;
+
+//
+// A thread opening 50 files, one every millisecond
+//
+class event_handle_test : public capture_test
+{
+protected:
+	void SetUp() override
+	{
+		w writer(m_capture, 1);
+		uint64_t ts = MS;
+
+		for(int64_t fd = 3; fd < 53; fd++)
+		{
+			std::string name = "/etc/file" + std::to_string(fd);
+			writer.write_event(ts, 100, PPME_SYSCALL_OPENAT_E, 0,
+				{w::i64(-100), w::str(name), w::u32(1), w::u32(0)});
+			writer.write_event(ts + 1000, 100, PPME_SYSCALL_OPENAT_X, 0,
+				{w::i64(fd), w::i64(-100), w::str(name), w::u32(1), w::u32(0), w::u32(0)});
+			ts += MS;
+		}
+	}
+
+	//
+	// Replays the capture, passing every event to f
+	//
+	template<typename F>
+	void replay(F f)
+	{
+		m_inspector.open(m_capture);
+
+		sinsp_evt* evt;
+		int32_t res;
+		while((res = m_inspector.next(&evt)) != SCAP_EOF)
+		{
+			ASSERT_EQ(SCAP_SUCCESS, res);
+			f(evt);
+		}
+	}
+
+	//
+	// What the held exit event of the file fd should be. The thread can
+	// only be checked on the inspector thread.
+	//
+	static void check_open(sinsp_evt* evt, int64_t fd, bool check_thread = true)
+	{
+		std::string name = "/etc/file" + std::to_string(fd);
+
+		ASSERT_EQ(PPME_SYSCALL_OPENAT_X, evt->get_type());
+		EXPECT_EQ((uint64_t)(fd - 2) * 2, evt->get_num());
+		ASSERT_EQ(1u, evt->get_num_params());
+		EXPECT_EQ(fd, *(int64_t*)evt->get_param(0)->m_val);
+		ASSERT_NE(nullptr, evt->get_fd_info());
+		EXPECT_EQ(name, evt->get_fd_info()->m_name);
+		EXPECT_EQ(fd, evt->get_fd_num());
+
+		if(check_thread)
+		{
+			ASSERT_NE(nullptr, evt->get_thread_info());
+			EXPECT_EQ(100, evt->get_thread_info()->m_tid);
+		}
+	}
+
+	sinsp m_inspector;
+};
+}
+
+TEST_F(event_handle_test, hold)
+{
+	sinsp_evt* evt = NULL;
+	EXPECT_FALSE(m_inspector.hold_event(evt));
+
+	m_inspector.set_event_handles(100);
+	std::vector<sinsp_evt_ref> held;
+	replay([&](sinsp_evt* evt) {
+		if(evt->get_type() == PPME_SYSCALL_OPENAT_X)
+		{
+			held.push_back(m_inspector.hold_event(evt));
+			ASSERT_TRUE(held.back());
+		}
+	});
+
+	EXPECT_EQ(50u, m_inspector.get_event_handles().get_n_free());
+
+	// The events, their fds and their thread are still there after the
+	// capture is gone
+	m_inspector.close();
+	for(int64_t fd = 3; fd < 53; fd++)
+	{
+		check_open(held[fd - 3].get(), fd);
+	}
+
+	held.clear();
+	EXPECT_EQ(100u, m_inspector.get_event_handles().get_n_free());
+	EXPECT_EQ(0u, m_inspector.get_event_handles().get_n_exhausted());
+}
+
+TEST_F(event_handle_test, exhausted)
+{
+	m_inspector.set_event_handles(10);
+	std::vector<sinsp_evt_ref> held;
+	replay([&](sinsp_evt* evt) {
+		sinsp_evt_ref ref = m_inspector.hold_event(evt);
+		if(ref)
+		{
+			held.push_back(ref);
+		}
+	});
+
+	EXPECT_EQ(10u, held.size());
+	EXPECT_EQ(90u, m_inspector.get_event_handles().get_n_exhausted());
+	EXPECT_THROW(m_inspector.set_event_handles(20), sinsp_exception);
+
+	// A handle is released with its last reference
+	sinsp_evt_ref copy = held[0];
+	held[0].reset();
+	EXPECT_EQ(0u, m_inspector.get_event_handles().get_n_free());
+	copy.reset();
+	EXPECT_EQ(1u, m_inspector.get_event_handles().get_n_free());
+
+	held.clear();
+	m_inspector.set_event_handles(20);
+	EXPECT_EQ(20u, m_inspector.get_event_handles().get_n_free());
+}
+
+TEST_F(event_handle_test, threads)
+{
+	// Fewer handles than events: the inspector waits for the worker
+	m_inspector.set_event_handles(4, ONE_SECOND_IN_NS);
+
+	std::mutex mutex;
+	std::condition_variable cond;
+	std::deque<sinsp_evt_ref> queue;
+	bool done = false;
+	uint32_t nchecked = 0;
+
+	std::thread worker([&]() {
+		while(true)
+		{
+			sinsp_evt_ref ref;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				cond.wait(lock, [&] { return done || !queue.empty(); });
+				if(queue.empty())
+				{
+					return;
+				}
+
+				ref = std::move(queue.front());
+				queue.pop_front();
+			}
+
+			if(ref->get_type() == PPME_SYSCALL_OPENAT_X)
+			{
+				check_open(ref.get(), (int64_t)ref->get_num() / 2 + 2, false);
+				nchecked++;
+			}
+		}
+	});
+
+	replay([&](sinsp_evt* evt) {
+		sinsp_evt_ref ref = m_inspector.hold_event(evt);
+		ASSERT_TRUE(ref);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		queue.push_back(std::move(ref));
+		cond.notify_one();
+	});
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		done = true;
+		cond.notify_one();
+	}
+
+	worker.join();
+	EXPECT_EQ(50u, nchecked);
+	EXPECT_EQ(0u, m_inspector.get_event_handles().get_n_exhausted());
+	EXPECT_EQ(4u, m_inspector.get_event_handles().get_n_free());
+}
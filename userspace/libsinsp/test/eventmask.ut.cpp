@@ -0,0 +1,145 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <memory>
+#include <gtest.h>
+#include "sinsp.h"
+#include "filter.h"
+
+namespace
+{
+std::set<uint16_t> filter_evttypes(sinsp& inspector, const char* fltstr)
+{
+	sinsp_filter_compiler compiler(&inspector, fltstr);
+	std::unique_ptr<sinsp_filter> filter(compiler.compile());
+
+	std::vector<bool> evttypes;
+	filter->evttypes(evttypes);
+
+	std::set<uint16_t> res;
+	for(uint16_t j = 0; j < PPM_EVENT_MAX; j++)
+	{
+		if(evttypes[j])
+		{
+			res.insert(j);
+		}
+	}
+	return res;
+}
+}
+
+TEST(eventmask, filter_evttypes)
+{
+	sinsp inspector;
+	// read is a syscall name too, the generic events can be about it
+	std::set<uint16_t> read = {PPME_GENERIC_E, PPME_GENERIC_X, PPME_SYSCALL_READ_E, PPME_SYSCALL_READ_X};
+
+	EXPECT_EQ(read, filter_evttypes(inspector, "evt.type=read"));
+	EXPECT_EQ(read, filter_evttypes(inspector, "evt.type=read and proc.name=nginx"));
+	EXPECT_EQ(read, filter_evttypes(inspector, "proc.name=nginx and (evt.type=read and not fd.num=0)"));
+	EXPECT_EQ(read, filter_evttypes(inspector, "evt.type in (read, write) and not evt.type=write and evt.type=read"));
+
+	std::set<uint16_t> rw = filter_evttypes(inspector, "evt.type=read or evt.type in (write, open)");
+	EXPECT_EQ(1u, rw.count(PPME_SYSCALL_WRITE_X));
+	EXPECT_EQ(1u, rw.count(PPME_SYSCALL_OPEN_E));
+	EXPECT_EQ(0u, rw.count(PPME_SYSCALL_CLOSE_X));
+
+	// Only told by the generic events
+	std::set<uint16_t> generic = {PPME_GENERIC_E, PPME_GENERIC_X};
+	EXPECT_EQ(generic, filter_evttypes(inspector, "evt.type=madvise"));
+
+	// Nothing to tell
+	EXPECT_EQ(PPM_EVENT_MAX, filter_evttypes(inspector, "proc.name=nginx").size());
+	EXPECT_EQ(PPM_EVENT_MAX, filter_evttypes(inspector, "not evt.type=read").size());
+	EXPECT_EQ(PPM_EVENT_MAX, filter_evttypes(inspector, "evt.type=read or proc.name=nginx").size());
+	EXPECT_EQ(PPM_EVENT_MAX, filter_evttypes(inspector, "evt.type!=read").size());
+}
+
+TEST(eventmask, auto_eventmask)
+{
+	sinsp inspector;
+	std::vector<bool> evttypes;
+
+	// Nobody told what they need
+	inspector.get_auto_eventmask(evttypes);
+	EXPECT_EQ(std::vector<bool>(PPM_EVENT_MAX + 1, true), evttypes);
+
+	inspector.set_filter("evt.type=read and proc.name=nginx");
+	inspector.get_auto_eventmask(evttypes);
+	EXPECT_TRUE(evttypes[PPME_SYSCALL_READ_X]);
+	EXPECT_FALSE(evttypes[PPME_SYSCALL_WRITE_X]);
+	EXPECT_FALSE(evttypes[PPME_SYSCALL_MMAP_X]);
+
+	// What the parsers need
+	EXPECT_TRUE(evttypes[PPME_SYSCALL_CLONE_20_X]);
+	EXPECT_TRUE(evttypes[PPME_SYSCALL_OPENAT_2_X]);
+	EXPECT_TRUE(evttypes[PPME_SYSCALL_CLOSE_E]);
+	EXPECT_TRUE(evttypes[PPME_PROCEXIT_1_E]);
+	EXPECT_TRUE(evttypes[PPME_DROP_E]);
+
+	// The rulesets follow their changes
+	sinsp_evttype_filter rules;
+	inspector.add_auto_eventmask_filter(&rules);
+
+	std::string name = "writes";
+	std::set<uint32_t> rule_evttypes = {PPME_SYSCALL_WRITE_E, PPME_SYSCALL_WRITE_X};
+	std::set<uint32_t> syscalls;
+	std::set<std::string> tags;
+	sinsp_filter_compiler compiler(&inspector, "evt.type=write and fd.num=1");
+	rules.add(name, rule_evttypes, syscalls, tags, compiler.compile());
+
+	uint64_t generation = rules.get_generation();
+	rules.enable("writes", true, 3);
+	EXPECT_NE(generation, rules.get_generation());
+
+	inspector.get_auto_eventmask(evttypes);
+	EXPECT_TRUE(evttypes[PPME_SYSCALL_READ_X]);
+	EXPECT_TRUE(evttypes[PPME_SYSCALL_WRITE_X]);
+
+	rules.enable("writes", false, 3);
+	inspector.get_auto_eventmask(evttypes);
+	EXPECT_FALSE(evttypes[PPME_SYSCALL_WRITE_X]);
+}
+
+TEST(eventmask, rollups)
+{
+	sinsp inspector;
+	std::vector<bool> evttypes;
+
+	inspector.set_filter("evt.type=read");
+
+	// No metrics, nothing needed
+	sinsp_rollup& rollup = inspector.enable_rollups();
+	inspector.get_auto_eventmask(evttypes);
+	EXPECT_FALSE(evttypes[PPME_SYSCALL_WRITE_X]);
+
+	rollup.add_metric({"write_bytes", sinsp_rollup::ENTITY_PROCESS,
+		sinsp_rollup::AGG_SUM, "evt.rawres", "evt.type=write and evt.rawres>0"});
+	inspector.get_auto_eventmask(evttypes);
+	EXPECT_TRUE(evttypes[PPME_SYSCALL_READ_X]);
+	EXPECT_TRUE(evttypes[PPME_SYSCALL_WRITE_X]);
+	EXPECT_FALSE(evttypes[PPME_SYSCALL_MMAP_X]);
+
+	// A metric of all the events needs them all
+	rollup.add_metric({"events", sinsp_rollup::ENTITY_CONTAINER,
+		sinsp_rollup::AGG_COUNT, "", ""});
+	inspector.get_auto_eventmask(evttypes);
+	for(uint16_t j = 0; j < PPM_EVENT_MAX; j++)
+	{
+		EXPECT_TRUE(evttypes[j]) << j;
+	}
+}
@@ -0,0 +1,249 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <memory>
+#include <gtest.h>
+#include "sinsp.h"
+#include "filter.h"
+#include "filterchecks.h"
+#include "capture_test.h"
+
+extern sinsp_filter_check_list g_filterlist;
+
+namespace
+{
+typedef scap_workload_writer w;
+
+const char* s_filters[] =
+{
+	"proc.name=nginx and fd.name contains /var/www",
+	"proc.name in (nginx, sh) and evt.type=read",
+	"fd.name startswith /var and evt.latency > 0",
+	"proc.name=nginx and thread.exectime > 0",
+};
+
+const char* s_format = "%evt.num %proc.name %thread.exectime %evt.type %fd.name %evt.latency %evt.args";
+
+//
+// The filter results and the formatted output of every event
+//
+std::vector<std::string> replay(sinsp& inspector, const std::string& capture)
+{
+	std::vector<std::unique_ptr<sinsp_filter>> filters;
+	for(const char* f : s_filters)
+	{
+		sinsp_filter_compiler compiler(&inspector, f);
+		filters.emplace_back(compiler.compile());
+	}
+
+	sinsp_evt_formatter formatter(&inspector, s_format);
+
+	std::vector<std::string> res;
+	for(uint32_t j = 0; j < 2; j++)
+	{
+		inspector.open(capture);
+
+		sinsp_evt* evt;
+		int32_t rc;
+		while((rc = inspector.next(&evt)) != SCAP_EOF)
+		{
+			EXPECT_EQ(SCAP_SUCCESS, rc);
+
+			std::string line;
+			for(auto& f : filters)
+			{
+				line += f->run(evt) ? '1' : '0';
+			}
+
+			std::string out;
+			formatter.tostring(evt, &out);
+			res.push_back(line + " " + out);
+		}
+
+		inspector.close();
+	}
+
+	return res;
+}
+
+class field_cache_test : public capture_test
+{
+protected:
+	void SetUp() override
+	{
+		scap_workload::generate(scap_workload::WEB_SERVER, m_capture, 5000);
+	}
+};
+}
+
+TEST_F(field_cache_test, shared_slots)
+{
+	sinsp inspector;
+	sinsp_field_cache& cache = inspector.get_field_cache();
+
+	sinsp_filter_compiler c1(&inspector, "proc.name=nginx and evt.latency > 0");
+	std::unique_ptr<sinsp_filter> f1(c1.compile());
+	sinsp_filter_compiler c2(&inspector, "proc.name=sh or proc.pid=1");
+	std::unique_ptr<sinsp_filter> f2(c2.compile());
+
+	// evt.latency keeps per-check state and isn't shared
+	EXPECT_EQ(3u, cache.get_n_attached());
+	// proc.name, raw and sanitized, and proc.pid
+	EXPECT_EQ(3u, cache.get_n_slots());
+
+	// Neither does thread.exectime, in the check itself
+	sinsp_filter_compiler c3(&inspector, "thread.exectime > 0");
+	std::unique_ptr<sinsp_filter> f3(c3.compile());
+	EXPECT_EQ(3u, cache.get_n_attached());
+	EXPECT_EQ(3u, cache.get_n_slots());
+
+	sinsp_evt_formatter formatter(&inspector, "%proc.name %proc.pid %fd.name");
+	EXPECT_EQ(6u, cache.get_n_attached());
+	EXPECT_EQ(5u, cache.get_n_slots());
+
+	cache.set_enabled(false);
+	sinsp_evt_formatter formatter2(&inspector, "%proc.name %container.id");
+	EXPECT_EQ(6u, cache.get_n_attached());
+	EXPECT_EQ(5u, cache.get_n_slots());
+}
+
+TEST_F(field_cache_test, same_results)
+{
+	//
+	// The web server never switches, which thread.exectime needs: nginx
+	// and sh taking turns on a few CPUs
+	//
+	temp_file switches("field_cache_ut");
+	{
+		w writer(switches.path(), 4);
+		write_execve(writer, 1000, 100, "/usr/sbin/nginx");
+		write_execve(writer, 2000, 200, "/bin/sh");
+
+		for(uint32_t j = 0; j < 200; j++)
+		{
+			int64_t tid = j % 3 == 0 ? 200 : 100;
+			writer.write_event(10000 + j * 1000, tid, PPME_SCHEDSWITCH_6_E, j % 4,
+				{w::i64(tid == 100 ? 200 : 100), w::u64(0), w::u64(j), w::u32(4096), w::u32(1024), w::u32(0)});
+		}
+	}
+
+	for(const std::string& capture : {m_capture, switches.path()})
+	{
+		sinsp cached;
+		std::vector<std::string> with_cache = replay(cached, capture);
+		EXPECT_LT(0u, cached.get_field_cache().get_n_attached());
+
+		sinsp uncached;
+		uncached.get_field_cache().set_enabled(false);
+		std::vector<std::string> without_cache = replay(uncached, capture);
+		EXPECT_EQ(0u, uncached.get_field_cache().get_n_attached());
+
+		ASSERT_EQ(without_cache.size(), with_cache.size());
+		for(uint32_t j = 0; j < with_cache.size(); j++)
+		{
+			ASSERT_EQ(without_cache[j], with_cache[j]) << capture << ", event " << j;
+		}
+
+		//
+		// The second pass starts again from event 1 and mustn't see the old
+		// values. thread.exectime does, with or without the cache: the
+		// check keeps the last switch of each CPU across captures.
+		//
+		if(capture == m_capture)
+		{
+			uint32_t half = with_cache.size() / 2;
+			for(uint32_t j = 0; j < half; j++)
+			{
+				ASSERT_EQ(with_cache[j], with_cache[half + j]) << "event " << j;
+			}
+		}
+	}
+}
+
+//
+// Checks whose cache entry is set by the caller, as Falco does
+//
+TEST_F(field_cache_test, external_entries)
+{
+	sinsp inspector;
+	sinsp_field_cache& cache = inspector.get_field_cache();
+
+	auto new_check = [&](const char* field)
+	{
+		sinsp_filter_check* chk = g_filterlist.new_filter_check_from_fldname(field, &inspector, true);
+		chk->parse_field_name(field, true, false);
+		return std::unique_ptr<sinsp_filter_check>(chk);
+	};
+
+	check_extraction_cache_entry name_entry;
+	std::unique_ptr<sinsp_filter_check> name(new_check("fd.name"));
+	name->m_extraction_cache_entry = &name_entry;
+	std::unique_ptr<sinsp_filter_check> name_uncached(new_check("fd.name"));
+
+	check_extraction_cache_entry pid_entry;
+	std::unique_ptr<sinsp_filter_check> pid(new_check("proc.pid"));
+	pid->m_extraction_cache_entry = &pid_entry;
+
+	uint32_t n_slots = cache.get_n_slots();
+	for(uint32_t j = 0; j < 2; j++)
+	{
+		inspector.open(m_capture);
+
+		sinsp_evt* evt;
+		while(inspector.next(&evt) != SCAP_EOF)
+		{
+			uint32_t len, expected_len;
+			uint8_t* res = name->extract_cached(evt, &len);
+			uint8_t* expected = name_uncached->extract(evt, &expected_len);
+			ASSERT_EQ(expected == NULL, res == NULL) << "event " << evt->get_num();
+			if(res != NULL)
+			{
+				ASSERT_EQ(std::string((char*)expected, expected_len), std::string((char*)res, len));
+			}
+
+			// Served from the cache the second time
+			EXPECT_EQ(res, name->extract_cached(evt, &len));
+			pid->extract_cached(evt, &len);
+			EXPECT_EQ(evt->get_num(), name->m_sanitized_extraction_cache_entry->m_evtnum);
+			EXPECT_EQ(evt->get_num(), pid_entry.m_evtnum);
+		}
+
+		inspector.close();
+	}
+
+	// The raw strings stay in the caller's entry, the sanitized ones get a slot
+	EXPECT_NE(&name_entry, name->m_sanitized_extraction_cache_entry);
+	EXPECT_EQ(&pid_entry, pid->m_sanitized_extraction_cache_entry);
+	EXPECT_EQ(n_slots + 1, cache.get_n_slots());
+
+	// The checks created again on the same entry, as on a rules reload
+	check_extraction_cache_entry* sanitized = name->m_sanitized_extraction_cache_entry;
+	for(uint32_t j = 0; j < 10; j++)
+	{
+		name = new_check("fd.name");
+		name->m_extraction_cache_entry = &name_entry;
+		inspector.open(m_capture);
+
+		sinsp_evt* evt;
+		uint32_t len;
+		ASSERT_EQ(SCAP_SUCCESS, inspector.next(&evt));
+		name->extract_cached(evt, &len);
+		EXPECT_EQ(sanitized, name->m_sanitized_extraction_cache_entry);
+		inspector.close();
+	}
+	EXPECT_EQ(n_slots + 1, cache.get_n_slots());
+}
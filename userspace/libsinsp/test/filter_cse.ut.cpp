@@ -0,0 +1,129 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <algorithm>
+#include <memory>
+#include <gtest.h>
+#include "sinsp.h"
+#include "filter.h"
+#include "capture_test.h"
+
+namespace
+{
+//
+// The same macros, expanded in every rule
+//
+const char* s_rules[] =
+{
+	"(evt.type=accept and evt.dir=<) and proc.name in (nginx, sh)",
+	"(evt.type=accept and evt.dir=<) and proc.name=nginx",
+	"(evt.type=accept and evt.dir=<) and proc.name in (nginx, sh) and fd.name startswith /var",
+	"(evt.type=read and evt.dir=<) and proc.name in (nginx, sh) and evt.latency > 0",
+	"(evt.type=read and evt.dir=<) and not proc.name in (nginx, sh)",
+};
+
+const uint32_t N_RULES = sizeof(s_rules) / sizeof(s_rules[0]);
+
+void add_rules(sinsp& inspector, sinsp_evttype_filter& rules)
+{
+	std::set<uint32_t> evttypes;
+	std::set<uint32_t> syscalls;
+	std::set<std::string> tags;
+
+	for(uint32_t j = 0; j < N_RULES; j++)
+	{
+		std::string name = "rule" + std::to_string(j);
+		sinsp_filter_compiler compiler(&inspector, s_rules[j]);
+		rules.add(name, evttypes, syscalls, tags, compiler.compile());
+
+		// One ruleset per rule, to see the result of each one
+		rules.enable(name, true, j);
+	}
+}
+
+std::vector<std::string> replay(bool share, const std::string& capture)
+{
+	sinsp inspector;
+	sinsp_evttype_filter rules;
+	rules.set_share_subexpressions(share);
+	add_rules(inspector, rules);
+
+	std::vector<std::string> res;
+	inspector.open(capture);
+
+	sinsp_evt* evt;
+	int32_t rc;
+	while((rc = inspector.next(&evt)) != SCAP_EOF)
+	{
+		EXPECT_EQ(SCAP_SUCCESS, rc);
+
+		std::string line;
+		for(uint32_t j = 0; j < N_RULES; j++)
+		{
+			line += rules.run(evt, j) ? '1' : '0';
+		}
+		res.push_back(line);
+	}
+
+	inspector.close();
+	return res;
+}
+
+class filter_cse_test : public capture_test
+{
+protected:
+	void SetUp() override
+	{
+		scap_workload::generate(scap_workload::WEB_SERVER, m_capture, 5000);
+	}
+};
+}
+
+TEST_F(filter_cse_test, shared_nodes)
+{
+	sinsp inspector;
+	sinsp_evttype_filter rules;
+	add_rules(inspector, rules);
+
+	const sinsp_filter_cse& cse = rules.get_cse();
+	// The accept and read macros and their leaves (evt.dir=< being the
+	// same one), the list, proc.name=nginx and fd.name. The negated list is
+	// the list, and evt.latency isn't shared.
+	EXPECT_EQ(8u, cse.get_n_nodes());
+	EXPECT_EQ(13u, cse.get_n_deduplicated());
+	EXPECT_EQ(cse.get_n_checks(), cse.get_n_nodes() + cse.get_n_deduplicated() + 1);
+
+	sinsp_evttype_filter unshared;
+	unshared.set_share_subexpressions(false);
+	add_rules(inspector, unshared);
+	EXPECT_EQ(0u, unshared.get_cse().get_n_nodes());
+}
+
+TEST_F(filter_cse_test, same_results)
+{
+	std::vector<std::string> shared = replay(true, m_capture);
+	std::vector<std::string> unshared = replay(false, m_capture);
+
+	ASSERT_EQ(unshared.size(), shared.size());
+	uint32_t nmatches = 0;
+	for(uint32_t j = 0; j < shared.size(); j++)
+	{
+		ASSERT_EQ(unshared[j], shared[j]) << "event " << j;
+		nmatches += std::count(shared[j].begin(), shared[j].end(), '1');
+	}
+	EXPECT_LT(0u, nmatches);
+}
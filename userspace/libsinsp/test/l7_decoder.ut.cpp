@@ -0,0 +1,363 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest.h>
+#include "sinsp.h"
+#include "l7_decoder.h"
+#include "capture_test.h"
+
+namespace
+{
+typedef scap_workload_writer w;
+
+const uint32_t CLIENT_IP = 0x0a000005;	// 10.0.0.5
+const uint32_t SERVER_IP = 0x0a000001;	// 10.0.0.1
+const uint64_t TS = 1600000000000000000ULL;
+const uint64_t MS = 1000000ULL;
+
+void write_connect(w& writer, uint64_t ts, int64_t tid, int64_t fd, uint32_t type, uint16_t sport, uint16_t dport)
+{
+	writer.write_event(ts, tid, PPME_SOCKET_SOCKET_E, 0, {w::u32(PPM_AF_INET), w::u32(type), w::u32(0)});
+	writer.write_event(ts + 1, tid, PPME_SOCKET_SOCKET_X, 0, {w::i64(fd)});
+	writer.write_event(ts + 2, tid, PPME_SOCKET_CONNECT_E, 0, {w::i64(fd)});
+	writer.write_event(ts + 3, tid, PPME_SOCKET_CONNECT_X, 0, {w::i64(0), w::tuple4(CLIENT_IP, sport, SERVER_IP, dport)});
+}
+
+//
+// size is what the syscall returned, data what made it into the capture
+//
+void write_rw(w& writer, uint64_t ts, int64_t tid, int64_t fd, bool read, const std::string& data, int64_t size = -1)
+{
+	if(size < 0)
+	{
+		size = data.size();
+	}
+
+	ppm_event_type etype = read ? PPME_SYSCALL_READ_E : PPME_SYSCALL_WRITE_E;
+	writer.write_event(ts, tid, etype, 0, {w::i64(fd), w::u32(size)});
+	writer.write_event(ts + 1, tid, (ppm_event_type)(etype + 1), 0, {w::i64(size), w::buf(data)});
+}
+
+std::string mysql_packet(uint8_t seq, const std::string& payload)
+{
+	std::string res;
+	res.push_back(payload.size() & 0xff);
+	res.push_back((payload.size() >> 8) & 0xff);
+	res.push_back((payload.size() >> 16) & 0xff);
+	res.push_back(seq);
+	return res + payload;
+}
+
+std::string dns_message(uint16_t id, uint16_t flags)
+{
+	const uint8_t question[] = {7, 'e', 'x', 'a', 'm', 'p', 'l', 'e', 3, 'c', 'o', 'm', 0, 0, 28, 0, 1};
+	uint8_t hdr[] = {(uint8_t)(id >> 8), (uint8_t)id, (uint8_t)(flags >> 8), (uint8_t)flags, 0, 1, 0, 0, 0, 0, 0, 0};
+	std::string res((const char*)hdr, sizeof(hdr));
+	res.append((const char*)question, sizeof(question));
+	return res;
+}
+
+std::vector<sinsp_l7_record> replay(const std::string& capture, bool single_connection = false)
+{
+	std::vector<sinsp_l7_record> records;
+	sinsp inspector;
+	sinsp_decoder_l7* l7 = (sinsp_decoder_l7*)inspector.require_protodecoder("l7");
+	l7->set_record_callback([&](const sinsp_l7_record& rec, sinsp_evt* evt)
+	{
+		EXPECT_EQ(rec.m_tid, evt->get_tid());
+		records.push_back(rec);
+	});
+
+	inspector.open(capture);
+
+	sinsp_evt* evt;
+	int32_t res;
+	while((res = inspector.next(&evt)) != SCAP_EOF)
+	{
+		EXPECT_EQ(SCAP_SUCCESS, res);
+	}
+
+	if(single_connection)
+	{
+		EXPECT_EQ(records.size(), l7->get_n_records());
+		EXPECT_EQ(0u, l7->get_n_dropped_requests());
+		EXPECT_EQ(1u, l7->get_n_connections());
+	}
+
+	inspector.close();
+	return records;
+}
+
+class l7_decoder_test : public capture_test
+{
+};
+}
+
+TEST_F(l7_decoder_test, http)
+{
+	{
+		w writer(m_capture, 1);
+		int64_t client = 100;
+		int64_t server = 200;
+
+		std::string req = "GET /index.html HTTP/1.1\r\nHost: example.com\r\nUser-Agent: curl/7.68.0\r\nAccept: */*\r\n\r\n";
+		std::string resp = "HTTP/1.1 200 OK\r\nServer: nginx\r\nContent-Length: 4096\r\nContent-Type: text/html\r\n\r\n";
+
+		write_execve(writer, TS, client, "/usr/bin/curl");
+		write_execve(writer, TS + 2, server, "/usr/sbin/nginx");
+		write_connect(writer, TS + 10, client, 3, 1, 40000, 80);
+		writer.write_event(TS + 14, server, PPME_SOCKET_ACCEPT4_5_E, 0, {w::i32(0)});
+		writer.write_event(TS + 15, server, PPME_SOCKET_ACCEPT4_5_X, 0,
+			{w::i64(7), w::tuple4(CLIENT_IP, 40001, SERVER_IP, 8080), w::u8(0), w::u32(0), w::u32(511)});
+
+		//
+		// The client side, with the request and the response cut by the
+		// snaplen. In between, the server fails a POST.
+		//
+		write_rw(writer, TS + 20, client, 3, false, req.substr(0, 80), req.size());
+		write_rw(writer, TS + 100, server, 7, true, "POST /api/v1/items HTTP/1.1\r\nContent-Length: 2\r\n\r\n{}");
+		write_rw(writer, TS + 100 + 2 * MS, server, 7, false, "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\n\r\n");
+		write_rw(writer, TS + 20 + 5 * MS, client, 3, true, resp.substr(0, 80), resp.size() + 4096);
+		// The rest of the body is not a response
+		write_rw(writer, TS + 30 + 5 * MS, client, 3, true, "HTTP/1.1 is the best", 4096);
+	}
+
+	std::vector<sinsp_l7_record> records = replay(m_capture);
+	ASSERT_EQ(2u, records.size());
+
+	// Sorted by response time
+	const sinsp_l7_record& srv = records[0];
+	EXPECT_EQ(sinsp_l7_record::L7_HTTP, srv.m_protocol);
+	EXPECT_TRUE(srv.m_is_server);
+	EXPECT_TRUE(srv.m_error);
+	EXPECT_EQ(200, srv.m_tid);
+	EXPECT_EQ(7, srv.m_fd);
+	EXPECT_EQ(503u, srv.m_status);
+	EXPECT_STREQ("POST", srv.m_method);
+	EXPECT_EQ(2 * MS, srv.m_latency_ns);
+
+	const sinsp_l7_record& cli = records[1];
+	EXPECT_EQ(sinsp_l7_record::L7_HTTP, cli.m_protocol);
+	EXPECT_FALSE(cli.m_is_server);
+	EXPECT_FALSE(cli.m_error);
+	EXPECT_EQ(100, cli.m_tid);
+	EXPECT_EQ(3, cli.m_fd);
+	EXPECT_EQ(200u, cli.m_status);
+	EXPECT_STREQ("GET", cli.m_method);
+	EXPECT_EQ(TS + 21, cli.m_req_ts);
+	EXPECT_EQ(5 * MS, cli.m_latency_ns);
+	EXPECT_EQ(std::string("GET /index.html HTTP/1.1\r\nHost: example.com\r\nUser-Agent: curl/7.68.0\r\nAccept: */*\r\n\r\n").size(), cli.m_req_len);
+}
+
+TEST_F(l7_decoder_test, redis_pipelined)
+{
+	{
+		w writer(m_capture, 1);
+		int64_t tid = 100;
+
+		write_execve(writer, TS, tid, "/usr/bin/redis-cli");
+		write_connect(writer, TS + 10, tid, 3, 1, 40000, 6379);
+		write_rw(writer, TS + 1 * MS, tid, 3, false, "*3\r\n$3\r\nset\r\n$3\r\nfoo\r\n$3\r\nbar\r\n");
+		write_rw(writer, TS + 2 * MS, tid, 3, false, "*2\r\n$5\r\nHSCAN\r\n$3\r\nfoo\r\n");
+		write_rw(writer, TS + 4 * MS, tid, 3, true, "+OK\r\n");
+		write_rw(writer, TS + 7 * MS, tid, 3, true, "-WRONGTYPE Operation against a key holding the wrong kind of value\r\n");
+	}
+
+	std::vector<sinsp_l7_record> records = replay(m_capture, true);
+	ASSERT_EQ(2u, records.size());
+
+	EXPECT_EQ(sinsp_l7_record::L7_REDIS, records[0].m_protocol);
+	EXPECT_STREQ("SET", records[0].m_method);
+	EXPECT_FALSE(records[0].m_error);
+	EXPECT_EQ(3 * MS, records[0].m_latency_ns);
+
+	EXPECT_STREQ("HSCAN", records[1].m_method);
+	EXPECT_TRUE(records[1].m_error);
+	EXPECT_EQ(5 * MS, records[1].m_latency_ns);
+}
+
+TEST_F(l7_decoder_test, mysql)
+{
+	{
+		w writer(m_capture, 1);
+		int64_t tid = 100;
+
+		write_execve(writer, TS, tid, "/usr/bin/mysql");
+		write_connect(writer, TS + 10, tid, 3, 1, 40000, 3306);
+
+		// Handshake and login are not requests
+		write_rw(writer, TS + 20, tid, 3, true, mysql_packet(0, std::string("\x0a" "8.0.21\0", 8)));
+		write_rw(writer, TS + 30, tid, 3, false, mysql_packet(1, std::string("\x0d\xa2\x00\x00", 4)));
+		write_rw(writer, TS + 40, tid, 3, true, mysql_packet(2, std::string("\x00\x00\x00\x02\x00", 5)));
+
+		write_rw(writer, TS + 1 * MS, tid, 3, false, mysql_packet(0, "\x03SELECT * FROM missing"));
+		write_rw(writer, TS + 3 * MS, tid, 3, true,
+			mysql_packet(1, std::string("\xff\x7a\x04", 3) + "#42S02Table 'db.missing' doesn't exist"));
+	}
+
+	std::vector<sinsp_l7_record> records = replay(m_capture, true);
+	ASSERT_EQ(1u, records.size());
+
+	EXPECT_EQ(sinsp_l7_record::L7_MYSQL, records[0].m_protocol);
+	EXPECT_STREQ("QUERY", records[0].m_method);
+	EXPECT_TRUE(records[0].m_error);
+	EXPECT_EQ(1146u, records[0].m_status);
+	EXPECT_EQ(2 * MS, records[0].m_latency_ns);
+}
+
+TEST_F(l7_decoder_test, dns_by_id)
+{
+	{
+		w writer(m_capture, 1);
+		int64_t tid = 100;
+		w::param tuple = w::tuple4(CLIENT_IP, 40000, SERVER_IP, 53);
+		std::string q1 = dns_message(0x1111, 0x0100);
+		std::string q2 = dns_message(0x2222, 0x0100);
+		std::string r2 = dns_message(0x2222, 0x8183);
+		std::string r1 = dns_message(0x1111, 0x8180);
+
+		write_execve(writer, TS, tid, "/usr/bin/dig");
+		write_connect(writer, TS + 10, tid, 3, 2, 40000, 53);
+		writer.write_event(TS + 1 * MS, tid, PPME_SOCKET_SENDTO_E, 0, {w::i64(3), w::u32(q1.size()), tuple});
+		writer.write_event(TS + 1 * MS, tid, PPME_SOCKET_SENDTO_X, 0, {w::i64(q1.size()), w::buf(q1)});
+		writer.write_event(TS + 2 * MS, tid, PPME_SOCKET_SENDTO_E, 0, {w::i64(3), w::u32(q2.size()), tuple});
+		writer.write_event(TS + 2 * MS, tid, PPME_SOCKET_SENDTO_X, 0, {w::i64(q2.size()), w::buf(q2)});
+
+		// Answered out of order
+		writer.write_event(TS + 3 * MS, tid, PPME_SOCKET_RECVFROM_E, 0, {w::i64(3), w::u32(512)});
+		writer.write_event(TS + 3 * MS, tid, PPME_SOCKET_RECVFROM_X, 0, {w::i64(r2.size()), w::buf(r2), tuple});
+		writer.write_event(TS + 5 * MS, tid, PPME_SOCKET_RECVFROM_E, 0, {w::i64(3), w::u32(512)});
+		writer.write_event(TS + 5 * MS, tid, PPME_SOCKET_RECVFROM_X, 0, {w::i64(r1.size()), w::buf(r1), tuple});
+	}
+
+	std::vector<sinsp_l7_record> records = replay(m_capture);
+	ASSERT_EQ(2u, records.size());
+
+	EXPECT_EQ(sinsp_l7_record::L7_DNS, records[0].m_protocol);
+	EXPECT_STREQ("AAAA", records[0].m_method);
+	EXPECT_TRUE(records[0].m_error);
+	EXPECT_EQ(3u, records[0].m_status);
+	EXPECT_EQ(1 * MS, records[0].m_latency_ns);
+
+	EXPECT_FALSE(records[1].m_error);
+	EXPECT_EQ(4 * MS, records[1].m_latency_ns);
+}
+
+TEST_F(l7_decoder_test, unknown_protocol)
+{
+	sinsp inspector;
+	sinsp_decoder_l7* l7 = (sinsp_decoder_l7*)inspector.require_protodecoder("l7");
+
+	{
+		w writer(m_capture, 1);
+		int64_t tid = 100;
+
+		write_execve(writer, TS, tid, "/usr/bin/openssl");
+		write_connect(writer, TS + 10, tid, 3, 1, 40000, 443);
+		for(uint32_t j = 0; j < 20; j++)
+		{
+			write_rw(writer, TS + 100 + j * 10, tid, 3, j % 2, std::string("\x17\x03\x03\x00\x20 encrypted", 15));
+		}
+	}
+
+	inspector.open(m_capture);
+
+	sinsp_evt* evt;
+	uint32_t n_watched = 0;
+	while(inspector.next(&evt) != SCAP_EOF)
+	{
+		uint16_t etype = evt->get_type();
+		sinsp_fdinfo_t* fdinfo = evt->get_fd_info();
+		if((etype == PPME_SYSCALL_READ_X || etype == PPME_SYSCALL_WRITE_X) &&
+			fdinfo != NULL && fdinfo->has_event_callback(CT_READ, l7))
+		{
+			n_watched++;
+		}
+	}
+
+	inspector.close();
+
+	// Given up after a few messages, the fd is released after the last one
+	EXPECT_EQ(0u, l7->get_n_connections());
+	EXPECT_EQ(8u, n_watched);
+}
+
+TEST_F(l7_decoder_test, close_and_max_connections)
+{
+	sinsp inspector;
+	sinsp_decoder_l7* l7 = (sinsp_decoder_l7*)inspector.require_protodecoder("l7");
+	l7->set_max_connections(2);
+
+	std::string req("GET / HTTP/1.1\r\nHost: example.com\r\n\r\n");
+	std::string resp("HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n");
+
+	{
+		w writer(m_capture, 1);
+		int64_t tid = 100;
+
+		write_execve(writer, TS, tid, "curl");
+		write_connect(writer, TS + 10, tid, 3, 1, 40000, 80);
+		write_connect(writer, TS + 20, tid, 4, 1, 40001, 80);
+		write_connect(writer, TS + 30, tid, 5, 1, 40002, 80);
+		write_connect(writer, TS + 40, tid, 6, 1, 40003, 80);
+
+		// The third one doesn't fit, and is counted once
+		write_rw(writer, TS + 1 * MS, tid, 3, false, req);
+		write_rw(writer, TS + 2 * MS, tid, 4, false, req);
+		write_rw(writer, TS + 3 * MS, tid, 5, false, req);
+		write_rw(writer, TS + 4 * MS, tid, 5, false, req);
+
+		// Closed with a request in flight
+		writer.write_event(TS + 5 * MS, tid, PPME_SYSCALL_CLOSE_E, 0, {w::i64(3)});
+		writer.write_event(TS + 5 * MS + 1, tid, PPME_SYSCALL_CLOSE_X, 0, {w::i64(0)});
+
+		// Shut down once the response is in
+		write_rw(writer, TS + 6 * MS, tid, 4, true, resp);
+		writer.write_event(TS + 7 * MS, tid, PPME_SOCKET_SHUTDOWN_E, 0, {w::i64(4), w::u8(2)});
+		writer.write_event(TS + 7 * MS + 1, tid, PPME_SOCKET_SHUTDOWN_X, 0, {w::i64(0)});
+
+		// There's room again, and the response can still come after a
+		// shutdown
+		write_rw(writer, TS + 8 * MS, tid, 6, false, req);
+		writer.write_event(TS + 9 * MS, tid, PPME_SOCKET_SHUTDOWN_E, 0, {w::i64(6), w::u8(1)});
+		writer.write_event(TS + 9 * MS + 1, tid, PPME_SOCKET_SHUTDOWN_X, 0, {w::i64(0)});
+		write_rw(writer, TS + 10 * MS, tid, 6, true, resp);
+	}
+
+	inspector.open(m_capture);
+
+	sinsp_evt* evt;
+	std::vector<size_t> n_connections;
+	while(inspector.next(&evt) != SCAP_EOF)
+	{
+		uint16_t etype = evt->get_type();
+		if(etype == PPME_SYSCALL_CLOSE_X || etype == PPME_SOCKET_SHUTDOWN_X)
+		{
+			n_connections.push_back(l7->get_n_connections());
+		}
+	}
+
+	inspector.close();
+
+	ASSERT_EQ(3u, n_connections.size());
+	EXPECT_EQ(1u, n_connections[0]);
+	EXPECT_EQ(0u, n_connections[1]);
+	EXPECT_EQ(1u, n_connections[2]);
+	EXPECT_EQ(1u, l7->get_n_skipped_connections());
+	EXPECT_EQ(1u, l7->get_n_dropped_requests());
+	EXPECT_EQ(2u, l7->get_n_records());
+}
@@ -0,0 +1,211 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest.h>
+#include "sinsp.h"
+
+namespace
+{
+const uint64_t TICK_NS = 100000000;
+
+//
+// A driver writing open() and read() events, half and half, in a 1MB ring
+// emptied by a consumer that reads a fixed number of bytes per tick
+//
+class simulated_producer : public sinsp_load_shedder::actuator
+{
+public:
+	simulated_producer():
+		m_snaplen(DEFAULT_SNAPLEN),
+		m_read_enabled(true),
+		m_ratio(1),
+		m_used(0),
+		m_drops(0),
+		m_ts(0)
+	{
+	}
+
+	void set_snaplen(uint32_t snaplen) override
+	{
+		m_snaplen = snaplen;
+		m_actions.push_back("snaplen " + std::to_string(snaplen));
+	}
+
+	void set_eventmask(uint32_t evttype, bool enabled) override
+	{
+		if(evttype == PPME_SYSCALL_READ_E || evttype == PPME_SYSCALL_READ_X)
+		{
+			m_read_enabled = enabled;
+			m_actions.push_back(enabled ? "read on" : "read off");
+		}
+	}
+
+	void set_sampling_ratio(uint32_t ratio) override
+	{
+		m_ratio = ratio;
+		m_actions.push_back("sampling " + std::to_string(ratio));
+	}
+
+	void tick(sinsp_load_shedder& shedder, uint64_t n_evts, uint64_t read_bytes)
+	{
+		uint64_t n = n_evts / m_ratio / 2;
+		m_used += n * 64;
+		if(m_read_enabled)
+		{
+			m_used += n * (32 + m_snaplen);
+		}
+
+		// Read while written
+		m_used -= std::min(m_used, read_bytes);
+		if(m_used > RING_SIZE)
+		{
+			m_drops += (m_used - RING_SIZE) / 64;
+			m_used = RING_SIZE;
+		}
+		m_ts += TICK_NS;
+
+		sinsp_load_shedder::sample s = {m_ts, m_used, m_drops, 0};
+		ASSERT_TRUE(shedder.is_due(m_ts));
+		shedder.update(s);
+	}
+
+	static const uint64_t RING_SIZE = 1024 * 1024;
+
+	uint32_t m_snaplen;
+	bool m_read_enabled;
+	uint32_t m_ratio;
+	uint64_t m_used;
+	uint64_t m_drops;
+	uint64_t m_ts;
+	std::vector<std::string> m_actions;
+};
+}
+
+TEST(load_shedder, ladder)
+{
+	simulated_producer producer;
+	sinsp_load_shedder shedder(&producer);
+	shedder.set_buffer_size(simulated_producer::RING_SIZE);
+	shedder.set_priority(PPME_SYSCALL_READ_X, sinsp_load_shedder::PRIORITY_LOW);
+	EXPECT_EQ(sinsp_load_shedder::PRIORITY_LOW, shedder.get_priority(PPME_SYSCALL_READ_E));
+
+	// Keeping up
+	for(uint32_t j = 0; j < 50; j++)
+	{
+		producer.tick(shedder, 1000, 300000);
+	}
+	EXPECT_EQ(sinsp_load_shedder::LEVEL_NONE, shedder.get_level());
+	EXPECT_TRUE(producer.m_actions.empty());
+
+	// 880KB per tick for a consumer reading 300KB: only sampling helps,
+	// after everything else was tried
+	for(uint32_t j = 0; j < 20; j++)
+	{
+		producer.tick(shedder, 10000, 300000);
+	}
+	ASSERT_LE(5u, producer.m_actions.size());
+	EXPECT_EQ("snaplen 20", producer.m_actions[0]);
+	EXPECT_EQ("snaplen 16", producer.m_actions[1]);
+	EXPECT_EQ("read off", producer.m_actions[2]);
+	EXPECT_EQ("read off", producer.m_actions[3]);
+	EXPECT_EQ("sampling 2", producer.m_actions[4]);
+
+	// Once there, no more drops
+	uint64_t drops = producer.m_drops;
+	for(uint32_t j = 0; j < 500; j++)
+	{
+		producer.tick(shedder, 10000, 300000);
+	}
+	EXPECT_EQ(drops, producer.m_drops);
+
+	// The load goes away, everything is restored
+	for(uint32_t j = 0; j < 200; j++)
+	{
+		producer.tick(shedder, 1000, 300000);
+	}
+	EXPECT_EQ(sinsp_load_shedder::LEVEL_NONE, shedder.get_level());
+	EXPECT_EQ((uint32_t)DEFAULT_SNAPLEN, producer.m_snaplen);
+	EXPECT_TRUE(producer.m_read_enabled);
+	EXPECT_EQ(1u, producer.m_ratio);
+}
+
+TEST(load_shedder, cpu)
+{
+	simulated_producer producer;
+	sinsp_load_shedder shedder(&producer);
+	shedder.set_thresholds(0.25, 0.75, 0.9, 3);
+
+	// The ring is empty, but the event loop is busy all the time
+	uint64_t ts = 0;
+	uint64_t cpu = 0;
+	for(uint32_t j = 0; j < 4; j++)
+	{
+		ts += TICK_NS;
+		cpu += TICK_NS;
+		sinsp_load_shedder::sample s = {ts, 0, 0, cpu};
+		shedder.update(s);
+	}
+	EXPECT_EQ(sinsp_load_shedder::LEVEL_MASK_LOW, shedder.get_level());
+	EXPECT_EQ(3u, shedder.get_n_escalations());
+
+	// Nothing low priority, nothing masked
+	EXPECT_EQ(2u, producer.m_actions.size());
+
+	// Half busy isn't calm enough to go back
+	for(uint32_t j = 0; j < 10; j++)
+	{
+		ts += TICK_NS;
+		cpu += TICK_NS / 2;
+		sinsp_load_shedder::sample s = {ts, 0, 0, cpu};
+		shedder.update(s);
+	}
+	EXPECT_EQ(sinsp_load_shedder::LEVEL_MASK_LOW, shedder.get_level());
+
+	EXPECT_THROW(shedder.set_thresholds(0.8, 0.75, 0.9, 3), sinsp_exception);
+}
+
+//
+// The snaplen set while shedding is the one restored
+//
+TEST(load_shedder, snaplen)
+{
+	sinsp inspector;
+	sinsp_load_shedder& shedder = inspector.enable_load_shedding();
+	EXPECT_EQ((uint32_t)DEFAULT_SNAPLEN, shedder.get_snaplen());
+	inspector.set_snaplen(400);
+	EXPECT_EQ(400u, shedder.get_snaplen());
+
+	simulated_producer producer;
+	sinsp_load_shedder standalone(&producer);
+	standalone.set_buffer_size(simulated_producer::RING_SIZE);
+	for(uint32_t j = 0; j < 3; j++)
+	{
+		producer.tick(standalone, 10000, 300000);
+	}
+	ASSERT_LE(sinsp_load_shedder::LEVEL_SNAPLEN, standalone.get_level());
+
+	// Still reduced
+	standalone.set_snaplen(400);
+	EXPECT_GT(400u, standalone.get_snaplen());
+
+	for(uint32_t j = 0; j < 200; j++)
+	{
+		producer.tick(standalone, 1000, 300000);
+	}
+	EXPECT_EQ(sinsp_load_shedder::LEVEL_NONE, standalone.get_level());
+	EXPECT_EQ(400u, producer.m_snaplen);
+}
@@ -0,0 +1,182 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest.h>
+#include "sinsp.h"
+#include "capture_test.h"
+
+namespace
+{
+typedef scap_workload_writer w;
+typedef sinsp_memory_budget mb;
+
+const uint64_t MS = 1000000;
+
+//
+// 100 processes opening 100 files each, one every millisecond, then the
+// first one opening some more
+//
+class memory_budget_test : public capture_test
+{
+protected:
+	void SetUp() override
+	{
+		w writer(m_capture, 1);
+		uint64_t ts = MS;
+
+		for(int64_t pid = 100; pid < 200; pid++)
+		{
+			for(int64_t fd = 3; fd < 103; fd++)
+			{
+				open(writer, ts, pid, fd);
+				ts += MS;
+			}
+		}
+
+		for(int64_t fd = 103; fd < 203; fd++)
+		{
+			open(writer, ts, 100, fd);
+			ts += MS;
+		}
+	}
+
+	static void open(w& writer, uint64_t ts, int64_t pid, int64_t fd)
+	{
+		std::string name = "/var/data/" + std::to_string(pid) + "/" + std::to_string(fd);
+		writer.write_event(ts, pid, PPME_SYSCALL_OPENAT_E, 0,
+			{w::i64(-100), w::str(name), w::u32(1), w::u32(0)});
+		writer.write_event(ts + 1000, pid, PPME_SYSCALL_OPENAT_X, 0,
+			{w::i64(fd), w::i64(-100), w::str(name), w::u32(1), w::u32(0), w::u32(0)});
+	}
+
+	//
+	// Replays the capture, returns the most bytes seen for comp
+	//
+	uint64_t replay(sinsp& inspector, mb::component comp)
+	{
+		inspector.open(m_capture);
+
+		uint64_t max_bytes = 0;
+		sinsp_evt* evt;
+		int32_t res;
+		while((res = inspector.next(&evt)) != SCAP_EOF)
+		{
+			EXPECT_EQ(SCAP_SUCCESS, res);
+			if(evt->get_num() % 1000 == 0)
+			{
+				max_bytes = std::max(max_bytes, inspector.get_memory_usage().m_bytes[comp]);
+			}
+		}
+
+		return max_bytes;
+	}
+
+};
+}
+
+TEST_F(memory_budget_test, usage)
+{
+	sinsp inspector;
+	replay(inspector, mb::COMP_FDS);
+
+	mb::usage usage = inspector.get_memory_usage();
+	EXPECT_EQ(100u, inspector.m_thread_manager->get_thread_count());
+	EXPECT_EQ(10100u, inspector.get_memory_budget().get_n_fds());
+
+	// At least the objects and the names
+	EXPECT_LT(10100 * (sizeof(sinsp_fdinfo_t) + 16), usage.m_bytes[mb::COMP_FDS]);
+	EXPECT_LT(100 * sizeof(sinsp_threadinfo), usage.m_bytes[mb::COMP_THREADS]);
+	EXPECT_EQ(inspector.get_enter_event_store().get_memory_usage(), usage.m_bytes[mb::COMP_ENTER_EVENTS]);
+	EXPECT_EQ(0u, usage.m_budget[mb::COMP_FDS]);
+	EXPECT_EQ(0u, usage.m_n_evicted[mb::COMP_FDS]);
+}
+
+TEST_F(memory_budget_test, fds)
+{
+	uint64_t unlimited;
+	{
+		sinsp inspector;
+		unlimited = replay(inspector, mb::COMP_FDS);
+	}
+
+	sinsp inspector;
+	uint64_t budget = unlimited / 4;
+	inspector.set_memory_budget(mb::COMP_FDS, budget);
+	uint64_t max_bytes = replay(inspector, mb::COMP_FDS);
+
+	mb::usage usage = inspector.get_memory_usage();
+	EXPECT_LE(max_bytes, budget);
+	EXPECT_LE(usage.m_bytes[mb::COMP_FDS], budget);
+	EXPECT_LT(0u, usage.m_n_evicted[mb::COMP_FDS]);
+
+	// The processes seen the longest time ago lost their fds, the most
+	// recent one kept them
+	sinsp_threadinfo* oldest = inspector.get_thread_ref(101, false, true).get();
+	ASSERT_NE(nullptr, oldest);
+	EXPECT_EQ(nullptr, oldest->get_fd(3));
+	sinsp_threadinfo* newest = inspector.get_thread_ref(100, false, true).get();
+	ASSERT_NE(nullptr, newest);
+	EXPECT_NE(nullptr, newest->get_fd(202));
+	EXPECT_EQ(100u, inspector.m_thread_manager->get_thread_count());
+}
+
+TEST_F(memory_budget_test, threads)
+{
+	sinsp inspector;
+	replay(inspector, mb::COMP_THREADS);
+	uint64_t bytes = inspector.get_memory_usage().m_bytes[mb::COMP_THREADS];
+
+	inspector.close();
+	inspector.set_memory_budget(mb::COMP_THREADS, bytes / 2);
+	replay(inspector, mb::COMP_THREADS);
+
+	mb::usage usage = inspector.get_memory_usage();
+	EXPECT_LE(usage.m_bytes[mb::COMP_THREADS], bytes / 2);
+	EXPECT_LT(0u, usage.m_n_evicted[mb::COMP_THREADS] + usage.m_n_refused[mb::COMP_THREADS]);
+	EXPECT_GE(55u, inspector.m_thread_manager->get_thread_count());
+
+	// The most recent one is still there
+	EXPECT_NE(nullptr, inspector.get_thread_ref(100, false, true).get());
+}
+
+TEST(memory_budget, enter_events)
+{
+	sinsp_enter_event_store store;
+	store.set_max_memory(sinsp_enter_event_store::SLOTS_PER_SLAB * sinsp_enter_event_store::SLOT_SIZE);
+
+	std::vector<uint8_t> evt(sizeof(struct ppm_evt_hdr));
+	scap_evt* hdr = (scap_evt*)&evt[0];
+	hdr->len = evt.size();
+	hdr->type = PPME_SYSCALL_READ_E;
+	hdr->nparams = 0;
+
+	std::vector<uint8_t*> stored;
+	for(uint32_t j = 0; j < sinsp_enter_event_store::SLOTS_PER_SLAB; j++)
+	{
+		stored.push_back(store.store(hdr, NULL));
+		ASSERT_NE(nullptr, stored.back());
+	}
+
+	// No room for a second slab
+	EXPECT_EQ(nullptr, store.store(hdr, NULL));
+	EXPECT_EQ(1u, store.get_n_refused());
+
+	// A slot given back is reused
+	store.release(stored.back());
+	EXPECT_NE(nullptr, store.store(hdr, NULL));
+	EXPECT_EQ(1u, store.get_n_refused());
+}
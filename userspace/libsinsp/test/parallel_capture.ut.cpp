@@ -0,0 +1,179 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <unistd.h>
+#include <gtest.h>
+#include "sinsp.h"
+#include "parallel_capture.h"
+#include "capture_test.h"
+
+namespace
+{
+const char* s_format = "%evt.type %evt.dir %thread.tid %proc.name %proc.pid %fd.num %fd.name";
+
+//
+// The formatted events, up to the end of the capture or of the segment
+//
+std::vector<std::string> read_all(sinsp& inspector)
+{
+	sinsp_evt_formatter formatter(&inspector, s_format);
+	std::vector<std::string> res;
+
+	sinsp_evt* evt;
+	int32_t rc;
+	while((rc = inspector.next(&evt)) != SCAP_EOF)
+	{
+		if(rc == SCAP_TIMEOUT)
+		{
+			continue;
+		}
+		EXPECT_EQ(SCAP_SUCCESS, rc);
+
+		std::string out;
+		formatter.tostring(evt, &out);
+		res.push_back(out);
+	}
+
+	return res;
+}
+
+class parallel_capture_test : public capture_test
+{
+protected:
+	void SetUp() override
+	{
+		m_checkpointed = m_capture + ".ckp";
+
+		scap_workload::generate(scap_workload::WEB_SERVER, m_capture, 20000);
+
+		//
+		// The same events, with the tables of the inspector saved every 64KB
+		//
+		sinsp inspector;
+		inspector.open(m_capture);
+		sinsp_dumper dumper(&inspector);
+		dumper.open(m_checkpointed, false, true);
+		dumper.enable_checkpoints(64 * 1024);
+
+		sinsp_evt* evt;
+		int32_t rc;
+		while((rc = inspector.next(&evt)) != SCAP_EOF)
+		{
+			ASSERT_EQ(SCAP_SUCCESS, rc);
+			dumper.dump(evt);
+		}
+		dumper.close();
+		inspector.close();
+	}
+
+	void TearDown() override
+	{
+		unlink(m_checkpointed.c_str());
+	}
+
+	std::string m_checkpointed;
+};
+}
+
+TEST_F(parallel_capture_test, sequential)
+{
+	sinsp inspector;
+	inspector.open(m_capture);
+	std::vector<std::string> expected = read_all(inspector);
+	inspector.close();
+
+	// Checkpoints are invisible to sequential readers
+	inspector.open(m_checkpointed);
+	EXPECT_EQ(expected, read_all(inspector));
+	inspector.close();
+}
+
+TEST_F(parallel_capture_test, segments)
+{
+	sinsp inspector;
+	inspector.open(m_capture);
+	std::vector<std::string> expected = read_all(inspector);
+	inspector.close();
+
+	sinsp_parallel_capture capture(m_checkpointed);
+	const std::vector<sinsp_parallel_capture::segment>& segments = capture.get_segments();
+	ASSERT_LT(4u, segments.size());
+	EXPECT_EQ(0u, segments[0].m_offset);
+
+	// A segment ends at the next checkpoint
+	capture.open(inspector, segments[1]);
+	std::vector<std::string> first = read_all(inspector);
+	inspector.close();
+	EXPECT_LT(0u, first.size());
+	EXPECT_GT(expected.size(), first.size());
+
+	std::vector<std::string> res;
+	uint32_t next_index = 0;
+	capture.run<std::vector<std::string>>(4,
+		[](sinsp& inspector, const sinsp_parallel_capture::segment& seg)
+		{
+			return read_all(inspector);
+		},
+		[&](std::vector<std::string>& lines)
+		{
+			next_index++;
+			res.insert(res.end(), lines.begin(), lines.end());
+		});
+
+	EXPECT_EQ(segments.size(), next_index);
+	EXPECT_EQ(expected, res);
+
+	// The failures of the workers end up here
+	EXPECT_THROW(capture.run<int>(4,
+		[](sinsp& inspector, const sinsp_parallel_capture::segment& seg)
+		{
+			if(seg.m_index == 2)
+			{
+				throw sinsp_exception("segment 2");
+			}
+			return 0;
+		},
+		[](int& n)
+		{
+		}), sinsp_exception);
+}
+
+#ifndef MINIMAL_BUILD
+// Only the full build writes compressed captures
+TEST_F(parallel_capture_test, compressed)
+{
+	std::string compressed = m_capture + ".gz";
+	{
+		sinsp inspector;
+		inspector.open(m_capture);
+		sinsp_dumper dumper(&inspector);
+		dumper.open(compressed, true, true);
+		dumper.enable_checkpoints(64 * 1024);
+
+		sinsp_evt* evt;
+		while(inspector.next(&evt) != SCAP_EOF)
+		{
+			dumper.dump(evt);
+		}
+		dumper.close();
+		inspector.close();
+	}
+
+	EXPECT_THROW(sinsp_parallel_capture capture(compressed), sinsp_exception);
+	unlink(compressed.c_str());
+}
+#endif // MINIMAL_BUILD
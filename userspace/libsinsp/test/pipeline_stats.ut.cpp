@@ -0,0 +1,139 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <thread>
+#include <gtest.h>
+#include "sinsp.h"
+
+namespace
+{
+void push_event(sinsp_pipeline_stats& stats, uint16_t evttype, uint16_t cpuid, uint64_t parse_ns)
+{
+	sinsp_pipeline_stats::sample s;
+	stats.begin_event(s);
+	if(s.m_timed)
+	{
+		s.m_stage_ns[sinsp_pipeline_stats::STAGE_SCAP_NEXT] = 10;
+		s.m_stage_ns[sinsp_pipeline_stats::STAGE_PARSE] = parse_ns;
+	}
+	stats.on_event(s, evttype, cpuid);
+}
+}
+
+TEST(pipeline_stats, disabled_by_default)
+{
+	sinsp inspector;
+	EXPECT_FALSE(inspector.get_pipeline_stats().is_enabled());
+	inspector.set_pipeline_stats_enabled(true);
+	EXPECT_TRUE(inspector.get_pipeline_stats().is_enabled());
+}
+
+TEST(pipeline_stats, counts_and_histograms)
+{
+	sinsp_pipeline_stats stats;
+	stats.set_sampling_ratio(1);
+
+	for(uint32_t j = 0; j < 100; j++)
+	{
+		push_event(stats, PPME_SYSCALL_OPEN_X, 1, 1000);
+	}
+	push_event(stats, PPME_SYSCALL_READ_X, 3, 100000);
+
+	sinsp_pipeline_stats::snapshot snap = stats.get_snapshot();
+	EXPECT_EQ(101u, snap.m_n_evts);
+	EXPECT_EQ(101u, snap.m_n_sampled_evts);
+	EXPECT_EQ(100u, snap.m_evttypes[PPME_SYSCALL_OPEN_X].m_count);
+	EXPECT_EQ(100u * 1000, snap.m_evttypes[PPME_SYSCALL_OPEN_X].m_stage_ns[sinsp_pipeline_stats::STAGE_PARSE]);
+	EXPECT_EQ(1u, snap.m_evttypes[PPME_SYSCALL_READ_X].m_count);
+
+	// CPUs are trimmed after the last one that saw events
+	ASSERT_EQ(4u, snap.m_cpus.size());
+	EXPECT_EQ(100u, snap.m_cpus[1].m_count);
+	EXPECT_EQ(0u, snap.m_cpus[2].m_count);
+	EXPECT_EQ(1u, snap.m_cpus[3].m_count);
+
+	const sinsp_pipeline_stats::histogram& parse = snap.m_stages[sinsp_pipeline_stats::STAGE_PARSE];
+	EXPECT_EQ(101u, parse.m_count);
+	EXPECT_EQ(1024u, parse.percentile(50));
+	EXPECT_EQ(131072u, parse.percentile(100));
+
+	// Stages that didn't run are not accounted
+	EXPECT_EQ(0u, snap.m_stages[sinsp_pipeline_stats::STAGE_DUMP].m_count);
+}
+
+TEST(pipeline_stats, sampling)
+{
+	sinsp_pipeline_stats stats;
+	stats.set_sampling_ratio(4);
+	EXPECT_THROW(stats.set_sampling_ratio(3), sinsp_exception);
+
+	for(uint32_t j = 0; j < 64; j++)
+	{
+		push_event(stats, PPME_SYSCALL_OPEN_X, 0, 1000);
+	}
+
+	sinsp_pipeline_stats::snapshot snap = stats.get_snapshot();
+	EXPECT_EQ(64u, snap.m_n_evts);
+	EXPECT_EQ(16u, snap.m_n_sampled_evts);
+	EXPECT_EQ(64u, snap.m_evttypes[PPME_SYSCALL_OPEN_X].m_count);
+	EXPECT_EQ(16u, snap.m_evttypes[PPME_SYSCALL_OPEN_X].m_latency.m_count);
+}
+
+TEST(pipeline_stats, reset)
+{
+	sinsp_pipeline_stats stats;
+	stats.set_sampling_ratio(1);
+
+	push_event(stats, PPME_SYSCALL_OPEN_X, 0, 1000);
+	stats.reset();
+	EXPECT_EQ(0u, stats.get_snapshot().m_n_evts);
+	EXPECT_TRUE(stats.get_snapshot().m_cpus.empty());
+
+	push_event(stats, PPME_SYSCALL_OPEN_X, 0, 1000);
+	sinsp_pipeline_stats::snapshot snap = stats.get_snapshot();
+	EXPECT_EQ(1u, snap.m_n_evts);
+	EXPECT_EQ(1u, snap.m_stages[sinsp_pipeline_stats::STAGE_PARSE].m_count);
+}
+
+TEST(pipeline_stats, per_thread_shards)
+{
+	sinsp_pipeline_stats stats;
+	std::vector<std::thread> threads;
+
+	for(uint32_t t = 0; t < 4; t++)
+	{
+		threads.emplace_back([&stats, t]()
+		{
+			for(uint32_t j = 0; j < 10000; j++)
+			{
+				push_event(stats, PPME_SYSCALL_OPEN_X, t, 1000);
+			}
+		});
+	}
+
+	for(auto& t : threads)
+	{
+		t.join();
+	}
+
+	sinsp_pipeline_stats::snapshot snap = stats.get_snapshot();
+	EXPECT_EQ(40000u, snap.m_n_evts);
+	for(uint32_t t = 0; t < 4; t++)
+	{
+		EXPECT_EQ(10000u, snap.m_cpus[t].m_count);
+	}
+}
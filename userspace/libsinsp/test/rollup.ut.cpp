@@ -0,0 +1,206 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest.h>
+#include "sinsp.h"
+#include "capture_test.h"
+
+namespace
+{
+typedef scap_workload_writer w;
+typedef sinsp_rollup r;
+
+const uint32_t CLIENT_IP = 0x0a000005;	// 10.0.0.5
+const uint32_t SERVER_IP = 0x0a000001;	// 10.0.0.1
+const uint64_t TS = 1600000000000000000ULL;
+const uint64_t MS = 1000000ULL;
+
+struct snapshot
+{
+	uint64_t m_start_ts;
+	uint64_t m_end_ts;
+	std::map<int64_t, std::vector<uint64_t>> m_processes;
+	std::map<std::string, std::vector<uint64_t>> m_containers;
+	// By client port
+	std::map<uint16_t, std::vector<uint64_t>> m_connections;
+};
+
+//
+// Two processes writing to their connection, 10 and 5 times, then the first
+// one once more in the next second
+//
+class rollup_test : public capture_test
+{
+protected:
+	void SetUp() override
+	{
+		w writer(m_capture, 1);
+		connect(writer, TS, 100, 40000);
+		connect(writer, TS + 10, 200, 40001);
+
+		for(uint32_t j = 1; j <= 10; j++)
+		{
+			write(writer, TS + j * MS, 100, 100 * j);
+		}
+
+		for(uint32_t j = 1; j <= 5; j++)
+		{
+			write(writer, TS + 20 * MS + j * MS, 200, 1000);
+		}
+
+		write(writer, TS + 1500 * MS, 100, 100);
+
+		m_rollup = &m_inspector.enable_rollups();
+		m_rollup->set_interval(ONE_SECOND_IN_NS);
+		m_rollup->set_snapshot_callback([this](const r& rollup, uint64_t start_ts, uint64_t end_ts) {
+			snapshot s;
+			s.m_start_ts = start_ts;
+			s.m_end_ts = end_ts;
+
+			for(uint32_t j = 0; j < rollup.get_n_entities(r::ENTITY_PROCESS); j++)
+			{
+				const uint64_t* row = rollup.get_row(r::ENTITY_PROCESS, j);
+				s.m_processes[rollup.get_pid(j)].assign(row, row + rollup.get_stride(r::ENTITY_PROCESS));
+			}
+
+			for(uint32_t j = 0; j < rollup.get_n_entities(r::ENTITY_CONTAINER); j++)
+			{
+				const uint64_t* row = rollup.get_row(r::ENTITY_CONTAINER, j);
+				s.m_containers[rollup.get_container_id(j)].assign(row, row + rollup.get_stride(r::ENTITY_CONTAINER));
+			}
+
+			for(uint32_t j = 0; j < rollup.get_n_entities(r::ENTITY_CONNECTION); j++)
+			{
+				const uint64_t* row = rollup.get_row(r::ENTITY_CONNECTION, j);
+				const sinsp_conn_key& key = rollup.get_connection(j);
+				uint16_t port = key.m_port[0] == 80 ? key.m_port[1] : key.m_port[0];
+				s.m_connections[port].assign(row, row + rollup.get_stride(r::ENTITY_CONNECTION));
+			}
+
+			m_snapshots.push_back(s);
+		});
+	}
+
+	static void connect(w& writer, uint64_t ts, int64_t tid, uint16_t sport)
+	{
+		writer.write_event(ts, tid, PPME_SOCKET_SOCKET_E, 0, {w::u32(PPM_AF_INET), w::u32(1), w::u32(0)});
+		writer.write_event(ts + 1, tid, PPME_SOCKET_SOCKET_X, 0, {w::i64(3)});
+		writer.write_event(ts + 2, tid, PPME_SOCKET_CONNECT_E, 0, {w::i64(3)});
+		writer.write_event(ts + 3, tid, PPME_SOCKET_CONNECT_X, 0,
+			{w::i64(0), w::tuple4(CLIENT_IP, sport, SERVER_IP, 80)});
+	}
+
+	static void write(w& writer, uint64_t ts, int64_t tid, uint32_t len)
+	{
+		std::string data(len, 'x');
+		writer.write_event(ts, tid, PPME_SYSCALL_WRITE_E, 0, {w::i64(3), w::u32(len)});
+		writer.write_event(ts + 1000, tid, PPME_SYSCALL_WRITE_X, 0, {w::i64(len), w::buf(data)});
+	}
+
+	void replay()
+	{
+		m_inspector.open(m_capture);
+
+		sinsp_evt* evt;
+		int32_t res;
+		while((res = m_inspector.next(&evt)) != SCAP_EOF)
+		{
+			ASSERT_EQ(SCAP_SUCCESS, res);
+		}
+
+		m_inspector.close();
+	}
+
+	sinsp m_inspector;
+	r* m_rollup;
+	std::vector<snapshot> m_snapshots;
+};
+}
+
+TEST_F(rollup_test, metrics)
+{
+	const std::string writes = "evt.type=write and evt.dir=<";
+	uint32_t syscalls = m_rollup->add_metric({"syscalls", r::ENTITY_PROCESS, r::AGG_COUNT, "", "evt.dir=<"});
+	uint32_t bytes = m_rollup->add_metric({"write_bytes", r::ENTITY_CONTAINER, r::AGG_SUM, "evt.rawres", writes});
+	uint32_t sizes = m_rollup->add_metric({"write_sizes", r::ENTITY_CONNECTION, r::AGG_HISTOGRAM, "evt.rawres", writes});
+	uint32_t nwrites = m_rollup->add_metric({"writes", r::ENTITY_CONNECTION, r::AGG_COUNT, "", writes});
+
+	EXPECT_THROW(m_rollup->add_metric({"bad", r::ENTITY_PROCESS, r::AGG_SUM, "proc.name", ""}), sinsp_exception);
+	EXPECT_THROW(m_rollup->add_metric({"bad", r::ENTITY_PROCESS, r::AGG_SUM, "evt.nope", ""}), sinsp_exception);
+	EXPECT_THROW(m_rollup->add_metric({"bad", r::ENTITY_PROCESS, r::AGG_COUNT, "", "evt.type=="}), sinsp_exception);
+	EXPECT_EQ(4u, m_rollup->get_n_metrics());
+
+	// A histogram takes a counter per bucket
+	EXPECT_EQ(1u, m_rollup->get_stride(r::ENTITY_PROCESS));
+	EXPECT_EQ(r::HISTOGRAM_BUCKETS + 1u, m_rollup->get_stride(r::ENTITY_CONNECTION));
+	EXPECT_EQ((uint32_t)r::HISTOGRAM_BUCKETS, m_rollup->get_offset(nwrites));
+
+	replay();
+
+	ASSERT_EQ(2u, m_snapshots.size());
+	const snapshot& first = m_snapshots[0];
+	EXPECT_EQ(TS, first.m_start_ts);
+	EXPECT_EQ(TS + ONE_SECOND_IN_NS, first.m_end_ts);
+
+	// socket, connect and the writes
+	ASSERT_EQ(2u, first.m_processes.size());
+	EXPECT_EQ(12u, first.m_processes.at(100)[m_rollup->get_offset(syscalls)]);
+	EXPECT_EQ(7u, first.m_processes.at(200)[m_rollup->get_offset(syscalls)]);
+
+	// Both on the host
+	ASSERT_EQ(1u, first.m_containers.size());
+	EXPECT_EQ(5500u + 5000u, first.m_containers.at("")[m_rollup->get_offset(bytes)]);
+
+	ASSERT_EQ(2u, first.m_connections.size());
+	const std::vector<uint64_t>& conn1 = first.m_connections.at(40000);
+	const std::vector<uint64_t>& conn2 = first.m_connections.at(40001);
+	EXPECT_EQ(10u, conn1[m_rollup->get_offset(nwrites)]);
+	EXPECT_EQ(5u, conn2[m_rollup->get_offset(nwrites)]);
+
+	// 100 to 1000 bytes
+	uint32_t off = m_rollup->get_offset(sizes);
+	EXPECT_EQ(1u, conn1[off + sinsp_log2_histogram::get_bucket(100)]);
+	EXPECT_EQ(5u, conn2[off + sinsp_log2_histogram::get_bucket(1000)]);
+	uint64_t total = 0;
+	for(uint32_t j = 0; j < r::HISTOGRAM_BUCKETS; j++)
+	{
+		total += conn1[off + j];
+	}
+	EXPECT_EQ(10u, total);
+
+	// Only what happened in the next second
+	const snapshot& second = m_snapshots[1];
+	EXPECT_EQ(TS + ONE_SECOND_IN_NS, second.m_start_ts);
+	ASSERT_EQ(1u, second.m_processes.size());
+	EXPECT_EQ(1u, second.m_processes.at(100)[m_rollup->get_offset(syscalls)]);
+	EXPECT_EQ(100u, second.m_containers.at("")[m_rollup->get_offset(bytes)]);
+	EXPECT_EQ(1u, second.m_connections.size());
+	EXPECT_EQ(0u, m_rollup->get_n_dropped());
+}
+
+TEST_F(rollup_test, max_entities)
+{
+	uint32_t syscalls = m_rollup->add_metric({"syscalls", r::ENTITY_PROCESS, r::AGG_COUNT, "", "evt.dir=<"});
+	m_rollup->set_max_entities(1);
+	replay();
+
+	// The second process doesn't fit
+	ASSERT_EQ(2u, m_snapshots.size());
+	ASSERT_EQ(1u, m_snapshots[0].m_processes.size());
+	EXPECT_EQ(12u, m_snapshots[0].m_processes.at(100)[m_rollup->get_offset(syscalls)]);
+	EXPECT_EQ(7u, m_rollup->get_n_dropped());
+}
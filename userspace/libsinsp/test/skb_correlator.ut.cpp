@@ -0,0 +1,243 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest.h>
+#include "sinsp.h"
+#include "capture_test.h"
+
+namespace
+{
+typedef scap_workload_writer w;
+
+const uint32_t CLIENT_IP = 0x0a000005;	// 10.0.0.5
+const uint32_t SERVER_IP = 0x0a000001;	// 10.0.0.1
+const uint64_t TS = 1600000000000000000ULL;
+const uint64_t US = 1000ULL;
+const uint64_t MS = 1000000ULL;
+const int64_t SERVER = 200;
+const int64_t FD = 7;
+
+void write_read(w& writer, uint64_t enter_ts, uint64_t exit_ts, const std::string& data)
+{
+	writer.write_event(enter_ts, SERVER, PPME_SYSCALL_READ_E, 0, {w::i64(FD), w::u32(data.size())});
+	writer.write_event(exit_ts, SERVER, PPME_SYSCALL_READ_X, 0, {w::i64(data.size()), w::buf(data)});
+}
+
+//
+// Softirq context: the tid is whatever was running
+//
+void write_skb(w& writer, uint64_t ts, bool ingress, uint16_t client_port = 40000)
+{
+	std::string mac("\x02\x42\xac\x11\x00\x02", 6);
+	if(ingress)
+	{
+		writer.write_event(ts, 0, PPME_NETIF_RECEIVE_SKB_E, 0,
+			{w::str("eth0"), w::u64(0xffff888000001000ULL), w::buf(mac), w::buf(mac),
+			 w::tuple4(CLIENT_IP, client_port, SERVER_IP, 80)});
+	}
+	else
+	{
+		writer.write_event(ts, 0, PPME_NET_DEV_XMIT_E, 0,
+			{w::str("eth0"), w::u64(0xffff888000002000ULL), w::buf(mac), w::buf(mac),
+			 w::tuple4(SERVER_IP, 80, CLIENT_IP, client_port)});
+	}
+}
+
+class skb_correlator_test : public capture_test
+{
+};
+}
+
+TEST_F(skb_correlator_test, kernel_latency)
+{
+	{
+		w writer(m_capture, 1);
+
+		write_execve(writer, TS, SERVER, "nginx");
+		writer.write_event(TS + 10, SERVER, PPME_SOCKET_ACCEPT4_5_E, 0, {w::i32(0)});
+		writer.write_event(TS + 11, SERVER, PPME_SOCKET_ACCEPT4_5_X, 0,
+			{w::i64(FD), w::tuple4(CLIENT_IP, 40000, SERVER_IP, 80), w::u8(0), w::u32(0), w::u32(511)});
+
+		// The request: one packet, then two for the same read
+		write_skb(writer, TS + 1 * MS, true);
+		write_read(writer, TS + 1 * MS + 10 * US, TS + 1 * MS + 50 * US, "GET / HTTP/1.1\r\n");
+		write_skb(writer, TS + 2 * MS, true);
+		write_skb(writer, TS + 2 * MS + 20 * US, true);
+		write_read(writer, TS + 2 * MS + 60 * US, TS + 2 * MS + 100 * US, "Host: example.com\r\n\r\n");
+
+		// The response, sent while the write is still in the kernel
+		std::string resp("HTTP/1.1 200 OK\r\n\r\n");
+		writer.write_event(TS + 3 * MS, SERVER, PPME_SYSCALL_WRITE_E, 0, {w::i64(FD), w::u32(resp.size())});
+		write_skb(writer, TS + 3 * MS + 30 * US, false);
+		writer.write_event(TS + 3 * MS + 40 * US, SERVER, PPME_SYSCALL_WRITE_X, 0, {w::i64(resp.size()), w::buf(resp)});
+
+		// The ACK of the response, long before the next request is read
+		write_skb(writer, TS + 3 * MS + 100 * US, true);
+		write_skb(writer, TS + 3 * MS + 800 * US, true);
+		write_read(writer, TS + 3 * MS + 850 * US, TS + 3 * MS + 900 * US, "GET / HTTP/1.1\r\n\r\n");
+
+		// A connection nobody owns
+		write_skb(writer, TS + 4 * MS, true, 40001);
+
+		// Never read, expires
+		write_skb(writer, TS + 5 * MS, true);
+		write_skb(writer, TS + 5 * MS + 2000 * MS, false);
+	}
+
+	sinsp inspector;
+	sinsp_evt_formatter formatter(&inspector, "%fd.num %proc.name %fd.ingress.latency.p50 %fd.egress.latency.p50");
+
+	inspector.open(m_capture);
+
+	std::vector<std::string> out;
+	sinsp_evt* evt;
+	int32_t res;
+	while((res = inspector.next(&evt)) != SCAP_EOF)
+	{
+		EXPECT_EQ(SCAP_SUCCESS, res);
+		if(evt->get_type() == PPME_NET_DEV_XMIT_E || evt->get_type() == PPME_SYSCALL_READ_X)
+		{
+			std::string line;
+			formatter.tostring(evt, &line);
+			out.push_back(line);
+		}
+	}
+
+	ASSERT_EQ(5u, out.size());
+	EXPECT_EQ("7 nginx 50000 ", out[0]);
+	// The second read only measures its newest packet, 80us
+	EXPECT_EQ("7 nginx 50000 ", out[1]);
+	EXPECT_EQ("7 nginx 50000 30000", out[2]);
+	// The median of 50us, 80us and 100us, in the bucket of the last two:
+	// the ACK, 800us before the read, isn't measured
+	EXPECT_EQ("7 nginx 98303 30000", out[3]);
+	EXPECT_EQ("7 nginx 98303 30000", out[4]);
+
+	sinsp_skb_correlator& correlator = inspector.get_skb_correlator();
+	EXPECT_EQ(4u, correlator.get_n_matched());
+	EXPECT_EQ(1u, correlator.get_n_expired());
+	EXPECT_EQ(0u, correlator.get_n_pending_connections());
+
+	std::vector<sinsp_conn> conns;
+	inspector.get_conn_index().snapshot(conns, true);
+	ASSERT_EQ(1u, conns.size());
+	const sinsp_skb_latency& lat = conns[0].m_skb_latency;
+	EXPECT_EQ(3u, lat.m_ingress.m_count);
+	EXPECT_EQ(50 * US, lat.m_ingress.m_min);
+	EXPECT_EQ(100 * US, lat.m_ingress.m_max);
+	EXPECT_EQ(1u, lat.m_egress.m_count);
+	EXPECT_EQ(30 * US, lat.m_egress.m_min);
+
+	inspector.get_conn_index().snapshot(conns, false);
+	ASSERT_EQ(1u, conns.size());
+	EXPECT_EQ(0u, conns[0].m_skb_latency.m_ingress.m_count);
+
+	inspector.close();
+}
+
+//
+// Both ends on the same host: every packet is sent by one socket and
+// received by the other, and each side only gets its own
+//
+TEST_F(skb_correlator_test, loopback)
+{
+	const uint32_t LOCALHOST = 0x7f000001;
+	const int64_t CLIENT = 100;
+	const int64_t CLIENT_FD = 3;
+	std::string mac("\x00\x00\x00\x00\x00\x00", 6);
+
+	{
+		w writer(m_capture, 1);
+
+		auto skb = [&](uint64_t ts, bool ingress, uint16_t sport, uint16_t dport)
+		{
+			writer.write_event(ts, 0, ingress ? PPME_NETIF_RECEIVE_SKB_E : PPME_NET_DEV_XMIT_E, 0,
+				{w::str("lo"), w::u64(0xffff888000001000ULL), w::buf(mac), w::buf(mac),
+				 w::tuple4(LOCALHOST, sport, LOCALHOST, dport)});
+		};
+		auto write = [&](uint64_t enter_ts, uint64_t exit_ts, int64_t tid, int64_t fd, const std::string& data)
+		{
+			writer.write_event(enter_ts, tid, PPME_SYSCALL_WRITE_E, 0, {w::i64(fd), w::u32(data.size())});
+			writer.write_event(exit_ts, tid, PPME_SYSCALL_WRITE_X, 0, {w::i64(data.size()), w::buf(data)});
+		};
+		auto read = [&](uint64_t enter_ts, uint64_t exit_ts, int64_t tid, int64_t fd, const std::string& data)
+		{
+			writer.write_event(enter_ts, tid, PPME_SYSCALL_READ_E, 0, {w::i64(fd), w::u32(data.size())});
+			writer.write_event(exit_ts, tid, PPME_SYSCALL_READ_X, 0, {w::i64(data.size()), w::buf(data)});
+		};
+
+		write_execve(writer, TS, CLIENT, "curl");
+		write_execve(writer, TS + 2, SERVER, "nginx");
+		writer.write_event(TS + 10, CLIENT, PPME_SOCKET_SOCKET_E, 0, {w::u32(PPM_AF_INET), w::u32(1), w::u32(0)});
+		writer.write_event(TS + 11, CLIENT, PPME_SOCKET_SOCKET_X, 0, {w::i64(CLIENT_FD)});
+		writer.write_event(TS + 12, CLIENT, PPME_SOCKET_CONNECT_E, 0, {w::i64(CLIENT_FD)});
+		writer.write_event(TS + 13, CLIENT, PPME_SOCKET_CONNECT_X, 0,
+			{w::i64(0), w::tuple4(LOCALHOST, 40000, LOCALHOST, 80)});
+		writer.write_event(TS + 20, SERVER, PPME_SOCKET_ACCEPT4_5_E, 0, {w::i32(0)});
+		writer.write_event(TS + 21, SERVER, PPME_SOCKET_ACCEPT4_5_X, 0,
+			{w::i64(FD), w::tuple4(LOCALHOST, 40000, LOCALHOST, 80), w::u8(0), w::u32(0), w::u32(511)});
+
+		// Some other traffic first, the correlator starts with it
+		skb(TS + 100, true, 50000, 443);
+
+		// The request
+		uint64_t ts = TS + 1 * MS;
+		write(ts, ts + 30 * US, CLIENT, CLIENT_FD, "GET / HTTP/1.1\r\n\r\n");
+		skb(ts + 10 * US, false, 40000, 80);
+		skb(ts + 20 * US, true, 40000, 80);
+		read(ts + 50 * US, ts + 100 * US, SERVER, FD, "GET / HTTP/1.1\r\n\r\n");
+
+		// The response
+		ts = TS + 2 * MS;
+		write(ts, ts + 25 * US, SERVER, FD, "HTTP/1.1 200 OK\r\n\r\n");
+		skb(ts + 5 * US, false, 80, 40000);
+		skb(ts + 15 * US, true, 80, 40000);
+		read(ts + 40 * US, ts + 200 * US, CLIENT, CLIENT_FD, "HTTP/1.1 200 OK\r\n\r\n");
+	}
+
+	sinsp inspector;
+	inspector.open(m_capture);
+
+	sinsp_evt* evt;
+	while(inspector.next(&evt) != SCAP_EOF)
+	{
+	}
+
+	EXPECT_EQ(4u, inspector.get_skb_correlator().get_n_matched());
+
+	std::vector<sinsp_conn> conns;
+	inspector.get_conn_index().snapshot(conns, false);
+	ASSERT_EQ(2u, conns.size());
+	for(const sinsp_conn& conn : conns)
+	{
+		const sinsp_skb_latency& lat = conn.m_skb_latency;
+		ASSERT_EQ(1u, lat.m_ingress.m_count);
+		ASSERT_EQ(1u, lat.m_egress.m_count);
+		if(conn.m_pid == CLIENT)
+		{
+			EXPECT_EQ(185 * US, lat.m_ingress.m_min);
+			EXPECT_EQ(10 * US, lat.m_egress.m_min);
+		}
+		else
+		{
+			EXPECT_EQ(80 * US, lat.m_ingress.m_min);
+			EXPECT_EQ(5 * US, lat.m_egress.m_min);
+		}
+	}
+
+	inspector.close();
+}
@@ -0,0 +1,184 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <memory>
+#include <gtest.h>
+#include "sinsp.h"
+#include "filter.h"
+#include "filterchecks.h"
+#include "capture_test.h"
+
+extern sinsp_filter_check_list g_filterlist;
+
+namespace
+{
+typedef scap_workload_writer w;
+
+const uint64_t MS = 1000000ULL;
+
+class threadinfo_test : public capture_test
+{
+protected:
+	bool run_filter(const std::string& fltstr, sinsp_evt* evt)
+	{
+		sinsp_filter_compiler compiler(&m_inspector, fltstr);
+		std::unique_ptr<sinsp_filter> filter(compiler.compile());
+		return filter->run(evt);
+	}
+
+	std::string extract(const std::string& field, sinsp_evt* evt, uint8_t** res = NULL)
+	{
+		std::unique_ptr<sinsp_filter_check> chk(g_filterlist.new_filter_check_from_fldname(field, &m_inspector, true));
+		chk->parse_field_name(field.c_str(), true, false);
+
+		uint32_t len;
+		uint8_t* val = chk->extract(evt, &len);
+		if(res != NULL)
+		{
+			*res = val;
+		}
+
+		return val != NULL ? std::string((char*)val, len) : "<NA>";
+	}
+
+	sinsp m_inspector;
+};
+}
+
+//
+// A process executing twice, the second time with other arguments
+//
+TEST_F(threadinfo_test, derived_fields)
+{
+	{
+		w writer(m_capture, 1);
+		write_execve(writer, MS, 100, "/bin/top", {"-d1", "-n2"}, {"HOME=/root", "TERM=xterm"});
+		write_execve(writer, 2 * MS, 100, "/bin/ls", {"-l"}, {"HOME=/root"});
+	}
+
+	m_inspector.open(m_capture);
+
+	std::vector<std::map<std::string, std::string>> values;
+	sinsp_evt* evt;
+	int32_t res;
+	while((res = m_inspector.next(&evt)) != SCAP_EOF)
+	{
+		ASSERT_EQ(SCAP_SUCCESS, res);
+		if(evt->get_type() != PPME_SYSCALL_EXECVE_19_X)
+		{
+			continue;
+		}
+
+		std::map<std::string, std::string> v;
+		for(const char* field : {"proc.name", "proc.args", "proc.env", "proc.cmdline", "proc.exeline"})
+		{
+			v[field] = extract(field, evt);
+		}
+		values.push_back(v);
+
+		// Straight from the thread, and built once
+		sinsp_threadinfo* tinfo = evt->get_thread_info();
+		uint8_t* val;
+		extract("proc.name", evt, &val);
+		EXPECT_EQ((uint8_t*)tinfo->m_comm.c_str(), val);
+		extract("proc.cmdline", evt, &val);
+		EXPECT_EQ((uint8_t*)tinfo->get_cmdline().c_str(), val);
+	}
+
+	ASSERT_EQ(2u, values.size());
+	EXPECT_EQ("top", values[0]["proc.name"]);
+	EXPECT_EQ("-d1 -n2", values[0]["proc.args"]);
+	EXPECT_EQ("HOME=/root TERM=xterm", values[0]["proc.env"]);
+	EXPECT_EQ("top -d1 -n2", values[0]["proc.cmdline"]);
+	EXPECT_EQ("/bin/top -d1 -n2", values[0]["proc.exeline"]);
+
+	// Built again after the exec
+	EXPECT_EQ("ls", values[1]["proc.name"]);
+	EXPECT_EQ("-l", values[1]["proc.args"]);
+	EXPECT_EQ("HOME=/root", values[1]["proc.env"]);
+	EXPECT_EQ("ls -l", values[1]["proc.cmdline"]);
+	EXPECT_EQ("/bin/ls -l", values[1]["proc.exeline"]);
+}
+
+//
+// init -> bash -> top -> sleep, then bash exits
+//
+TEST_F(threadinfo_test, ancestors)
+{
+	{
+		w writer(m_capture, 1);
+		write_execve(writer, MS, 100, "/sbin/init", {}, {}, 0);
+		write_execve(writer, 2 * MS, 200, "/bin/bash", {}, {}, 100);
+		write_execve(writer, 3 * MS, 300, "/bin/top", {}, {}, 200);
+		write_execve(writer, 4 * MS, 400, "/bin/sleep", {"1"}, {}, 300);
+		writer.write_event(5 * MS, 200, PPME_PROCEXIT_1_E, 0, {w::i64(0)});
+		write_execve(writer, 6 * MS, 400, "/bin/sleep", {"2"}, {}, 300);
+	}
+
+	m_inspector.open(m_capture);
+
+	sinsp_evt* evt;
+	int32_t res;
+	uint32_t nexecs = 0;
+	while((res = m_inspector.next(&evt)) != SCAP_EOF)
+	{
+		ASSERT_EQ(SCAP_SUCCESS, res);
+		if(evt->get_type() != PPME_SYSCALL_EXECVE_19_X || evt->get_tid() != 400)
+		{
+			continue;
+		}
+
+		sinsp_threadinfo* tinfo = evt->get_thread_info();
+		ASSERT_NE(nullptr, tinfo);
+
+		if(++nexecs == 1)
+		{
+			EXPECT_EQ("top", extract("proc.aname[1]", evt));
+			EXPECT_EQ("init", extract("proc.aname[3]", evt));
+			EXPECT_EQ("<NA>", extract("proc.aname[4]", evt));
+			EXPECT_EQ("sleep", extract("proc.aname[0]", evt));
+			int64_t apid;
+			std::string val = extract("proc.apid[2]", evt);
+			ASSERT_EQ(sizeof(apid), val.size());
+			memcpy(&apid, val.data(), sizeof(apid));
+			EXPECT_EQ(200, apid);
+
+			EXPECT_TRUE(run_filter("proc.aname=bash", evt));
+			EXPECT_TRUE(run_filter("proc.apid=100", evt));
+			EXPECT_FALSE(run_filter("proc.aname=sleep", evt));
+
+			// Built once, and the ancestors got theirs on the way
+			const std::vector<sinsp_threadinfo*>& ancestors = tinfo->get_ancestors();
+			ASSERT_EQ(3u, ancestors.size());
+			EXPECT_EQ(ancestors.data(), tinfo->get_ancestors().data());
+			const std::vector<sinsp_threadinfo*>& parent_ancestors = ancestors[0]->get_ancestors();
+			ASSERT_EQ(2u, parent_ancestors.size());
+			EXPECT_EQ(ancestors[1], parent_ancestors[0]);
+			EXPECT_EQ(ancestors[2], parent_ancestors[1]);
+		}
+		else
+		{
+			// The chain stops where bash was
+			EXPECT_EQ("top", extract("proc.aname[1]", evt));
+			EXPECT_EQ("<NA>", extract("proc.aname[2]", evt));
+			EXPECT_FALSE(run_filter("proc.aname=init", evt));
+			EXPECT_EQ(1u, tinfo->get_ancestors().size());
+		}
+	}
+
+	EXPECT_EQ(2u, nexecs);
+}
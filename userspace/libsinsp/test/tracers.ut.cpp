@@ -0,0 +1,116 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest.h>
+#include "sinsp.h"
+#include "tracers.h"
+
+namespace
+{
+class tracers_test : public testing::Test
+{
+protected:
+	void SetUp()
+	{
+		m_inspector.request_tracer_state_tracking();
+		m_tinfo.reset(new sinsp_threadinfo(&m_inspector));
+		m_tinfo->m_tid = 33;
+		m_tinfo->m_pid = 22;
+		m_parser.reset(new sinsp_tracerparser(&m_inspector));
+		m_parser->m_tinfo = m_tinfo.get();
+	}
+
+	sinsp_tracerparser::parse_result process(std::string data, uint64_t ts)
+	{
+		return m_parser->process_event_data((char*)data.c_str(), data.size(), ts);
+	}
+
+	sinsp m_inspector;
+	std::unique_ptr<sinsp_threadinfo> m_tinfo;
+	std::unique_ptr<sinsp_tracerparser> m_parser;
+};
+}
+
+TEST_F(tracers_test, parse_simple)
+{
+	// Longer than a vector, with escapes on both sides of the boundaries
+	ASSERT_EQ(sinsp_tracerparser::RES_OK,
+		process(">:t:a_rather_long_service_name.que\\.ry:arg_name_that_is_long=v\\,1,b=a_long_value_012345:", 1));
+
+	ASSERT_EQ(2u, m_parser->m_tags.size());
+	EXPECT_STREQ("a_rather_long_service_name", m_parser->m_tags[0]);
+	EXPECT_STREQ("que.ry", m_parser->m_tags[1]);
+	EXPECT_EQ(6u, m_parser->m_taglens[1]);
+	ASSERT_EQ(2u, m_parser->m_argnames.size());
+	EXPECT_STREQ("arg_name_that_is_long", m_parser->m_argnames[0]);
+	EXPECT_STREQ("v,1", m_parser->m_argvals[0]);
+	EXPECT_STREQ("b", m_parser->m_argnames[1]);
+	EXPECT_STREQ("a_long_value_012345", m_parser->m_argvals[1]);
+	EXPECT_EQ(33, m_parser->m_id);
+
+	EXPECT_EQ(sinsp_tracerparser::RES_TRUNCATED, process(">:t:mysql.query_that_is_not_finished_yet", 2));
+	EXPECT_EQ(sinsp_tracerparser::RES_OK, process("::", 2));
+	EXPECT_STREQ("query_that_is_not_finished_yet", m_parser->m_tags[1]);
+
+	EXPECT_EQ(sinsp_tracerparser::RES_FAILED, process(">:t:mysql=query:", 3));
+}
+
+TEST_F(tracers_test, parse_json)
+{
+	ASSERT_EQ(sinsp_tracerparser::RES_OK,
+		process("[\">\", 12345, [\"mysql\", \"a \\\"quoted\\\" query tag\"], [{\"argname1\":\"argval1\"}]]", 1));
+
+	ASSERT_EQ(2u, m_parser->m_tags.size());
+	EXPECT_STREQ("a \\\"quoted\\\" query tag", m_parser->m_tags[1]);
+	EXPECT_STREQ("argval1", m_parser->m_argvals[0]);
+	EXPECT_EQ(12345, m_parser->m_id);
+}
+
+TEST_F(tracers_test, match_spans)
+{
+	process(">:t:app::", 10);
+	sinsp_partial_tracer* app = m_parser->m_enter_pae;
+	process(">:t:app.db:a=1:", 20);
+	process(">:t:app.db:a=2:", 30);
+	sinsp_partial_tracer* db = m_parser->m_enter_pae;
+	process(">:1:app.db::", 40);
+
+	// The most recent one with the same id and tags
+	process("<:t:app.db:b=3:", 35);
+	EXPECT_EQ(db, m_parser->m_enter_pae);
+	EXPECT_EQ(30u, m_parser->m_enter_pae->m_time);
+	EXPECT_EQ(35u, m_parser->m_exit_pae.m_time);
+	EXPECT_STREQ("b", m_parser->m_exit_pae.m_argnames[0]);
+	EXPECT_STREQ("3", m_parser->m_exit_pae.m_argvals[0]);
+	EXPECT_EQ(app, m_parser->find_parent_enter_pae());
+
+	process("<:t:app.db::", 50);
+	EXPECT_EQ(20u, m_parser->m_enter_pae->m_time);
+
+	// No such span
+	process("<:t:app.cache::", 60);
+	EXPECT_EQ(NULL, m_parser->m_enter_pae);
+
+	process("<:1:app.db::", 70);
+	EXPECT_EQ(40u, m_parser->m_enter_pae->m_time);
+	EXPECT_EQ(NULL, m_parser->find_parent_enter_pae());
+
+	process("<:t:app::", 80);
+	EXPECT_EQ(app, m_parser->m_enter_pae);
+	process("<:t:app::", 90);
+	EXPECT_EQ(NULL, m_parser->m_enter_pae);
+}
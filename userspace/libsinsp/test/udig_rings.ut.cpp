@@ -0,0 +1,261 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <gtest.h>
+#include "scap.h"
+#include "udig_rings.h"
+
+namespace
+{
+const uint32_t s_nproducers = 4;
+const uint64_t s_nevts = 50000;
+
+uint64_t now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+//
+// A close() enter event whose fd is the sequence number
+//
+void produce(uint64_t nevts, int64_t* tid)
+{
+	char error[SCAP_LASTERR_SIZE];
+	udig_producer p;
+
+	ASSERT_EQ(SCAP_SUCCESS, udig_producer_open(&p, error)) << error;
+	*tid = syscall(SYS_gettid);
+
+	uint32_t len = sizeof(struct ppm_evt_hdr) + sizeof(uint16_t) + sizeof(int64_t);
+	for(uint64_t j = 0; j < nevts; j++)
+	{
+		uint8_t* buf;
+		while((buf = udig_producer_reserve(&p, len)) == NULL)
+		{
+			// Ring full, wait for the consumer
+			usleep(100);
+		}
+
+		struct ppm_evt_hdr* hdr = (struct ppm_evt_hdr*)buf;
+		hdr->ts = now_ns();
+		hdr->tid = *tid;
+		hdr->len = len;
+		hdr->type = PPME_SYSCALL_CLOSE_E;
+		hdr->nparams = 1;
+
+		uint16_t plen = sizeof(int64_t);
+		int64_t fd = j;
+		memcpy(buf + sizeof(struct ppm_evt_hdr), &plen, sizeof(plen));
+		memcpy(buf + sizeof(struct ppm_evt_hdr) + sizeof(plen), &fd, sizeof(fd));
+
+		udig_producer_commit(&p, len);
+	}
+
+	udig_producer_close(&p);
+}
+
+class udig_rings_test : public testing::Test
+{
+protected:
+	void SetUp()
+	{
+		char error[SCAP_LASTERR_SIZE];
+		int32_t rc;
+		scap_open_args args = {};
+
+		//
+		// Private shared memory areas, a udig capture on the host is left alone
+		//
+		m_prefix = "udig_ut_" + std::to_string(getpid()) + "_";
+		udig_set_shm_prefix(m_prefix.c_str());
+		cleanup();
+
+		args.mode = SCAP_MODE_LIVE;
+		args.udig = true;
+		args.proc_callback = NULL;
+		m_h = scap_open(args, error, &rc);
+		ASSERT_TRUE(m_h != NULL) << error;
+	}
+
+	void TearDown()
+	{
+		if(m_h != NULL)
+		{
+			scap_close(m_h);
+		}
+
+		cleanup();
+		udig_set_shm_prefix("");
+	}
+
+	void cleanup()
+	{
+		shm_unlink((m_prefix + UDIG_RINGS_SM_FNAME).c_str());
+		shm_unlink((m_prefix + UDIG_RINGS_DESCS_SM_FNAME).c_str());
+		shm_unlink((m_prefix + UDIG_RING_SM_FNAME).c_str());
+		shm_unlink((m_prefix + UDIG_RING_DESCS_SM_FNAME).c_str());
+	}
+
+	//
+	// Lets the consumer pick up the claimed rings
+	//
+	uint32_t ndevs()
+	{
+		scap_evt* evt;
+		uint16_t cpuid;
+		EXPECT_EQ(SCAP_TIMEOUT, scap_next(m_h, &evt, &cpuid));
+		return scap_get_ndevs(m_h);
+	}
+
+	std::string m_prefix;
+	scap_t* m_h = NULL;
+};
+}
+
+TEST_F(udig_rings_test, claim)
+{
+	char error[SCAP_LASTERR_SIZE];
+	udig_producer p1;
+	udig_producer p2;
+
+	//
+	// Only the shared ring until a producer shows up
+	//
+	EXPECT_EQ(1u, scap_get_ndevs(m_h));
+
+	ASSERT_EQ(SCAP_SUCCESS, udig_producer_open(&p1, error)) << error;
+	ASSERT_EQ(SCAP_SUCCESS, udig_producer_open(&p2, error)) << error;
+	EXPECT_NE(p1.m_ring_id, p2.m_ring_id);
+	EXPECT_TRUE(udig_producer_is_capturing(&p1));
+	EXPECT_EQ(3u, ndevs());
+
+	int32_t id = p1.m_ring_id;
+	udig_producer_close(&p1);
+	ASSERT_EQ(SCAP_SUCCESS, udig_producer_open(&p1, error)) << error;
+	EXPECT_EQ(id, p1.m_ring_id);
+
+	udig_producer_close(&p1);
+	udig_producer_close(&p2);
+	EXPECT_EQ(1u, ndevs());
+}
+
+//
+// The ring of a producer that died without closing it is reclaimed, and
+// a stale owner pid alone doesn't keep a ring taken
+//
+TEST_F(udig_rings_test, reclaim)
+{
+	char error[SCAP_LASTERR_SIZE];
+	udig_producer p;
+
+	pid_t child = fork();
+	ASSERT_NE(-1, child);
+	if(child == 0)
+	{
+		_exit(udig_producer_open(&p, error) == SCAP_SUCCESS && p.m_ring_id == 0 ? 0 : 1);
+	}
+
+	int status;
+	ASSERT_EQ(child, waitpid(child, &status, 0));
+	ASSERT_TRUE(WIFEXITED(status));
+	ASSERT_EQ(0, WEXITSTATUS(status));
+
+	ASSERT_EQ(SCAP_SUCCESS, udig_producer_open(&p, error)) << error;
+	EXPECT_EQ(0, p.m_ring_id);
+	EXPECT_EQ(getpid(), p.m_rings->m_rings[0].m_owner_pid);
+
+	//
+	// Looks owned by a live process, but nobody holds it
+	//
+	p.m_rings->m_rings[1].m_owner_pid = getppid();
+
+	udig_producer p2;
+	ASSERT_EQ(SCAP_SUCCESS, udig_producer_open(&p2, error)) << error;
+	EXPECT_EQ(1, p2.m_ring_id);
+
+	udig_producer_close(&p2);
+	udig_producer_close(&p);
+}
+
+TEST_F(udig_rings_test, concurrent_producers)
+{
+	std::vector<std::thread> producers;
+	std::vector<int64_t> tids(s_nproducers, 0);
+	for(uint32_t j = 0; j < s_nproducers; j++)
+	{
+		producers.emplace_back(produce, s_nevts, &tids[j]);
+	}
+
+	//
+	// Every thread gets its events in order, none is lost
+	//
+	std::map<int64_t, uint64_t> next_seq;
+	uint64_t nevts = 0;
+	uint64_t deadline = now_ns() + 30 * 1000000000ULL;
+	while(nevts < s_nproducers * s_nevts && now_ns() < deadline)
+	{
+		scap_evt* evt;
+		uint16_t cpuid;
+		int32_t rc = scap_next(m_h, &evt, &cpuid);
+		if(rc == SCAP_TIMEOUT)
+		{
+			continue;
+		}
+		//
+		// No ASSERT before the producers are joined
+		//
+		EXPECT_EQ(SCAP_SUCCESS, rc);
+		if(rc != SCAP_SUCCESS)
+		{
+			break;
+		}
+		EXPECT_EQ(PPME_SYSCALL_CLOSE_E, evt->type);
+
+		int64_t seq;
+		memcpy(&seq, (uint8_t*)evt + sizeof(struct ppm_evt_hdr) + sizeof(uint16_t), sizeof(seq));
+		EXPECT_EQ(next_seq[evt->tid], (uint64_t)seq) << "tid " << evt->tid;
+		next_seq[evt->tid] = seq + 1;
+		nevts++;
+	}
+
+	for(auto& t : producers)
+	{
+		t.join();
+	}
+
+	EXPECT_EQ(s_nproducers * s_nevts, nevts);
+	ASSERT_EQ(s_nproducers, next_seq.size());
+	for(int64_t tid : tids)
+	{
+		EXPECT_EQ(s_nevts, next_seq[tid]);
+	}
+
+	scap_stats stats;
+	ASSERT_EQ(SCAP_SUCCESS, scap_get_stats(m_h, &stats));
+	EXPECT_EQ(s_nproducers * s_nevts, stats.n_evts);
+}
@@ -0,0 +1,129 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <gtest.h>
+#include "sinsp.h"
+#include "capture_test.h"
+
+namespace
+{
+int listen_socket()
+{
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in addr = {};
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if(fd < 0 ||
+	   bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+	   listen(fd, 1) != 0)
+	{
+		return -1;
+	}
+	return fd;
+}
+
+sinsp_fdinfo_t* own_fd(sinsp& inspector, int fd)
+{
+	sinsp_threadinfo* tinfo = inspector.get_thread_ref(getpid(), false).get();
+	return tinfo == NULL ? NULL : tinfo->get_fd(fd);
+}
+}
+
+TEST(warm_restart, reconcile)
+{
+	temp_file state("warm_restart_ut");
+
+	int fd = listen_socket();
+	ASSERT_NE(-1, fd);
+
+	// Mark what only the saved state can tell
+	{
+		sinsp inspector;
+		inspector.open_nodriver();
+
+		sinsp_threadinfo* tinfo = inspector.get_thread_ref(getpid(), false).get();
+		ASSERT_NE(nullptr, tinfo);
+		tinfo->m_exe = "saved_exe";
+		ASSERT_NE(nullptr, own_fd(inspector, fd));
+		ASSERT_EQ(SCAP_FD_IPV4_SERVSOCK, own_fd(inspector, fd)->m_type);
+		own_fd(inspector, fd)->m_sockinfo.m_ipv4serverinfo.m_port = 1;
+
+		auto container = std::make_shared<sinsp_container_info>();
+		container->m_id = "aaaa";
+		container->m_name = "saved_container";
+		container->m_type = CT_DOCKER;
+		inspector.m_container_manager.add_container(container, nullptr);
+
+		inspector.save_state(state.path());
+		inspector.close();
+	}
+
+	// Nothing changed, everything comes from the state
+	{
+		sinsp inspector;
+		inspector.set_warm_restart_state(state.path());
+		inspector.open_nodriver();
+
+		sinsp_threadinfo* tinfo = inspector.get_thread_ref(getpid(), false).get();
+		ASSERT_NE(nullptr, tinfo);
+		EXPECT_EQ("saved_exe", tinfo->m_exe);
+		EXPECT_EQ(getppid(), tinfo->m_ptid);
+		ASSERT_NE(nullptr, own_fd(inspector, fd));
+		EXPECT_EQ(1, own_fd(inspector, fd)->m_sockinfo.m_ipv4serverinfo.m_port);
+
+		auto container = inspector.m_container_manager.get_container("aaaa");
+		ASSERT_NE(nullptr, container);
+		EXPECT_EQ("saved_container", container->m_name);
+		inspector.close();
+	}
+
+	// Another socket behind the same fd number is read again
+	int other_fd = listen_socket();
+	ASSERT_NE(-1, other_fd);
+	ASSERT_EQ(fd, dup2(other_fd, fd));
+	close(other_fd);
+	{
+		sinsp inspector;
+		inspector.set_warm_restart_state(state.path());
+		inspector.open_nodriver();
+
+		sinsp_threadinfo* tinfo = inspector.get_thread_ref(getpid(), false).get();
+		ASSERT_NE(nullptr, tinfo);
+		EXPECT_EQ("saved_exe", tinfo->m_exe);
+		ASSERT_NE(nullptr, own_fd(inspector, fd));
+		EXPECT_NE(1, own_fd(inspector, fd)->m_sockinfo.m_ipv4serverinfo.m_port);
+		inspector.close();
+	}
+
+	// A missing state is a cold start
+	{
+		sinsp inspector;
+		inspector.set_warm_restart_state(state.path() + ".missing");
+		inspector.open_nodriver();
+
+		sinsp_threadinfo* tinfo = inspector.get_thread_ref(getpid(), false).get();
+		ASSERT_NE(nullptr, tinfo);
+		EXPECT_NE("saved_exe", tinfo->m_exe);
+		inspector.close();
+	}
+
+	close(fd);
+}
@@ -89,6 +89,9 @@ void sinsp_threadinfo::init()
 	m_category = CAT_NONE;
 	m_blprogram = NULL;
 	m_loginuid = 0;
+	m_derived_valid = 0;
+	m_ancestry_gen = 0;
+	m_ancestry_referenced = false;
 }
 
 sinsp_threadinfo::~sinsp_threadinfo()
@@ -103,7 +106,7 @@ sinsp_threadinfo::~sinsp_threadinfo()
 	m_private_state.clear();
 	if(m_lastevent_data)
 	{
-		free(m_lastevent_data);
+		m_inspector->m_enter_store.release(m_lastevent_data);
 	}
 
 	if(m_tracer_parser)
@@ -372,7 +375,11 @@ void sinsp_threadinfo::add_fd_from_scap(scap_fdinfo *fdi, OUT sinsp_fdinfo_t *re
 	//
 	if(do_add)
 	{
-		m_fdtable.add(fdi->fd, newfdi);
+		sinsp_fdinfo_t* added = m_fdtable.add(fdi->fd, newfdi);
+		if(added != NULL)
+		{
+			m_inspector->m_conn_index.add(this, fdi->fd, added);
+		}
 	}
 }
 
@@ -484,23 +491,104 @@ void sinsp_threadinfo::init(scap_threadinfo* pi)
 	}
 }
 
-std::string sinsp_threadinfo::get_comm() const
+const std::string& sinsp_threadinfo::get_comm() const
 {
 	return m_comm;
 }
 
-std::string sinsp_threadinfo::get_exe() const
+const std::string& sinsp_threadinfo::get_exe() const
 {
 	return m_exe;
 }
 
-std::string sinsp_threadinfo::get_exepath() const
+const std::string& sinsp_threadinfo::get_exepath() const
 {
 	return m_exepath;
 }
 
+#define DERIVED_ARGS (1 << 0)
+#define DERIVED_ENV (1 << 1)
+#define DERIVED_CMDLINE (1 << 2)
+#define DERIVED_EXELINE (1 << 3)
+
+static void join_strings(std::string& dst, const std::vector<std::string>& strs)
+{
+	for(uint32_t j = 0; j < strs.size(); j++)
+	{
+		if(j != 0)
+		{
+			dst += ' ';
+		}
+		dst += strs[j];
+	}
+}
+
+const std::string& sinsp_threadinfo::get_args_str()
+{
+	if(!(m_derived_valid & DERIVED_ARGS))
+	{
+		m_args_str.clear();
+		join_strings(m_args_str, m_args);
+		m_derived_valid |= DERIVED_ARGS;
+	}
+
+	return m_args_str;
+}
+
+const std::string& sinsp_threadinfo::get_env_str()
+{
+	//
+	// Kept by the thread that owns the environment, see get_env()
+	//
+	if(!is_main_thread())
+	{
+		sinsp_threadinfo* mtinfo = get_main_thread();
+		if(mtinfo != nullptr)
+		{
+			return mtinfo->get_env_str();
+		}
+	}
+
+	if(!(m_derived_valid & DERIVED_ENV))
+	{
+		m_env_str.clear();
+		join_strings(m_env_str, m_env);
+		m_derived_valid |= DERIVED_ENV;
+	}
+
+	return m_env_str;
+}
+
+const std::string& sinsp_threadinfo::get_cmdline()
+{
+	if(!(m_derived_valid & DERIVED_CMDLINE))
+	{
+		populate_cmdline(m_cmdline, this);
+		m_derived_valid |= DERIVED_CMDLINE;
+	}
+
+	return m_cmdline;
+}
+
+const std::string& sinsp_threadinfo::get_exeline()
+{
+	if(!(m_derived_valid & DERIVED_EXELINE))
+	{
+		m_exeline = m_exe;
+		m_exeline += ' ';
+		join_strings(m_exeline, m_args);
+		m_derived_valid |= DERIVED_EXELINE;
+	}
+
+	return m_exeline;
+}
+
 void sinsp_threadinfo::set_args(const char* args, size_t len)
 {
+	//
+	// m_comm and m_exe are set before the arguments, with the same event
+	//
+	clear_derived_fields();
 	m_args.clear();
 
 	size_t offset = 0;
@@ -513,6 +601,8 @@ void sinsp_threadinfo::set_args(const char* args, size_t len)
 
 void sinsp_threadinfo::set_env(const char* env, size_t len)
 {
+	clear_derived_fields();
+
 	if (len == SCAP_MAX_ENV_SIZE && m_inspector->large_envs_enabled())
 	{
 		// the environment is possibly truncated, try to read from /proc
@@ -669,6 +759,106 @@ sinsp_threadinfo* sinsp_threadinfo::get_parent_thread()
 	return &*m_inspector->get_thread_ref(m_ptid, false, true);
 }
 
+const vector<sinsp_threadinfo*>& sinsp_threadinfo::get_ancestors()
+{
+	uint64_t gen = m_inspector->m_thread_manager->get_ancestry_gen();
+	if(m_ancestry_gen == gen)
+	{
+		return m_ancestry;
+	}
+
+	//
+	// Walk up until an ancestor whose chain is still valid, and take
+	// the rest from it
+	//
+	m_ancestry.clear();
+	bool loop = false;
+	int64_t ptid = m_ptid;
+	sinsp_threadinfo* pt = get_parent_thread();
+	const vector<sinsp_threadinfo*>* rest = NULL;
+
+	while(pt != NULL && pt->m_tid != -1)
+	{
+		if(pt == this || std::find(m_ancestry.begin(), m_ancestry.end(), pt) != m_ancestry.end())
+		{
+			loop = true;
+			break;
+		}
+
+		m_ancestry.push_back(pt);
+
+		if(pt->m_ancestry_gen == gen)
+		{
+			rest = &pt->m_ancestry;
+			break;
+		}
+
+		ptid = pt->m_ptid;
+		pt = pt->get_parent_thread();
+	}
+
+	uint32_t nwalked = (uint32_t)m_ancestry.size();
+
+	if(rest != NULL)
+	{
+		for(sinsp_threadinfo* apt : *rest)
+		{
+			if(apt == this || std::find(m_ancestry.begin(), m_ancestry.begin() + nwalked, apt) != m_ancestry.begin() + nwalked)
+			{
+				loop = true;
+				break;
+			}
+
+			m_ancestry.push_back(apt);
+		}
+	}
+
+	for(sinsp_threadinfo* apt : m_ancestry)
+	{
+		apt->m_ancestry_referenced = true;
+	}
+
+	if(loop)
+	{
+		// Note we only log a loop once for a given main thread, to avoid flooding logs.
+		if(!m_parent_loop_detected)
+		{
+			g_logger.log(string("Loop in parent thread state detected for pid ") +
+				     std::to_string(m_pid) +
+				     ". stopped at tid= " + std::to_string(m_ancestry.empty() ? m_tid : m_ancestry.back()->m_tid),
+				     sinsp_logger::SEV_WARNING);
+			m_parent_loop_detected = true;
+		}
+
+		m_ancestry_gen = gen;
+		return m_ancestry;
+	}
+
+	//
+	// A chain that stops at a parent missing from the table is built
+	// again every time, the parent may show up later
+	//
+	if(rest == NULL && pt == NULL && ptid > 0)
+	{
+		return m_ancestry;
+	}
+
+	//
+	// The ancestors walked through get their chain too, so that their
+	// other descendants start from it
+	//
+	m_ancestry_gen = gen;
+	uint32_t nwalked_chains = rest != NULL ? nwalked - 1 : nwalked;
+	for(uint32_t j = 0; j < nwalked_chains; j++)
+	{
+		sinsp_threadinfo* apt = m_ancestry[j];
+		apt->m_ancestry.assign(m_ancestry.begin() + j + 1, m_ancestry.end());
+		apt->m_ancestry_gen = gen;
+	}
+
+	return m_ancestry;
+}
+
 sinsp_fdinfo_t* sinsp_threadinfo::add_fd(int64_t fd, sinsp_fdinfo_t *fdinfo)
 {
 	sinsp_fdinfo_t* res = get_fd_table()->add(fd, fdinfo);
@@ -751,8 +941,10 @@ sinsp_threadinfo* sinsp_threadinfo::get_cwd_root()
 	}
 }
 
-string sinsp_threadinfo::get_cwd()
+const string& sinsp_threadinfo::get_cwd()
 {
+	static const string unknown_cwd = "./";
+
 	// Ideally we should use get_cwd_root()
 	// but scap does not read CLONE_FS from /proc
 	// Also glibc and muslc use always
@@ -767,7 +959,7 @@ string sinsp_threadinfo::get_cwd()
 	else
 	{
 		ASSERT(false);
-		return "./";
+		return unknown_cwd;
 	}
 }
 
@@ -902,50 +1094,12 @@ const std::string& sinsp_threadinfo::get_cgroup(const std::string& subsys) const
 
 void sinsp_threadinfo::traverse_parent_state(visitor_func_t &visitor)
 {
-	// Use two pointers starting at this, traversing the parent
-	// state, at different rates. If they ever equal each other
-	// before slow is NULL there's a loop.
-
-	sinsp_threadinfo *slow=this->get_parent_thread(), *fast=slow;
-
-	// Move fast to its parent
-	fast = (fast ? fast->get_parent_thread() : fast);
-
-	// The slow pointer must be valid and not have a tid of -1.
-	while(slow && slow->m_tid != -1)
+	for(sinsp_threadinfo* pt : get_ancestors())
 	{
-		if(!visitor(slow))
+		if(!visitor(pt))
 		{
 			break;
 		}
-
-		// Advance slow one step and advance fast two steps
-		slow = slow->get_parent_thread();
-
-		// advance fast 2 steps, checking to see if we meet
-		// slow after each step.
-		for (uint32_t i = 0; i < 2; i++) {
-			fast = (fast ? fast->get_parent_thread() : fast);
-
-			// If not at the end but fast == slow or if
-			// slow points to itself, there's a loop in
-			// the thread state.
-			if(slow && (slow == fast ||
-				    slow->m_tid == slow->m_ptid))
-			{
-				// Note we only log a loop once for a given main thread, to avoid flooding logs.
-				if(!m_parent_loop_detected)
-				{
-					g_logger.log(string("Loop in parent thread state detected for pid ") +
-						     std::to_string(m_pid) +
-						     ". stopped at tid= " + std::to_string(slow->m_tid) +
-						     " ptid=" + std::to_string(slow->m_ptid),
-						     sinsp_logger::SEV_WARNING);
-					m_parent_loop_detected = true;
-				}
-				return;
-			}
-		}
 	}
 }
 
@@ -958,7 +1112,8 @@ void sinsp_threadinfo::populate_cmdline(string &cmdline, const sinsp_threadinfo
 
 	for(j = 0; j < nargs; j++)
 	{
-		cmdline += " " + tinfo->m_args[j];
+		cmdline += ' ';
+		cmdline += tinfo->m_args[j];
 	}
 }
 
@@ -1220,6 +1375,7 @@ sinsp_thread_manager::sinsp_thread_manager(sinsp* inspector)
 void sinsp_thread_manager::clear()
 {
 	m_threadtable.clear();
+	invalidate_ancestry();
 	m_last_tid = 0;
 	m_last_tinfo.reset();
 	m_last_flush_time_ns = 0;
@@ -1280,11 +1436,30 @@ bool sinsp_thread_manager::add_thread(sinsp_threadinfo *threadinfo, bool from_sc
 		return false;
 	}
 
+	if(
+#if defined(HAS_CAPTURE)
+		threadinfo->m_pid != m_inspector->m_sysdig_pid &&
+#endif
+		!m_inspector->m_memory_budget.can_add_thread())
+	{
+		m_n_drops++;
+		return false;
+	}
+
 	if(!from_scap_proctable)
 	{
 		increment_mainthread_childcount(threadinfo);
 	}
 
+	//
+	// A thread replaced in the table can't stay in the chains
+	//
+	sinsp_threadinfo* replaced = m_threadtable.get(threadinfo->m_tid);
+	if(replaced != nullptr && replaced->m_ancestry_referenced)
+	{
+		invalidate_ancestry();
+	}
+
 	threadinfo->compute_program_hash();
 	threadinfo->allocate_private_state();
 	m_threadtable.put(threadinfo);
@@ -1375,6 +1550,15 @@ void sinsp_thread_manager::remove_thread(int64_t tid, bool force)
 		m_removed_threads->increment();
 #endif
 
+		//
+		// The chains it's part of would point to a deleted thread. The
+		// ones that never forked, most of the exiting ones, aren't in any.
+		//
+		if(tinfo->m_ancestry_referenced)
+		{
+			invalidate_ancestry();
+		}
+
 		m_threadtable.erase(tid);
 
 		//
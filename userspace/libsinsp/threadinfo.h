@@ -73,22 +73,22 @@ public:
 	/*!
 	  \brief Return the name of the process containing this thread, e.g. "top".
 	*/
-	std::string get_comm() const;
+	const std::string& get_comm() const;
 
 	/*!
 	  \brief Return the name of the process containing this thread from argv[0], e.g. "/bin/top".
 	*/
-	std::string get_exe() const;
+	const std::string& get_exe() const;
 
 	/*!
 	  \brief Return the full executable path of the process containing this thread, e.g. "/bin/top".
 	*/
-	std::string get_exepath() const;
+	const std::string& get_exepath() const;
 
 	/*!
 	  \brief Return the working directory of the process containing this thread.
 	*/
-	std::string get_cwd();
+	const std::string& get_cwd();
 
 	/*!
 	  \brief Return the values of all environment variables for the process
@@ -96,6 +96,40 @@ public:
 	*/
 	const std::vector<std::string>& get_env();
 
+	/*!
+	  \brief Return the arguments joined by spaces, e.g. "-d1 -n2". Like
+	  the other derived strings below, it's built on first use and kept
+	  until the fields it's made of change.
+	*/
+	const std::string& get_args_str();
+
+	/*!
+	  \brief Return the environment variables of the process containing
+	  this thread, joined by spaces.
+	*/
+	const std::string& get_env_str();
+
+	/*!
+	  \brief Return the command name followed by the arguments, e.g.
+	  "top -d1".
+	*/
+	const std::string& get_cmdline();
+
+	/*!
+	  \brief Return the executable name followed by the arguments, e.g.
+	  "/bin/top -d1".
+	*/
+	const std::string& get_exeline();
+
+	/*!
+	  \brief Drop the derived strings. To be called after changing m_comm,
+	  m_exe, m_args or m_env directly: set_args() and set_env() do it.
+	*/
+	void clear_derived_fields()
+	{
+		m_derived_valid = 0;
+	}
+
 	/*!
 	  \brief Return the value of the specified environment variable for the process
 	  containing this thread. Returns empty string if variable is not found.
@@ -155,6 +189,16 @@ public:
 	*/
 	sinsp_threadinfo* get_parent_thread();
 
+	/*!
+	  \brief Get the ancestors of this thread, the parent first, up to the
+	  first one that isn't in the thread table or to a loop.
+
+	  \note The chain is built once and reused until a thread in it leaves
+	  the table or gets another parent: the reference is only valid until
+	  the next event.
+	*/
+	const std::vector<sinsp_threadinfo*>& get_ancestors();
+
 	/*!
 	  \brief Retrieve information about one of this thread/process FDs.
 
@@ -224,7 +268,7 @@ public:
 	//
 	// Walk up the parent process hierarchy, calling the provided
 	// function for each node. If the function returns false, the
-	// traversal stops.
+	// traversal stops. The nodes are the ones of get_ancestors().
 	//
 	typedef std::function<bool (sinsp_threadinfo *)> visitor_func_t;
 	void traverse_parent_state(visitor_func_t &visitor);
@@ -431,6 +475,19 @@ VISIBILITY_PRIVATE
 	//
 	sinsp_fdtable m_fdtable; // The fd table of this thread
 	std::string m_cwd; // current working directory
+	// The strings returned by get_args_str() and the like, valid when their
+	// DERIVED_* flag is set in m_derived_valid
+	std::string m_args_str;
+	std::string m_env_str;
+	std::string m_cmdline;
+	std::string m_exeline;
+	uint8_t m_derived_valid;
+	// The chain returned by get_ancestors(), valid when m_ancestry_gen is the
+	// one of the thread manager. m_ancestry_referenced is set once this
+	// thread is part of a chain, so that its removal invalidates them.
+	std::vector<sinsp_threadinfo*> m_ancestry;
+	uint64_t m_ancestry_gen;
+	bool m_ancestry_referenced;
 	mutable std::weak_ptr<sinsp_threadinfo> m_main_thread;
 	uint8_t* m_lastevent_data; // Used by some event parsers to store the last enter event
 	std::vector<void*> m_private_state;
@@ -451,6 +508,7 @@ VISIBILITY_PRIVATE
 	friend class sinsp_tracerparser;
 	friend class lua_cbacks;
 	friend class sinsp_baseliner;
+	friend class sinsp_memory_budget;
 };
 
 /*@}*/
@@ -632,6 +690,20 @@ public:
 
 	void set_m_max_n_proc_lookups(int32_t val) { m_max_n_proc_lookups = val; }
 	void set_m_max_n_proc_socket_lookups(int32_t val) { m_max_n_proc_socket_lookups = val; }
+
+	//
+	// Drops the ancestor chains of all the threads, e.g. after the parent
+	// of one of them changed
+	//
+	void invalidate_ancestry()
+	{
+		m_ancestry_gen++;
+	}
+
+	uint64_t get_ancestry_gen() const
+	{
+		return m_ancestry_gen;
+	}
 private:
 	void increment_mainthread_childcount(sinsp_threadinfo* threadinfo);
 	inline void clear_thread_pointers(sinsp_threadinfo& threadinfo);
@@ -651,6 +723,8 @@ private:
 	int32_t m_n_main_thread_lookups = 0;
 	int32_t m_max_n_proc_lookups = -1;
 	int32_t m_max_n_proc_socket_lookups = -1;
+	// Starts above the one of the new threads, whose chains aren't built
+	uint64_t m_ancestry_gen = 1;
 
 	INTERNAL_COUNTER(m_failed_lookups);
 	INTERNAL_COUNTER(m_cached_lookups);
@@ -16,10 +16,85 @@ limitations under the License.
 */
 
 #include <time.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include "sinsp.h"
 #include "sinsp_int.h"
 #include "tracers.h"
 
+//
+// Returns the first character of p that is either a zero or one of the
+// delimiters, NULL if there's none in the first maxlen characters
+//
+template<size_t N>
+static inline char* scan_delims_scalar(char* p, const char (&delims)[N], uint32_t maxlen)
+{
+	for(uint32_t j = 0; j < maxlen; j++, p++)
+	{
+		if(*p == 0)
+		{
+			return p;
+		}
+
+		for(size_t k = 0; k < N - 1; k++)
+		{
+			if(*p == delims[k])
+			{
+				return p;
+			}
+		}
+	}
+
+	return NULL;
+}
+
+//
+// Returns the first character of p that is either a zero or one of the
+// delimiters, 16 bytes at a time when SSE2 is available. The parser storage
+// has TRACER_SCAN_PADDING bytes after the terminating zero, so the vector
+// loads never go past its end.
+//
+template<size_t N>
+static inline char* scan_delims(char* p, const char (&delims)[N])
+{
+#ifdef __SSE2__
+	//
+	// Most tokens are short, and the vector loads are slow right after the
+	// byte stores of the parser, so the first bytes are done one by one
+	//
+	char* res = scan_delims_scalar(p, delims, 16);
+	if(res != NULL)
+	{
+		return res;
+	}
+	p += 16;
+
+	const __m128i zero = _mm_setzero_si128();
+
+	while(true)
+	{
+		__m128i chunk = _mm_loadu_si128((const __m128i*)p);
+		__m128i hits = _mm_cmpeq_epi8(chunk, zero);
+
+		for(size_t j = 0; j < N - 1; j++)
+		{
+			hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(delims[j])));
+		}
+
+		int mask = _mm_movemask_epi8(hits);
+		if(mask != 0)
+		{
+			return p + __builtin_ctz(mask);
+		}
+
+		p += 16;
+	}
+#else
+	return scan_delims_scalar(p, delims, UINT32_MAX);
+#endif
+}
+
 sinsp_tracerparser::sinsp_tracerparser(sinsp *inspector)
 {
 	m_inspector = inspector;
@@ -57,9 +132,9 @@ sinsp_tracerparser::parse_result sinsp_tracerparser::process_event_data(char *da
 	//
 	// Make sure we have enough space in the buffer and copy the data into it
 	//
-	if(m_storage_size < m_storlen + 1)
+	if(m_storage_size < m_storlen + 1 + TRACER_SCAN_PADDING)
 	{
-		set_storage_size(m_storlen + 1);
+		set_storage_size(m_storlen + 1 + TRACER_SCAN_PADDING);
 	}
 
 	memcpy(m_storage + m_fragment_size, data, datalen);
@@ -172,7 +247,7 @@ sinsp_tracerparser::parse_result sinsp_tracerparser::process_event_data(char *da
 
 	//
 	// If this is an enter event, allocate a sinsp_partial_tracer object and
-	// push it to the list
+	// push it to the list and to the index
 	//
 	if(m_type_str[0] == '>')
 	{
@@ -184,52 +259,47 @@ sinsp_tracerparser::parse_result sinsp_tracerparser::process_event_data(char *da
 			// the entries will be stuck there forever. Better clean the list, miss the 128
 			// events it contains, and start fresh.
 			//
-			list<sinsp_partial_tracer*>* partial_tracers_list = &m_inspector->m_partial_tracers_list;
-			list<sinsp_partial_tracer*>::iterator it;
-
-			for(it = partial_tracers_list->begin(); it != partial_tracers_list->end(); ++it)
-			{
-				m_inspector->m_partial_tracers_pool->push(*it);
-			}
-
-			partial_tracers_list->clear();
-
+			clear_partial_tracers();
 			return sinsp_tracerparser::RES_OK;
 		}
 
 		init_partial_tracer(pae);
 		pae->m_time = ts;
+		pae->m_hash = sinsp_partial_tracer::hash(m_id, m_tags, m_taglens, pae->m_ntags);
 		m_inspector->m_partial_tracers_list.push_front(pae);
+		pae->m_list_it = m_inspector->m_partial_tracers_list.begin();
+		index_add(pae);
 		m_enter_pae = pae;
 	}
 	else
 	{
-		list<sinsp_partial_tracer*>* partial_tracers_list = &m_inspector->m_partial_tracers_list;
-		list<sinsp_partial_tracer*>::iterator it;
-
-		init_partial_tracer(&m_exit_pae);
+		//
+		// The exit span only lives as long as the event, so it points into
+		// the storage instead of packing a copy of it
+		//
+		init_exit_pae();
 
-		for(it = partial_tracers_list->begin(); it != partial_tracers_list->end(); ++it)
+		sinsp_partial_tracer* pae = find_enter_pae(
+			sinsp_partial_tracer::hash(m_id, m_tags, m_taglens, m_exit_pae.m_ntags));
+		if(pae != NULL)
 		{
-			if(m_exit_pae.compare(*it) == true)
-			{
-				m_exit_pae.m_time = ts;
-
-				//
-				// This is a bit tricky and deserves some explanation:
-				// despite removing the pae and returning it to the available pool,
-				// we link to it so that the filters will use it. We do that as an
-				// optimization (it avoids making a copy or implementing logic for 
-				// delayed list removal), and we base it on the assumption that,
-				// since the processing is strictly sequential and single thread,
-				// nobody will modify the pae until the event is fully processed.
-				//
-				m_enter_pae = *it;
-
-				m_inspector->m_partial_tracers_pool->push(*it);
-				partial_tracers_list->erase(it);
-				return sinsp_tracerparser::RES_OK;
-			}
+			m_exit_pae.m_time = ts;
+
+			//
+			// This is a bit tricky and deserves some explanation:
+			// despite removing the pae and returning it to the available pool,
+			// we link to it so that the filters will use it. We do that as an
+			// optimization (it avoids making a copy or implementing logic for 
+			// delayed list removal), and we base it on the assumption that,
+			// since the processing is strictly sequential and single thread,
+			// nobody will modify the pae until the event is fully processed.
+			//
+			m_enter_pae = pae;
+
+			index_remove(pae);
+			m_inspector->m_partial_tracers_list.erase(pae->m_list_it);
+			m_inspector->m_partial_tracers_pool->push(pae);
+			return sinsp_tracerparser::RES_OK;
 		}
 
 		m_enter_pae = NULL;
@@ -238,34 +308,117 @@ sinsp_tracerparser::parse_result sinsp_tracerparser::process_event_data(char *da
 	return sinsp_tracerparser::RES_OK;
 }
 
-sinsp_partial_tracer* sinsp_tracerparser::find_parent_enter_pae()
+void sinsp_tracerparser::clear_partial_tracers()
 {
 	list<sinsp_partial_tracer*>* partial_tracers_list = &m_inspector->m_partial_tracers_list;
 	list<sinsp_partial_tracer*>::iterator it;
 
-	char* tse = m_enter_pae->m_tags_storage + m_tot_taglens;
-	if(*tse == 0 && tse > m_enter_pae->m_tags_storage)
+	for(it = partial_tracers_list->begin(); it != partial_tracers_list->end(); ++it)
+	{
+		m_inspector->m_partial_tracers_pool->push(*it);
+	}
+
+	partial_tracers_list->clear();
+	m_inspector->m_partial_tracers_index.clear();
+}
+
+//
+// The most recent enter span with the ID and the tags that have just been
+// parsed
+//
+inline sinsp_partial_tracer* sinsp_tracerparser::find_enter_pae(uint64_t hash)
+{
+	auto it = m_inspector->m_partial_tracers_index.find(hash);
+	if(it == m_inspector->m_partial_tracers_index.end())
+	{
+		return NULL;
+	}
+
+	for(sinsp_partial_tracer* pae = it->second; pae != NULL; pae = pae->m_hash_next)
+	{
+		if(pae->match(m_id, m_tags, m_taglens, (uint32_t)m_tags.size()))
+		{
+			return pae;
+		}
+	}
+
+	return NULL;
+}
+
+//
+// Each hash has a chain of spans, most recent first. The chains that become
+// empty are left in the index, since the same spans tend to come back, and
+// only purged when there are too many of them.
+//
+inline void sinsp_tracerparser::index_add(sinsp_partial_tracer* pae)
+{
+	unordered_map<uint64_t, sinsp_partial_tracer*>* index = &m_inspector->m_partial_tracers_index;
+
+	if(index->size() >= MAX_PARTIAL_TRACERS_INDEX_SIZE)
+	{
+		for(auto it = index->begin(); it != index->end();)
+		{
+			if(it->second == NULL)
+			{
+				it = index->erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+
+	sinsp_partial_tracer*& head = (*index)[pae->m_hash];
+	pae->m_hash_next = head;
+	head = pae;
+}
+
+inline void sinsp_tracerparser::index_remove(sinsp_partial_tracer* pae)
+{
+	auto it = m_inspector->m_partial_tracers_index.find(pae->m_hash);
+	if(it == m_inspector->m_partial_tracers_index.end())
 	{
-		--tse;
+		ASSERT(false);
+		return;
 	}
 
-	uint32_t len = 0;
-	while(tse != m_enter_pae->m_tags_storage)
+	for(sinsp_partial_tracer** cur = &it->second; *cur != NULL; cur = &(*cur)->m_hash_next)
 	{
-		if(*tse == 0)
+		if(*cur == pae)
 		{
-			len = tse - m_enter_pae->m_tags_storage + 1; // 1 is for the trailing zero
+			*cur = pae->m_hash_next;
 			break;
 		}
+	}
+
+	pae->m_hash_next = NULL;
+}
 
-		--tse;
+sinsp_partial_tracer* sinsp_tracerparser::find_parent_enter_pae()
+{
+	if(m_enter_pae->m_ntags == 0)
+	{
+		return NULL;
 	}
 
-	for(it = partial_tracers_list->begin(); it != partial_tracers_list->end(); ++it)
+	uint32_t nparent_tags = m_enter_pae->m_ntags - 1;
+	uint64_t hash = sinsp_partial_tracer::hash(m_enter_pae->m_id,
+		m_enter_pae->m_tags,
+		m_enter_pae->m_taglens,
+		nparent_tags);
+
+	auto it = m_inspector->m_partial_tracers_index.find(hash);
+	if(it == m_inspector->m_partial_tracers_index.end())
+	{
+		return NULL;
+	}
+
+	for(sinsp_partial_tracer* pae = it->second; pae != NULL; pae = pae->m_hash_next)
 	{
-		if(m_enter_pae->compare(*it, len) == true)
+		if(pae->match(m_enter_pae->m_id, m_enter_pae->m_tags, m_enter_pae->m_taglens, nparent_tags))
 		{
-			return *it;
+			return pae;
 		}
 	}
 
@@ -647,6 +800,8 @@ inline void sinsp_tracerparser::parse_simple(char* evtstr)
 					continue;
 				}
 
+				p = scan_delims(p, "\\.:><=\n");
+
 				if(*p == '\\')
 				{
 					ASSERT(dont_interpret_next_char == false);
@@ -655,18 +810,14 @@ inline void sinsp_tracerparser::parse_simple(char* evtstr)
 					continue;
 				}
 
-				if(*p == '.' || *p == ':')
+				if(*p == '.' || *p == ':' || *p == 0)
 				{
 					break;
 				}
 
-				if(*p == '>' || *p == '<' || *p == '=' || *p == '\n')
-				{
-					m_res = sinsp_tracerparser::RES_FAILED;
-					return;
-				}
-
-				++p;
+				// '>', '<', '=' or '\n'
+				m_res = sinsp_tracerparser::RES_FAILED;
+				return;
 			}
 
 			m_taglens.push_back((uint32_t)(p - start));
@@ -723,6 +874,8 @@ inline void sinsp_tracerparser::parse_simple(char* evtstr)
 					continue;
 				}
 
+				p = scan_delims(p, "\\=><\n");
+
 				if(*p == '\\')
 				{
 					ASSERT(dont_interpret_next_char == false);
@@ -731,18 +884,14 @@ inline void sinsp_tracerparser::parse_simple(char* evtstr)
 					continue;
 				}
 
-				if(*p == '=')
+				if(*p == '=' || *p == 0)
 				{
 					break;
 				}
 
-				if(*p == '>' || *p == '<' || *p == '\n')
-				{
-					m_res = sinsp_tracerparser::RES_FAILED;
-					return;
-				}
-
-				++p;
+				// '>', '<' or '\n'
+				m_res = sinsp_tracerparser::RES_FAILED;
+				return;
 			}
 
 			m_argnamelens.push_back((uint32_t)(p - start));
@@ -787,6 +936,8 @@ inline void sinsp_tracerparser::parse_simple(char* evtstr)
 					continue;
 				}
 
+				p = scan_delims(p, "\\,:=");
+
 				if(*p == '\\')
 				{
 					ASSERT(dont_interpret_next_char == false);
@@ -795,12 +946,7 @@ inline void sinsp_tracerparser::parse_simple(char* evtstr)
 					continue;
 				}
 
-				if(*p == ',' || *p == ':' || *p == '=')
-				{
-					break;
-				}
-
-				++p;
+				break;
 			}
 
 			m_argvallens.push_back((uint32_t)(p - start));
@@ -1071,14 +1217,21 @@ inline sinsp_tracerparser::parse_result sinsp_tracerparser::parsestr(char* p, ch
 	//
 	// Navigate to the end of the string
 	//
-	while(!(*p == '\"' && *(p - 1) != '\\'))
+	while(true)
 	{
+		p = scan_delims(p, "\"");
+
 		if(*p == 0)
 		{
 			*delta = (uint32_t)(p - initial + 1);
 			return sinsp_tracerparser::RES_TRUNCATED;
 		}
 
+		if(*(p - 1) != '\\')
+		{
+			break;
+		}
+
 		p++;
 	}
 
@@ -1300,6 +1453,26 @@ inline void sinsp_tracerparser::init_partial_tracer(sinsp_partial_tracer* pae)
 	pae->m_argvals_len = (uint32_t)(p - pae->m_argvals_storage);
 }
 
+inline void sinsp_tracerparser::init_exit_pae()
+{
+	ASSERT(m_tinfo != NULL);
+	m_exit_pae.m_tid = m_tinfo->m_tid;
+	m_exit_pae.m_id = m_id;
+
+	m_exit_pae.m_tags = m_tags;
+	m_exit_pae.m_taglens = m_taglens;
+	m_exit_pae.m_ntags = (uint32_t)m_tags.size();
+	m_exit_pae.m_tags_len = m_tot_taglens + m_exit_pae.m_ntags + 1;
+
+	m_exit_pae.m_argnames = m_argnames;
+	m_exit_pae.m_argnamelens = m_argnamelens;
+	m_exit_pae.m_argvals = m_argvals;
+	m_exit_pae.m_argvallens = m_argvallens;
+	m_exit_pae.m_nargs = (uint32_t)m_argnames.size();
+	m_exit_pae.m_argnames_len = m_tot_argnamelens + m_exit_pae.m_nargs + 1;
+	m_exit_pae.m_argvals_len = m_tot_argvallens + m_exit_pae.m_nargs + 1;
+}
+
 void sinsp_tracerparser::test()
 {
 	char doc1[] = "[\">\",     12345, [\"mysql\", \"query\", \"init\"], [{\"argname1\":\"argval1\"}, {\"argname2\":\"argval2\"}, {\"argname3\":\"argval3\"}]]";
@@ -17,6 +17,24 @@ limitations under the License.
 
 #define UESTORAGE_INITIAL_BUFSIZE 256
 
+//
+// Extra bytes at the end of the tracer parser storage, so that the delimiter
+// scans can always read 16 bytes at a time past the terminating zero
+//
+#define TRACER_SCAN_PADDING 16
+
+//
+// Number of hashes in sinsp::m_partial_tracers_index past which the empty
+// ones get purged
+//
+#define MAX_PARTIAL_TRACERS_INDEX_SIZE 1024
+
+//
+// The span hash works on 64 bit words, FNV style
+//
+#define TRACER_HASH_SEED 14695981039346656037ULL
+#define TRACER_HASH_PRIME 0x9e3779b97f4a7c15ULL
+
 ///////////////////////////////////////////////////////////////////////////////
 // A partial tracer
 ///////////////////////////////////////////////////////////////////////////////
@@ -31,6 +49,8 @@ public:
 		m_tags_storage_size = UESTORAGE_INITIAL_BUFSIZE;
 		m_argnames_storage_size = UESTORAGE_INITIAL_BUFSIZE;
 		m_argvals_storage_size = UESTORAGE_INITIAL_BUFSIZE;
+		m_hash = 0;
+		m_hash_next = NULL;
 	}
 
 	~sinsp_partial_tracer()
@@ -51,48 +71,55 @@ public:
 		}
 	}
 
-	inline bool compare(sinsp_partial_tracer* other)
+	//
+	// Whether this span has the given ID and its first ntags tags are
+	// exactly the given ones
+	//
+	inline bool match(uint64_t id, const vector<char*>& tags, const vector<uint32_t>& taglens, uint32_t ntags)
 	{
-		if(m_id != other->m_id)
-		{
-			return false;
-		}
-
-		if(m_tags_len != other->m_tags_len)
+		if(m_id != id || m_ntags != ntags)
 		{
 			return false;
 		}
 
-		if(memcmp(m_tags_storage, 
-			other->m_tags_storage,
-			m_tags_len) == 0)
+		for(uint32_t j = 0; j < ntags; j++)
 		{
-			return true;
+			if(m_taglens[j] != taglens[j] ||
+				memcmp(m_tags[j], tags[j], taglens[j]) != 0)
+			{
+				return false;
+			}
 		}
 
-		return false;
+		return true;
 	}
 
-	inline bool compare(sinsp_partial_tracer* other, uint32_t len)
+	//
+	// The hash of an ID and of the first ntags tags. The parent of a span
+	// is the one whose hash covers the same ID and tags minus the last one.
+	//
+	static inline uint64_t hash(uint64_t id, const vector<char*>& tags, const vector<uint32_t>& taglens, uint32_t ntags)
 	{
-		if(m_id != other->m_id)
-		{
-			return false;
-		}
+		uint64_t res = mix(TRACER_HASH_SEED, id);
 
-		if(len != other->m_tags_len - 1)
+		for(uint32_t j = 0; j < ntags; j++)
 		{
-			return false;
-		}
-
-		if(memcmp(m_tags_storage, 
-			other->m_tags_storage,
-			len) == 0)
-		{
-			return true;
+			const char* p = tags[j];
+			uint32_t len = taglens[j];
+			uint64_t w;
+
+			for(; len >= sizeof(w); len -= sizeof(w), p += sizeof(w))
+			{
+				memcpy(&w, p, sizeof(w));
+				res = mix(res, w);
+			}
+
+			w = 0;
+			memcpy(&w, p, len);
+			res = mix(res, w ^ ((uint64_t)taglens[j] << 56));
 		}
 
-		return false;
+		return res;
 	}
 
 	char* m_tags_storage;
@@ -116,6 +143,22 @@ public:
 
 	uint64_t m_time;
 	uint64_t m_tid;
+
+	//
+	// Only for the enter spans waiting for their exit: the position in
+	// sinsp::m_partial_tracers_list and the next span with the same hash
+	// in sinsp::m_partial_tracers_index
+	//
+	uint64_t m_hash;
+	sinsp_partial_tracer* m_hash_next;
+	list<sinsp_partial_tracer*>::iterator m_list_it;
+
+private:
+	static inline uint64_t mix(uint64_t hash, uint64_t w)
+	{
+		hash = (hash ^ w) * TRACER_HASH_PRIME;
+		return hash ^ (hash >> 29);
+	}
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -173,6 +216,11 @@ VISIBILITY_PRIVATE
 	inline parse_result parsenumber(char* p, int64_t* res, uint32_t* delta);
 	inline parse_result parsenumber_colend(char* p, int64_t* res, uint32_t* delta);
 	inline void init_partial_tracer(sinsp_partial_tracer* pae);
+	inline void init_exit_pae();
+	inline sinsp_partial_tracer* find_enter_pae(uint64_t hash);
+	inline void index_add(sinsp_partial_tracer* pae);
+	inline void index_remove(sinsp_partial_tracer* pae);
+	void clear_partial_tracers();
 	inline void delete_char(char* p);
 
 	string m_fullfragment_storage_str;
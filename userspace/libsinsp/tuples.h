@@ -18,6 +18,7 @@ limitations under the License.
 #pragma once
 
 #include <stdint.h>
+#include <functional>
 
 /** @defgroup state State management
  *  @{
@@ -60,6 +61,18 @@ typedef struct _ipv6addr
 	static struct _ipv6addr empty_address;
 }ipv6addr;
 
+namespace std
+{
+template<> struct hash<ipv6addr>
+{
+	std::size_t operator()(const ipv6addr& a) const
+	{
+		return std::hash<uint64_t>{}((((uint64_t)a.m_b[0] << 32) | a.m_b[1]) ^
+					     (((uint64_t)a.m_b[2] << 32) | a.m_b[3]));
+	}
+};
+}
+
 
 /*!
 	\brief An IPv6 tuple. 